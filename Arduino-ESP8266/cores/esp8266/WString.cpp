@@ -326,8 +326,9 @@ unsigned char String::concat(const char *cstr, unsigned int length) {
         return 1;
     if(!reserve(newlen))
         return 0;
-    strcpy(wbuffer() + len(), cstr);
+    memmove(wbuffer() + len(), cstr, length);
     setLen(newlen);
+    wbuffer()[newlen] = 0;
     return 1;
 }
 
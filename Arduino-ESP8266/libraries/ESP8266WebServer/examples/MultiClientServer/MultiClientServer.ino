@@ -0,0 +1,149 @@
+/*
+  Serves several clients at once, for example a few browser dashboards and
+  a collector polling the same readings. Each one keeps its connection open
+  between requests, a slow client does not hold up the others.
+
+  The latest readings are rendered once per sample into a ResponseCache and
+  sent as they are, a client sending the ETag it has gets a 304. The history
+  goes out in chunks, without building it in memory.
+
+  Try it with:
+    curl -s http://esp8266.local/readings http://esp8266.local/readings
+  which makes both requests over one connection.
+*/
+
+#include <ESP8266WiFi.h>
+#include <WiFiClient.h>
+#include <ESP8266WebServer.h>
+#include <ESP8266mDNS.h>
+
+#ifndef STASSID
+#define STASSID "your-ssid"
+#define STAPSK  "your-password"
+#endif
+
+#define SAMPLE_INTERVAL 10000 // ms
+#define HISTORY 64            // samples kept
+
+const char* ssid = STASSID;
+const char* password = STAPSK;
+
+ESP8266WebServer server(80);
+
+struct Sample {
+  unsigned long uptime;
+  uint32_t heap;
+  int32_t rssi;
+};
+
+Sample history[HISTORY];
+int samples = 0;
+unsigned long lastSample = 0;
+
+int sampleIndex(int n) {
+  return (samples - n - 1 + HISTORY) % HISTORY; // n = 0 is the latest
+}
+
+void printSample(Print& out, const Sample& sample) {
+  out.printf("{\"uptime\":%lu,\"heap\":%u,\"rssi\":%d}", sample.uptime, (unsigned) sample.heap, (int) sample.rssi);
+}
+
+ResponseCache readings(128, "application/json", [](Print& out) {
+  if (samples) {
+    printSample(out, history[sampleIndex(0)]);
+  } else {
+    out.print("{}");
+  }
+});
+
+void takeSample() {
+  Sample& sample = history[samples % HISTORY];
+  lastSample = millis();
+  sample.uptime = lastSample;
+  sample.heap = ESP.getFreeHeap();
+  sample.rssi = WiFi.RSSI();
+  samples++;
+  // rendered again on the next request only
+  readings.invalidate();
+}
+
+// a Print writing into a buffer on the stack, sent as one chunk when full
+class ChunkPrint : public Print {
+public:
+  size_t write(uint8_t c) override {
+    if (len == sizeof(buf))
+      flush();
+    buf[len++] = c;
+    return 1;
+  }
+  void flush() override {
+    if (len)
+      server.sendContent(buf, len);
+    len = 0;
+  }
+private:
+  char buf[256];
+  size_t len = 0;
+};
+
+void handleHistory() {
+  int count = samples < HISTORY ? samples : HISTORY;
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", emptyString);
+  ChunkPrint out;
+  out.print('[');
+  for (int n = 0; n < count; n++) {
+    if (n)
+      out.print(',');
+    printSample(out, history[sampleIndex(n)]);
+  }
+  out.print(']');
+  out.flush();
+}
+
+void setup(void) {
+  Serial.begin(115200);
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(ssid, password);
+  Serial.println("");
+
+  // Wait for connection
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(500);
+    Serial.print(".");
+  }
+  Serial.println("");
+  Serial.print("Connected to ");
+  Serial.println(ssid);
+  Serial.print("IP address: ");
+  Serial.println(WiFi.localIP());
+
+  if (MDNS.begin("esp8266")) {
+    Serial.println("MDNS responder started");
+  }
+
+  server.on("/readings", []() {
+    server.send(readings);
+  });
+  server.on("/history", handleHistory);
+
+  server.onNotFound([]() {
+    server.send(404, "text/plain", "Not found");
+  });
+
+  // up to 4 connections at once
+  server.setMaxClients(4);
+  server.begin();
+  Serial.println("HTTP server started");
+
+  takeSample();
+}
+
+void loop(void) {
+  server.handleClient();
+  MDNS.update();
+
+  if (millis() - lastSample >= SAMPLE_INTERVAL) {
+    takeSample();
+  }
+}
@@ -1,6 +1,6 @@
 /*
   ESP8266WebServer.cpp - Dead simple web-server.
-  Supports only one simultaneous client, knows how to handle GET and POST.
+  Supports one or a pool of simultaneous clients, knows how to handle GET and POST.
 
   Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
 
@@ -21,6 +21,7 @@
 */
 
 
+#include <algorithm>
 #include <Arduino.h>
 #include <libb64/cencode.h>
 #include "WiFiServer.h"
@@ -49,17 +50,30 @@ ESP8266WebServer::ESP8266WebServer(IPAddress addr, int port)
 , _currentVersion(0)
 , _currentStatus(HC_NONE)
 , _statusChange(0)
+, _keepAlive(false)
+, _clientKeepAlive(false)
+, _slots(nullptr)
+, _slotCount(0)
+, _nextSlot(0)
 , _currentHandler(nullptr)
 , _firstHandler(nullptr)
 , _lastHandler(nullptr)
+, _routes(nullptr)
+, _routeCount(0)
+, _handlerCount(0)
+, _routesValid(false)
 , _currentArgCount(0)
 , _currentArgs(nullptr)
+, _currentArgCapacity(0)
 , _postArgsLen(0)
 , _postArgs(nullptr)
 , _headerKeysCount(0)
 , _currentHeaders(nullptr)
 , _contentLength(0)
 , _chunked(false)
+, _ifNoneMatch()
+, _isForm(false)
+, _isEncoded(false)
 {
 }
 
@@ -69,17 +83,30 @@ ESP8266WebServer::ESP8266WebServer(int port)
 , _currentVersion(0)
 , _currentStatus(HC_NONE)
 , _statusChange(0)
+, _keepAlive(false)
+, _clientKeepAlive(false)
+, _slots(nullptr)
+, _slotCount(0)
+, _nextSlot(0)
 , _currentHandler(nullptr)
 , _firstHandler(nullptr)
 , _lastHandler(nullptr)
+, _routes(nullptr)
+, _routeCount(0)
+, _handlerCount(0)
+, _routesValid(false)
 , _currentArgCount(0)
 , _currentArgs(nullptr)
+, _currentArgCapacity(0)
 , _postArgsLen(0)
 , _postArgs(nullptr)
 , _headerKeysCount(0)
 , _currentHeaders(nullptr)
 , _contentLength(0)
 , _chunked(false)
+, _ifNoneMatch()
+, _isForm(false)
+, _isEncoded(false)
 {
 }
 
@@ -93,6 +120,8 @@ ESP8266WebServer::~ESP8266WebServer() {
     delete handler;
     handler = next;
   }
+  delete[] _routes;
+  delete[] _slots;
 }
 
 void ESP8266WebServer::begin() {
@@ -105,6 +134,19 @@ void ESP8266WebServer::begin(uint16_t port) {
   _server.begin(port);
 }
 
+void ESP8266WebServer::setMaxClients(int count) {
+  delete[] _slots;
+  _slots = nullptr;
+  _slotCount = 0;
+  _nextSlot = 0;
+  if (count <= 1)
+    return;
+  _slots = new ClientSlot[count];
+  _slotCount = count;
+  for (int i = 0; i < _slotCount; i++)
+    _releaseSlot(_slots[i]);
+}
+
 String ESP8266WebServer::_extractParam(String& authReq,const String& param,const char delimit) const {
   int _begin = authReq.indexOf(param);
   if (_begin == -1)
@@ -267,6 +309,81 @@ void ESP8266WebServer::_addRequestHandler(RequestHandler* handler) {
       _lastHandler->next(handler);
       _lastHandler = handler;
     }
+    _handlerCount++;
+    _routesValid = false;
+}
+
+// FNV-1a
+static uint32_t uriHash(const char* uri) {
+    uint32_t hash = 2166136261u;
+    while (*uri)
+        hash = (hash ^ (uint8_t) *uri++) * 16777619u;
+    return hash;
+}
+
+// Builds the route table once after handlers were added: first the handlers
+// bound to one uri, sorted by uri hash and registration order, then all
+// others, e.g. static file handlers, in registration order.
+void ESP8266WebServer::_compileRoutes() {
+    delete[] _routes;
+    _routes = new Route[_handlerCount];
+    _routeCount = 0;
+
+    int index = 0;
+    int other = _handlerCount;
+    for (RequestHandler* handler = _firstHandler; handler; handler = handler->next(), index++) {
+        HTTPMethod method = HTTP_ANY;
+        const String* uri = handler->route(method);
+        Route& route = uri ? _routes[_routeCount++] : _routes[--other];
+        route.hash = uri ? uriHash(uri->c_str()) : 0;
+        route.index = index;
+        route.uri = uri;
+        route.method = method;
+        route.handler = handler;
+    }
+    std::sort(_routes, _routes + _routeCount, [](const Route& a, const Route& b) {
+        return a.hash < b.hash || (a.hash == b.hash && a.index < b.index);
+    });
+    // filled from the end, back to registration order
+    std::reverse(_routes + _routeCount, _routes + _handlerCount);
+    _routesValid = true;
+}
+
+// The first handler, in registration order, for the current request: a
+// binary search for the bound ones, only the others are asked canHandle().
+RequestHandler* ESP8266WebServer::_findHandler() {
+    if (!_routesValid)
+        _compileRoutes();
+
+    const char* uri = _currentUri.c_str();
+    uint32_t hash = uriHash(uri);
+    int lo = 0;
+    int hi = _routeCount;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (_routes[mid].hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    const Route* found = nullptr;
+    for (int i = lo; i < _routeCount && _routes[i].hash == hash; i++) {
+        const Route& route = _routes[i];
+        if ((route.method == HTTP_ANY || route.method == _currentMethod) && strcmp(route.uri->c_str(), uri) == 0) {
+            found = &route;
+            break;
+        }
+    }
+
+    for (int i = _routeCount; i < _handlerCount; i++) {
+        const Route& route = _routes[i];
+        if (found && route.index > found->index)
+            break;
+        if (route.handler->canHandle(_currentMethod, _currentUri))
+            return route.handler;
+    }
+    return found ? found->handler : nullptr;
 }
 
 void ESP8266WebServer::serveStatic(const char* uri, FS& fs, const char* path, const char* cache_header) {
@@ -274,6 +391,11 @@ void ESP8266WebServer::serveStatic(const char* uri, FS& fs, const char* path, co
 }
 
 void ESP8266WebServer::handleClient() {
+  if (_slots) {
+    _handleSlots();
+    return;
+  }
+
   if (_currentStatus == HC_NONE) {
     WiFiClient client = _server.available();
     if (!client) {
@@ -338,9 +460,120 @@ void ESP8266WebServer::handleClient() {
   }
 }
 
+// Takes new clients into the free slots, then gives each slot one turn,
+// starting one further every time so that no slot is always served first.
+void ESP8266WebServer::_handleSlots() {
+  for (int i = 0; i < _slotCount; i++) {
+    if (_slots[i].status != HC_NONE)
+      continue;
+    WiFiClient client = _server.available();
+    if (!client)
+      break;
+
+#ifdef DEBUG_ESP_HTTP_SERVER
+    DEBUG_OUTPUT.printf("New client in slot %d\n", i);
+#endif
+
+    _slots[i].client = client;
+    _slots[i].status = HC_WAIT_READ;
+    _slots[i].statusChange = millis();
+  }
+
+  bool callYield = true;
+  for (int n = 0; n < _slotCount; n++) {
+    ClientSlot& slot = _slots[(_nextSlot + n) % _slotCount];
+    if (slot.status == HC_NONE)
+      continue;
+    int served = slot.requests;
+    _serviceSlot(slot);
+    if (slot.requests != served)
+      callYield = false;
+  }
+  _nextSlot = (_nextSlot + 1) % _slotCount;
+
+  if (callYield) {
+    yield();
+  }
+}
+
+void ESP8266WebServer::_serviceSlot(ClientSlot& slot) {
+  bool keepClient = false;
+
+  if (slot.client.connected()) {
+    switch (slot.status) {
+    case HC_NONE:
+      break;
+    case HC_WAIT_READ: {
+      if (!slot.client.available()) {
+        // an idle connection waits longer than one in the middle of a request
+        unsigned long wait = slot.requests && !slot.headLen ? HTTP_MAX_KEEPALIVE_WAIT : HTTP_MAX_DATA_WAIT;
+        keepClient = millis() - slot.statusChange <= wait;
+        break;
+      }
+      if (!slot.headLen)
+        slot.statusChange = millis();
+      int head = _receiveHead(slot);
+      if (!head) {
+        keepClient = millis() - slot.statusChange <= HTTP_MAX_DATA_WAIT;
+        break;
+      }
+
+      _currentClient = slot.client;
+      if (head < 0) {
+        _resetRequest();
+        _currentVersion = 1;
+        _contentLength = CONTENT_LENGTH_NOT_SET;
+        send(431, "text/plain", responseCodeToString(431));
+      } else if (_parseRequest(_currentClient, slot.head, slot.headLen)) {
+        // a form may leave the rest of its body unread
+        _keepAlive = _clientKeepAlive && !_isForm && slot.requests + 1 < HTTP_MAX_KEEPALIVE_REQUESTS;
+        _currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
+        _contentLength = CONTENT_LENGTH_NOT_SET;
+        _handleRequest();
+      }
+      slot.requests++;
+      slot.headLen = 0;
+      slot.lineLen = 0;
+      slot.started = false;
+      slot.statusChange = millis();
+      if (!_keepAlive)
+        slot.status = HC_WAIT_CLOSE;
+      keepClient = true;
+      _keepAlive = false;
+      _currentClient = WiFiClient();
+      _currentUpload.reset();
+      break;
+    }
+    case HC_WAIT_CLOSE:
+      // Wait for client to close the connection
+      keepClient = millis() - slot.statusChange <= HTTP_MAX_CLOSE_WAIT;
+      break;
+    }
+  }
+
+  if (!keepClient) {
+#ifdef DEBUG_ESP_HTTP_SERVER
+    DEBUG_OUTPUT.printf("Client done after %d requests\n", slot.requests);
+#endif
+    _releaseSlot(slot);
+  }
+}
+
+void ESP8266WebServer::_releaseSlot(ClientSlot& slot) {
+  slot.client = WiFiClient();
+  slot.status = HC_NONE;
+  slot.statusChange = 0;
+  slot.requests = 0;
+  slot.headLen = 0;
+  slot.lineLen = 0;
+  slot.started = false;
+}
+
 void ESP8266WebServer::close() {
   _server.close();
   _currentStatus = HC_NONE;
+  for (int i = 0; i < _slotCount; i++)
+    _releaseSlot(_slots[i]);
   if(!_headerKeysCount)
     collectHeaders(0, 0);
 }
@@ -389,7 +622,10 @@ void ESP8266WebServer::_prepareHeader(String& response, int code, const char* co
       sendHeader(String(F("Accept-Ranges")),String(F("none")));
       sendHeader(String(F("Transfer-Encoding")),String(F("chunked")));
     }
-    sendHeader(String(F("Connection")), String(F("close")));
+    // without a length the end of the response is the end of the connection
+    if (_contentLength == CONTENT_LENGTH_UNKNOWN && !_chunked)
+      _keepAlive = false;
+    sendHeader(String(F("Connection")), _keepAlive ? String(F("keep-alive")) : String(F("close")));
 
     response += _responseHeaders;
     response += "\r\n";
@@ -441,15 +677,35 @@ void ESP8266WebServer::send(int code, const String& content_type, const String&
   send(code, (const char*)content_type.c_str(), content);
 }
 
+void ESP8266WebServer::send(ResponseCache& cache) {
+  _responseHeaders = "";
+  if (!cache.update()) {
+    send(500, "text/plain", String(F("Response too large")));
+    return;
+  }
+  if (cache.matches(_ifNoneMatch)) {
+    char response[96];
+    size_t len = cache.notModified(_currentVersion, _keepAlive, response, sizeof(response));
+    _currentClientWrite(response, len);
+    return;
+  }
+  const char* response;
+  size_t len = cache.response(_currentVersion, _keepAlive, response);
+  _currentClientWrite(response, len);
+}
+
 void ESP8266WebServer::sendContent(const String& content) {
+  sendContent(content.c_str(), content.length());
+}
+
+void ESP8266WebServer::sendContent(const char* content, size_t len) {
   const char * footer = "\r\n";
-  size_t len = content.length();
   if(_chunked) {
     char chunkSize[11];
     sprintf(chunkSize, "%zx\r\n", len);
     _currentClientWrite(chunkSize, strlen(chunkSize));
   }
-  _currentClientWrite(content.c_str(), len);
+  _currentClientWrite(content, len);
   if(_chunked){
     _currentClient.write(footer, 2);
     if (len == 0) {
@@ -661,6 +917,7 @@ const String ESP8266WebServer::responseCodeToString(const int code) {
     case 415: return F("Unsupported Media Type");
     case 416: return F("Requested range not satisfiable");
     case 417: return F("Expectation Failed");
+    case 431: return F("Request Header Fields Too Large");
     case 500: return F("Internal Server Error");
     case 501: return F("Not Implemented");
     case 502: return F("Bad Gateway");
@@ -1,6 +1,6 @@
 /*
   ESP8266WebServer.h - Dead simple web-server.
-  Supports only one simultaneous client, knows how to handle GET and POST.
+  Supports one or a pool of simultaneous clients, knows how to handle GET and POST.
 
   Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
 
@@ -27,8 +27,9 @@
 #include <functional>
 #include <memory>
 #include <ESP8266WiFi.h>
+#include "detail/HTTPParser.h"
+#include "ResponseCache.h"
 
-enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
 enum HTTPUploadStatus { UPLOAD_FILE_START, UPLOAD_FILE_WRITE, UPLOAD_FILE_END,
                         UPLOAD_FILE_ABORTED };
 enum HTTPClientStatus { HC_NONE, HC_WAIT_READ, HC_WAIT_CLOSE };
@@ -44,6 +45,12 @@ enum HTTPAuthMethod { BASIC_AUTH, DIGEST_AUTH };
 #define HTTP_MAX_POST_WAIT 5000 //ms to wait for POST data to arrive
 #define HTTP_MAX_SEND_WAIT 5000 //ms to wait for data chunk to be ACKed
 #define HTTP_MAX_CLOSE_WAIT 2000 //ms to wait for the client to close the connection
+#define HTTP_MAX_KEEPALIVE_WAIT 5000 //ms to keep an idle connection open for the next request
+#define HTTP_MAX_KEEPALIVE_REQUESTS 100 //requests served on one connection before it is closed
+
+#ifndef WEBSERVER_HEAD_LEN
+#define WEBSERVER_HEAD_LEN 1024 // request line and headers kept per client slot, see setMaxClients()
+#endif
 
 #define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
 #define CONTENT_LENGTH_NOT_SET ((size_t) -2)
@@ -67,7 +74,7 @@ namespace fs {
 class FS;
 }
 
-class ESP8266WebServer
+class ESP8266WebServer : protected HTTPParserHandler
 {
 public:
   ESP8266WebServer(IPAddress addr, int port = 80);
@@ -81,6 +88,12 @@ public:
   virtual void close();
   void stop();
 
+  // Serves up to count clients at once, round robin, each connection kept
+  // alive for further requests. The request heads come in side by side, a
+  // request is handled once its head is complete. Call before begin(), 1 is
+  // the single client mode, one connection at a time without keep-alive.
+  void setMaxClients(int count);
+
   bool authenticate(const char * username, const char * password);
   void requestAuthentication(HTTPAuthMethod mode = BASIC_AUTH, const char* realm = NULL, const String& authFailMsg = String("") );
 
@@ -120,10 +133,14 @@ public:
   void send(int code, const String& content_type, const String& content);
   void send_P(int code, PGM_P content_type, PGM_P content);
   void send_P(int code, PGM_P content_type, PGM_P content, size_t contentLength);
+  // a cached 200 in one write, or a 304 when the request has its ETag,
+  // without the headers added by sendHeader()
+  void send(ResponseCache& cache);
 
   void setContentLength(const size_t contentLength);
   void sendHeader(const String& name, const String& value, bool first = false);
   void sendContent(const String& content);
+  void sendContent(const char* content, size_t size);
   void sendContent_P(PGM_P content);
   void sendContent_P(PGM_P content, size_t size);
 
@@ -144,6 +161,17 @@ protected:
   void _handleRequest();
   void _finalizeResponse();
   bool _parseRequest(WiFiClient& client);
+  bool _parseRequest(WiFiClient& client, const char* head, size_t len);
+  bool _parseBody(WiFiClient& client);
+  void _resetRequest();
+  void _sendParseError();
+  bool _feedParser(WiFiClient& client, HTTPParser::State until, int timeout_ms);
+  RequestHandler* _findHandler();
+  void _compileRoutes();
+  bool onMethod(HTTPMethod method) override;
+  bool onUri(const char* path, const char* query) override;
+  bool onHeader(const char* name, const char* value) override;
+  bool onBody(const char* data, size_t len) override;
   void _parseArguments(const String& data);
   int _parseArgumentsPrivate(const String& data, std::function<void(String&,String&,const String&,int,int,int,int)> handler);
   bool _parseForm(WiFiClient& client, const String& boundary, uint32_t len);
@@ -164,6 +192,32 @@ protected:
     String value;
   };
 
+  // one connection of the pool, see setMaxClients()
+  struct ClientSlot {
+    WiFiClient client;
+    HTTPClientStatus status;
+    unsigned long statusChange;
+    int requests;       // served on this connection
+    uint16_t headLen;
+    uint16_t lineLen;   // of the line coming in, without CR
+    bool started;       // past the empty lines ahead of a request
+    char head[WEBSERVER_HEAD_LEN];
+  };
+
+  void _handleSlots();
+  void _serviceSlot(ClientSlot& slot);
+  void _releaseSlot(ClientSlot& slot);
+  int _receiveHead(ClientSlot& slot);
+
+  // handlers bound to one uri, sorted by the hash of the uri, see _compileRoutes()
+  struct Route {
+    uint32_t hash;
+    int index;
+    const String* uri;
+    HTTPMethod method;
+    RequestHandler* handler;
+  };
+
   WiFiServer  _server;
 
   WiFiClient  _currentClient;
@@ -172,15 +226,26 @@ protected:
   uint8_t     _currentVersion;
   HTTPClientStatus _currentStatus;
   unsigned long _statusChange;
+  bool        _keepAlive;
+  bool        _clientKeepAlive;
+
+  ClientSlot* _slots;
+  int         _slotCount;
+  int         _nextSlot;
 
   RequestHandler*  _currentHandler;
   RequestHandler*  _firstHandler;
   RequestHandler*  _lastHandler;
+  Route*           _routes;
+  int              _routeCount;
+  int              _handlerCount;
+  bool             _routesValid;
   THandlerFunction _notFoundHandler;
   THandlerFunction _fileUploadHandler;
 
   int              _currentArgCount;
   RequestArgument* _currentArgs;
+  int              _currentArgCapacity;
   std::unique_ptr<HTTPUpload> _currentUpload;
   int              _postArgsLen;
   RequestArgument* _postArgs;
@@ -193,6 +258,14 @@ protected:
 
   String           _hostHeader;
   bool             _chunked;
+  char             _ifNoneMatch[48]; // enough for a few of our ETags
+
+  HTTPParser       _parser;
+  String           _currentQuery;
+  String           _currentBody;
+  String           _boundary;
+  bool             _isForm;
+  bool             _isEncoded;
 
   String           _snonce;  // Store noance and opaque for future comparison
   String           _sopaque;
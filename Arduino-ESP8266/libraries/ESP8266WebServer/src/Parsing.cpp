@@ -36,217 +36,212 @@
 #define WEBSERVER_MAX_POST_ARGS 32
 #endif
 
+#ifndef HTTP_PARSER_CHUNK
+#define HTTP_PARSER_CHUNK 128 // bytes passed to the parser at a time, on the stack
+#endif
+
 static const char Content_Type[] PROGMEM = "Content-Type";
 static const char filename[] PROGMEM = "filename";
 
-static bool readBytesWithTimeout(WiFiClient& client, size_t maxLength, String& data, int timeout_ms)
+static bool startsWith_P(const char* s, PGM_P prefix)
 {
-  if (!data.reserve(maxLength + 1))
-    return false;
-  data[0] = 0;  // data.clear()??
-  while (data.length() < maxLength) {
-    int tries = timeout_ms;
-    size_t avail;
-    while (!(avail = client.available()) && tries--)
+  return strncmp_P(s, prefix, strlen_P(prefix)) == 0;
+}
+
+// "keep-alive, Upgrade" has the token "keep-alive"
+static bool hasToken(const char* list, const char* token)
+{
+  size_t len = strlen(token);
+  while (*list) {
+    while (*list == ' ' || *list == '\t' || *list == ',')
+      list++;
+    const char* end = list;
+    while (*end && *end != ',')
+      end++;
+    const char* last = end;
+    while (last > list && (last[-1] == ' ' || last[-1] == '\t'))
+      last--;
+    if ((size_t) (last - list) == len && strncasecmp(list, token, len) == 0)
+      return true;
+    list = end;
+  }
+  return false;
+}
+
+// Passes what the client sent on to the parser until it reaches the given
+// state. Bytes are only taken from the client once the parser has used them,
+// so the body is still there for _parseForm() after the headers.
+bool ESP8266WebServer::_feedParser(WiFiClient& client, HTTPParser::State until, int timeout_ms)
+{
+  char chunk[HTTP_PARSER_CHUNK];
+  unsigned long start = millis();
+
+  while (_parser.state() < until) {
+    size_t avail = client.available();
+    if (!avail) {
+      if (!client.connected() || millis() - start > (unsigned long) timeout_ms)
+        return false;
       delay(1);
+      continue;
+    }
+    if (avail > sizeof(chunk))
+      avail = sizeof(chunk);
+    avail = client.peekBytes((uint8_t*) chunk, avail);
+    size_t used = _parser.parse(*this, chunk, avail);
+    client.read((uint8_t*) chunk, used);
+    start = millis();
+  }
+  return _parser.state() != HTTPParser::PARSE_ERROR;
+}
+
+// Takes what a pool slot's client sent into the slot, up to the end of the
+// request head: 1 once it is complete, 0 while it is still coming in and -1
+// when it does not fit. The body is left for _parseBody().
+int ESP8266WebServer::_receiveHead(ClientSlot& slot)
+{
+  WiFiClient& client = slot.client;
+
+  while (size_t avail = client.available()) {
+    size_t room = sizeof(slot.head) - slot.headLen;
+    if (!room)
+      return -1;
+    if (avail > room)
+      avail = room;
+    char* data = slot.head + slot.headLen;
+    avail = client.peekBytes((uint8_t*) data, avail);
     if (!avail)
-      break;
-    if (data.length() + avail > maxLength)
-      avail = maxLength - data.length();
-    while (avail--)
-      data += (char)client.read();
+      return 0;
+
+    size_t used = avail;
+    bool complete = false;
+    for (size_t i = 0; i < avail; i++) {
+      if (data[i] == '\n') {
+        // an empty line ends the head, unless it comes ahead of the request
+        if (!slot.lineLen && slot.started) {
+          used = i + 1;
+          complete = true;
+          break;
+        }
+        if (slot.lineLen)
+          slot.started = true;
+        slot.lineLen = 0;
+      } else if (data[i] != '\r') {
+        slot.lineLen++;
+      }
+    }
+    client.read((uint8_t*) data, used);
+    slot.headLen += used;
+    if (complete)
+      return 1;
   }
-  return data.length() == maxLength;
+  return 0;
 }
 
-bool ESP8266WebServer::_parseRequest(WiFiClient& client) {
-  // Read the first line of HTTP request
-  String req = client.readStringUntil('\r');
-#ifdef DEBUG_ESP_HTTP_SERVER
-    DEBUG_OUTPUT.print("request: ");
-    DEBUG_OUTPUT.println(req);
-#endif
-  client.readStringUntil('\n');
+void ESP8266WebServer::_resetRequest() {
   //reset header value
   for (int i = 0; i < _headerKeysCount; ++i) {
-    _currentHeaders[i].value =String();
-   }
-
-  // First line of HTTP request looks like "GET /path HTTP/1.1"
-  // Retrieve the "/path" part by finding the spaces
-  int addr_start = req.indexOf(' ');
-  int addr_end = req.indexOf(' ', addr_start + 1);
-  if (addr_start == -1 || addr_end == -1) {
+    _currentHeaders[i].value = emptyString;
+  }
+  _hostHeader = emptyString;
+  _currentQuery = emptyString;
+  _currentBody = emptyString;
+  _boundary = emptyString;
+  _isForm = false;
+  _isEncoded = false;
+  _chunked = false;
+  _keepAlive = false;
+  _clientKeepAlive = false;
+  _ifNoneMatch[0] = 0;
+
+  _parser.reset();
+}
+
+void ESP8266WebServer::_sendParseError() {
+  if (_parser.state() != HTTPParser::PARSE_ERROR)
+    return;
 #ifdef DEBUG_ESP_HTTP_SERVER
-    DEBUG_OUTPUT.println("Invalid request");
+  DEBUG_OUTPUT.print("Invalid request: ");
+  DEBUG_OUTPUT.println(_parser.error());
 #endif
+  _currentVersion = _parser.version();
+  _contentLength = CONTENT_LENGTH_NOT_SET;
+  send(_parser.error(), "text/plain", responseCodeToString(_parser.error()));
+}
+
+bool ESP8266WebServer::_parseRequest(WiFiClient& client) {
+  _resetRequest();
+
+  // request line and headers, through the callbacks below
+  if (!_feedParser(client, HTTPParser::PARSE_BODY, HTTP_MAX_DATA_WAIT)) {
+    _sendParseError();
     return false;
   }
+  return _parseBody(client);
+}
 
-  String methodStr = req.substring(0, addr_start);
-  String url = req.substring(addr_start + 1, addr_end);
-  String versionEnd = req.substring(addr_end + 8);
-  _currentVersion = atoi(versionEnd.c_str());
-  String searchStr = "";
-  int hasSearch = url.indexOf('?');
-  if (hasSearch != -1){
-    searchStr = url.substring(hasSearch + 1);
-    url = url.substring(0, hasSearch);
-  }
-  _currentUri = url;
-  _chunked = false;
+// The same with the head already taken from the client, by _receiveHead().
+bool ESP8266WebServer::_parseRequest(WiFiClient& client, const char* head, size_t len) {
+  _resetRequest();
 
-  HTTPMethod method = HTTP_GET;
-  if (methodStr == F("POST")) {
-    method = HTTP_POST;
-  } else if (methodStr == F("DELETE")) {
-    method = HTTP_DELETE;
-  } else if (methodStr == F("OPTIONS")) {
-    method = HTTP_OPTIONS;
-  } else if (methodStr == F("PUT")) {
-    method = HTTP_PUT;
-  } else if (methodStr == F("PATCH")) {
-    method = HTTP_PATCH;
+  _parser.parse(*this, head, len);
+  if (!_parser.headersComplete()) {
+    _sendParseError();
+    return false;
   }
-  _currentMethod = method;
+  return _parseBody(client);
+}
 
-#ifdef DEBUG_ESP_HTTP_SERVER
-  DEBUG_OUTPUT.print("method: ");
-  DEBUG_OUTPUT.print(methodStr);
-  DEBUG_OUTPUT.print(" url: ");
-  DEBUG_OUTPUT.print(url);
-  DEBUG_OUTPUT.print(" search: ");
-  DEBUG_OUTPUT.println(searchStr);
-#endif
+bool ESP8266WebServer::_parseBody(WiFiClient& client) {
+  _currentVersion = _parser.version();
 
   //attach handler
-  RequestHandler* handler;
-  for (handler = _firstHandler; handler; handler = handler->next()) {
-    if (handler->canHandle(_currentMethod, _currentUri))
-      break;
-  }
-  _currentHandler = handler;
+  _currentHandler = _findHandler();
 
-  String formData;
+  HTTPMethod method = _currentMethod;
   // below is needed only when POST type request
   if (method == HTTP_POST || method == HTTP_PUT || method == HTTP_PATCH || method == HTTP_DELETE){
-    String boundaryStr;
-    String headerName;
-    String headerValue;
-    bool isForm = false;
-    bool isEncoded = false;
-    uint32_t contentLength = 0;
-    //parse headers
-    while(1){
-      req = client.readStringUntil('\r');
-      client.readStringUntil('\n');
-      if (req == "") break;//no moar headers
-      int headerDiv = req.indexOf(':');
-      if (headerDiv == -1){
-        break;
-      }
-      headerName = req.substring(0, headerDiv);
-      headerValue = req.substring(headerDiv + 1);
-      headerValue.trim();
-       _collectHeader(headerName.c_str(),headerValue.c_str());
-
-      #ifdef DEBUG_ESP_HTTP_SERVER
-      DEBUG_OUTPUT.print("headerName: ");
-      DEBUG_OUTPUT.println(headerName);
-      DEBUG_OUTPUT.print("headerValue: ");
-      DEBUG_OUTPUT.println(headerValue);
-      #endif
-
-      if (headerName.equalsIgnoreCase(FPSTR(Content_Type))){
-        using namespace mime;
-        if (headerValue.startsWith(FPSTR(mimeTable[txt].mimeType))){
-          isForm = false;
-        } else if (headerValue.startsWith(F("application/x-www-form-urlencoded"))){
-          isForm = false;
-          isEncoded = true;
-        } else if (headerValue.startsWith(F("multipart/"))){
-          boundaryStr = headerValue.substring(headerValue.indexOf('=') + 1);
-          boundaryStr.replace("\"","");
-          isForm = true;
-        }
-      } else if (headerName.equalsIgnoreCase(F("Content-Length"))){
-        contentLength = headerValue.toInt();
-      } else if (headerName.equalsIgnoreCase(F("Host"))){
-        _hostHeader = headerValue;
-      }
-    }
+    size_t contentLength = _parser.contentLength();
 
-    String plainBuf;
-    if (   !isForm
-        && // read content into plainBuf
-           (   !readBytesWithTimeout(client, contentLength, plainBuf, HTTP_MAX_POST_WAIT)
-            || (plainBuf.length() < contentLength)
-           )
-       )
-    {
+    // read content into _currentBody
+    if (!_isForm && contentLength) {
+      if (!_currentBody.reserve(contentLength) || !_feedParser(client, HTTPParser::PARSE_DONE, HTTP_MAX_POST_WAIT))
         return false;
     }
 
-    if (isEncoded) {
-        // isEncoded => !isForm => plainBuf is not empty
-        // add plainBuf in search str
-        if (searchStr.length())
-          searchStr += '&';
-        searchStr += plainBuf;
+    if (_isEncoded) {
+        // isEncoded => !isForm => _currentBody is not empty
+        // add _currentBody in search str
+        if (_currentQuery.length())
+          _currentQuery += '&';
+        _currentQuery += _currentBody;
     }
 
     // parse searchStr for key/value pairs
-    _parseArguments(searchStr);
+    _parseArguments(_currentQuery);
 
-    if (!isForm) {
+    if (!_isForm) {
       if (contentLength) {
         // add key=value: plain={body} (post json or other data)
         RequestArgument& arg = _currentArgs[_currentArgCount++];
         arg.key = F("plain");
-        arg.value = plainBuf;
+        arg.value = std::move(_currentBody);
       }
     } else { // isForm is true
-      // here: content is not yet read (plainBuf is still empty)
-      if (!_parseForm(client, boundaryStr, contentLength)) {
+      // here: content is not yet read
+      if (!_parseForm(client, _boundary, contentLength)) {
         return false;
       }
     }
   } else {
-    String headerName;
-    String headerValue;
-    //parse headers
-    while(1){
-      req = client.readStringUntil('\r');
-      client.readStringUntil('\n');
-      if (req == "") break;//no moar headers
-      int headerDiv = req.indexOf(':');
-      if (headerDiv == -1){
-        break;
-      }
-      headerName = req.substring(0, headerDiv);
-      headerValue = req.substring(headerDiv + 2);
-      _collectHeader(headerName.c_str(),headerValue.c_str());
-
-#ifdef DEBUG_ESP_HTTP_SERVER
-      DEBUG_OUTPUT.print(F("headerName: "));
-      DEBUG_OUTPUT.println(headerName);
-      DEBUG_OUTPUT.print(F("headerValue: "));
-      DEBUG_OUTPUT.println(headerValue);
-#endif
-
-      if (headerName.equalsIgnoreCase("Host")){
-        _hostHeader = headerValue;
-      }
-    }
-    _parseArguments(searchStr);
+    _parseArguments(_currentQuery);
   }
   client.flush();
 
 #ifdef DEBUG_ESP_HTTP_SERVER
   DEBUG_OUTPUT.print(F("Request: "));
-  DEBUG_OUTPUT.println(url);
+  DEBUG_OUTPUT.println(_currentUri);
   DEBUG_OUTPUT.print(F("Arguments: "));
-  DEBUG_OUTPUT.println(searchStr);
+  DEBUG_OUTPUT.println(_currentQuery);
 
   DEBUG_OUTPUT.println(F("final list of key/value pairs:"));
   for (int i = 0; i < _currentArgCount; i++)
@@ -258,9 +253,70 @@ bool ESP8266WebServer::_parseRequest(WiFiClient& client) {
   return true;
 }
 
+bool ESP8266WebServer::onMethod(HTTPMethod method) {
+  _currentMethod = method;
+  // HTTP/1.1 keeps the connection unless told otherwise, see onHeader()
+  _clientKeepAlive = _parser.version() != 0;
+  return true;
+}
+
+bool ESP8266WebServer::onUri(const char* path, const char* query) {
+#ifdef DEBUG_ESP_HTTP_SERVER
+  DEBUG_OUTPUT.print("url: ");
+  DEBUG_OUTPUT.print(path);
+  DEBUG_OUTPUT.print(" search: ");
+  DEBUG_OUTPUT.println(query);
+#endif
+  _currentUri = path;
+  _currentQuery = query;
+  return true;
+}
+
+bool ESP8266WebServer::onHeader(const char* name, const char* value) {
+#ifdef DEBUG_ESP_HTTP_SERVER
+  DEBUG_OUTPUT.print("headerName: ");
+  DEBUG_OUTPUT.println(name);
+  DEBUG_OUTPUT.print("headerValue: ");
+  DEBUG_OUTPUT.println(value);
+#endif
+  _collectHeader(name, value);
+
+  if (strcasecmp(name, "Host") == 0) {
+    _hostHeader = value;
+  } else if (strcasecmp(name, "If-None-Match") == 0) {
+    // a longer list is cut short, at worst the full response goes out
+    strncpy(_ifNoneMatch, value, sizeof(_ifNoneMatch) - 1);
+    _ifNoneMatch[sizeof(_ifNoneMatch) - 1] = 0;
+  } else if (strcasecmp(name, "Connection") == 0) {
+    if (hasToken(value, "close"))
+      _clientKeepAlive = false;
+    else if (hasToken(value, "keep-alive"))
+      _clientKeepAlive = true;
+  } else if (strcasecmp(name, "Content-Type") == 0) {
+    using namespace mime;
+    if (startsWith_P(value, mimeTable[txt].mimeType)) {
+      _isForm = false;
+    } else if (startsWith_P(value, PSTR("application/x-www-form-urlencoded"))) {
+      _isForm = false;
+      _isEncoded = true;
+    } else if (startsWith_P(value, PSTR("multipart/"))) {
+      const char* boundary = strchr(value, '=');
+      _boundary = boundary ? boundary + 1 : "";
+      _boundary.replace("\"", "");
+      _isForm = true;
+    }
+  }
+  return true;
+}
+
+bool ESP8266WebServer::onBody(const char* data, size_t len) {
+  // the room was reserved up front, no reallocation in here
+  return _currentBody.concat(data, len);
+}
+
 bool ESP8266WebServer::_collectHeader(const char* headerName, const char* headerValue) {
   for (int i = 0; i < _headerKeysCount; i++) {
-    if (_currentHeaders[i].key.equalsIgnoreCase(headerName)) {
+    if (strcasecmp(_currentHeaders[i].key.c_str(), headerName) == 0) {
             _currentHeaders[i].value=headerValue;
             return true;
         }
@@ -287,13 +343,19 @@ struct nullArgHandler
 };
 
 void ESP8266WebServer::_parseArguments(const String& data) {
-  if (_currentArgs)
-    delete[] _currentArgs;
-
   _currentArgCount = _parseArgumentsPrivate(data, nullArgHandler());
 
-  // allocate one more, this is needed because {"plain": plainBuf} is always added
-  _currentArgs = new RequestArgument[_currentArgCount + 1];
+  // allocate one more, this is needed because {"plain": plainBuf} is always added,
+  // the array is kept for the next requests as long as it is large enough
+  if (_currentArgCount + 1 > _currentArgCapacity) {
+    if (_currentArgs)
+      delete[] _currentArgs;
+    _currentArgs = new RequestArgument[_currentArgCount + 1];
+    _currentArgCapacity = _currentArgCount + 1;
+  }
+  // a key without '=' leaves the value alone
+  for (int i = 0; i < _currentArgCount; i++)
+    _currentArgs[i].value = emptyString;
 
   (void)_parseArgumentsPrivate(data, storeArgHandler());
 }
@@ -566,6 +628,7 @@ readfile:
     }
     if (_currentArgs) delete[] _currentArgs;
     _currentArgs = new RequestArgument[_postArgsLen];
+    _currentArgCapacity = _postArgsLen;
     for (iarg = 0; iarg < _postArgsLen; iarg++){
       RequestArgument& arg = _currentArgs[iarg];
       arg.key = _postArgs[iarg].key;
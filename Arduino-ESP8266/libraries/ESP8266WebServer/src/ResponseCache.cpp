@@ -0,0 +1,124 @@
+/*
+  ResponseCache.cpp - A response rendered once and sent as it is.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "ResponseCache.h"
+
+// room in front of the body for the status line and the header lines,
+// the Content-Type value comes on top
+#define RESPONSE_CACHE_HEADER 160
+
+static const char status200[] = "HTTP/1.1 200 OK\r\n";
+static const char keepAliveLine[] = "Connection: keep-alive\r\n";
+static const char closeLine[] = "Connection: close\r\n";
+
+ResponseCache::ResponseCache(size_t size, const char* content_type, TRenderFunction render)
+: _render(render)
+, _contentType(content_type)
+, _size(size)
+, _length(0)
+, _valid(false)
+, _overflow(false)
+{
+  size_t room = RESPONSE_CACHE_HEADER + strlen(content_type);
+  _buf = new char[room + size];
+  _body = _buf + room;
+  _header = _body;
+  _etag[0] = 0;
+}
+
+ResponseCache::~ResponseCache() {
+  delete[] _buf;
+}
+
+bool ResponseCache::update() {
+  if (_valid)
+    return true;
+
+  _length = 0;
+  _overflow = false;
+  _render(*this);
+  if (_overflow)
+    return false;
+
+  // FNV-1a of the body, the same body keeps the same ETag
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < _length; i++)
+    hash = (hash ^ (uint8_t) _body[i]) * 16777619u;
+  snprintf(_etag, sizeof(_etag), "\"%08x\"", (unsigned) hash);
+
+  // written at the start of the buffer, then moved up to the body
+  size_t room = _body - _buf;
+  int len = snprintf(_buf, room,
+    "Content-Type: %s\r\n"
+    "Content-Length: %u\r\n"
+    "ETag: %s\r\n"
+    "Cache-Control: no-cache\r\n"
+    "\r\n",
+    _contentType, (unsigned) _length, _etag);
+  _header = _body - len;
+  memmove(_header, _buf, len);
+  _valid = true;
+  return true;
+}
+
+bool ResponseCache::matches(const char* if_none_match) const {
+  if (!_valid || !if_none_match)
+    return false;
+  while (*if_none_match == ' ')
+    if_none_match++;
+  if (strcmp(if_none_match, "*") == 0)
+    return true;
+  // also finds a weak W/"..." and one in a list
+  return strstr(if_none_match, _etag) != nullptr;
+}
+
+size_t ResponseCache::response(uint8_t version, bool keep_alive, const char*& data) {
+  const char* connection = keep_alive ? keepAliveLine : closeLine;
+  size_t connectionLen = keep_alive ? sizeof(keepAliveLine) - 1 : sizeof(closeLine) - 1;
+
+  char* start = _header - connectionLen;
+  memcpy(start, connection, connectionLen);
+  start -= sizeof(status200) - 1;
+  memcpy(start, status200, sizeof(status200) - 1);
+  start[7] = '0' + version;
+
+  data = start;
+  return _body + _length - start;
+}
+
+size_t ResponseCache::notModified(uint8_t version, bool keep_alive, char* buf, size_t size) const {
+  int len = snprintf(buf, size, "HTTP/1.%u 304 Not Modified\r\nETag: %s\r\n%s\r\n",
+    (unsigned) version, _etag, keep_alive ? keepAliveLine : closeLine);
+  return len > 0 && (size_t) len < size ? len : 0;
+}
+
+size_t ResponseCache::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t ResponseCache::write(const uint8_t* buffer, size_t size) {
+  if (size > _size - _length) {
+    size = _size - _length;
+    _overflow = true;
+  }
+  memcpy(_body + _length, buffer, size);
+  _length += size;
+  return size;
+}
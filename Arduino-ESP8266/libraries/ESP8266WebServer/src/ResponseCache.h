@@ -0,0 +1,78 @@
+/*
+  ResponseCache.h - A response rendered once and sent as it is.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef RESPONSECACHE_H
+#define RESPONSECACHE_H
+
+#include <functional>
+#include <Print.h>
+
+// Holds the body of a response that changes less often than it is asked
+// for, e.g. the latest readings, in a buffer of fixed size, together with
+// its Content-Type, Content-Length and ETag header lines. invalidate() only
+// marks it stale, the render function writes the body again when the next
+// request comes in, so that the rate of requests costs no rendering and no
+// heap. Send it with ESP8266WebServer::send(ResponseCache&), which answers
+// a request carrying the current ETag in If-None-Match with a 304.
+class ResponseCache : public Print {
+public:
+  typedef std::function<void(Print&)> TRenderFunction;
+
+  // size is the longest body, content_type must stay valid
+  ResponseCache(size_t size, const char* content_type, TRenderFunction render);
+  virtual ~ResponseCache();
+
+  void invalidate() { _valid = false; }
+  bool valid() const { return _valid; }
+
+  // renders the body if it is stale, false if it did not fit
+  bool update();
+
+  const char* body() const { return _body; }
+  size_t contentLength() const { return _length; }
+  const char* etag() const { return _etag; } // quoted, as in the header
+
+  // an If-None-Match value holds the current ETag, or is "*"
+  bool matches(const char* if_none_match) const;
+
+  // Puts the status and Connection lines in front of the header lines kept
+  // with the body and returns the whole response, in one piece.
+  size_t response(uint8_t version, bool keep_alive, const char*& data);
+  // a 304 for the current ETag into buf, 0 if it does not fit
+  size_t notModified(uint8_t version, bool keep_alive, char* buf, size_t size) const;
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+
+protected:
+  ResponseCache(const ResponseCache&) = delete;
+  ResponseCache& operator=(const ResponseCache&) = delete;
+
+  TRenderFunction _render;
+  const char*     _contentType;
+  char*           _buf;       // room for the header, then the body
+  char*           _body;
+  char*           _header;    // header lines kept in front of the body
+  size_t          _size;
+  size_t          _length;
+  bool            _valid;
+  bool            _overflow;
+  char            _etag[11];
+};
+
+#endif //RESPONSECACHE_H
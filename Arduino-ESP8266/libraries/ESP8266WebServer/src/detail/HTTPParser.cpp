@@ -0,0 +1,187 @@
+/*
+  HTTPParser.cpp - Incremental HTTP/1.x request parser.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <string.h>
+#include <strings.h>
+#include "HTTPParser.h"
+
+struct MethodName {
+  const char* name;
+  HTTPMethod method;
+};
+
+// HEAD and unknown methods are served as GET, as they always were
+static const MethodName methodNames[] = {
+  { "GET", HTTP_GET },
+  { "POST", HTTP_POST },
+  { "PUT", HTTP_PUT },
+  { "PATCH", HTTP_PATCH },
+  { "DELETE", HTTP_DELETE },
+  { "OPTIONS", HTTP_OPTIONS },
+};
+
+static bool isBlank(char c) {
+  return c == ' ' || c == '\t';
+}
+
+void HTTPParser::reset() {
+  _state = PARSE_REQUEST_LINE;
+  _error = 0;
+  _method = HTTP_GET;
+  _version = 0;
+  _contentLength = 0;
+  _bodyLeft = 0;
+  _lineLen = 0;
+}
+
+size_t HTTPParser::parse(HTTPParserHandler& handler, const char* data, size_t len) {
+  size_t pos = 0;
+
+  while (pos < len) {
+    if (_state == PARSE_BODY) {
+      size_t n = len - pos < _bodyLeft ? len - pos : _bodyLeft;
+      if (!handler.onBody(data + pos, n)) {
+        _fail(400);
+        return pos;
+      }
+      pos += n;
+      _bodyLeft -= n;
+      if (!_bodyLeft)
+        _state = PARSE_DONE;
+      return pos;
+    }
+    if (_state != PARSE_REQUEST_LINE && _state != PARSE_HEADERS)
+      return pos;
+
+    // collect the line, in one copy up to its end or the end of the data
+    const char* nl = (const char*) memchr(data + pos, '\n', len - pos);
+    size_t n = nl ? nl - (data + pos) : len - pos;
+    if (_lineLen + n >= sizeof(_line)) {
+      _fail(_state == PARSE_REQUEST_LINE ? 414 : 431);
+      return pos;
+    }
+    memcpy(_line + _lineLen, data + pos, n);
+    _lineLen += n;
+    pos += n;
+    if (!nl)
+      break;
+    pos++;
+
+    if (_lineLen && _line[_lineLen - 1] == '\r')
+      _lineLen--;
+    _line[_lineLen] = 0;
+    bool ok = _parseLine(handler);
+    _lineLen = 0;
+    if (!ok || headersComplete())
+      return pos;
+  }
+  return pos;
+}
+
+bool HTTPParser::_parseLine(HTTPParserHandler& handler) {
+  if (_state == PARSE_REQUEST_LINE) {
+    // empty lines ahead of a request are allowed
+    if (!_lineLen)
+      return true;
+    return _parseRequestLine(handler);
+  }
+  if (_lineLen)
+    return _parseHeader(handler);
+
+  if (!handler.onHeadersComplete())
+    return _fail(400);
+  _bodyLeft = _contentLength;
+  _state = _bodyLeft ? PARSE_BODY : PARSE_DONE;
+  return true;
+}
+
+// "GET /path?query HTTP/1.1"
+bool HTTPParser::_parseRequestLine(HTTPParserHandler& handler) {
+  char* uri = strchr(_line, ' ');
+  if (!uri || uri == _line)
+    return _fail(400);
+  *uri++ = 0;
+  char* version = strchr(uri, ' ');
+  if (!version || version == uri)
+    return _fail(400);
+  *version++ = 0;
+
+  if (strncmp(version, "HTTP/", 5) != 0)
+    return _fail(400);
+  if (version[5] != '1' || version[6] != '.' || version[7] < '0' || version[7] > '9' || version[8])
+    return _fail(505);
+  _version = version[7] - '0';
+
+  _method = HTTP_GET;
+  for (size_t i = 0; i < sizeof(methodNames) / sizeof(methodNames[0]); i++) {
+    if (strcmp(_line, methodNames[i].name) == 0) {
+      _method = methodNames[i].method;
+      break;
+    }
+  }
+
+  const char* query = "";
+  char* search = strchr(uri, '?');
+  if (search) {
+    *search++ = 0;
+    query = search;
+  }
+
+  if (!handler.onMethod(_method) || !handler.onUri(uri, query))
+    return _fail(400);
+  _state = PARSE_HEADERS;
+  return true;
+}
+
+// "Name: value", the value without the blanks around it
+bool HTTPParser::_parseHeader(HTTPParserHandler& handler) {
+  char* value = strchr(_line, ':');
+  if (!value || value == _line || isBlank(value[-1]) || isBlank(_line[0]))
+    return _fail(400);
+  *value++ = 0;
+  while (isBlank(*value))
+    value++;
+  char* end = _line + _lineLen;
+  while (end > value && isBlank(end[-1]))
+    end--;
+  *end = 0;
+
+  if (strcasecmp(_line, "Content-Length") == 0) {
+    size_t length = 0;
+    if (!*value)
+      return _fail(400);
+    for (const char* p = value; *p; p++) {
+      if (*p < '0' || *p > '9' || length > ((size_t) -1 - 9) / 10)
+        return _fail(400);
+      length = length * 10 + (*p - '0');
+    }
+    _contentLength = length;
+  } else if (strcasecmp(_line, "Transfer-Encoding") == 0 && strcasecmp(value, "identity") != 0) {
+    return _fail(501);
+  }
+
+  if (!handler.onHeader(_line, value))
+    return _fail(400);
+  return true;
+}
+
+bool HTTPParser::_fail(int code) {
+  _state = PARSE_ERROR;
+  _error = code;
+  return false;
+}
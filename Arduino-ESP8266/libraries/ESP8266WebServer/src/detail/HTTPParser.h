@@ -0,0 +1,83 @@
+/*
+  HTTPParser.h - Incremental HTTP/1.x request parser.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HTTPPARSER_H
+#define HTTPPARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+#ifndef HTTP_PARSER_LINE_LEN
+#define HTTP_PARSER_LINE_LEN 512 // longest request line or header line
+#endif
+
+// Receives the parts of a request as the parser gets to them. Strings point
+// into the parser's line buffer, they are NUL terminated and only valid
+// during the call. Returning false rejects the request with a 400.
+class HTTPParserHandler {
+public:
+  virtual ~HTTPParserHandler() { }
+  virtual bool onMethod(HTTPMethod method) { (void) method; return true; }
+  virtual bool onUri(const char* path, const char* query) { (void) path; (void) query; return true; }
+  virtual bool onHeader(const char* name, const char* value) { (void) name; (void) value; return true; }
+  virtual bool onHeadersComplete() { return true; }
+  virtual bool onBody(const char* data, size_t len) { (void) data; (void) len; return true; }
+};
+
+// Parses a request as it comes in, in pieces of any size, with a fixed line
+// buffer and no heap. Lines end in CRLF or a bare LF. The body is delimited
+// by Content-Length, a chunked request body is not supported (501).
+class HTTPParser {
+public:
+  enum State { PARSE_REQUEST_LINE, PARSE_HEADERS, PARSE_BODY, PARSE_DONE, PARSE_ERROR };
+
+  HTTPParser() { reset(); }
+  void reset();
+
+  // Takes up to len bytes and returns how many it used. Stops right after
+  // the header block, in PARSE_BODY or PARSE_DONE, so that the caller can
+  // decide how to read the body, further calls pass it on to onBody().
+  size_t parse(HTTPParserHandler& handler, const char* data, size_t len);
+
+  State state() const { return _state; }
+  bool headersComplete() const { return _state == PARSE_BODY || _state == PARSE_DONE; }
+  int error() const { return _error; } // response code of a rejected request
+  HTTPMethod method() const { return _method; }
+  uint8_t version() const { return _version; } // minor version, HTTP/1.x
+  size_t contentLength() const { return _contentLength; }
+  size_t bodyLeft() const { return _bodyLeft; }
+
+protected:
+  bool _parseLine(HTTPParserHandler& handler);
+  bool _parseRequestLine(HTTPParserHandler& handler);
+  bool _parseHeader(HTTPParserHandler& handler);
+  bool _fail(int code);
+
+  State      _state;
+  int        _error;
+  HTTPMethod _method;
+  uint8_t    _version;
+  size_t     _contentLength;
+  size_t     _bodyLeft;
+  size_t     _lineLen;
+  char       _line[HTTP_PARSER_LINE_LEN];
+};
+
+#endif //HTTPPARSER_H
@@ -50,6 +50,11 @@ public:
             _ufn();
     }
 
+    const String* route(HTTPMethod& method) override {
+        method = _method;
+        return &_uri;
+    }
+
 protected:
     ESP8266WebServer::THandlerFunction _fn;
     ESP8266WebServer::THandlerFunction _ufn;
@@ -0,0 +1,32 @@
+/*
+ ArduinoCatchEmu.cpp - emulator settings for the Catch tests on its network
+
+ ArduinoMain.cpp takes these from its command line. The Catch tests that
+ run on the emulator's sockets link without it, Catch has the main(), so
+ they get the defaults here: no interface binding, the port shifter of
+ ArduinoMain, quiet mock messages.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+#define MOCK_PORT_SHIFTER 9000
+
+const char* host_interface = nullptr;
+int mock_port_shifter = MOCK_PORT_SHIFTER;
+
+int mockverbose (const char* fmt, ...)
+{
+	(void)fmt;
+	return 0;
+}
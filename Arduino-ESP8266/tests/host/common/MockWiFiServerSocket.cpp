@@ -101,7 +101,8 @@ void WiFiServer::begin ()
 		exit(EXIT_FAILURE);
 	}
 
-	if (listen(sock, 1) == -1)
+	// lwIP queues the connections a server has not taken yet as well
+	if (listen(sock, SOMAXCONN) == -1)
 	{
 		perror(MOCK "listen()");
 		exit(EXIT_FAILURE);
@@ -121,6 +121,11 @@ TEST_CASE("String concantenation", "[core][String]")
     str = "clean";
     REQUIRE(str.concat(str) == true);
     REQUIRE(str == "cleanclean");
+    // a piece of a buffer, not terminated
+    str = "body:";
+    REQUIRE(str.concat("0123456789", 4) == true);
+    REQUIRE(str == "body:0123");
+    REQUIRE(str.length() == 9);
     // non-decimal negative #s should be as if they were unsigned
     str = String((int)-100, 16);
     REQUIRE(str == "ffffff9c");
@@ -0,0 +1,145 @@
+/*
+ bench_HTTPParser.cpp - ESP8266WebServer request parsing benchmark
+
+ Requests per second and heap allocations per request of HTTPParser, next
+ to the String based parsing ESP8266WebServer used before.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <Stream.h>
+#include "detail/HTTPParser.h"
+
+static unsigned long allocations = 0;
+
+#ifdef __GLIBC__
+// counts every heap allocation of the process, String uses malloc/realloc
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) { allocations++; return __libc_malloc(size); }
+void* calloc(size_t count, size_t size) { allocations++; return __libc_calloc(count, size); }
+void* realloc(void* ptr, size_t size) { allocations++; return __libc_realloc(ptr, size); }
+void free(void* ptr) { __libc_free(ptr); }
+}
+#endif
+
+static const char request[] =
+  "GET /api/readings?sensor=bmp180&format=json HTTP/1.1\r\n"
+  "Host: 192.168.1.50\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:60.0) Gecko/20100101 Firefox/60.0\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+  "Accept-Language: en-US,en;q=0.5\r\n"
+  "Accept-Encoding: gzip, deflate\r\n"
+  "Connection: keep-alive\r\n"
+  "\r\n";
+
+class CountingHandler : public HTTPParserHandler
+{
+public:
+  size_t count = 0;
+
+  bool onUri(const char* path, const char* query) override { count += strlen(path) + strlen(query); return true; }
+  bool onHeader(const char* name, const char* value) override { count += strlen(name) + strlen(value); return true; }
+};
+
+// reads a request from memory, as WiFiClient does from its receive buffer
+class RequestStream : public Stream
+{
+public:
+  RequestStream(const char* data, size_t len) : _data(data), _len(len), _pos(0) { }
+  void rewind() { _pos = 0; }
+
+  int available() override { return _len - _pos; }
+  int read() override { return _pos < _len ? (uint8_t) _data[_pos++] : -1; }
+  int peek() override { return _pos < _len ? (uint8_t) _data[_pos] : -1; }
+  void flush() override { }
+  size_t write(uint8_t c) override { (void) c; return 0; }
+
+private:
+  const char* _data;
+  size_t _len;
+  size_t _pos;
+};
+
+// what ESP8266WebServer::_parseRequest() did for a GET up to now
+static size_t parseWithStrings(Stream& client)
+{
+  size_t count = 0;
+  String req = client.readStringUntil('\r');
+  client.readStringUntil('\n');
+  int addr_start = req.indexOf(' ');
+  int addr_end = req.indexOf(' ', addr_start + 1);
+  String methodStr = req.substring(0, addr_start);
+  String url = req.substring(addr_start + 1, addr_end);
+  String versionEnd = req.substring(addr_end + 8);
+  String searchStr = "";
+  int hasSearch = url.indexOf('?');
+  if (hasSearch != -1) {
+    searchStr = url.substring(hasSearch + 1);
+    url = url.substring(0, hasSearch);
+  }
+  count += url.length() + searchStr.length();
+  while (1) {
+    req = client.readStringUntil('\r');
+    client.readStringUntil('\n');
+    if (req == "") break;
+    int headerDiv = req.indexOf(':');
+    if (headerDiv == -1) break;
+    String headerName = req.substring(0, headerDiv);
+    String headerValue = req.substring(headerDiv + 2);
+    count += headerName.length() + headerValue.length();
+  }
+  return count;
+}
+
+static void report(const char* name, int n, std::chrono::steady_clock::duration time, unsigned long allocs)
+{
+  double seconds = std::chrono::duration<double>(time).count();
+  printf("%-12s %10.0f requests/s %8.2f allocations/request\n", name, n / seconds, (double) allocs / n);
+}
+
+int main()
+{
+  const int n = 200000;
+  const size_t len = strlen(request);
+  size_t check = 0;
+
+  HTTPParser parser;
+  CountingHandler handler;
+  unsigned long allocs = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    parser.reset();
+    // in pieces the size of a small TCP segment
+    for (size_t pos = 0; pos < len; )
+      pos += parser.parse(handler, request + pos, len - pos < 64 ? len - pos : 64);
+  }
+  report("HTTPParser", n, std::chrono::steady_clock::now() - start, allocations - allocs);
+  check += handler.count;
+
+  RequestStream client(request, len);
+  allocs = allocations;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    client.rewind();
+    check += parseWithStrings(client);
+  }
+  report("String", n, std::chrono::steady_clock::now() - start, allocations - allocs);
+
+  return check == 0;
+}
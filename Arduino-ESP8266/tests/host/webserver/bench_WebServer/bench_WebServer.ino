@@ -0,0 +1,234 @@
+/*
+ bench_WebServer.ino - ESP8266WebServer serving live readings benchmark
+
+ Requests per second, server time and heap allocations per request for the
+ readings built into a String on every request, next to a ResponseCache
+ and the 304s of a client that sends its ETag. Runs in the emulator, see
+ "make bench": a host thread makes the requests over one keep-alive
+ connection, loop() serves them.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <ESP8266WiFi.h>
+#include <ESP8266WebServer.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#define BENCH_PORT 18080 // not shifted by the emulator
+#define BENCH_REQUESTS 10000
+#define BENCH_SAMPLE_EVERY 1000 // requests per new sample
+
+static std::atomic<unsigned long> allocations(0);
+
+#ifdef __GLIBC__
+// counts every heap allocation of the process, String uses malloc/realloc
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) { allocations++; return __libc_malloc(size); }
+void* calloc(size_t count, size_t size) { allocations++; return __libc_calloc(count, size); }
+void* realloc(void* ptr, size_t size) { allocations++; return __libc_realloc(ptr, size); }
+void free(void* ptr) { __libc_free(ptr); }
+}
+#endif
+
+static const char* const names[] = {
+  "battery_mv", "battery_ma", "soc", "remaining_mah", "full_mah", "input_mv", "battery_temp",
+  "bmp_temp", "pressure", "dht_temp", "humidity", "mcu_temp", "wind_mv", "rain_mv",
+};
+#define FIELDS (sizeof(names) / sizeof(names[0]))
+
+static uint32_t sampleTime = 1792310400;
+static int32_t values[FIELDS] = { 3912, -85, 76, 1520, 2000, 5120, 231, 198, 101325, 205, 563, 284, 12, 0 };
+static unsigned long served = 0;
+
+static void sample() {
+  sampleTime += 60;
+  values[8] += 3;
+}
+
+static void renderReadings(Print& out) {
+  out.print("{\"time\":");
+  out.print(sampleTime);
+  for (size_t i = 0; i < FIELDS; i++) {
+    out.print(",\"");
+    out.print(names[i]);
+    out.print("\":");
+    out.print(values[i]);
+  }
+  out.print('}');
+}
+
+ESP8266WebServer server(BENCH_PORT);
+ResponseCache readings(512, "application/json", renderReadings);
+
+struct Phase {
+  const char* name;
+  const char* uri;
+  bool etag;
+  std::chrono::steady_clock::duration time;
+  std::chrono::steady_clock::duration serverTime;
+  unsigned long allocations;
+  int notModified;
+};
+
+static Phase phases[] = {
+  { "String", "/string", false, { }, { }, 0, 0 },
+  { "cached", "/cached", false, { }, { }, 0, 0 },
+  { "If-None-Match", "/cached", true, { }, { }, 0, 0 },
+};
+#define PHASES (sizeof(phases) / sizeof(phases[0]))
+
+static std::atomic<int> phase(-1);
+static std::atomic<bool> done(false);
+
+// one response off the connection, its status code, the ETag kept in etag
+static int readResponse(int sock, char* etag, bool& close) {
+  static char buf[4096];
+  size_t len = 0;
+  char* end = nullptr;
+  while (!end) {
+    // ACK at once, a response sent in two writes would otherwise wait for
+    // the delayed ACK of the first one, Nagle, 40 ms instead of the server
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+    ssize_t n = recv(sock, buf + len, sizeof(buf) - 1 - len, 0);
+    if (n <= 0)
+      return -1;
+    len += n;
+    buf[len] = 0;
+    end = strstr(buf, "\r\n\r\n");
+  }
+  int code = atoi(buf + 9);
+  size_t body = 0;
+  const char* field = strstr(buf, "Content-Length: ");
+  if (field && field < end)
+    body = atol(field + 16);
+  field = strstr(buf, "ETag: ");
+  if (field && field < end)
+    sscanf(field + 6, "%10s", etag);
+  field = strstr(buf, "Connection: close");
+  close = field && field < end;
+
+  size_t have = len - (end + 4 - buf);
+  while (have < body) {
+    ssize_t n = recv(sock, buf, body - have < sizeof(buf) ? body - have : sizeof(buf), 0);
+    if (n <= 0)
+      return -1;
+    have += n;
+  }
+  return code;
+}
+
+static int connectServer() {
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(BENCH_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(sock, (sockaddr*) &addr, sizeof(addr)) != 0) {
+    perror("connect");
+    exit(EXIT_FAILURE);
+  }
+  return sock;
+}
+
+// keeps the connection as long as the server does, HTTP_MAX_KEEPALIVE_REQUESTS
+static void client() {
+  int sock = connectServer();
+  char etag[16] = "\"0\"";
+  for (size_t p = 0; p < PHASES; p++) {
+    char request[128];
+    phase = p;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_REQUESTS; i++) {
+      int len = phases[p].etag ?
+        snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nIf-None-Match: %s\r\n\r\n", phases[p].uri, etag) :
+        snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\n\r\n", phases[p].uri);
+      send(sock, request, len, 0);
+      bool closed;
+      int code = readResponse(sock, etag, closed);
+      if (code == 304)
+        phases[p].notModified++;
+      else if (code != 200) {
+        fprintf(stderr, "%s: response %d\n", phases[p].uri, code);
+        exit(EXIT_FAILURE);
+      }
+      if (closed) {
+        close(sock);
+        sock = connectServer();
+      }
+    }
+    phases[p].time = std::chrono::steady_clock::now() - start;
+  }
+  close(sock);
+  done = true;
+}
+
+void setup() {
+  server.on("/string", []() {
+    if (++served % BENCH_SAMPLE_EVERY == 0)
+      sample();
+    String json = "{\"time\":";
+    json += sampleTime;
+    for (size_t i = 0; i < FIELDS; i++) {
+      json += ",\"";
+      json += names[i];
+      json += "\":";
+      json += values[i];
+    }
+    json += '}';
+    server.send(200, "application/json", json);
+  });
+  server.on("/cached", []() {
+    if (++served % BENCH_SAMPLE_EVERY == 0) {
+      sample();
+      readings.invalidate();
+    }
+    server.send(readings);
+  });
+  server.setMaxClients(2);
+  server.begin();
+
+  std::thread(client).detach();
+}
+
+void loop() {
+  int p = phase;
+  unsigned long requests = served;
+  unsigned long allocs = allocations;
+  auto start = std::chrono::steady_clock::now();
+  server.handleClient();
+  // only the turns that served a request, not the polling in between
+  if (p >= 0 && served != requests) {
+    phases[p].serverTime += std::chrono::steady_clock::now() - start;
+    phases[p].allocations += allocations - allocs;
+  }
+
+  if (done) {
+    for (auto& ph : phases) {
+      double seconds = std::chrono::duration<double>(ph.time).count();
+      double server = std::chrono::duration<double, std::micro>(ph.serverTime).count();
+      printf("%-14s %8.0f requests/s %7.2f us/request in the server %6.2f allocations/request %5d x 304\n",
+        ph.name, BENCH_REQUESTS / seconds, server / BENCH_REQUESTS, (double) ph.allocations / BENCH_REQUESTS, ph.notModified);
+    }
+    exit(EXIT_SUCCESS);
+  }
+}
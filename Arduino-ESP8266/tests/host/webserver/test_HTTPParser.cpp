@@ -0,0 +1,190 @@
+/*
+ test_HTTPParser.cpp - ESP8266WebServer request parser tests
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include <string>
+#include "detail/HTTPParser.h"
+
+// writes down every callback as one line
+class RecordingHandler : public HTTPParserHandler
+{
+public:
+  std::string log;
+  std::string body;
+
+  bool onMethod(HTTPMethod method) override {
+    log += "method " + std::to_string(method) + "\n";
+    return true;
+  }
+  bool onUri(const char* path, const char* query) override {
+    log += std::string("uri ") + path + " ? " + query + "\n";
+    return true;
+  }
+  bool onHeader(const char* name, const char* value) override {
+    log += std::string("header ") + name + "=" + value + "\n";
+    return true;
+  }
+  bool onHeadersComplete() override {
+    log += "complete\n";
+    return true;
+  }
+  bool onBody(const char* data, size_t len) override {
+    body.append(data, len);
+    return true;
+  }
+};
+
+// feeds the request in pieces of step bytes, as long as the parser takes them
+static size_t feed(HTTPParser& parser, HTTPParserHandler& handler, const char* req, size_t step)
+{
+  size_t len = strlen(req);
+  size_t pos = 0;
+  while (pos < len && parser.state() != HTTPParser::PARSE_DONE && parser.state() != HTTPParser::PARSE_ERROR) {
+    size_t n = len - pos < step ? len - pos : step;
+    pos += parser.parse(handler, req + pos, n);
+  }
+  return pos;
+}
+
+static const char getRequest[] =
+  "GET /path/x?a=1&b=2 HTTP/1.1\r\n"
+  "Host: example.com\r\n"
+  "Accept:  text/html \t\r\n"
+  "\r\n";
+
+TEST_CASE("HTTPParser request line and headers", "[HTTPParser]")
+{
+  RecordingHandler handler;
+  HTTPParser parser;
+
+  REQUIRE(feed(parser, handler, getRequest, 1000) == strlen(getRequest));
+  REQUIRE(parser.state() == HTTPParser::PARSE_DONE);
+  REQUIRE(parser.method() == HTTP_GET);
+  REQUIRE(parser.version() == 1);
+  REQUIRE(handler.log ==
+    "method 1\n"
+    "uri /path/x ? a=1&b=2\n"
+    "header Host=example.com\n"
+    "header Accept=text/html\n"
+    "complete\n");
+}
+
+TEST_CASE("HTTPParser gives the same result for any split", "[HTTPParser]")
+{
+  RecordingHandler whole;
+  HTTPParser parser;
+  feed(parser, whole, getRequest, 1000);
+
+  for (size_t step = 1; step < sizeof(getRequest); step++) {
+    RecordingHandler handler;
+    parser.reset();
+    feed(parser, handler, getRequest, step);
+    REQUIRE(parser.state() == HTTPParser::PARSE_DONE);
+    REQUIRE(handler.log == whole.log);
+  }
+}
+
+TEST_CASE("HTTPParser bare LF, empty leading lines, no query", "[HTTPParser]")
+{
+  RecordingHandler handler;
+  HTTPParser parser;
+
+  feed(parser, handler, "\r\n\nOPTIONS * HTTP/1.0\nX-A:b\n\n", 1000);
+  REQUIRE(parser.state() == HTTPParser::PARSE_DONE);
+  REQUIRE(parser.version() == 0);
+  REQUIRE(handler.log ==
+    "method 6\n"
+    "uri * ? \n"
+    "header X-A=b\n"
+    "complete\n");
+}
+
+TEST_CASE("HTTPParser body", "[HTTPParser]")
+{
+  const char req[] =
+    "POST /form HTTP/1.1\r\n"
+    "content-length: 11\r\n"
+    "\r\n"
+    "hello world"
+    "GET / HTTP/1.1\r\n\r\n";
+  HTTPParser parser;
+
+  for (size_t step = 1; step < sizeof(req); step++) {
+    RecordingHandler handler;
+    parser.reset();
+    size_t used = feed(parser, handler, req, step);
+    REQUIRE(parser.state() == HTTPParser::PARSE_DONE);
+    REQUIRE(parser.method() == HTTP_POST);
+    REQUIRE(parser.contentLength() == 11);
+    REQUIRE(handler.body == "hello world");
+    // stops at the end of the request, the next one is left
+    REQUIRE(strcmp(req + used, "GET / HTTP/1.1\r\n\r\n") == 0);
+  }
+}
+
+TEST_CASE("HTTPParser stops after the headers", "[HTTPParser]")
+{
+  const char req[] = "PUT /x HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc";
+  RecordingHandler handler;
+  HTTPParser parser;
+
+  size_t used = parser.parse(handler, req, strlen(req));
+  REQUIRE(parser.state() == HTTPParser::PARSE_BODY);
+  REQUIRE(parser.bodyLeft() == 3);
+  REQUIRE(strcmp(req + used, "abc") == 0);
+  REQUIRE(handler.body.empty());
+}
+
+TEST_CASE("HTTPParser rejects bad requests", "[HTTPParser]")
+{
+  struct {
+    const char* req;
+    int error;
+  } cases[] = {
+    { "GET /\r\n\r\n", 400 },
+    { "GET  HTTP/1.1\r\n\r\n", 400 },
+    { "GET / FTP/1.1\r\n\r\n", 400 },
+    { "GET / HTTP/2.0\r\n\r\n", 505 },
+    { "GET / HTTP/1.1\r\nNoColon\r\n\r\n", 400 },
+    { "GET / HTTP/1.1\r\nName : x\r\n\r\n", 400 },
+    { "POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n", 400 },
+    { "POST / HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n", 400 },
+    { "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n", 501 },
+  };
+
+  for (auto& c : cases) {
+    RecordingHandler handler;
+    HTTPParser parser;
+    feed(parser, handler, c.req, 1000);
+    REQUIRE(parser.state() == HTTPParser::PARSE_ERROR);
+    REQUIRE(parser.error() == c.error);
+  }
+}
+
+TEST_CASE("HTTPParser line too long", "[HTTPParser]")
+{
+  std::string uri(HTTP_PARSER_LINE_LEN, 'a');
+  std::string req = "GET /" + uri + " HTTP/1.1\r\n\r\n";
+  RecordingHandler handler;
+  HTTPParser parser;
+
+  feed(parser, handler, req.c_str(), 100);
+  REQUIRE(parser.error() == 414);
+
+  req = "GET / HTTP/1.1\r\nX: " + uri + "\r\n\r\n";
+  parser.reset();
+  feed(parser, handler, req.c_str(), 100);
+  REQUIRE(parser.error() == 431);
+}
@@ -0,0 +1,116 @@
+/*
+ test_ResponseCache.cpp - ESP8266WebServer cached response tests
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include <string>
+#include "ResponseCache.h"
+
+TEST_CASE("ResponseCache renders once per invalidate", "[ResponseCache]")
+{
+  int renders = 0;
+  int value = 21;
+  ResponseCache cache(64, "application/json", [&](Print& out) {
+    renders++;
+    out.print("{\"value\":");
+    out.print(value);
+    out.print("}");
+  });
+
+  REQUIRE(!cache.valid());
+  REQUIRE(cache.update());
+  REQUIRE(cache.update());
+  REQUIRE(renders == 1);
+  REQUIRE(std::string(cache.body(), cache.contentLength()) == "{\"value\":21}");
+  std::string etag = cache.etag();
+  REQUIRE(etag.size() == 10);
+
+  // the same body keeps its ETag
+  cache.invalidate();
+  REQUIRE(cache.update());
+  REQUIRE(renders == 2);
+  REQUIRE(etag == cache.etag());
+
+  value = 22;
+  cache.invalidate();
+  REQUIRE(cache.update());
+  REQUIRE(std::string(cache.body(), cache.contentLength()) == "{\"value\":22}");
+  REQUIRE(etag != cache.etag());
+}
+
+TEST_CASE("ResponseCache response in one piece", "[ResponseCache]")
+{
+  ResponseCache cache(64, "text/plain", [](Print& out) { out.print("hello"); });
+  REQUIRE(cache.update());
+  std::string etag = cache.etag();
+
+  const char* data;
+  size_t len = cache.response(1, true, data);
+  REQUIRE(std::string(data, len) ==
+    "HTTP/1.1 200 OK\r\n"
+    "Connection: keep-alive\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 5\r\n"
+    "ETag: " + etag + "\r\n"
+    "Cache-Control: no-cache\r\n"
+    "\r\n"
+    "hello");
+
+  len = cache.response(0, false, data);
+  REQUIRE(std::string(data, len).find("HTTP/1.0 200 OK\r\nConnection: close\r\nContent-Type") == 0);
+
+  char buf[96];
+  len = cache.notModified(1, true, buf, sizeof(buf));
+  REQUIRE(std::string(buf, len) ==
+    "HTTP/1.1 304 Not Modified\r\n"
+    "ETag: " + etag + "\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n");
+  REQUIRE(cache.notModified(1, true, buf, 20) == 0);
+}
+
+TEST_CASE("ResponseCache If-None-Match", "[ResponseCache]")
+{
+  ResponseCache cache(64, "text/plain", [](Print& out) { out.print("hello"); });
+  REQUIRE(!cache.matches("*"));
+  REQUIRE(cache.update());
+  std::string etag = cache.etag();
+
+  REQUIRE(cache.matches(etag.c_str()));
+  REQUIRE(cache.matches(("W/" + etag).c_str()));
+  REQUIRE(cache.matches(("\"0\", " + etag).c_str()));
+  REQUIRE(cache.matches(" *"));
+  REQUIRE(!cache.matches(""));
+  REQUIRE(!cache.matches("\"00000000\""));
+  REQUIRE(!cache.matches(nullptr));
+
+  cache.invalidate();
+  REQUIRE(!cache.matches(etag.c_str()));
+}
+
+TEST_CASE("ResponseCache body too long", "[ResponseCache]")
+{
+  size_t length = 20;
+  ResponseCache cache(16, "text/plain", [&](Print& out) {
+    for (size_t i = 0; i < length; i++)
+      out.write('x');
+  });
+
+  REQUIRE(!cache.update());
+  REQUIRE(!cache.valid());
+
+  length = 16;
+  REQUIRE(cache.update());
+  REQUIRE(cache.contentLength() == 16);
+}
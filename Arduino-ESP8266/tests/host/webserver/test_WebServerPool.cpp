@@ -0,0 +1,250 @@
+/*
+ test_WebServerPool.cpp - ESP8266WebServer client pool tests
+
+ The server runs on the emulator's WiFiServer and WiFiClient, which are host
+ sockets; the clients are plain sockets on the loopback. The test calls
+ handleClient() itself while it waits for an answer, as loop() would.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <ESP8266WebServer.h> // ahead of arpa/inet.h, IPAddress.h has an INADDR_ANY
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define POOL_PORT 18090 // not shifted by the emulator, one per test case
+#define POOL_WAIT 2000 // ms for an answer
+
+struct Response {
+  int code;
+  std::string body;
+  bool close;
+};
+
+static int connectServer(uint16_t port) {
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  REQUIRE(connect(sock, (sockaddr*) &addr, sizeof(addr)) == 0);
+  return sock;
+}
+
+static void sendText(int sock, const std::string& text) {
+  REQUIRE(send(sock, text.data(), text.size(), 0) == (ssize_t) text.size());
+}
+
+// takes what came in on sock into in, false once the server closed it
+static bool receive(int sock, std::string& in) {
+  char buf[2048];
+  ssize_t n = recv(sock, buf, sizeof(buf), MSG_DONTWAIT);
+  if (n == 0)
+    return false;
+  if (n > 0)
+    in.append(buf, n);
+  return true;
+}
+
+// the first whole response in in, taken out of it
+static bool takeResponse(std::string& in, Response& response) {
+  size_t end = in.find("\r\n\r\n");
+  if (end == std::string::npos)
+    return false;
+  std::string head = in.substr(0, end + 4);
+  size_t field = head.find("Content-Length: ");
+  size_t length = field == std::string::npos ? 0 : atol(head.c_str() + field + 16);
+  if (in.size() < end + 4 + length)
+    return false;
+  response.code = atoi(head.c_str() + 9);
+  response.body = in.substr(end + 4, length);
+  response.close = head.find("Connection: close") != std::string::npos;
+  in.erase(0, end + 4 + length);
+  return true;
+}
+
+// serves until a response is in on sock, code -1 if it does not come
+static Response serveResponse(ESP8266WebServer& server, int sock, std::string& in) {
+  Response response = { -1, "", false };
+  unsigned long start = millis();
+  while (!takeResponse(in, response) && millis() - start < POOL_WAIT) {
+    server.handleClient();
+    if (!receive(sock, in))
+      break;
+  }
+  return response;
+}
+
+// serves for ms or until the server closes sock, true if it did
+static bool serveUntilClosed(ESP8266WebServer& server, int sock, unsigned long ms) {
+  std::string in;
+  unsigned long start = millis();
+  while (millis() - start < ms) {
+    server.handleClient();
+    if (!receive(sock, in))
+      return true;
+    usleep(1000);
+  }
+  return false;
+}
+
+static void addHandlers(ESP8266WebServer& server, int& served) {
+  server.on("/a", [&]() {
+    served++;
+    server.send(200, "text/plain", "a");
+  });
+  server.on("/b", [&]() {
+    served++;
+    server.send(200, "text/plain", "bb");
+  });
+}
+
+TEST_CASE("WebServer pool serves keep-alive clients next to a slow one", "[WebServerPool]")
+{
+  ESP8266WebServer server(POOL_PORT);
+  int served = 0;
+  addHandlers(server, served);
+  server.setMaxClients(3);
+  server.begin();
+
+  // half a head, the rest much later
+  int slow = connectServer(POOL_PORT);
+  std::string slowIn;
+  sendText(slow, "GET /b HTTP/1.1\r\nHost: pool\r\n");
+
+  int clients[2];
+  std::string in[2];
+  for (int c = 0; c < 2; c++)
+    clients[c] = connectServer(POOL_PORT);
+
+  // turns of requests on the same two connections
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 2; c++) {
+      INFO("client " << c << " request " << r);
+      sendText(clients[c], c ? "GET /b HTTP/1.1\r\n\r\n" : "GET /a HTTP/1.1\r\n\r\n");
+      Response response = serveResponse(server, clients[c], in[c]);
+      CHECK(response.code == 200);
+      CHECK(response.body == (c ? "bb" : "a"));
+      CHECK_FALSE(response.close);
+    }
+  }
+  CHECK(served == 6);
+
+  sendText(slow, "\r\n");
+  Response response = serveResponse(server, slow, slowIn);
+  CHECK(response.code == 200);
+  CHECK(response.body == "bb");
+  CHECK(served == 7);
+
+  close(slow);
+  for (int c = 0; c < 2; c++)
+    close(clients[c]);
+}
+
+TEST_CASE("WebServer pool answers pipelined requests in order", "[WebServerPool]")
+{
+  ESP8266WebServer server(POOL_PORT + 1);
+  int served = 0;
+  addHandlers(server, served);
+  server.setMaxClients(2);
+  server.begin();
+
+  int sock = connectServer(POOL_PORT + 1);
+  std::string in;
+  sendText(sock,
+    "GET /a HTTP/1.1\r\n\r\n"
+    "GET /b HTTP/1.1\r\nHost: pool\r\n\r\n"
+    "\r\n" // a stray empty line between two requests is skipped
+    "GET /a HTTP/1.1\r\n\r\n");
+
+  const char* bodies[] = { "a", "bb", "a" };
+  for (const char* body : bodies) {
+    INFO("body " << body);
+    Response response = serveResponse(server, sock, in);
+    CHECK(response.code == 200);
+    CHECK(response.body == body);
+  }
+  CHECK(served == 3);
+  CHECK(in.empty());
+
+  // HTTP/1.0 closes after the response
+  sendText(sock, "GET /b HTTP/1.0\r\n\r\n");
+  Response response = serveResponse(server, sock, in);
+  CHECK(response.code == 200);
+  CHECK(response.close);
+  CHECK(serveUntilClosed(server, sock, HTTP_MAX_CLOSE_WAIT + 500));
+  close(sock);
+}
+
+TEST_CASE("WebServer pool sends 431 for a head over WEBSERVER_HEAD_LEN", "[WebServerPool]")
+{
+  ESP8266WebServer server(POOL_PORT + 2);
+  int served = 0;
+  addHandlers(server, served);
+  server.setMaxClients(2);
+  server.begin();
+
+  int big = connectServer(POOL_PORT + 2);
+  std::string bigIn;
+  sendText(big, "GET /a HTTP/1.1\r\nX-Filler: " + std::string(WEBSERVER_HEAD_LEN, 'x') + "\r\n\r\n");
+  Response response = serveResponse(server, big, bigIn);
+  CHECK(response.code == 431);
+  CHECK(response.close);
+  CHECK(served == 0);
+
+  // the other slot goes on
+  int sock = connectServer(POOL_PORT + 2);
+  std::string in;
+  sendText(sock, "GET /a HTTP/1.1\r\n\r\n");
+  response = serveResponse(server, sock, in);
+  CHECK(response.code == 200);
+  CHECK(served == 1);
+
+  close(big);
+  close(sock);
+}
+
+TEST_CASE("WebServer pool closes an idle keep-alive connection", "[WebServerPool]")
+{
+  ESP8266WebServer server(POOL_PORT + 3);
+  int served = 0;
+  addHandlers(server, served);
+  server.setMaxClients(2);
+  server.begin();
+
+  int sock = connectServer(POOL_PORT + 3);
+  std::string in;
+  sendText(sock, "GET /a HTTP/1.1\r\n\r\n");
+  Response response = serveResponse(server, sock, in);
+  CHECK(response.code == 200);
+  CHECK_FALSE(response.close);
+
+  // open for HTTP_MAX_KEEPALIVE_WAIT after the response, closed then
+  unsigned long start = millis();
+  CHECK_FALSE(serveUntilClosed(server, sock, HTTP_MAX_KEEPALIVE_WAIT - 500));
+  CHECK(serveUntilClosed(server, sock, 1500));
+  unsigned long idle = millis() - start;
+  CHECK(idle >= HTTP_MAX_KEEPALIVE_WAIT);
+  close(sock);
+
+  // and the slot takes the next client
+  sock = connectServer(POOL_PORT + 3);
+  sendText(sock, "GET /b HTTP/1.1\r\n\r\n");
+  response = serveResponse(server, sock, in);
+  CHECK(response.code == 200);
+  CHECK(served == 2);
+  close(sock);
+}
@@ -58,6 +58,13 @@ void PendSV_Handler(void);
 void SysTick_Handler(void);
 void USART2_IRQHandler(void);
 /* USER CODE BEGIN EFP */
+void DMA1_Channel6_IRQHandler(void);
+void DMA1_Channel7_IRQHandler(void);
+void I2C3_EV_IRQHandler(void);
+void I2C3_ER_IRQHandler(void);
+void DMA1_Channel2_IRQHandler(void);
+void DMA1_Channel1_IRQHandler(void);
+void LPTIM1_IRQHandler(void);
 
 /* USER CODE END EFP */
 
@@ -0,0 +1,285 @@
+/*
+ * AdcScan.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <string.h>
+#include "AdcScan.h"
+
+// the rank constants are register encodings, not 1..n
+static const uint32_t Ranks[ADC_MAX_CHANNELS] =
+{
+	ADC_REGULAR_RANK_1, ADC_REGULAR_RANK_2, ADC_REGULAR_RANK_3, ADC_REGULAR_RANK_4,
+	ADC_REGULAR_RANK_5, ADC_REGULAR_RANK_6, ADC_REGULAR_RANK_7, ADC_REGULAR_RANK_8
+};
+
+// scan whose DMA interrupts are served
+static AdcScan *Scanning;
+
+AdcScan::AdcScan(ADC_HandleTypeDef *hadc)
+{
+	m_hadc = hadc;
+	memset(&m_dma, 0, sizeof(m_dma));
+	memset(m_channels, 0, sizeof(m_channels));
+	memset(m_buffer, 0, sizeof(m_buffer));
+
+	m_count = 0;
+	m_vrefIndex = -1;
+	m_filterShift = 0;
+	m_running = false;
+	m_ready = -1;
+	m_scanning = false;
+	m_scans = 0;
+	m_polled = 0;
+}
+
+int AdcScan::AddChannel(uint32_t channel, GPIO_TypeDef *port, uint32_t pin,
+		uint16_t gainNum, uint16_t gainDen)
+{
+	if (m_running || m_count >= ADC_MAX_CHANNELS || gainDen == 0)
+		return -1;
+
+	if (port != NULL)
+	{
+		GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+		GPIO_InitStruct.Pin = pin;
+		GPIO_InitStruct.Mode = GPIO_MODE_ANALOG_ADC_CONTROL;
+		GPIO_InitStruct.Pull = GPIO_NOPULL;
+		HAL_GPIO_Init(port, &GPIO_InitStruct);
+	}
+
+	AdcChannel &ch = m_channels[m_count];
+	ch.channel = channel;
+	ch.gainNum = gainNum;
+	ch.gainDen = gainDen;
+	ch.filter = 0;
+
+	if (channel == ADC_CHANNEL_VREFINT)
+		m_vrefIndex = m_count;
+
+	return m_count++;
+}
+
+bool AdcScan::Begin(int filterShift)
+{
+	ADC_ChannelConfTypeDef sConfig = {0};
+
+	if (m_running)
+		return true;
+
+	// the reference is needed for every conversion
+	if (m_vrefIndex < 0 && AddChannel(ADC_CHANNEL_VREFINT) < 0)
+		return false;
+
+	m_filterShift = filterShift;
+
+	HAL_ADC_DeInit(m_hadc);
+
+	m_hadc->Init.ClockPrescaler = ADC_SCAN_PRESCALER;
+	m_hadc->Init.Resolution = ADC_RESOLUTION_12B;
+	m_hadc->Init.DataAlign = ADC_DATAALIGN_RIGHT;
+	m_hadc->Init.ScanConvMode = ADC_SCAN_ENABLE;
+	m_hadc->Init.EOCSelection = ADC_EOC_SEQ_CONV;
+	m_hadc->Init.LowPowerAutoWait = DISABLE;
+	m_hadc->Init.ContinuousConvMode = ENABLE;
+	m_hadc->Init.NbrOfConversion = m_count;
+	m_hadc->Init.DiscontinuousConvMode = DISABLE;
+	m_hadc->Init.ExternalTrigConv = ADC_SOFTWARE_START;
+	m_hadc->Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
+	m_hadc->Init.DMAContinuousRequests = ENABLE;
+	m_hadc->Init.Overrun = ADC_OVR_DATA_OVERWRITTEN;
+	m_hadc->Init.OversamplingMode = ENABLE;
+	m_hadc->Init.Oversampling.Ratio = ADC_OVS_RATIO;
+	m_hadc->Init.Oversampling.RightBitShift = ADC_OVS_SHIFT;
+	m_hadc->Init.Oversampling.TriggeredMode = ADC_TRIGGEREDMODE_SINGLE_TRIGGER;
+	m_hadc->Init.Oversampling.OversamplingStopReset = ADC_REGOVERSAMPLING_CONTINUED_MODE;
+	if (HAL_ADC_Init(m_hadc) != HAL_OK)
+		return false;
+
+	for (int i = 0; i < m_count; i++)
+	{
+		// the internal channels need at least 5 us of sampling
+		sConfig.Channel = m_channels[i].channel;
+		sConfig.Rank = Ranks[i];
+		sConfig.SamplingTime = ADC_SAMPLETIME_640CYCLES_5;
+		sConfig.SingleDiff = ADC_SINGLE_ENDED;
+		sConfig.OffsetNumber = ADC_OFFSET_NONE;
+		sConfig.Offset = 0;
+		if (HAL_ADC_ConfigChannel(m_hadc, &sConfig) != HAL_OK)
+			return false;
+	}
+
+	if (HAL_ADCEx_Calibration_Start(m_hadc, ADC_SINGLE_ENDED) != HAL_OK)
+		return false;
+
+	// ADC1 requests are wired to DMA1 channel 1, request 0
+	__HAL_RCC_DMA1_CLK_ENABLE();
+
+	m_dma.Instance = DMA1_Channel1;
+	m_dma.Init.Request = DMA_REQUEST_0;
+	m_dma.Init.Direction = DMA_PERIPH_TO_MEMORY;
+	m_dma.Init.PeriphInc = DMA_PINC_DISABLE;
+	m_dma.Init.MemInc = DMA_MINC_ENABLE;
+	m_dma.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+	m_dma.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+	m_dma.Init.Mode = DMA_CIRCULAR;
+	m_dma.Init.Priority = DMA_PRIORITY_LOW;
+	if (HAL_DMA_Init(&m_dma) != HAL_OK)
+		return false;
+	__HAL_LINKDMA(m_hadc, DMA_Handle, m_dma);
+
+	HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, 3, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+
+	Scanning = this;
+	m_ready = -1;
+	m_scanning = true;
+	if (HAL_ADC_Start_DMA(m_hadc, (uint32_t *) m_buffer, 2 * m_count) != HAL_OK)
+		return false;
+
+	m_running = true;
+	return true;
+}
+
+void AdcScan::Suspend(void)
+{
+	if (!m_running)
+		return;
+
+	HAL_ADC_Stop_DMA(m_hadc);
+
+	// Resume() starts over at the first half, which may hold the last scan
+	int half = m_ready;
+
+	m_ready = -1;
+	if (half >= 0)
+		FilterScan(half);
+}
+
+void AdcScan::Resume(void)
+{
+	if (!m_running)
+		return;
+
+	// a new scan starts at the beginning of the buffer
+	m_scanning = true;
+	HAL_ADC_Start_DMA(m_hadc, (uint32_t *) m_buffer, 2 * m_count);
+}
+
+bool AdcScan::Poll(void)
+{
+	int half = m_ready;
+
+	if (half >= 0)
+	{
+		m_ready = -1;
+		FilterScan(half);
+	}
+
+	bool fresh = (m_scans != m_polled);
+
+	m_polled = m_scans;
+	return fresh;
+}
+
+void AdcScan::FilterScan(int half)
+{
+	// the DMA is filling the other half meanwhile
+	const uint16_t *scan = &m_buffer[half * m_count];
+
+	for (int i = 0; i < m_count; i++)
+		Filter(m_channels[i].filter, scan[i], m_filterShift);
+
+	m_scans++;
+}
+
+uint32_t AdcScan::Filtered(int index)
+{
+	return (uint32_t) m_channels[index].filter >> m_filterShift;
+}
+
+uint32_t AdcScan::GetVdda(void)
+{
+	if (m_vrefIndex < 0 || m_scans == 0)
+		return 0;
+
+	return Vdda(Filtered(m_vrefIndex), *VREFINT_CAL_ADDR);
+}
+
+int32_t AdcScan::Get(int index)
+{
+	if (index < 0 || index >= m_count || m_scans == 0)
+		return 0;
+
+	const AdcChannel &ch = m_channels[index];
+
+	return (int32_t) (ToMillivolts(Filtered(index), GetVdda()) * ch.gainNum / ch.gainDen);
+}
+
+int32_t AdcScan::GetTemperature(int index)
+{
+	if (index < 0 || index >= m_count || m_scans == 0)
+		return 0;
+
+	return Temperature(Filtered(index), GetVdda(), *TEMPSENSOR_CAL1_ADDR,
+			*TEMPSENSOR_CAL2_ADDR);
+}
+
+uint32_t AdcScan::Vdda(uint32_t vrefRaw, uint16_t vrefCal)
+{
+	if (vrefRaw == 0)
+		return 0;
+
+	return (VREFINT_CAL_VREF * vrefCal * ADC_OVS_SCALE + vrefRaw / 2) / vrefRaw;
+}
+
+uint32_t AdcScan::ToMillivolts(uint32_t raw, uint32_t vdda)
+{
+	return (raw * vdda + ADC_FULL_SCALE / 2) / ADC_FULL_SCALE;
+}
+
+int32_t AdcScan::Temperature(uint32_t raw, uint32_t vdda, uint16_t cal1,
+		uint16_t cal2)
+{
+	if (cal2 <= cal1)
+		return 0;
+
+	// result as it would read at the calibration voltage, still scaled
+	int32_t atCal = (int32_t) (raw * vdda / TEMPSENSOR_CAL_VREFANALOG);
+	int32_t span = (TEMPSENSOR_CAL2_TEMP - TEMPSENSOR_CAL1_TEMP) * 10;
+
+	return (atCal - cal1 * ADC_OVS_SCALE) * span / ((cal2 - cal1) * ADC_OVS_SCALE)
+			+ TEMPSENSOR_CAL1_TEMP * 10;
+}
+
+uint32_t AdcScan::Filter(int32_t &state, uint32_t sample, int shift)
+{
+	if (state == 0)
+		state = (int32_t) sample << shift;
+	else
+		state += (int32_t) sample - (state >> shift);
+
+	return (uint32_t) state >> shift;
+}
+
+void AdcScan::ScanDone(ADC_HandleTypeDef *hadc, int half)
+{
+	if (Scanning != NULL && Scanning->m_hadc == hadc)
+	{
+		Scanning->m_ready = half;
+		Scanning->m_scanning = false;
+	}
+}
+
+extern "C" void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc)
+{
+	AdcScan::ScanDone(hadc, 0);
+}
+
+extern "C" void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+	AdcScan::ScanDone(hadc, 1);
+}
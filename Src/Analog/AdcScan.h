@@ -0,0 +1,138 @@
+/*
+ * AdcScan.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef ANALOG_ADCSCAN_H_
+#define ANALOG_ADCSCAN_H_
+
+#include <stdint.h>
+#include <stm32l4xx_hal.h>
+
+// regular channels of a scan, the VREFINT channel added by Begin() included
+#define ADC_MAX_CHANNELS	8
+
+// 64 conversions per result shifted right by 2: 16 bit results, 12 bit
+// values scaled by 16
+#define ADC_OVS_RATIO		ADC_OVERSAMPLING_RATIO_64
+#define ADC_OVS_SHIFT		ADC_RIGHTBITSHIFT_2
+#define ADC_OVS_SCALE		16
+#define ADC_FULL_SCALE		(4095 * ADC_OVS_SCALE)
+
+// ADC clock 64 MHz / 16, with 640.5 cycle sampling one scan of five
+// channels takes about 50 ms
+#define ADC_SCAN_PRESCALER	ADC_CLOCK_ASYNC_DIV16
+
+struct AdcChannel
+{
+	uint32_t 	channel;		// ADC_CHANNEL_x
+	uint16_t 	gainNum;		// input divider, mV at the input =
+	uint16_t 	gainDen;		//   mV at the pin * gainNum / gainDen
+	int32_t 	filter;			// filtered result << filter shift
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	class AdcScan
+//
+//	background acquisition of several ADC channels. The ADC scans all
+//	channels continuously with hardware oversampling, DMA moves the results
+//	into a circular buffer that holds two scans. The half and full transfer
+//	interrupts only note which scan is complete, Poll() runs each new scan
+//	through a first order low pass per channel.
+//
+//	The internal reference is always part of the scan: its factory
+//	calibration gives the actual VDDA, so the millivolt values do not
+//	depend on the supply. The conversion math is in static members that do
+//	not touch the hardware.
+//
+class AdcScan
+{
+public:
+	AdcScan(ADC_HandleTypeDef *hadc);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	int AddChannel(channel, port, pin, gainNum, gainDen);
+	//
+	//		channel		ADC_CHANNEL_x, ADC_CHANNEL_TEMPSENSOR for the
+	//					internal sensor
+	//		port, pin	input pin, switched to analog mode; NULL for an
+	//					internal channel
+	//		gainNum/Den	external divider
+	//
+	//	returns the index of the channel for Get(), -1 if the scan is full
+	//	or running
+	//
+	int AddChannel(uint32_t channel, GPIO_TypeDef *port = NULL, uint32_t pin = 0,
+			uint16_t gainNum = 1, uint16_t gainDen = 1);
+
+	// sets up the ADC and its DMA and starts scanning, the low pass weight
+	// of a new scan is 1 / 2^filterShift
+	bool Begin(int filterShift);
+
+	// filters a completed scan, returns true if one was filtered since the
+	// last call, here or in Suspend()
+	bool Poll(void);
+
+	// filtered input voltage in mV, 0 until the first scan is in
+	int32_t Get(int index);
+
+	// filtered temperature of an ADC_CHANNEL_TEMPSENSOR channel, 0.1 C
+	int32_t GetTemperature(int index);
+
+	// supply and reference voltage in mV
+	uint32_t GetVdda(void);
+
+	uint32_t Scans(void) { return m_scans; }
+
+	// stops and restarts scanning, the ADC does not run in STOP2. A scan
+	// completed before Suspend() is filtered, a partial one is lost.
+	void Suspend(void);
+	void Resume(void);
+
+	// true from Begin() or Resume() until the first scan is complete: a
+	// scan takes longer than most idle times, stopping in each of them
+	// would never let one finish
+	bool IsBusy(void) { return m_running && m_scanning; }
+
+	////////////////////////////// conversion math //////////////////////////////
+
+	// VDDA from a VREFINT result and its calibration value (taken at 3.0 V)
+	static uint32_t Vdda(uint32_t vrefRaw, uint16_t vrefCal);
+
+	// pin voltage of a result
+	static uint32_t ToMillivolts(uint32_t raw, uint32_t vdda);
+
+	// temperature sensor result to 0.1 C, cal1/cal2 taken at 3.0 V
+	static int32_t Temperature(uint32_t raw, uint32_t vdda, uint16_t cal1,
+			uint16_t cal2);
+
+	// first order low pass, state is kept << shift; a zero state is seeded
+	// with the first sample
+	static uint32_t Filter(int32_t &state, uint32_t sample, int shift);
+
+	// called from the DMA interrupts, half 0 or 1 of the buffer is complete
+	static void ScanDone(ADC_HandleTypeDef *hadc, int half);
+
+private:
+	void FilterScan(int half);
+	uint32_t Filtered(int index);
+
+	ADC_HandleTypeDef 	*m_hadc;
+	DMA_HandleTypeDef 	m_dma;
+
+	AdcChannel 			m_channels[ADC_MAX_CHANNELS];
+	int 				m_count;
+	int 				m_vrefIndex;
+	int 				m_filterShift;
+	bool 				m_running;
+
+	uint16_t 			m_buffer[2 * ADC_MAX_CHANNELS];		// two scans
+	volatile int 		m_ready;		// complete half, -1 for none
+	volatile bool 		m_scanning;		// no scan complete since the start
+	uint32_t 			m_scans;
+	uint32_t 			m_polled;		// m_scans at the last Poll()
+};
+
+#endif /* ANALOG_ADCSCAN_H_ */
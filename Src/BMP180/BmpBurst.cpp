@@ -0,0 +1,138 @@
+/*
+ * BmpBurst.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include "BmpBurst.h"
+
+BmpBurst::BmpBurst(SFE_BMP180 *pBmp)
+{
+	m_pBmp = pBmp;
+	m_errors = 0;
+	Begin(1, 1, 1, 0, 0);
+}
+
+void BmpBurst::Begin(int oss, int pressPerTemp, int samples, uint32_t periodMs,
+		int filterShift)
+{
+	m_oss = oss;
+	m_pressPerTemp = (pressPerTemp < 1) ? 1 : pressPerTemp;
+	m_samples = (samples < 1) ? 1 : samples;
+	m_periodMs = periodMs;
+	m_filterShift = filterShift;
+
+	m_state = burstIdle;
+	m_blockStart = 0;
+	m_count = 0;
+	m_sinceTemp = m_pressPerTemp;		// no temperature yet
+	m_sum = 0;
+	m_temperature = 0;
+	m_filtered = 0;
+	m_primed = false;
+	m_pressure = 0;
+	m_new = false;
+}
+
+// Drops the block and starts over after a pause
+uint32_t BmpBurst::Fail()
+{
+	m_errors++;
+	m_state = burstIdle;
+	m_sinceTemp = m_pressPerTemp;
+	return BMP_BURST_RETRY_MS;
+}
+
+uint32_t BmpBurst::Step(uint32_t now)
+{
+	byte wait;
+
+	switch (m_state)
+	{
+	case burstIdle:
+		// a block starts with a temperature when the last one is used up
+		m_blockStart = now;
+		m_count = 0;
+		m_sum = 0;
+
+		if (m_sinceTemp >= m_pressPerTemp)
+		{
+			wait = m_pBmp->StartTemperature();
+			m_state = burstTemp;
+		}
+		else
+		{
+			wait = m_pBmp->StartPressure(m_oss);
+			m_state = burstPress;
+		}
+		return (wait == 0) ? Fail() : wait;
+
+	case burstTemp:
+		if (!m_pBmp->GetTemperature(m_temperature))
+			return Fail();
+
+		m_sinceTemp = 0;
+		wait = m_pBmp->StartPressure(m_oss);
+		if (wait == 0)
+			return Fail();
+		m_state = burstPress;
+		return wait;
+
+	case burstPress:
+	default:
+	{
+		int32_t p;
+
+		if (!m_pBmp->GetPressure(p))
+			return Fail();
+
+		m_sum += p;
+		m_count++;
+		m_sinceTemp++;
+
+		if (m_count < m_samples)
+		{
+			// next conversion right away, a new temperature every pressPerTemp
+			if (m_sinceTemp >= m_pressPerTemp)
+			{
+				wait = m_pBmp->StartTemperature();
+				m_state = burstTemp;
+			}
+			else
+				wait = m_pBmp->StartPressure(m_oss);
+
+			return (wait == 0) ? Fail() : wait;
+		}
+
+		// block complete: mean, then low pass
+		int32_t mean = (m_sum + m_samples / 2) / m_samples;
+
+		if (!m_primed || m_filterShift == 0)
+		{
+			m_filtered = mean << m_filterShift;
+			m_primed = true;
+		}
+		else
+			m_filtered += mean - (m_filtered >> m_filterShift);
+
+		m_pressure = (m_filtered + ((1 << m_filterShift) >> 1)) >> m_filterShift;
+		m_new = true;
+
+		m_state = burstIdle;
+
+		uint32_t elapsed = now - m_blockStart;
+		return (elapsed < m_periodMs) ? m_periodMs - elapsed : 0;
+	}
+	}
+}
+
+bool BmpBurst::Read(int32_t &pressure, int32_t &temperature)
+{
+	bool isNew = m_new;
+
+	pressure = m_pressure;
+	temperature = m_temperature;
+	m_new = false;
+	return isNew;
+}
@@ -0,0 +1,95 @@
+/*
+ * BmpBurst.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef BMP180_BMPBURST_H_
+#define BMP180_BMPBURST_H_
+
+#include <stdint.h>
+#include "SFE_BMP180.h"
+
+// delay before a new attempt after an I2C error
+#define BMP_BURST_RETRY_MS	100
+
+//////////////////////////////////////////////////////////////////////////////
+//	class BmpBurst
+//
+//	continuous BMP180 acquisition for a pressure trend. One temperature
+//	conversion is used for the next N pressure conversions, as the data
+//	sheet allows when the temperature changes slowly; N may span several
+//	output blocks. Fetching a result and starting the next conversion are
+//	done in the same step, so the sensor converts back to back without an
+//	idle gap in between.
+//
+//	The pressures of a block are averaged (decimation) and the block means
+//	go through a first order low pass, one output per block. When the
+//	output period is longer than the block, the sensor idles until the next
+//	block is due.
+//
+//	Step() does not wait: it returns the ms until it wants to be called
+//	again, meant as the delay of a scheduler task.
+//
+class BmpBurst
+{
+public:
+	BmpBurst(SFE_BMP180 *pBmp);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	void Begin(oss, pressPerTemp, samples, periodMs, filterShift);
+	//
+	//		oss				pressure oversampling 0 - 3
+	//		pressPerTemp	pressure conversions per temperature conversion,
+	//						also across blocks when larger than samples
+	//		samples			pressure conversions averaged into one output
+	//		periodMs		output period, 0 runs the blocks back to back
+	//		filterShift		low pass weight of a new output is 1 / 2^filterShift,
+	//						0 disables the filter
+	//
+	void Begin(int oss, int pressPerTemp, int samples, uint32_t periodMs,
+			int filterShift);
+
+	// runs one acquisition step, returns the ms until the next one
+	uint32_t Step(uint32_t now);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	bool Read(int32_t &pressure, int32_t &temperature);
+	//
+	//	latest output: filtered pressure in Pa, temperature in 0.1 deg C
+	//
+	//	returns true if it is new since the last call
+	//
+	bool Read(int32_t &pressure, int32_t &temperature);
+
+	uint32_t Errors() { return m_errors; }
+
+private:
+	enum BurstState {burstIdle, burstTemp, burstPress};
+
+	uint32_t Fail();
+
+	SFE_BMP180 	*m_pBmp;
+	BurstState 	m_state;
+
+	int 		m_oss;
+	int 		m_pressPerTemp;
+	int 		m_samples;
+	uint32_t 	m_periodMs;
+	int 		m_filterShift;
+
+	uint32_t 	m_blockStart;		// tick when the current block started
+	int 		m_count;			// pressures in the current block
+	int 		m_sinceTemp;		// pressures since the last temperature
+	int32_t 	m_sum;
+
+	int32_t 	m_temperature;		// 0.1 deg C
+	int32_t 	m_filtered;			// Pa << filterShift
+	bool 		m_primed;			// m_filtered holds a value
+	int32_t 	m_pressure;			// output, Pa
+	bool 		m_new;
+	uint32_t 	m_errors;
+};
+
+#endif /* BMP180_BMPBURST_H_ */
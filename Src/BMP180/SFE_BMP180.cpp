@@ -20,12 +20,18 @@
 #include <SFE_BMP180.h>
 #include <stdio.h>
 #include <math.h>
+#include "DLog.h"
+#include "Profiler.h"
 
 
-SFE_BMP180::SFE_BMP180(I2C_HandleTypeDef *pI2C)
+SFE_BMP180::SFE_BMP180(I2cBus *pBus, BmpCompEnum comp)
 // Base library Constructor
 {
-	m_pI2C = pI2C;
+	m_comp = comp;
+	m_B5 = 0;
+	m_oss = 0;
+	m_pBus = pBus;
+	m_dev = pBus->AddDevice(BMP180_ADDR);
 }
 
 
@@ -40,7 +46,7 @@ bool SFE_BMP180::Begin()
 	// used in the calculations when taking pressure measurements.
 
 	// Retrieve calibration data from device:
-	m_error= HAL_I2C_Mem_Read(m_pI2C, BMP180_ADDR << 1, 0xAA, I2C_MEMADD_SIZE_8BIT, buf, 22, 500);
+	m_error = m_pBus->MemRead(m_dev, 0xAA, buf, 22);
 	
 	if(m_error == HAL_OK)
 	{
@@ -70,17 +76,17 @@ bool SFE_BMP180::Begin()
 		m_MC  = (int16_t)((buf[18]<<8) | buf[19]);
 		m_MD  = (int16_t)((buf[20]<<8) | buf[21]);
 
-		printf("BMP180: AC1=%d \n", m_AC1);
-		printf("BMP180: AC2=%d \n", m_AC2);
-		printf("BMP180: AC3=%d \n", m_AC3);
-		printf("BMP180: AC4=%d \n", m_AC4);
-		printf("BMP180: AC5=%d \n", m_AC5);
-		printf("BMP180: AC6=%d \n", m_AC6);
-		printf("BMP180: VB1=%d \n", m_VB1);
-		printf("BMP180: VB2=%d \n", m_VB2);
-		printf("BMP180: MB=%d \n", m_MB);
-		printf("BMP180: MC=%d \n", m_MC);
-		printf("BMP180: MD=%d \n", m_MD);
+		DLOG_DEBUG("BMP180: AC1=%d \n", m_AC1);
+		DLOG_DEBUG("BMP180: AC2=%d \n", m_AC2);
+		DLOG_DEBUG("BMP180: AC3=%d \n", m_AC3);
+		DLOG_DEBUG("BMP180: AC4=%d \n", m_AC4);
+		DLOG_DEBUG("BMP180: AC5=%d \n", m_AC5);
+		DLOG_DEBUG("BMP180: AC6=%d \n", m_AC6);
+		DLOG_DEBUG("BMP180: VB1=%d \n", m_VB1);
+		DLOG_DEBUG("BMP180: VB2=%d \n", m_VB2);
+		DLOG_DEBUG("BMP180: MB=%d \n", m_MB);
+		DLOG_DEBUG("BMP180: MC=%d \n", m_MC);
+		DLOG_DEBUG("BMP180: MD=%d \n", m_MD);
 		
 		// Compute floating-point polynominals:
 
@@ -97,26 +103,30 @@ bool SFE_BMP180::Begin()
 		m_y0 = c4 * pow(2,15);
 		m_y1 = c4 * c3;
 		m_y2 = c4 * b1;
-		m_y0 = (3791.0 - 8.0) / 1600.0;
-		m_y1 = 1.0 - 7357.0 * pow(2,-20);
-		m_y2 = 3038.0 * 100.0 * pow(2,-36);
-
-		printf("BMP180: c3=%f\n", c3);
-		printf("BMP180: c4=%f\n", c4);
-		printf("BMP180: m_c5=%f\n", m_c5);
-		printf("BMP180: m_c6=%f\n", m_c6);
-		printf("BMP180: b1=%f\n", b1);
-		printf("BMP180: m_mc=%f\n", m_mc);
-		printf("BMP180: m_md=%f\n", m_md);
-		printf("BMP180: m_x0=%f\n", m_x0);
-		printf("BMP180: m_x1=%f\n", m_x1);
-		printf("BMP180: m_x2=%f\n", m_x2);
-		printf("BMP180: m_y0=%f\n", m_y0);
-		printf("BMP180: m_y1=%f\n", m_y1);
-		printf("BMP180: m_y2=%f\n", m_y2);
-		printf("BMP180: m_p0=%f\n", m_p0);
-		printf("BMP180: m_p1=%f\n", m_p1);
-		printf("BMP180: m_p2=%f\n", m_p2);
+		m_p0 = (3791.0 - 8.0) / 1600.0;
+		m_p1 = 1.0 - 7357.0 * pow(2,-20);
+		m_p2 = 3038.0 * 100.0 * pow(2,-36);
+
+		// Integer algorithm: terms that only depend on the calibration
+		m_MC11 = (int32_t) m_MC << 11;
+		m_AC1x4 = (int32_t) m_AC1 * 4;
+
+		DLOG_DEBUG("BMP180: c3=%f\n", c3);
+		DLOG_DEBUG("BMP180: c4=%f\n", c4);
+		DLOG_DEBUG("BMP180: m_c5=%f\n", m_c5);
+		DLOG_DEBUG("BMP180: m_c6=%f\n", m_c6);
+		DLOG_DEBUG("BMP180: b1=%f\n", b1);
+		DLOG_DEBUG("BMP180: m_mc=%f\n", m_mc);
+		DLOG_DEBUG("BMP180: m_md=%f\n", m_md);
+		DLOG_DEBUG("BMP180: m_x0=%f\n", m_x0);
+		DLOG_DEBUG("BMP180: m_x1=%f\n", m_x1);
+		DLOG_DEBUG("BMP180: m_x2=%f\n", m_x2);
+		DLOG_DEBUG("BMP180: m_y0=%f\n", m_y0);
+		DLOG_DEBUG("BMP180: m_y1=%f\n", m_y1);
+		DLOG_DEBUG("BMP180: m_y2=%f\n", m_y2);
+		DLOG_DEBUG("BMP180: m_p0=%f\n", m_p0);
+		DLOG_DEBUG("BMP180: m_p1=%f\n", m_p1);
+		DLOG_DEBUG("BMP180: m_p2=%f\n", m_p2);
 		
 		// Success!
 		return true;
@@ -159,6 +169,15 @@ bool SFE_BMP180::GetTemperature(float &temperature)
 	bool result;
 	float tu, a;
 	
+	if (m_comp == bmpCompInteger)
+	{
+		int32_t t;
+
+		result = GetTemperature(t);
+		if (result)
+			temperature = t / 10.0f;
+		return result;
+	}
 
 	result = ReadBytes(BMP180_REG_RESULT, data, 2);
 
@@ -175,9 +194,9 @@ bool SFE_BMP180::GetTemperature(float &temperature)
 		a = m_c5 * (tu - m_c6);
 		temperature = a + (m_mc / (a + m_md));
 
-		printf("BMP_GetTemperature: tu=%f\n", tu);
-		printf("BMP_GetTemperature: a=%f\n", a);
-		printf("BMP_GetTemperature: temperature=%f\n", temperature);
+		DLOG_DEBUG("BMP_GetTemperature: tu=%f\n", tu);
+		DLOG_DEBUG("BMP_GetTemperature: a=%f\n", a);
+		DLOG_DEBUG("BMP_GetTemperature: temperature=%f\n", temperature);
 	}
 
 	return(result);
@@ -217,6 +236,7 @@ byte SFE_BMP180::StartPressure(int oversampling)
 		break;
 	}
 	result = WriteBytes(BMP180_REG_CONTROL, &data, 1);
+	m_oss = (data >> 6) & 3;
 
 	if (result) // good write?
 		return(delay); // return the delay in ms (rounded up) to wait before retrieving data
@@ -241,6 +261,17 @@ bool SFE_BMP180::GetPressure(float &pressure, float temperature)
 	bool result;
 	float pu,s,x,y,z;
 
+	if (m_comp == bmpCompInteger)
+	{
+		int32_t p;
+
+		// the temperature term comes from the last GetTemperature()
+		result = GetPressure(p);
+		if (result)
+			pressure = p / 100.0f;
+		return result;
+	}
+
 	result = ReadBytes(BMP180_REG_RESULT, data, 3);
 	
 	if (result) 	// good read, calculate pressure
@@ -259,18 +290,99 @@ bool SFE_BMP180::GetPressure(float &pressure, float temperature)
 		z = (pu - x) / y;
 		pressure = (m_p2 * pow(z, 2)) + (m_p1 * z) + m_p0;
 
-		printf("%s(%d): Pressure=%f\n", __FUNCTION__, __LINE__, pressure);
-		printf("BMP180: Temp=%f\n", temperature);
-		printf("BMP180: s=%f\n", s);
-		printf("BMP180: x=%f\n", x);
-		printf("BMP180: y=%f\n", y);
-		printf("BMP180: z=%f\n", z);
-		printf("BMP180: pu=%f\n", pu);
+		DLOG_DEBUG("%s(%d): Pressure=%f\n", __FUNCTION__, __LINE__, pressure);
+		DLOG_DEBUG("BMP180: Temp=%f\n", temperature);
+		DLOG_DEBUG("BMP180: s=%f\n", s);
+		DLOG_DEBUG("BMP180: x=%f\n", x);
+		DLOG_DEBUG("BMP180: y=%f\n", y);
+		DLOG_DEBUG("BMP180: z=%f\n", z);
+		DLOG_DEBUG("BMP180: pu=%f\n", pu);
 	}
 	return(result);
 }
 
 
+bool SFE_BMP180::GetTemperature(int32_t &temperature)
+// Retrieve a previously-started temperature reading with the integer algorithm.
+// temperature: external variable to hold the result in 0.1 deg C.
+// Returns 1 if successful, 0 if I2C error.
+{
+	byte data[2];
+
+	if (!ReadBytes(BMP180_REG_RESULT, data, 2))
+		return false;
+
+	temperature = CompTemperature((data[0] << 8) | data[1]);
+	return true;
+}
+
+
+bool SFE_BMP180::GetPressure(int32_t &pressure)
+// Retrieve a previously-started pressure reading with the integer algorithm.
+// Requires a temperature reading before, its term is kept in m_B5.
+// pressure: external variable to hold the result in Pa.
+// Returns 1 if successful, 0 if I2C error.
+{
+	byte data[3];
+
+	if (!ReadBytes(BMP180_REG_RESULT, data, 3))
+		return false;
+
+	int32_t up = ((data[0] << 16) | (data[1] << 8) | data[2]) >> (8 - m_oss);
+
+	pressure = CompPressure(up, m_oss);
+	return true;
+}
+
+
+int32_t SFE_BMP180::CompTemperature(int32_t ut)
+// Temperature compensation from the BMP180 data sheet, chapter 3.5.
+// Data sheet example: ut = 27898 gives 150 (15.0 deg C).
+{
+	PROFILE_SCOPE("bmp temp");
+	int32_t x1, x2;
+
+	x1 = ((ut - (int32_t) m_AC6) * (int32_t) m_AC5) >> 15;
+	x2 = m_MC11 / (x1 + m_MD);
+	m_B5 = x1 + x2;
+
+	return (m_B5 + 8) >> 4;
+}
+
+
+int32_t SFE_BMP180::CompPressure(int32_t up, int oss)
+// Pressure compensation from the BMP180 data sheet, chapter 3.5.
+// Data sheet example: up = 23843, oss = 0 gives 69964 Pa.
+{
+	PROFILE_SCOPE("bmp pressure");
+	int32_t b6, x1, x2, x3, b3, p;
+	uint32_t b4, b7;
+
+	b6 = m_B5 - 4000;
+	x1 = (m_VB2 * ((b6 * b6) >> 12)) >> 11;
+	x2 = (m_AC2 * b6) >> 11;
+	x3 = x1 + x2;
+	b3 = (((m_AC1x4 + x3) << oss) + 2) / 4;
+
+	x1 = (m_AC3 * b6) >> 13;
+	x2 = (m_VB1 * ((b6 * b6) >> 12)) >> 16;
+	x3 = ((x1 + x2) + 2) >> 2;
+	b4 = ((uint32_t) m_AC4 * (uint32_t) (x3 + 32768)) >> 15;
+	b7 = ((uint32_t) up - b3) * (uint32_t) (50000 >> oss);
+
+	if (b7 < 0x80000000)
+		p = (b7 * 2) / b4;
+	else
+		p = (b7 / b4) * 2;
+
+	x1 = (p >> 8) * (p >> 8);
+	x1 = (x1 * 3038) >> 16;
+	x2 = (-7357 * p) >> 16;
+
+	return p + ((x1 + x2 + 3791) >> 4);
+}
+
+
 float SFE_BMP180::SeaLevel(float basePressure, float altitude)
 // Given a pressure P (mb) taken at a specific altitude (meters),
 // return the equivalent pressure (mb) at sea level.
@@ -306,19 +418,9 @@ bool SFE_BMP180::ReadBytes(byte regAddr, byte *values, int length)
 // values: external array to hold data. Put starting register in values[0].
 // length: number of bytes to read
 {
-	byte buf[255];
+	m_error = m_pBus->MemRead(m_dev, regAddr, values, length);
 
-	m_error = HAL_I2C_Mem_Read(m_pI2C, BMP180_ADDR << 1, regAddr, I2C_MEMADD_SIZE_8BIT, buf, length, 500);
-
-	if (m_error == HAL_OK)
-	{
-		for(int ix = 0; ix < length; ix++)
-		{
-			values[ix] = buf[ix];
-		}
-		return true;
-	}
-	return false;
+	return (m_error == HAL_OK);
 }
 
 /***************************************************************************************************************/
@@ -330,9 +432,7 @@ bool SFE_BMP180::ReadInt(byte regAddr, int16_t &value)
 {
 	uint8_t buf[2];
 
-	m_error = HAL_I2C_Mem_Read(m_pI2C, BMP180_ADDR << 1, regAddr, I2C_MEMADD_SIZE_8BIT, buf, 2, 100);
-
-	HAL_Delay(1);
+	m_error = m_pBus->MemRead(m_dev, regAddr, buf, 2);
 
 	if(m_error == HAL_OK)
 	{
@@ -351,9 +451,7 @@ bool SFE_BMP180::ReadUInt(byte registerAddress, uint16_t &value)
 {
 	uint8_t buf[2];
 
-	m_error= HAL_I2C_Mem_Read(m_pI2C, BMP180_ADDR << 1, registerAddress, I2C_MEMADD_SIZE_8BIT, buf, 2, 100);
-
-	HAL_Delay(1);
+	m_error = m_pBus->MemRead(m_dev, registerAddress, buf, 2);
 
 	if(m_error == HAL_OK)
 	{
@@ -371,7 +469,7 @@ bool SFE_BMP180::WriteBytes(byte regAddr, byte *values, int length)
 // values: external array of data to write. Put starting register in values[0].
 // length: number of bytes to write
 {
-	m_error= HAL_I2C_Mem_Write(m_pI2C, BMP180_ADDR << 1, regAddr, I2C_MEMADD_SIZE_8BIT, values, length, 500);
+	m_error = m_pBus->MemWrite(m_dev, regAddr, values, length);
 
 	if (m_error == HAL_OK)
 		return true;
@@ -23,11 +23,22 @@
 #include <stdio.h>
 #include <stm32l4xx_hal.h>
 #include <main.h>
+#include "I2cBus.h"
+
+// compensation of the raw readings
+enum BmpCompEnum
+{
+	bmpCompFloat,		// floating point polynomials (wmrx00 project)
+	bmpCompInteger		// integer algorithm of the Bosch data sheet
+};
 
 class SFE_BMP180
 {
 	public:
-		SFE_BMP180(I2C_HandleTypeDef *pI2C); // base type
+		SFE_BMP180(I2cBus *pBus, BmpCompEnum comp = bmpCompInteger); // base type
+
+		void SetCompensation(BmpCompEnum comp) { m_comp = comp; }
+			// select the compensation used by GetTemperature() and GetPressure()
 
 		bool Begin();
 			// call pressure.begin() to initialize BMP180 before use
@@ -53,6 +64,12 @@ class SFE_BMP180
 			// places returned value in P variable (mbar)
 			// returns 1 for success, 0 for fail
 
+		bool GetTemperature(int32_t &temperature);
+		bool GetPressure(int32_t &pressure);
+			// same with the integer algorithm of the data sheet, whatever the
+			// compensation selected: temperature in 0.1 deg C, pressure in Pa.
+			// GetPressure() uses the last temperature read
+
 		float SeaLevel(float P, float A);
 			// convert absolute pressure to sea-level pressure (as used in weather data)
 			// P: absolute pressure (mbar)
@@ -94,6 +111,14 @@ class SFE_BMP180
 			// length: number of bytes to read back
 			// returns 1 for success, 0 for fail, with read bytes in values[] array
 			
+		int32_t CompTemperature(int32_t ut);
+			// data sheet compensation of the raw temperature ut, sets m_B5
+			// returns temperature in 0.1 deg C
+
+		int32_t CompPressure(int32_t up, int oss);
+			// data sheet compensation of the raw pressure up, needs m_B5
+			// returns pressure in Pa
+
 		bool WriteBytes(byte regAddr, byte *values, int length);
 			// write a number of bytes to a BMP180 register (and consecutive subsequent registers)
 			// values: array of char with register address in first location [0]
@@ -106,8 +131,13 @@ class SFE_BMP180
 		float m_x0, m_x1, m_x2;
 		float m_y0, m_y1, m_y2;
 		float m_p0, m_p1, m_p2;
+		int32_t m_MC11, m_AC1x4;	// MC << 11 and 4 * AC1 of the integer algorithm
+		int32_t m_B5;				// temperature term of the last reading
+		int m_oss;					// oversampling of the running pressure conversion
+		BmpCompEnum m_comp;
 		HAL_StatusTypeDef m_error;
-		I2C_HandleTypeDef *m_pI2C;
+		I2cBus *m_pBus;
+		int m_dev;		// id of the BMP180 on the bus
 };
 
 #define BMP180_ADDR 0x77 // 7-bit address
@@ -1,118 +1,283 @@
-/**
- ******************************************************************************
- * @file           : dht.c
- * @brief          : DHT11 Interface routines
- ******************************************************************************
-**/
-
-#include "dwt_stm32_delay.h"
-#include "dht11.h"
-
-/* USER CODE BEGIN PFP */
-/* Private function prototypes -----------------------------------------------*/
-
-/* USER CODE END PFP */
-
-/* USER CODE BEGIN 0 */
-
-DHT11::DHT11(GPIO_TypeDef  *port, uint32_t pin)
-{
-	m_port = port;
-	m_pin = pin;
-}
-
-void DHT11::SetGpioOutput(void)
-{
-	/*Configure GPIO pin output: PA2 */
-	GPIO_InitStruct.Pin = m_pin;
-	GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
-	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
-
-	HAL_GPIO_Init(m_port, &GPIO_InitStruct);
-}
-
-void DHT11::SetGpioInput(void)
-{
-	/*Configure GPIO pin input: PA2 */
-	GPIO_InitStruct.Pin = m_pin;
-	GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
-	GPIO_InitStruct.Pull = GPIO_NOPULL;
-
-	HAL_GPIO_Init(m_port, &GPIO_InitStruct);
-}
-
-void DHT11::Start(void)
-{
-	SetGpioOutput();  // set the pin as output
-
-	HAL_GPIO_WritePin(m_port, m_pin, GPIO_PIN_RESET); 		 // pull the pin low
-
-	HAL_Delay(18);   // wait for 18ms
-
-	SetGpioInput();   // set as input
-
-}
-
-void DHT11::CheckResponse(void)
-{
-	DWT_Delay_us(40);
-
-	if (!(HAL_GPIO_ReadPin(m_port, m_pin)))
-	{
-		DWT_Delay_us(80);
-		if ((HAL_GPIO_ReadPin(m_port, m_pin)))
-			check = 1;
-	}
-
-	while ((HAL_GPIO_ReadPin(m_port, m_pin)))
-		;   // wait for the pin to go low
-}
-
-uint8_t DHT11::ReadData(void)
-{
-	uint8_t i, j;
-
-	for (j = 0; j < 8; j++)
-	{
-		while (!(HAL_GPIO_ReadPin(m_port, m_pin)))			;   // wait for the pin to go high
-
-		DWT_Delay_us(40);   // wait for 40 us
-		if ((HAL_GPIO_ReadPin(m_port, m_pin)) == 0)   // if the pin is low
-		{
-			i &= ~(1 << (7 - j));   // write 0
-		}
-		else
-			i |= (1 << (7 - j));  // if the pin is high, write 1
-
-		while ((HAL_GPIO_ReadPin(m_port, m_pin)));  // wait for the pin to go low
-	}
-	return i;
-}
-
-bool DHT11::ReadSensor(void)
-{
-	int sum;
-	Start();
-	CheckResponse();
-
-	m_Rh[0] = ReadData();
-	m_Rh[1] = ReadData();
-	m_Temp[0] = ReadData();
-	m_Temp[1] = ReadData();
-	sum = ReadData();
-
-	if (sum != (m_Rh[0] + m_Rh[1] + m_Temp[0] + m_Temp[1])) 	// if the data is correct
-		return false;
-
-	return true;
-}
-
-float DHT11::GetTemperature(void)
-{
-	return (float)m_Temp[0] + m_Temp[1]/255.0;
-}
-
-float DHT11::GetHumidity(void)
-{
-	return (float)m_Rh[0] + m_Rh[1]/255.0;
-}
+/**
+ ******************************************************************************
+ * @file           : dht.c
+ * @brief          : DHT11 Interface routines
+ ******************************************************************************
+**/
+
+#include <string.h>
+#include "dht11.h"
+
+// TIM3_CH3 capture requests are wired to DMA1 channel 2, request 5
+static DMA_HandleTypeDef DmaCapture;
+
+// reader waiting for its capture to complete
+static DHT11 *Capturing;
+
+DHT11::DHT11(TIM_HandleTypeDef *htim, uint32_t channel, GPIO_TypeDef *port,
+		uint32_t pin, DhtTypeEnum type)
+{
+	m_htim = htim;
+	m_channel = channel;
+	m_port = port;
+	m_pin = pin;
+	m_type = type;
+
+	m_state = dhtIdle;
+	m_tick = 0;
+	m_captured = false;
+
+	memset(m_edges, 0, sizeof(m_edges));
+	memset(m_data, 0, sizeof(m_data));
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool DHT11::Begin(void)
+{
+	TIM_SlaveConfigTypeDef sSlaveConfig = {0};
+	TIM_IC_InitTypeDef sConfigIC = {0};
+
+	if (m_htim->Instance != TIM3 || m_channel != TIM_CHANNEL_3)
+		return false;
+
+	// free running counter with 1 us ticks, clocked internally
+	m_htim->Init.Prescaler = (SystemCoreClock / 1000000) - 1;
+	m_htim->Init.Period = 0xFFFF;
+	if (HAL_TIM_IC_Init(m_htim) != HAL_OK)
+		return false;
+
+	sSlaveConfig.SlaveMode = TIM_SLAVEMODE_DISABLE;
+	sSlaveConfig.InputTrigger = TIM_TS_ITR0;
+	if (HAL_TIM_SlaveConfigSynchronization(m_htim, &sSlaveConfig) != HAL_OK)
+		return false;
+
+	sConfigIC.ICPolarity = TIM_INPUTCHANNELPOLARITY_BOTHEDGE;
+	sConfigIC.ICSelection = TIM_ICSELECTION_DIRECTTI;
+	sConfigIC.ICPrescaler = TIM_ICPSC_DIV1;
+	sConfigIC.ICFilter = 2;		// ignore glitches shorter than 4 timer clocks
+	if (HAL_TIM_IC_ConfigChannel(m_htim, &sConfigIC, m_channel) != HAL_OK)
+		return false;
+
+	__HAL_RCC_DMA1_CLK_ENABLE();
+
+	DmaCapture.Instance = DMA1_Channel2;
+	DmaCapture.Init.Request = DMA_REQUEST_5;
+	DmaCapture.Init.Direction = DMA_PERIPH_TO_MEMORY;
+	DmaCapture.Init.PeriphInc = DMA_PINC_DISABLE;
+	DmaCapture.Init.MemInc = DMA_MINC_ENABLE;
+	DmaCapture.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+	DmaCapture.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+	DmaCapture.Init.Mode = DMA_NORMAL;
+	DmaCapture.Init.Priority = DMA_PRIORITY_MEDIUM;
+	if (HAL_DMA_Init(&DmaCapture) != HAL_OK)
+		return false;
+	__HAL_LINKDMA(m_htim, hdma[TIM_DMA_ID_CC3], DmaCapture);
+
+	HAL_NVIC_SetPriority(DMA1_Channel2_IRQn, 2, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+
+	// line released until the first read
+	SetGpioCapture();
+	return true;
+}
+
+void DHT11::SetGpioOutput(void)
+{
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+	// open drain, the sensor has its own pull up
+	GPIO_InitStruct.Pin = m_pin;
+	GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_OD;
+	GPIO_InitStruct.Pull = GPIO_PULLUP;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+
+	HAL_GPIO_Init(m_port, &GPIO_InitStruct);
+}
+
+void DHT11::SetGpioCapture(void)
+{
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+	GPIO_InitStruct.Pin = m_pin;
+	GPIO_InitStruct.Mode = GPIO_MODE_AF_OD;
+	GPIO_InitStruct.Pull = GPIO_PULLUP;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+	GPIO_InitStruct.Alternate = GPIO_AF2_TIM3;
+
+	HAL_GPIO_Init(m_port, &GPIO_InitStruct);
+}
+
+void DHT11::Start(void)
+{
+	SetGpioOutput();
+	HAL_GPIO_WritePin(m_port, m_pin, GPIO_PIN_RESET); 		 // pull the pin low
+
+	m_tick = HAL_GetTick();
+	m_state = dhtStart;
+}
+
+int DHT11::Poll(void)
+{
+	uint32_t elapsed = HAL_GetTick() - m_tick;
+
+	switch (m_state)
+	{
+	case dhtStart:
+		// +1: the first ms may be partial
+		if (elapsed < ((m_type == dhtType11) ? DHT11_START_MS : DHT22_START_MS) + 1)
+			return DHT_BUSY;
+
+		// capture first, then release the line so that no edge is missed
+		m_captured = false;
+		Capturing = this;
+		if (HAL_TIM_IC_Start_DMA(m_htim, m_channel, (uint32_t *) m_edges, DHT_EDGES) != HAL_OK)
+		{
+			m_state = dhtIdle;
+			SetGpioCapture();
+			return Finish(0);
+		}
+		SetGpioCapture();
+
+		m_tick = HAL_GetTick();
+		m_state = dhtCapture;
+		return DHT_BUSY;
+
+	case dhtCapture:
+		if (!m_captured && elapsed <= DHT_CAPTURE_MS)
+			return DHT_BUSY;
+
+		{
+			int count = DHT_EDGES - __HAL_DMA_GET_COUNTER(m_htim->hdma[TIM_DMA_ID_CC3]);
+
+			HAL_TIM_IC_Stop_DMA(m_htim, m_channel);
+			Capturing = NULL;
+			m_state = dhtIdle;
+
+			return Finish(count);
+		}
+
+	case dhtIdle:
+	default:
+		return DHT_ERR_TIMEOUT;
+	}
+}
+
+// Decodes the captured edges and keeps the frame if it is good
+int DHT11::Finish(int count)
+{
+	uint8_t data[5];
+
+	int ret = Decode(m_edges, count, data);
+
+	m_stats.reads++;
+	switch (ret)
+	{
+	case DHT_OK:
+		memcpy(m_data, data, sizeof(m_data));
+		break;
+	case DHT_ERR_TIMEOUT:
+		m_stats.timeouts++;
+		break;
+	case DHT_ERR_FRAME:
+		m_stats.frameErrors++;
+		break;
+	case DHT_ERR_CHECKSUM:
+	default:
+		m_stats.checksumErrors++;
+		break;
+	}
+	return ret;
+}
+
+bool DHT11::ReadSensor(void)
+{
+	int ret;
+
+	Start();
+	while ((ret = Poll()) == DHT_BUSY)
+		;
+
+	return (ret == DHT_OK);
+}
+
+int DHT11::Decode(const uint16_t *edges, int count, uint8_t data[5])
+{
+	// from the fall that starts the response to the fall that ends bit 39
+	const int frame = DHT_EDGES - 2;
+
+	if (count < frame)
+		return DHT_ERR_TIMEOUT;
+
+	// response: 80 us low, 80 us high. The capture runs before the line is
+	// released, so the release comes first, 20-40 us ahead of the response.
+	int resp;
+
+	for (resp = 0; resp + frame <= count; resp++)
+	{
+		uint16_t low = edges[resp + 1] - edges[resp];
+		uint16_t high = edges[resp + 2] - edges[resp + 1];
+
+		if (low >= DHT_RESPONSE_MIN && low <= DHT_RESPONSE_MAX
+				&& high >= DHT_RESPONSE_MIN && high <= DHT_RESPONSE_MAX)
+			break;
+	}
+	if (resp + frame > count)
+		return DHT_ERR_FRAME;
+
+	memset(data, 0, 5);
+
+	for (int bit = 0; bit < 40; bit++)
+	{
+		int rise = resp + 3 + 2 * bit;
+		uint16_t low = edges[rise] - edges[rise - 1];
+		uint16_t high = edges[rise + 1] - edges[rise];
+
+		// 50 us low, then 26-28 us (0) or 70 us (1) high
+		if (low < 30 || low > 90 || high < 10 || high > 100)
+			return DHT_ERR_FRAME;
+
+		if (high > DHT_BIT_THRESHOLD)
+			data[bit / 8] |= 0x80 >> (bit % 8);
+	}
+
+	if (((data[0] + data[1] + data[2] + data[3]) & 0xFF) != data[4])
+		return DHT_ERR_CHECKSUM;
+
+	return DHT_OK;
+}
+
+float DHT11::GetTemperature(void)
+{
+	if (m_type == dhtType22)
+	{
+		float t = (((m_data[2] & 0x7F) << 8) | m_data[3]) / 10.0;
+		return (m_data[2] & 0x80) ? -t : t;
+	}
+	return (float)m_data[2] + m_data[3] / 10.0;
+}
+
+float DHT11::GetHumidity(void)
+{
+	if (m_type == dhtType22)
+		return ((m_data[0] << 8) | m_data[1]) / 10.0;
+
+	return (float)m_data[0] + m_data[1] / 10.0;
+}
+
+void DHT11::GetStats(DhtStats &stats, bool reset)
+{
+	stats = m_stats;
+	if (reset)
+		memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void DHT11::CaptureDone(TIM_HandleTypeDef *htim)
+{
+	if (Capturing != NULL && Capturing->m_htim == htim)
+		Capturing->m_captured = true;
+}
+
+extern "C" void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
+{
+	DHT11::CaptureDone(htim);
+}
@@ -1,46 +1,125 @@
-/*
- * dht11.h
- *
- *  Created on: Mar 30, 2019
- *      Author: Archer
- */
-
-#ifndef DHT11_DHT11_H_
-#define DHT11_DHT11_H_
-
-#include <stdio.h>
-#include <stm32l4xx_hal.h>
-
-
-class DHT11
-{
-	public:
-		DHT11(GPIO_TypeDef *port, uint32_t m_pin);
-		bool ReadSensor(void);
-		void Start(void);
-		float GetTemperature(void);
-		float GetHumidity(void);
-
-	private:
-		void SetGpioOutput(void);
-		void SetGpioInput(void);
-		uint8_t ReadData(void);
-		void CheckResponse(void);
-
-
-		GPIO_TypeDef    *m_port;
-		uint32_t		 m_pin;
-
-		uint8_t m_Rh[2];
-		uint8_t m_Temp[2];
-		uint16_t sum, RH, TEMP;
-
-		int temp_low, temp_high, rh_low, rh_high;
-		char temp_char1[2], temp_char2, rh_char1[2], rh_char2;
-
-		uint8_t check;
-
-		GPIO_InitTypeDef GPIO_InitStruct;
-};
-
-#endif /* DHT11_DHT11_H_ */
+/*
+ * dht11.h
+ *
+ *  Created on: Mar 30, 2019
+ *      Author: Archer
+ */
+
+#ifndef DHT11_DHT11_H_
+#define DHT11_DHT11_H_
+
+#include <stdio.h>
+#include <stm32l4xx_hal.h>
+
+// edges of a read: release of the start signal, response low/high, 40 bits
+// low/high, final release
+#define DHT_EDGES			85
+
+// response preamble, 80 us low then 80 us high
+#define DHT_RESPONSE_MIN	50
+#define DHT_RESPONSE_MAX	110
+
+// host start signal, the DHT22 only needs 1 ms
+#define DHT11_START_MS		18
+#define DHT22_START_MS		2
+
+// the frame takes about 5 ms, give up after
+#define DHT_CAPTURE_MS		10
+
+// high time of a bit in us: 26-28 for a 0, 70 for a 1
+#define DHT_BIT_THRESHOLD	48
+
+// results of Poll() and Decode()
+#define DHT_OK				0
+#define DHT_BUSY			1
+#define DHT_ERR_TIMEOUT		-1		// too few edges, sensor missing?
+#define DHT_ERR_FRAME		-2		// response or bit timing out of range
+#define DHT_ERR_CHECKSUM	-3
+
+typedef enum {dhtType11, dhtType22} DhtTypeEnum;
+
+struct DhtStats
+{
+	uint32_t reads;
+	uint32_t timeouts;
+	uint32_t frameErrors;
+	uint32_t checksumErrors;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	class DHT11
+//
+//	DHT11/DHT22 reader. The host start signal is driven as GPIO, then the
+//	pin is switched to the timer input and every edge of the answer is
+//	time stamped (1 us ticks) by input capture into a DMA buffer. The CPU is
+//	not involved until the frame has been captured, the bits are decoded
+//	from the pulse widths afterwards.
+//
+//	A read is a state machine run by Poll(), no step waits: Start() drives
+//	the start signal, Poll() switches to capture once it has lasted long
+//	enough, then decodes when the frame is complete or DHT_CAPTURE_MS have
+//	passed.
+//
+//	Decode() works on the time stamps only, it runs unchanged on the host.
+//
+class DHT11
+{
+	public:
+		DHT11(TIM_HandleTypeDef *htim, uint32_t channel, GPIO_TypeDef *port,
+				uint32_t pin, DhtTypeEnum type = dhtType11);
+
+		// sets up the timer (1 MHz, both edges) and its capture DMA
+		bool Begin(void);
+
+		// starts a read
+		void Start(void);
+
+		// advances the read, returns DHT_BUSY until it is done, then its result
+		int Poll(void);
+
+		// blocking read, Start() and Poll() until done
+		bool ReadSensor(void);
+
+		float GetTemperature(void);
+		float GetHumidity(void);
+
+		void GetStats(DhtStats &stats, bool reset = false);
+
+		//////////////////////////////////////////////////////////////////////////////
+		//	static int Decode(const uint16_t *edges, int count, uint8_t data[5]);
+		//
+		//	decodes a frame from the capture time stamps of its edges, in us
+		//	of a free running 16 bit counter. The frame is located by its
+		//	response preamble, edges before it (the release of the start
+		//	signal) are skipped.
+		//
+		//	returns DHT_OK or one of the DHT_ERR_ codes
+		//
+		static int Decode(const uint16_t *edges, int count, uint8_t data[5]);
+
+		// called from the capture complete interrupt
+		static void CaptureDone(TIM_HandleTypeDef *htim);
+
+	private:
+		enum DhtState {dhtIdle, dhtStart, dhtCapture};
+
+		void SetGpioOutput(void);
+		void SetGpioCapture(void);
+		int Finish(int count);
+
+		TIM_HandleTypeDef 	*m_htim;
+		uint32_t 			m_channel;
+		GPIO_TypeDef    	*m_port;
+		uint32_t		 	m_pin;
+		DhtTypeEnum 		m_type;
+
+		DhtState 			m_state;
+		uint32_t 			m_tick;			// start of the current state
+		volatile bool 		m_captured;
+
+		uint16_t 			m_edges[DHT_EDGES];
+		uint8_t 			m_data[5];		// last good frame
+		DhtStats 			m_stats;
+};
+
+#endif /* DHT11_DHT11_H_ */
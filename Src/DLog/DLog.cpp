@@ -0,0 +1,228 @@
+/*
+ * DLog.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <stdio.h>
+#include <stm32l4xx_hal.h>
+#include "DLog.h"
+#include "SpscRing.h"
+#include "Profiler.h"
+
+static SpscRing<DLOG_RING_SIZE> Ring;
+static DLogTickSource Tick = NULL;
+static DLogWriter Writer = NULL;
+static DLogStats Stats;
+
+static uint32_t GetU32(const uint8_t *p)
+{
+	uint32_t w;
+
+	memcpy(&w, p, 4);
+	return w;
+}
+
+void DLog::Begin(DLogTickSource tick, DLogWriter writer)
+{
+	Tick = tick;
+	Writer = writer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// producer side
+
+void DLog::Put(uint8_t *rec, int &n, const char *s)
+{
+	int len = s ? strlen(s) : 0;
+
+	if (len > DLOG_MAX_STRING)
+		len = DLOG_MAX_STRING;
+	if (len > DLOG_MAX_RECORD - n - 1)
+		len = DLOG_MAX_RECORD - n - 1;
+	if (len < 0)
+		return;
+
+	rec[n++] = len;
+	memcpy(rec + n, s, len);
+	n += len;
+}
+
+void DLog::Commit(uint8_t *rec, int len, uint8_t level, const char *fmt)
+{
+	uint32_t time = Tick ? Tick() : 0;
+	uint32_t addr = (uint32_t) (uintptr_t) fmt;
+
+	rec[0] = len;
+	rec[1] = level;
+	memcpy(rec + 2, &time, 4);
+	memcpy(rec + 6, &addr, 4);
+
+	// the free space check and the copy must not be split by another producer
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if (Ring.Free() >= len)
+	{
+		Ring.Write(rec, len);
+		Stats.records++;
+		if ((uint32_t) Ring.Size() > Stats.maxUsed)
+			Stats.maxUsed = Ring.Size();
+	}
+	else
+		Stats.dropped++;
+
+	__set_PRIMASK(primask);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// consumer side
+
+int DLog::Drain(int maxRecords)
+{
+	PROFILE_SCOPE("dlog drain");
+	uint8_t rec[DLOG_MAX_RECORD];
+	char text[128];
+	int count = 0;
+
+	while (count < maxRecords)
+	{
+		uint8_t len;
+
+		if (!Ring.Peek(&len))
+			break;
+		Ring.Read(rec, len);
+
+		if (Writer)
+			Writer(rec, len);
+		else
+		{
+			Format(text, sizeof(text), rec, len);
+			fputs(text, stdout);
+		}
+		count++;
+	}
+	return count;
+}
+
+bool DLog::Pending(void)
+{
+	return !Ring.IsEmpty();
+}
+
+void DLog::GetStats(DLogStats &stats, bool reset)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	stats = Stats;
+	if (reset)
+		memset(&Stats, 0, sizeof(Stats));
+
+	__set_PRIMASK(primask);
+}
+
+void DLog::ItmWriter(const uint8_t *data, int len)
+{
+	// nothing to do without a debugger listening on the port
+	if (!(ITM->TCR & ITM_TCR_ITMENA_Msk) || !(ITM->TER & (1UL << DLOG_ITM_PORT)))
+		return;
+
+	for (int i = 0; i < len; i++)
+	{
+		while (ITM->PORT[DLOG_ITM_PORT].u32 == 0)
+			;
+		ITM->PORT[DLOG_ITM_PORT].u8 = data[i];
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// formatting
+
+int DLog::Format(char *out, int size, const uint8_t *record, int len)
+{
+	const char *fmt = (const char *) (uintptr_t) GetU32(record + 6);
+	int pos = DLOG_HEADER;
+	int n = 0;
+
+	out[0] = 0;
+	while (*fmt && n < size - 1)
+	{
+		if (*fmt != '%')
+		{
+			out[n++] = *fmt++;
+			continue;
+		}
+
+		// copy the conversion without length modifiers, the arguments are 32 bit
+		char spec[16];
+		int s = 0;
+
+		spec[s++] = *fmt++;
+		while (*fmt && strchr("-+ #0123456789.lhzjt", *fmt))
+		{
+			if (!strchr("lhzjt", *fmt) && s < (int) sizeof(spec) - 2)
+				spec[s++] = *fmt;
+			fmt++;
+		}
+		if (!*fmt)
+			break;
+
+		char conv = *fmt++;
+		int room = size - n;
+		int w;
+
+		spec[s++] = conv;
+		spec[s] = 0;
+
+		if (conv == '%')
+		{
+			out[n++] = '%';
+			continue;
+		}
+
+		if (conv == 's')
+		{
+			char str[DLOG_MAX_STRING + 1];
+			int l = (pos < len) ? record[pos++] : 0;
+
+			if (l > len - pos)
+				l = len - pos;
+			memcpy(str, record + pos, l);
+			str[l] = 0;
+			pos += l;
+			w = snprintf(out + n, room, spec, str);
+		}
+		else
+		{
+			uint32_t v = 0;
+
+			if (pos + 4 <= len)
+			{
+				v = GetU32(record + pos);
+				pos += 4;
+			}
+
+			if (strchr("fFeEgG", conv))
+			{
+				float f;
+
+				memcpy(&f, &v, 4);
+				w = snprintf(out + n, room, spec, (double) f);
+			}
+			else if (strchr("di", conv))
+				w = snprintf(out + n, room, spec, (int) v);
+			else if (conv == 'p')
+				w = snprintf(out + n, room, "0x%08lx", (unsigned long) v);
+			else
+				w = snprintf(out + n, room, spec, (unsigned) v);
+		}
+
+		if (w > 0)
+			n += (w < room) ? w : room - 1;
+	}
+
+	out[n] = 0;
+	return n;
+}
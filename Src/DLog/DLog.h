@@ -0,0 +1,172 @@
+/*
+ * DLog.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef DLOG_DLOG_H_
+#define DLOG_DLOG_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+// levels, DLOG_LEVEL is the highest one compiled in; define it before the
+// include to change it for one file
+#define DLOG_LEVEL_NONE		0
+#define DLOG_LEVEL_ERROR	1
+#define DLOG_LEVEL_WARN		2
+#define DLOG_LEVEL_INFO		3
+#define DLOG_LEVEL_DEBUG	4
+
+#ifndef DLOG_LEVEL
+#define DLOG_LEVEL			DLOG_LEVEL_INFO
+#endif
+
+// record: length, level, time in ms, format address, arguments
+#define DLOG_RING_SIZE		2048
+#define DLOG_HEADER			10
+#define DLOG_MAX_RECORD		64
+#define DLOG_MAX_STRING		31			// longer %s arguments are cut
+#define DLOG_ITM_PORT		1			// stimulus port of the binary stream
+
+// returns the current time in ms, e.g. HAL_GetTick
+typedef uint32_t (*DLogTickSource)(void);
+
+// takes whole records for a host to decode
+typedef void (*DLogWriter)(const uint8_t *data, int len);
+
+struct DLogStats
+{
+	uint32_t 	records;
+	uint32_t 	dropped;		// the ring was full
+	uint32_t 	maxUsed;		// bytes
+};
+
+// format strings go to their own section, their address is the record id
+#define DLOG_RECORD(level, fmt, ...) do { \
+		static const char dlogFmt[] __attribute__((section(".dlog"))) = fmt; \
+		DLog::Record(level, dlogFmt, ##__VA_ARGS__); \
+	} while (0)
+
+#if DLOG_LEVEL >= DLOG_LEVEL_ERROR
+#define DLOG_ERROR(fmt, ...)	DLOG_RECORD(DLOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define DLOG_ERROR(fmt, ...)	do {} while (0)
+#endif
+
+#if DLOG_LEVEL >= DLOG_LEVEL_WARN
+#define DLOG_WARN(fmt, ...)		DLOG_RECORD(DLOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define DLOG_WARN(fmt, ...)		do {} while (0)
+#endif
+
+#if DLOG_LEVEL >= DLOG_LEVEL_INFO
+#define DLOG_INFO(fmt, ...)		DLOG_RECORD(DLOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define DLOG_INFO(fmt, ...)		do {} while (0)
+#endif
+
+#if DLOG_LEVEL >= DLOG_LEVEL_DEBUG
+#define DLOG_DEBUG(fmt, ...)	DLOG_RECORD(DLOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define DLOG_DEBUG(fmt, ...)	do {} while (0)
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+//	class DLog
+//
+//	deferred log: a call site stores the address of its format string and
+//	its raw arguments in a ring, formatting happens later in Drain(), called
+//	from a low priority task. Numbers are stored as 32 bit words, floats as
+//	float bits, strings are copied since the caller's buffer may be gone by
+//	then. Call sites above DLOG_LEVEL compile to nothing, arguments included.
+//
+//	The format strings follow printf, without 64 bit values or '*' widths.
+//
+//	Recording masks the interrupts only for the copy into the ring, so it
+//	may be used from interrupt handlers; the consumer side takes no lock.
+//	With a writer set, Drain() hands out the binary records instead of text,
+//	e.g. to the ITM, and Tools/dlog_decode.py formats them on the host with
+//	the format strings from the .dlog section of the ELF file.
+//
+class DLog
+{
+public:
+	// time source for the records, binary output if writer is set
+	static void Begin(DLogTickSource tick, DLogWriter writer = NULL);
+
+	// formats or writes up to maxRecords records, returns the number done
+	static int Drain(int maxRecords);
+
+	static bool Pending(void);
+
+	static void GetStats(DLogStats &stats, bool reset = false);
+
+	// writes to DLOG_ITM_PORT, printf keeps port 0
+	static void ItmWriter(const uint8_t *data, int len);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	int Format(char *out, int size, const uint8_t *record, int len);
+	//
+	//	formats a record as printf would have done
+	//
+	//	returns the length of the text, truncated to size - 1
+	//
+	static int Format(char *out, int size, const uint8_t *record, int len);
+
+	template<typename... Args>
+	static void Record(uint8_t level, const char *fmt, Args... args)
+	{
+		uint8_t rec[DLOG_MAX_RECORD];
+		int n = DLOG_HEADER;
+
+		Pack(rec, n, args...);
+		Commit(rec, n, level, fmt);
+	}
+
+private:
+	static void Commit(uint8_t *rec, int len, uint8_t level, const char *fmt);
+
+	static void Pack(uint8_t *rec, int &n) {}
+
+	template<typename T, typename... Rest>
+	static void Pack(uint8_t *rec, int &n, T arg, Rest... rest)
+	{
+		Put(rec, n, arg);
+		Pack(rec, n, rest...);
+	}
+
+	static void PutWord(uint8_t *rec, int &n, uint32_t w)
+	{
+		if (n + 4 <= DLOG_MAX_RECORD)
+		{
+			memcpy(rec + n, &w, 4);
+			n += 4;
+		}
+	}
+
+	template<typename T>
+	static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+	Put(uint8_t *rec, int &n, T v)
+	{
+		static_assert(sizeof(T) <= 4, "64 bit log arguments are not supported");
+		PutWord(rec, n, (uint32_t) v);
+	}
+
+	// float arguments end up here too, as they would for printf
+	static void Put(uint8_t *rec, int &n, double v)
+	{
+		float f = v;
+		uint32_t w;
+
+		memcpy(&w, &f, 4);
+		PutWord(rec, n, w);
+	}
+
+	static void Put(uint8_t *rec, int &n, const void *p) { PutWord(rec, n, (uint32_t) (uintptr_t) p); }
+	static void Put(uint8_t *rec, int &n, const char *s);
+};
+
+#endif /* DLOG_DLOG_H_ */
@@ -0,0 +1,109 @@
+/*
+ * FlashL4.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include "FlashL4.h"
+
+// double words with an ECC error, written by the NMI
+static volatile uint32_t EccFaults[LOG_FLASH_ECC_FAULTS];
+static volatile int EccCount;
+
+extern "C" void FlashL4_EccError(uint32_t eccr)
+{
+	// system flash is no page of ours
+	if (eccr & FLASH_ECCR_SYSF_ECC)
+		return;
+
+	uint32_t addr = FLASH_BASE + (eccr & FLASH_ECCR_ADDR_ECC);
+	if (eccr & FLASH_ECCR_BK_ECC)
+		addr += FLASH_BANK_SIZE;
+	addr &= ~7;
+
+	for (int i = 0; i < EccCount; i++)
+	{
+		if (EccFaults[i] == addr)
+			return;
+	}
+	// when full the newest one is dropped, its record still fails the CRC
+	if (EccCount < LOG_FLASH_ECC_FAULTS)
+		EccFaults[EccCount++] = addr;
+}
+
+FlashL4::FlashL4(uint32_t base, int pages)
+{
+	m_base = base;
+	m_pages = pages;
+}
+
+const uint8_t *FlashL4::Page(int page)
+{
+	return (const uint8_t *) (m_base + page * FLASH_PAGE_SIZE);
+}
+
+bool FlashL4::Program(int page, int offset, uint64_t data)
+{
+	uint32_t addr = m_base + page * FLASH_PAGE_SIZE + offset;
+
+	HAL_FLASH_Unlock();
+	// flags left over from an earlier operation make the next one fail
+	__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+	HAL_StatusTypeDef status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, addr, data);
+	HAL_FLASH_Lock();
+
+	return (status == HAL_OK);
+}
+
+bool FlashL4::Erase(int page)
+{
+	FLASH_EraseInitTypeDef erase = {0};
+	uint32_t addr = m_base + page * FLASH_PAGE_SIZE;
+	uint32_t error;
+
+	erase.TypeErase = FLASH_TYPEERASE_PAGES;
+	if (addr < FLASH_BASE + FLASH_BANK_SIZE)
+	{
+		erase.Banks = FLASH_BANK_1;
+		erase.Page = (addr - FLASH_BASE) / FLASH_PAGE_SIZE;
+	}
+	else
+	{
+		erase.Banks = FLASH_BANK_2;
+		erase.Page = (addr - FLASH_BASE - FLASH_BANK_SIZE) / FLASH_PAGE_SIZE;
+	}
+	erase.NbPages = 1;
+
+	HAL_FLASH_Unlock();
+	__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+	HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &error);
+	HAL_FLASH_Lock();
+
+	if (status != HAL_OK)
+		return false;
+
+	// the faults of the page are gone with it
+	__disable_irq();
+	for (int i = 0; i < EccCount; )
+	{
+		if (EccFaults[i] >= addr && EccFaults[i] < addr + FLASH_PAGE_SIZE)
+			EccFaults[i] = EccFaults[--EccCount];
+		else
+			i++;
+	}
+	__enable_irq();
+	return true;
+}
+
+bool FlashL4::ReadError(int page, int offset, int len)
+{
+	uint32_t addr = m_base + page * FLASH_PAGE_SIZE + offset;
+
+	for (int i = 0; i < EccCount; i++)
+	{
+		if (EccFaults[i] + 8 > addr && EccFaults[i] < addr + len)
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,52 @@
+/*
+ * FlashL4.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef FLASHLOG_FLASHL4_H_
+#define FLASHLOG_FLASHL4_H_
+
+#include <stm32l4xx_hal.h>
+#include "FlashStore.h"
+
+// the log takes the top 128 KB of bank 2, the linker script leaves them out
+#define LOG_FLASH_BASE		0x080E0000
+#define LOG_FLASH_PAGES		64
+
+// ECC error addresses remembered until their page is erased
+#define LOG_FLASH_ECC_FAULTS	8
+
+// called from NMI_Handler with FLASH->ECCR when ECCD is set
+extern "C" void FlashL4_EccError(uint32_t eccr);
+
+//////////////////////////////////////////////////////////////////////////////
+//	class FlashL4
+//
+//	FlashStore on the internal flash of the STM32L476: 2 KB pages, double
+//	word programming. The program runs from bank 1 and keeps running while
+//	bank 2 is written.
+//
+//	A double ECC error on a read raises the NMI, NMI_Handler passes the
+//	address on to FlashL4_EccError() and clears the flag; left set, the NMI
+//	would fire again as soon as it returns.
+//
+class FlashL4 : public FlashStore
+{
+public:
+	FlashL4(uint32_t base = LOG_FLASH_BASE, int pages = LOG_FLASH_PAGES);
+
+	virtual int PageSize() { return FLASH_PAGE_SIZE; }
+	virtual int Pages() { return m_pages; }
+	virtual const uint8_t *Page(int page);
+	virtual bool Program(int page, int offset, uint64_t data);
+	virtual bool Erase(int page);
+	virtual bool ReadError(int page, int offset, int len);
+
+private:
+	uint32_t 	m_base;
+	int 		m_pages;
+};
+
+#endif /* FLASHLOG_FLASHL4_H_ */
@@ -0,0 +1,554 @@
+/*
+ * FlashLog.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <string.h>
+#include "FlashLog.h"
+#include "VarintCodec.h"
+#include "Profiler.h"
+
+#define ALIGN8(n)	(((n) + 7) & ~7)
+
+static uint32_t GetU32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+FlashLog::FlashLog(FlashStore *pFlash)
+{
+	m_pFlash = pFlash;
+	m_pages = pFlash->Pages();
+	m_pageSize = pFlash->PageSize();
+
+	m_empty = true;
+	m_tailSeq = 0;
+	m_headSeq = 0xFFFFFFFF;
+	m_headOffset = 0;
+	m_based = false;
+	memset(&m_last, 0, sizeof(m_last));
+
+	StartOf(m_upload, 0);
+	m_ackPending = false;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// record coding
+
+int FlashLog::EncodeFrame(uint8_t *buf, const LogFrame &frame, const LogFrame *base)
+{
+	int n = 0;
+
+	n += VarintPut(buf + n, base ? frame.time - base->time : frame.time);
+	buf[n++] = frame.count;
+
+	for (int i = 0; i < frame.count; i++)
+	{
+		uint32_t v = (uint32_t) frame.values[i];
+		if (base)
+			v -= (uint32_t) base->values[i];
+		n += VarintPut(buf + n, ZigZagEncode(v));
+	}
+	return n;
+}
+
+bool FlashLog::DecodeFrame(const uint8_t *buf, int len, uint8_t type,
+		LogFrame &frame, const LogFrame *base)
+{
+	uint32_t v;
+	int n, pos = 0;
+
+	if (type == LOG_REC_DELTA && base == NULL)
+		return false;
+
+	if ((n = VarintGet(buf, len, &v)) == 0)
+		return false;
+	pos += n;
+	frame.time = (type == LOG_REC_DELTA) ? base->time + v : v;
+
+	if (pos >= len)
+		return false;
+	frame.count = buf[pos++];
+	if (frame.count > LOG_MAX_FIELDS
+			|| (type == LOG_REC_DELTA && frame.count != base->count))
+		return false;
+
+	for (int i = 0; i < frame.count; i++)
+	{
+		if ((n = VarintGet(buf + pos, len - pos, &v)) == 0)
+			return false;
+		pos += n;
+
+		v = ZigZagDecode(v);
+		if (type == LOG_REC_DELTA)
+			v += (uint32_t) base->values[i];
+		frame.values[i] = (int32_t) v;
+	}
+	return (pos == len);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// pages and records
+
+bool FlashLog::PageValid(uint32_t page, uint32_t *seq, uint32_t *firstTime)
+{
+	const uint8_t *p = m_pFlash->Page(page);
+
+	if (GetU32(p) != LOG_PAGE_MAGIC)
+		return false;
+
+	*seq = GetU32(p + 4);
+	*firstTime = GetU32(p + 8);
+
+	// a header with an ECC error is treated like a torn one, the page is
+	// skipped and erased when its turn comes
+	if (m_pFlash->ReadError(page, 0, LOG_PAGE_HEADER))
+		return false;
+
+	// a page can only hold its own sequence numbers
+	return (GetU32(p + 12) == ~*seq) && (PageOf(*seq) == (int) page);
+}
+
+// time of the first frame of a page, 0 if it has none or is not valid
+uint32_t FlashLog::PageTime(uint32_t seq)
+{
+	uint32_t pageSeq, firstTime;
+
+	if (!PageValid(PageOf(seq), &pageSeq, &firstTime) || pageSeq != seq)
+		return 0;
+	return firstTime;
+}
+
+void FlashLog::StartOf(LogCursor &cursor, uint32_t seq)
+{
+	cursor.seq = seq;
+	cursor.offset = LOG_PAGE_HEADER;
+	cursor.based = false;
+}
+
+// returns the size of the record at offset, 0 at the end of the page data;
+// *type is 0 for a record that fails its CRC
+int FlashLog::RecordAt(uint32_t seq, int offset, uint8_t *type,
+		const uint8_t **payload, int *len)
+{
+	const uint8_t *p = m_pFlash->Page(PageOf(seq)) + offset;
+
+	if (offset + LOG_REC_HEADER > m_pageSize)
+		return 0;
+
+	uint32_t header = GetU32(p);
+	if (header == 0xFFFFFFFF)
+		return 0;
+
+	*len = (header >> 8) & 0xFF;
+	int size = ALIGN8(LOG_REC_HEADER + *len);
+	if (offset + size > m_pageSize)
+		return 0;
+
+	*type = header & 0xFF;
+	*payload = p + LOG_REC_HEADER;
+
+	if (Crc16Ccitt(*payload, *len, Crc16Ccitt(p, 2)) != (header >> 16)
+			|| m_pFlash->ReadError(PageOf(seq), offset, size))
+		*type = 0;
+
+	return size;
+}
+
+// finds the end of the data in the head page and its last frame
+void FlashLog::ScanPage(uint32_t seq)
+{
+	int offset = LOG_PAGE_HEADER;
+	int size, len;
+	uint8_t type;
+	const uint8_t *payload;
+	LogFrame frame;
+
+	m_based = false;
+
+	while ((size = RecordAt(seq, offset, &type, &payload, &len)) > 0)
+	{
+		if (type == LOG_REC_KEY || type == LOG_REC_DELTA)
+		{
+			m_based = DecodeFrame(payload, len, type, frame, m_based ? &m_last : NULL);
+			if (m_based)
+				m_last = frame;
+		}
+		else if (type != LOG_REC_ACK)
+		{
+			// cut by a power loss, the next frame is written in full
+			m_based = false;
+			m_stats.errors++;
+		}
+		offset += size;
+	}
+
+	// neither erased nor a record: nothing more can be written here
+	if (offset + LOG_REC_HEADER <= m_pageSize
+			&& (GetU32(m_pFlash->Page(PageOf(seq)) + offset) != 0xFFFFFFFF
+				|| m_pFlash->ReadError(PageOf(seq), offset, LOG_REC_HEADER)))
+		offset = m_pageSize;
+
+	m_headOffset = offset;
+}
+
+bool FlashLog::Mount(void)
+{
+	uint32_t seq, firstTime;
+
+	m_empty = true;
+	m_ackPending = false;
+
+	for (int page = 0; page < m_pages; page++)
+	{
+		if (!PageValid(page, &seq, &firstTime))
+			continue;
+
+		if (m_empty || (int32_t) (seq - m_headSeq) > 0)
+			m_headSeq = seq;
+		if (m_empty || (int32_t) (seq - m_tailSeq) < 0)
+			m_tailSeq = seq;
+		m_empty = false;
+	}
+
+	if (m_empty)
+	{
+		m_tailSeq = 0;
+		m_headSeq = 0xFFFFFFFF;
+		m_headOffset = m_pageSize;
+		m_based = false;
+		StartOf(m_upload, 0);
+		return false;
+	}
+
+	// only the pages after a gap are in order
+	while (m_tailSeq != m_headSeq
+			&& !(PageValid(PageOf(m_tailSeq), &seq, &firstTime) && seq == m_tailSeq))
+		m_tailSeq++;
+
+	ScanPage(m_headSeq);
+
+	// the last ack is the upload position
+	bool acked = false;
+	uint32_t ackSeq = 0, ackOffset = 0;
+
+	for (seq = m_tailSeq; (int32_t) (seq - m_headSeq) <= 0; seq++)
+	{
+		int offset = LOG_PAGE_HEADER;
+		int size, len;
+		uint8_t type;
+		const uint8_t *payload;
+
+		while ((size = RecordAt(seq, offset, &type, &payload, &len)) > 0)
+		{
+			uint32_t s, o;
+			int n;
+
+			if (type == LOG_REC_ACK && (n = VarintGet(payload, len, &s)) > 0
+					&& VarintGet(payload + n, len - n, &o) > 0)
+			{
+				acked = true;
+				ackSeq = s;
+				ackOffset = o;
+			}
+			offset += size;
+		}
+	}
+
+	if (!acked || (int32_t) (ackSeq - m_tailSeq) < 0)
+	{
+		StartOf(m_upload, m_tailSeq);
+		return true;
+	}
+
+	// replay the page up to the ack, the cursor needs the base frame
+	LogFrame frame;
+
+	StartOf(m_upload, ackSeq);
+	while (m_upload.seq == ackSeq && m_upload.offset < ackOffset)
+	{
+		LogCursor before = m_upload;
+
+		if (!Read(m_upload, frame))
+			break;
+		if (m_upload.seq != ackSeq || m_upload.offset > ackOffset)
+		{
+			m_upload = before;
+			break;
+		}
+	}
+	return true;
+}
+
+// erases the page for the next sequence number and writes its header
+bool FlashLog::OpenPage(uint32_t time)
+{
+	uint32_t seq = m_empty ? 0 : m_headSeq + 1;
+	int page = PageOf(seq);
+
+	if (!m_empty && seq - m_tailSeq >= (uint32_t) m_pages)
+	{
+		// full: the oldest page goes, with what was not uploaded from it
+		LogCursor cursor = m_upload;
+		LogFrame frame;
+
+		while (cursor.seq == m_tailSeq && Read(cursor, frame) && cursor.seq == m_tailSeq)
+			m_stats.lost++;
+
+		m_tailSeq++;
+		if ((int32_t) (m_upload.seq - m_tailSeq) < 0)
+			StartOf(m_upload, m_tailSeq);
+	}
+
+	m_stats.erases++;
+	if (!m_pFlash->Erase(page)
+			|| !m_pFlash->Program(page, 0, LOG_PAGE_MAGIC | ((uint64_t) seq << 32))
+			|| !m_pFlash->Program(page, 8, time | ((uint64_t) ~seq << 32)))
+	{
+		m_stats.errors++;
+		return false;
+	}
+
+	if (m_empty)
+	{
+		m_tailSeq = seq;
+		StartOf(m_upload, seq);
+	}
+	m_empty = false;
+	m_headSeq = seq;
+	m_headOffset = LOG_PAGE_HEADER;
+	m_based = false;
+	return true;
+}
+
+bool FlashLog::WriteRecord(uint8_t type, const uint8_t *payload, int len)
+{
+	uint8_t buf[ALIGN8(LOG_REC_HEADER + LOG_MAX_PAYLOAD)];
+	int size = ALIGN8(LOG_REC_HEADER + len);
+
+	memset(buf, 0xFF, size);
+	buf[0] = type;
+	buf[1] = len;
+	memcpy(buf + LOG_REC_HEADER, payload, len);
+
+	uint16_t crc = Crc16Ccitt(payload, len, Crc16Ccitt(buf, 2));
+	buf[2] = crc & 0xFF;
+	buf[3] = crc >> 8;
+
+	int page = PageOf(m_headSeq);
+
+	for (int i = 0; i < size; i += 8)
+	{
+		uint64_t dword;
+
+		memcpy(&dword, buf + i, 8);
+		if (!m_pFlash->Program(page, m_headOffset + i, dword))
+		{
+			// whatever made it into the flash fails its CRC later
+			m_headOffset += size;
+			m_based = false;
+			m_stats.errors++;
+			return false;
+		}
+	}
+
+	m_headOffset += size;
+	return true;
+}
+
+// records the upload position in the head page, or leaves it pending
+bool FlashLog::WriteAck(void)
+{
+	uint8_t payload[10];
+	int len = VarintPut(payload, m_upload.seq);
+	len += VarintPut(payload + len, m_upload.offset);
+
+	if (m_empty || m_headOffset + ALIGN8(LOG_REC_HEADER + len) > m_pageSize)
+	{
+		m_ackPending = true;
+		return false;
+	}
+
+	m_ackPending = false;
+	return WriteRecord(LOG_REC_ACK, payload, len);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// writing
+
+bool FlashLog::Append(uint32_t time, const int32_t *values, int count)
+{
+	PROFILE_SCOPE("log append");
+	uint8_t payload[LOG_MAX_PAYLOAD];
+	LogFrame frame;
+
+	if (count < 0 || count > LOG_MAX_FIELDS)
+		return false;
+
+	frame.time = time;
+	frame.count = count;
+	memcpy(frame.values, values, count * sizeof(int32_t));
+
+	bool delta = m_based && m_last.count == count;
+	int len = EncodeFrame(payload, frame, delta ? &m_last : NULL);
+
+	if (m_empty || m_headOffset + ALIGN8(LOG_REC_HEADER + len) > m_pageSize)
+	{
+		if (!OpenPage(time))
+			return false;
+
+		// a page starts with a full frame
+		delta = false;
+		len = EncodeFrame(payload, frame, NULL);
+	}
+
+	if (!WriteRecord(delta ? LOG_REC_DELTA : LOG_REC_KEY, payload, len))
+		return false;
+
+	m_last = frame;
+	m_based = true;
+	m_stats.appended++;
+
+	if (m_ackPending)
+		WriteAck();
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// reading
+
+bool FlashLog::Read(LogCursor &cursor, LogFrame &frame)
+{
+	int size, len;
+	uint8_t type;
+	const uint8_t *payload;
+
+	if (m_empty)
+		return false;
+
+	if ((int32_t) (cursor.seq - m_tailSeq) < 0)
+		StartOf(cursor, m_tailSeq);
+
+	while (true)
+	{
+		if (cursor.seq == m_headSeq && cursor.offset >= m_headOffset)
+			return false;
+
+		size = RecordAt(cursor.seq, cursor.offset, &type, &payload, &len);
+		if (size == 0)
+		{
+			if (cursor.seq == m_headSeq)
+				return false;
+			StartOf(cursor, cursor.seq + 1);
+			continue;
+		}
+		cursor.offset += size;
+
+		if (type == LOG_REC_KEY || type == LOG_REC_DELTA)
+		{
+			cursor.based = DecodeFrame(payload, len, type, frame,
+					cursor.based ? &cursor.last : NULL);
+			if (cursor.based)
+			{
+				cursor.last = frame;
+				return true;
+			}
+		}
+		else if (type != LOG_REC_ACK)
+			cursor.based = false;
+	}
+}
+
+void FlashLog::Seek(LogCursor &cursor, uint32_t time)
+{
+	StartOf(cursor, m_tailSeq);
+	if (m_empty)
+		return;
+
+	// the last page that starts at or before time, the page headers are
+	// in time order. A page without a time takes it from the next one that
+	// has one; if there is none the search goes on before it, the frame by
+	// frame part below reads through it.
+	uint32_t lo = m_tailSeq, hi = m_headSeq;
+
+	while (lo != hi)
+	{
+		uint32_t mid = lo + (hi - lo + 1) / 2;
+		uint32_t probe = mid;
+		uint32_t firstTime;
+
+		while ((firstTime = PageTime(probe)) == 0 && probe != hi)
+			probe++;
+
+		if (firstTime != 0 && firstTime <= time)
+			lo = probe;
+		else
+			hi = mid - 1;
+	}
+	StartOf(cursor, lo);
+
+	// then frame by frame, leaving the cursor before the first one that is due
+	LogFrame frame;
+
+	while (true)
+	{
+		LogCursor before = cursor;
+
+		if (!Read(cursor, frame) || frame.time >= time)
+		{
+			cursor = before;
+			return;
+		}
+	}
+}
+
+bool FlashLog::Pending(void)
+{
+	LogCursor cursor = m_upload;
+	LogFrame frame;
+
+	return Read(cursor, frame);
+}
+
+int FlashLog::Drain(LogSink sink, void *ctx, int maxFrames, LogCommit commit)
+{
+	LogCursor start = m_upload;
+	LogFrame frame;
+	int count = 0;
+
+	while (count < maxFrames)
+	{
+		LogCursor cursor = m_upload;
+
+		if (!Read(cursor, frame) || !sink(ctx, frame))
+			break;
+
+		m_upload = cursor;
+		count++;
+	}
+
+	if (count == 0)
+		return 0;
+
+	// the frames are taken once they are through
+	if (commit != NULL && !commit(ctx))
+	{
+		m_upload = start;
+		return 0;
+	}
+	m_stats.drained += count;
+
+	// remember the position; a page is only opened for a frame, with its time
+	WriteAck();
+	return count;
+}
+
+void FlashLog::GetStats(LogStats &stats, bool reset)
+{
+	stats = m_stats;
+	if (reset)
+		memset(&m_stats, 0, sizeof(m_stats));
+}
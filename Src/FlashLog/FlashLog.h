@@ -0,0 +1,154 @@
+/*
+ * FlashLog.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef FLASHLOG_FLASHLOG_H_
+#define FLASHLOG_FLASHLOG_H_
+
+#include <stdint.h>
+#include "FlashStore.h"
+
+// values per frame
+#define LOG_MAX_FIELDS		16
+
+// page header: magic and sequence, time of the first frame and ~sequence
+#define LOG_PAGE_MAGIC		0x31474C46		// "FLG1"
+#define LOG_PAGE_HEADER		16
+
+// record header: type, payload length, CRC-16 of type, length and payload
+#define LOG_REC_HEADER		4
+#define LOG_REC_KEY			0x4B			// frame with full values
+#define LOG_REC_DELTA		0x44			// frame relative to the previous one
+#define LOG_REC_ACK			0x41			// frames uploaded up to a position
+#define LOG_MAX_PAYLOAD		(5 + 1 + 5 * LOG_MAX_FIELDS)
+
+// one sample of all values
+struct LogFrame
+{
+	uint32_t 	time;
+	uint8_t 	count;
+	int32_t 	values[LOG_MAX_FIELDS];
+};
+
+// read position, with the last frame as base for the deltas that follow
+struct LogCursor
+{
+	uint32_t 	seq;			// page sequence number
+	uint16_t 	offset;			// next record in the page
+	bool 		based;			// last holds the frame a delta refers to
+	LogFrame 	last;
+};
+
+// takes one frame while draining, returns false to stop
+typedef bool (*LogSink)(void *ctx, const LogFrame &frame);
+
+// passes on the frames a sink took, returns false if they did not get through
+typedef bool (*LogCommit)(void *ctx);
+
+struct LogStats
+{
+	uint32_t 	appended;
+	uint32_t 	drained;
+	uint32_t 	erases;
+	uint32_t 	lost;			// frames erased before they were uploaded
+	uint32_t 	errors;			// failed writes and torn records
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	class FlashLog
+//
+//	append only time series in flash pages used round robin, so that the
+//	erases spread over all of them. Every page gets a sequence number when
+//	it is opened, flash page n takes the numbers n, n + Pages(), ...; when
+//	the log is full the oldest page is erased and its frames are lost.
+//
+//	A frame is stored as zig-zag varints, the first one of a page with its
+//	full values and the others as the change from the frame before, padded
+//	to whole double words with a CRC. A record cut by a power loss fails its
+//	CRC and is skipped on the next Mount(), the next frame is then stored in
+//	full. The page headers hold the time of their first frame, they are the
+//	index for Seek().
+//
+//	Drain() hands the frames not yet uploaded to a sink and appends an ack
+//	record with the position reached, so that it survives a restart. An ack
+//	that does not fit into the head page waits for the next frame, which
+//	opens a page with its own time: every page header holds the time of its
+//	first frame. Pages written with a time of 0 are passed over by Seek().
+//
+class FlashLog
+{
+public:
+	FlashLog(FlashStore *pFlash);
+
+	// finds the newest page and the upload position, returns false if the
+	// log was empty
+	bool Mount(void);
+
+	// appends a frame of count values, returns false if it could not be written
+	bool Append(uint32_t time, const int32_t *values, int count);
+
+	// positions a cursor at the first frame at or after time
+	void Seek(LogCursor &cursor, uint32_t time);
+
+	// reads the frame at the cursor and advances it, returns false at the end
+	bool Read(LogCursor &cursor, LogFrame &frame);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	int Drain(LogSink sink, void *ctx, int maxFrames, LogCommit commit);
+	//
+	//	passes up to maxFrames frames from the upload position on to sink and
+	//	records how far it got. A sink that only collects the frames, e.g.
+	//	into one datagram, sends them from commit: when it fails the upload
+	//	position stays where it was.
+	//
+	//	returns the number of frames taken by the sink, 0 if commit failed
+	//
+	int Drain(LogSink sink, void *ctx, int maxFrames, LogCommit commit = NULL);
+
+	// frames not yet drained are waiting
+	bool Pending(void);
+
+	void GetStats(LogStats &stats, bool reset = false);
+
+	////////////////////////////// record coding //////////////////////////////
+
+	// payload of a frame, full values or relative to base; returns its length
+	static int EncodeFrame(uint8_t *buf, const LogFrame &frame, const LogFrame *base);
+
+	// decodes a payload, base for a LOG_REC_DELTA; returns false if malformed
+	static bool DecodeFrame(const uint8_t *buf, int len, uint8_t type,
+			LogFrame &frame, const LogFrame *base);
+
+private:
+	bool PageValid(uint32_t page, uint32_t *seq, uint32_t *firstTime);
+	int PageOf(uint32_t seq) { return seq % m_pages; }
+	uint32_t PageTime(uint32_t seq);
+	bool OpenPage(uint32_t time);
+	bool WriteRecord(uint8_t type, const uint8_t *payload, int len);
+	bool WriteAck(void);
+	int RecordAt(uint32_t seq, int offset, uint8_t *type, const uint8_t **payload,
+			int *len);
+	void ScanPage(uint32_t seq);
+	void StartOf(LogCursor &cursor, uint32_t seq);
+
+	FlashStore 		*m_pFlash;
+	int 			m_pages;
+	int 			m_pageSize;
+
+	bool 			m_empty;
+	uint32_t 		m_tailSeq;		// oldest page
+	uint32_t 		m_headSeq;		// page being written
+	int 			m_headOffset;
+
+	bool 			m_based;		// m_last is in the head page and readable
+	LogFrame 		m_last;
+
+	LogCursor 		m_upload;		// first frame not yet drained
+	bool 			m_ackPending;	// m_upload is not in the flash yet
+	LogStats 		m_stats;
+};
+
+#endif /* FLASHLOG_FLASHLOG_H_ */
@@ -0,0 +1,46 @@
+/*
+ * FlashStore.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef FLASHLOG_FLASHSTORE_H_
+#define FLASHLOG_FLASHSTORE_H_
+
+#include <stdint.h>
+
+//////////////////////////////////////////////////////////////////////////////
+//	class FlashStore
+//
+//	pages of NOR flash as seen by FlashLog: read through memory, programmed
+//	in 64 bit double words that go from erased (all ones) to their value
+//	once, erased a whole page at a time. Another implementation can back it
+//	with RAM, e.g. to cut the power at a chosen write.
+//
+//	A double word cut by a power loss while it was programmed can hold an
+//	uncorrectable ECC error. Reading it gives no exception the log could
+//	catch, the store notes it and ReadError() tells.
+//
+class FlashStore
+{
+public:
+	virtual ~FlashStore() {}
+
+	virtual int PageSize() = 0;
+	virtual int Pages() = 0;
+
+	// start of a page, readable like memory
+	virtual const uint8_t *Page(int page) = 0;
+
+	// programs the double word at offset, which must be a multiple of 8
+	virtual bool Program(int page, int offset, uint64_t data) = 0;
+
+	virtual bool Erase(int page) = 0;
+
+	// true if reading len bytes at offset hit an ECC error since the page
+	// was last erased; the data read there is not to be trusted
+	virtual bool ReadError(int page, int offset, int len) { return false; }
+};
+
+#endif /* FLASHLOG_FLASHSTORE_H_ */
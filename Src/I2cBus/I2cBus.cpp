@@ -0,0 +1,311 @@
+/*
+ * I2cBus.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <string.h>
+#include "I2cBus.h"
+#include "Profiler.h"
+
+// buses with a transaction in flight, for the HAL callbacks
+#define I2C_MAX_BUSES	2
+
+static I2cBus *Buses[I2C_MAX_BUSES];
+static I2C_HandleTypeDef *BusHandles[I2C_MAX_BUSES];
+
+// completion of a blocking call
+struct I2cSyncDone
+{
+	volatile bool 		done;
+	HAL_StatusTypeDef 	status;
+};
+
+static void SyncDone(void *ctx, HAL_StatusTypeDef status)
+{
+	I2cSyncDone *pSync = (I2cSyncDone *) ctx;
+
+	pSync->status = status;
+	pSync->done = true;
+}
+
+I2cBus::I2cBus(I2C_HandleTypeDef *pI2C)
+{
+	m_pI2C = pI2C;
+	m_count = 0;
+	m_cur = -1;
+	m_devCount = 0;
+	m_startTick = 0;
+	m_done = false;
+	m_status = HAL_OK;
+
+	for (int i = 0; i < I2C_MAX_BUSES; i++)
+	{
+		if (Buses[i] == NULL)
+		{
+			Buses[i] = this;
+			BusHandles[i] = pI2C;
+			break;
+		}
+	}
+}
+
+I2cBus::~I2cBus()
+{
+	for (int i = 0; i < I2C_MAX_BUSES; i++)
+	{
+		if (Buses[i] == this)
+		{
+			Buses[i] = NULL;
+			BusHandles[i] = NULL;
+		}
+	}
+}
+
+int I2cBus::AddDevice(uint8_t addr, uint32_t gapMs)
+{
+	for (int i = 0; i < m_devCount; i++)
+	{
+		if (m_devices[i].addr == addr)
+			return i;
+	}
+
+	if (m_devCount >= I2C_MAX_DEVICES)
+		return -1;
+
+	I2cDevice *pDev = &m_devices[m_devCount];
+
+	memset(pDev, 0, sizeof(I2cDevice));
+	pDev->addr = addr;
+	pDev->gapMs = gapMs;
+	pDev->lastEnd = HAL_GetTick() - gapMs;
+	pDev->stats.addr = addr;
+
+	return m_devCount++;
+}
+
+bool I2cBus::Submit(int dev, I2cDirEnum dir, int reg, uint8_t *data,
+		uint16_t len, I2cDoneHandler onDone, void *ctx)
+{
+	if (dev < 0 || dev >= m_devCount || m_count >= I2C_QUEUE_SIZE)
+		return false;
+
+	I2cXfer *pXfer = &m_queue[m_count++];
+
+	pXfer->dev = dev;
+	pXfer->dir = dir;
+	pXfer->reg = reg;
+	pXfer->data = data;
+	pXfer->len = len;
+	pXfer->onDone = onDone;
+	pXfer->ctx = ctx;
+	pXfer->submitTick = HAL_GetTick();
+
+	// nothing running, start at once if the device is ready
+	Poll();
+	return true;
+}
+
+HAL_StatusTypeDef I2cBus::Run(int dev, I2cDirEnum dir, int reg, uint8_t *data,
+		uint16_t len)
+{
+	I2cSyncDone sync;
+
+	sync.done = false;
+	sync.status = HAL_ERROR;
+
+	if (dev < 0 || dev >= m_devCount)
+		return HAL_ERROR;
+
+	// the queue drains by itself, every transaction ends or times out
+	while (!Submit(dev, dir, reg, data, len, SyncDone, &sync))
+		Poll();
+
+	while (!sync.done)
+		Poll();
+
+	return sync.status;
+}
+
+HAL_StatusTypeDef I2cBus::MemRead(int dev, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	return Run(dev, i2cRead, reg, data, len);
+}
+
+HAL_StatusTypeDef I2cBus::MemWrite(int dev, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	return Run(dev, i2cWrite, reg, data, len);
+}
+
+HAL_StatusTypeDef I2cBus::Receive(int dev, uint8_t *data, uint16_t len)
+{
+	return Run(dev, i2cRead, I2C_NO_REG, data, len);
+}
+
+HAL_StatusTypeDef I2cBus::Transmit(int dev, uint8_t *data, uint16_t len)
+{
+	return Run(dev, i2cWrite, I2C_NO_REG, data, len);
+}
+
+// Returns the first queued transaction whose device is past its gap and has
+// no older transaction waiting, -1 if none
+int I2cBus::NextReady(uint32_t now)
+{
+	uint32_t waiting = 0;		// devices with an older transaction queued
+
+	for (int i = 0; i < m_count; i++)
+	{
+		uint8_t dev = m_queue[i].dev;
+		I2cDevice *pDev = &m_devices[dev];
+
+		if (!(waiting & (1 << dev)) && (now - pDev->lastEnd) >= pDev->gapMs)
+			return i;
+
+		waiting |= 1 << dev;
+	}
+	return -1;
+}
+
+HAL_StatusTypeDef I2cBus::Start(I2cXfer *pXfer)
+{
+	uint16_t addr = m_devices[pXfer->dev].addr << 1;
+
+	if (pXfer->reg == I2C_NO_REG)
+	{
+		if (pXfer->dir == i2cRead)
+			return HAL_I2C_Master_Receive_IT(m_pI2C, addr, pXfer->data, pXfer->len);
+		return HAL_I2C_Master_Transmit_IT(m_pI2C, addr, pXfer->data, pXfer->len);
+	}
+
+	if (pXfer->dir == i2cRead)
+		return HAL_I2C_Mem_Read_IT(m_pI2C, addr, pXfer->reg, I2C_MEMADD_SIZE_8BIT,
+				pXfer->data, pXfer->len);
+	return HAL_I2C_Mem_Write_IT(m_pI2C, addr, pXfer->reg, I2C_MEMADD_SIZE_8BIT,
+			pXfer->data, pXfer->len);
+}
+
+// Removes the running transaction, updates its device and reports it
+void I2cBus::Finish(HAL_StatusTypeDef status)
+{
+	I2cXfer xfer = m_queue[m_cur];
+	I2cDevice *pDev = &m_devices[xfer.dev];
+	uint32_t now = HAL_GetTick();
+
+	PROFILE_SINCE_WALL("i2c xfer", m_profStart);
+
+	m_count--;
+	memmove(&m_queue[m_cur], &m_queue[m_cur + 1], (m_count - m_cur) * sizeof(I2cXfer));
+	m_cur = -1;
+
+	pDev->lastEnd = now;
+	pDev->stats.count++;
+	if (status != HAL_OK)
+		pDev->stats.errors++;
+
+	uint32_t latency = now - xfer.submitTick;
+	if (latency > pDev->stats.latencyMax)
+		pDev->stats.latencyMax = latency;
+	pDev->stats.latencySum += latency;
+
+	// the handler may submit again
+	if (xfer.onDone != NULL)
+		xfer.onDone(xfer.ctx, status);
+}
+
+void I2cBus::Poll()
+{
+	uint32_t now = HAL_GetTick();
+
+	if (m_cur >= 0)
+	{
+		if (m_done)
+			Finish(m_status);
+		else if ((now - m_startTick) > I2C_XFER_TIMEOUT_MS)
+		{
+			// stuck, e.g. a slave holding SDA low: start over with a clean peripheral
+			HAL_I2C_DeInit(m_pI2C);
+			HAL_I2C_Init(m_pI2C);
+			Finish(HAL_TIMEOUT);
+		}
+		else
+			return;
+	}
+
+	while (m_cur < 0 && m_count > 0)
+	{
+		int next = NextReady(now);
+		if (next < 0)
+			return;
+
+		m_cur = next;
+		m_done = false;
+		m_startTick = now;
+		// the completion interrupt may end a SLEEP
+		PROFILE_STAMP_WALL(m_profStart);
+
+		HAL_StatusTypeDef status = Start(&m_queue[next]);
+		if (status == HAL_OK)
+			return;
+
+		Finish(status);
+		now = HAL_GetTick();
+	}
+}
+
+bool I2cBus::GetStats(int dev, I2cStats &stats, bool reset)
+{
+	if (dev < 0 || dev >= m_devCount)
+		return false;
+
+	stats = m_devices[dev].stats;
+
+	if (reset)
+	{
+		memset(&m_devices[dev].stats, 0, sizeof(I2cStats));
+		m_devices[dev].stats.addr = m_devices[dev].addr;
+	}
+	return true;
+}
+
+void I2cBus::Complete(I2C_HandleTypeDef *pI2C, HAL_StatusTypeDef status)
+{
+	for (int i = 0; i < I2C_MAX_BUSES; i++)
+	{
+		if (BusHandles[i] == pI2C && Buses[i] != NULL)
+		{
+			Buses[i]->m_status = status;
+			Buses[i]->m_done = true;
+			return;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// HAL callbacks, interrupt context
+////////////////////////////////////////////////////////////////////////////////
+
+extern "C" void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	I2cBus::Complete(hi2c, HAL_OK);
+}
+
+extern "C" void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	I2cBus::Complete(hi2c, HAL_OK);
+}
+
+extern "C" void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	I2cBus::Complete(hi2c, HAL_OK);
+}
+
+extern "C" void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	I2cBus::Complete(hi2c, HAL_OK);
+}
+
+extern "C" void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+	I2cBus::Complete(hi2c, HAL_ERROR);
+}
@@ -0,0 +1,134 @@
+/*
+ * I2cBus.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef I2CBUS_I2CBUS_H_
+#define I2CBUS_I2CBUS_H_
+
+#include <stdint.h>
+#include <stm32l4xx_hal.h>
+
+// transactions waiting for the bus
+#define I2C_QUEUE_SIZE		8
+
+// devices sharing one bus
+#define I2C_MAX_DEVICES		6
+
+// a transfer that does not complete in time is aborted and the bus reset
+#define I2C_XFER_TIMEOUT_MS	100
+
+// register address of a plain transmit or receive
+#define I2C_NO_REG			-1
+
+typedef enum {i2cRead, i2cWrite} I2cDirEnum;
+
+// called in the main loop context when a queued transaction has completed
+typedef void (*I2cDoneHandler)(void *ctx, HAL_StatusTypeDef status);
+
+// transaction counters of one device, times in ms
+struct I2cStats
+{
+	uint8_t 	addr;
+	uint32_t 	count;
+	uint32_t 	errors;
+	uint32_t 	latencyMax;		// from Submit() to completion, including the wait in the queue
+	uint32_t 	latencySum;		// divided by count gives the average
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	class I2cBus
+//
+//	serializes the transactions of all drivers on one I2C bus. Transactions
+//	are queued and run one at a time with the interrupt driven HAL calls,
+//	the completion is reported from Poll() in the main loop context.
+//
+//	Devices that need a pause between two accesses (the fuel gauge) get a
+//	minimum gap: the next transaction of the device is started no earlier
+//	than gap ms after the end of the previous one. Meanwhile the bus serves
+//	the other devices, the transactions of one device keep their order.
+//
+//	The blocking calls (MemRead, MemWrite, Receive, Transmit) queue the
+//	transaction and poll the bus until it is done, so the sensor drivers
+//	keep their synchronous interface.
+//
+class I2cBus
+{
+public:
+	I2cBus(I2C_HandleTypeDef *pI2C);
+	~I2cBus();
+
+	// registers a device (7 bit address), returns its id for the calls below
+	int AddDevice(uint8_t addr, uint32_t gapMs = 0);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	bool Submit(dev, dir, reg, data, len, onDone, ctx);
+	//
+	//	queues a transaction and returns at once
+	//
+	//		reg		register address for a memory access, I2C_NO_REG for a
+	//				plain transmit or receive
+	//		data	must stay valid until onDone is called
+	//
+	//	returns false if the queue is full
+	//
+	bool Submit(int dev, I2cDirEnum dir, int reg, uint8_t *data, uint16_t len,
+			I2cDoneHandler onDone = NULL, void *ctx = NULL);
+
+	HAL_StatusTypeDef MemRead(int dev, uint8_t reg, uint8_t *data, uint16_t len);
+	HAL_StatusTypeDef MemWrite(int dev, uint8_t reg, uint8_t *data, uint16_t len);
+	HAL_StatusTypeDef Receive(int dev, uint8_t *data, uint16_t len);
+	HAL_StatusTypeDef Transmit(int dev, uint8_t *data, uint16_t len);
+
+	// completes the running transaction and starts the next one, call it regularly
+	void Poll();
+
+	bool IsIdle() { return m_count == 0; }
+
+	bool GetStats(int dev, I2cStats &stats, bool reset = false);
+
+	// called from the HAL completion and error callbacks
+	static void Complete(I2C_HandleTypeDef *pI2C, HAL_StatusTypeDef status);
+
+private:
+	struct I2cXfer
+	{
+		uint8_t 		dev;
+		I2cDirEnum 		dir;
+		int 			reg;
+		uint8_t 		*data;
+		uint16_t 		len;
+		I2cDoneHandler 	onDone;
+		void 			*ctx;
+		uint32_t 		submitTick;
+	};
+
+	struct I2cDevice
+	{
+		uint8_t 	addr;
+		uint32_t 	gapMs;
+		uint32_t 	lastEnd;		// tick when its last transaction completed
+		I2cStats 	stats;
+	};
+
+	HAL_StatusTypeDef Run(int dev, I2cDirEnum dir, int reg, uint8_t *data, uint16_t len);
+	int NextReady(uint32_t now);
+	HAL_StatusTypeDef Start(I2cXfer *pXfer);
+	void Finish(HAL_StatusTypeDef status);
+
+	I2C_HandleTypeDef 	*m_pI2C;
+	I2cXfer 			m_queue[I2C_QUEUE_SIZE];	// in submit order
+	int 				m_count;
+	int 				m_cur;			// entry on the bus, -1 if none
+	I2cDevice 			m_devices[I2C_MAX_DEVICES];
+	int 				m_devCount;
+
+	uint32_t 			m_startTick;
+	uint32_t 			m_profStart;	// ProfWallNow() at the start, with PROFILE_ENABLED
+	volatile bool 				m_done;			// set by the interrupt
+	volatile HAL_StatusTypeDef 	m_status;
+};
+
+#endif /* I2CBUS_I2CBUS_H_ */
@@ -10,17 +10,24 @@
   
 *****************************************/
 #include <stdio.h>
-#include ".\NS_energyShield2.h"
+#include "NS_energyShield2.h"
 
 #define DELAY 100
-#define ES2_DELAY 1
+
+// Bus device id of one of the shield's chips
+int NS_energyShield2::device(uint8_t slaveAddress)
+{
+	if (slaveAddress == RTC_SLAVE_ADDR)
+		return _rtcDev;
+	if (slaveAddress == DAC_SLAVE_ADDR)
+		return _dacDev;
+	return _fgDev;
+}
 
 // Write one byte via TWI
 void NS_energyShield2::writeByte(uint8_t slaveAddress, uint8_t registerAddress, uint8_t data)
 {
-	HAL_I2C_Mem_Write(_pI2C, slaveAddress << 1, registerAddress, I2C_MEMADD_SIZE_8BIT, &data, 1, 100);
-
-	HAL_Delay(ES2_DELAY);
+	_pBus->MemWrite(device(slaveAddress), registerAddress, &data, 1);
 
 	return;	
 }
@@ -30,8 +37,7 @@ uint8_t NS_energyShield2::readByte(uint8_t slaveAddress, uint8_t registerAddress
 {
 	uint8_t data;
 
-	HAL_I2C_Mem_Read(_pI2C, slaveAddress << 1, registerAddress, I2C_MEMADD_SIZE_8BIT, &data, 1, 100);
-	HAL_Delay(ES2_DELAY);
+	_pBus->MemRead(device(slaveAddress), registerAddress, &data, 1);
 
 	return data;
 }
@@ -44,9 +50,7 @@ void NS_energyShield2::writeCommand(uint8_t slaveAddress, uint8_t registerAddres
 	buf[0] = dataWord & 0xFF;
 	buf[1] = dataWord >> 8;
 
-	HAL_I2C_Mem_Write(_pI2C, slaveAddress << 1, registerAddress, I2C_MEMADD_SIZE_8BIT, buf, 2, 100);
-
-	HAL_Delay(ES2_DELAY);
+	_pBus->MemWrite(device(slaveAddress), registerAddress, buf, 2);
 
   return;
 }
@@ -57,9 +61,7 @@ uint16_t NS_energyShield2::readCommand(uint8_t slaveAddress, uint8_t registerAdd
 	uint16_t dataWord;
 	uint8_t buf[2];
 
-	HAL_I2C_Mem_Read(_pI2C, slaveAddress << 1, registerAddress, I2C_MEMADD_SIZE_8BIT, buf, 2, 100);
-
-	HAL_Delay(ES2_DELAY);
+	_pBus->MemRead(device(slaveAddress), registerAddress, buf, 2);
 
 	dataWord = buf[0];
 	dataWord |= buf[1] << 8;
@@ -77,12 +79,10 @@ uint16_t NS_energyShield2::readSubCommand(uint8_t slaveAddress, uint16_t control
 	buf[1] = controlData & 0xFF;
 	buf[2] = controlData >> 8;
 
-	HAL_I2C_Master_Transmit(_pI2C, slaveAddress << 1, buf, 3, 100);
+	_pBus->Transmit(device(slaveAddress), buf, 3);
 
 	dataWord = readCommand(slaveAddress, 0x00);
 
-	HAL_Delay(ES2_DELAY);
-
 	return dataWord;
 } 
 
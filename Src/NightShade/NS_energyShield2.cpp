@@ -9,20 +9,40 @@
   https://opensource.org/licenses/MIT
   
 *****************************************/
+#include <string.h>
 #include <adc.h>
-#include ".\NS_energyShield2.h"
+#include "NS_energyShield2.h"
 
 // Creates an instance of NS_energyShield2
-NS_energyShield2::NS_energyShield2(I2C_HandleTypeDef *pI2C)
+NS_energyShield2::NS_energyShield2(I2cBus *pBus)
 {
 	_batteryCapacity = BATTERY_CAPACITY;
-	_pI2C = pI2C;
+	_pBus = pBus;
+	_pAdc = NULL;
+	_adcIndex = -1;
+	_clockValid = false;
+	addDevices();
+	initSnapshot();
 }
 
 // Creates an instance of NS_energyShield2 and defines custom battery size
-NS_energyShield2::NS_energyShield2(I2C_HandleTypeDef *pI2C, uint16_t batteryCapacity_mAh) {
+NS_energyShield2::NS_energyShield2(I2cBus *pBus, uint16_t batteryCapacity_mAh) {
 	_batteryCapacity = batteryCapacity_mAh;	
-	_pI2C = pI2C;
+	_pBus = pBus;
+	_pAdc = NULL;
+	_adcIndex = -1;
+	_clockValid = false;
+	addDevices();
+	initSnapshot();
+}
+
+// Registers the three chips of the shield on the bus, the RTC and the fuel
+// gauge need a short pause between two accesses
+void NS_energyShield2::addDevices()
+{
+	_rtcDev = _pBus->AddDevice(RTC_SLAVE_ADDR, ES2_DELAY);
+	_dacDev = _pBus->AddDevice(DAC_SLAVE_ADDR);
+	_fgDev = _pBus->AddDevice(FG_SLAVE_ADDR, ES2_DELAY);
 }
 
 
@@ -32,7 +52,7 @@ void NS_energyShield2::setTimeDate(uint8_t second, uint8_t minute, uint8_t hour,
   uint8_t timeDate[7];
 
   // Load timeDate array
-  timeDate[0] = 0b10000000 | encodeBCD(second);
+  timeDate[0] = encodeBCD(second);	// clears OS, the time is valid from now on
   timeDate[1] = encodeBCD(minute);
   timeDate[2] = encodeBCD(hour);
   timeDate[3] = encodeBCD(dayOfMonth);
@@ -41,7 +61,7 @@ void NS_energyShield2::setTimeDate(uint8_t second, uint8_t minute, uint8_t hour,
   timeDate[6] = encodeBCD(year);
 
 	// Program RTC registers
-	HAL_I2C_Mem_Write(_pI2C, RTC_SLAVE_ADDR << 1, 0x04, I2C_MEMADD_SIZE_8BIT, timeDate, 7, 100);
+	_pBus->MemWrite(_rtcDev, 0x04, timeDate, 7);
 	//device address 0x40 in the data sheet is shifted 1-bit to the left.
 	//7 bytes are transmitting to the slave RTC
 
@@ -55,8 +75,10 @@ void NS_energyShield2::readClock()
 	
 	// Read time and date
 	// read from register 4 to 0xA from RTC
-	HAL_I2C_Mem_Read(_pI2C, RTC_SLAVE_ADDR << 1, 0x04, I2C_MEMADD_SIZE_8BIT, _timeDate, 7, 100);
+	_pBus->MemRead(_rtcDev, 0x04, _timeDate, 7);
 
+	// OS, the oscillator has stopped since the time was set
+	_clockValid = !(_timeDate[0] & 0x80);
 	
 	// Convert seconds, minutes, hours, day-of-the-month, and year from BCD to binary (skipping day-of-the-week)
 	for (i = 0; i < 7; i++)
@@ -68,6 +90,42 @@ void NS_energyShield2::readClock()
 	return;
 }
 
+// Read the RTC once and return the time in seconds since 1970, 0 if the time
+// is not valid. Between two reads the time is best kept by a WallClock.
+uint32_t NS_energyShield2::readEpoch()
+{
+	readClock();
+
+	if (!_clockValid || second() > 59 || minute() > 59 || hour() > 23 ||
+			month() < 1 || month() > 12 || dayOfMonth() < 1 || dayOfMonth() > 31)
+		return 0;
+	return clockEpoch();
+}
+
+// Set the RTC to a time in seconds since 1970 (2000 to 2099)
+void NS_energyShield2::setEpoch(uint32_t epoch)
+{
+	CalendarTime cal;
+
+	EpochToCalendar(epoch, cal);
+	setTimeDate(cal.second, cal.minute, cal.hour, cal.day, cal.weekday,
+			cal.month, cal.year % 100);
+}
+
+// Time of the last readClock() in seconds since 1970
+uint32_t NS_energyShield2::clockEpoch()
+{
+	CalendarTime cal;
+
+	cal.year = 2000 + year();
+	cal.month = month();
+	cal.day = dayOfMonth();
+	cal.hour = hour();
+	cal.minute = minute();
+	cal.second = second();
+	return CalendarToEpoch(cal);
+}
+
 // Returns current second(0-59)
 uint8_t NS_energyShield2::second()
 {
@@ -119,46 +177,33 @@ void NS_energyShield2::clearAlarms()
 		tmp[i] = 0xff;
 
 	//HAL_Delay(15);
-	HAL_I2C_Mem_Write(_pI2C, RTC_SLAVE_ADDR << 1, 0x0B, I2C_MEMADD_SIZE_8BIT, tmp, 5, 100);
+	_pBus->MemWrite(_rtcDev, 0x0B, tmp, 5);
 
 	return;
 }
 
+// Sets the alarm alarmTimeSeconds after the time of the last readClock().
+// The alarm fields are those of the target time, so they carry over minutes,
+// hours, days and months. Up to 28 days, longer times are cut short.
 void NS_energyShield2::writeAlarms(long alarmTimeSeconds)
 {
-	uint8_t secondAlarm, minuteAlarm, hourAlarm, dayAlarm, chksum = 0, received;
-	uint8_t tmp[5];
+	CalendarAlarm alarm;
+	uint8_t regs[5], received[5];
+
+	CalendarAlarmIn(clockEpoch(), alarmTimeSeconds > 0 ? alarmTimeSeconds : 1, alarm);
+
+	// second, minute, hour, day and weekday alarm, bit 7 disables a field
+	regs[0] = alarm.match & ALARM_MATCH_SECOND ? encodeBCD(alarm.second) : 0x80;
+	regs[1] = alarm.match & ALARM_MATCH_MINUTE ? encodeBCD(alarm.minute) : 0x80;
+	regs[2] = alarm.match & ALARM_MATCH_HOUR ? encodeBCD(alarm.hour) : 0x80;
+	regs[3] = alarm.match & ALARM_MATCH_DAY ? encodeBCD(alarm.day) : 0x80;
+	regs[4] = 0x80;
 
 	do
 	{
-		clearAlarms(); 				// Clear all active alarms
-		
-		secondAlarm = encodeBCD((second() + alarmTimeSeconds) % 60);
-		minuteAlarm = alarmTimeSeconds >= 60 ?
-				encodeBCD((minute() + alarmTimeSeconds/60)%60) : 0;
-		hourAlarm = alarmTimeSeconds >= 3600 ?
-				encodeBCD((hour() + alarmTimeSeconds/3600)%24) : 0;
-		dayAlarm = alarmTimeSeconds >= 86400 ?
-				encodeBCD((dayOfWeek() + alarmTimeSeconds/86400)%7) : 0;
-
-		writeByte(RTC_SLAVE_ADDR, 0x0B, secondAlarm);
-		if (alarmTimeSeconds >= 60)
-			writeByte(RTC_SLAVE_ADDR, 0x0C, minuteAlarm);
-		if (alarmTimeSeconds >= 3600)
-			writeByte(RTC_SLAVE_ADDR, 0x0D, hourAlarm);
-		if (alarmTimeSeconds >= 86400)
-			writeByte(RTC_SLAVE_ADDR, 0x0F, dayAlarm);
-		
-		HAL_Delay(1);
-		HAL_I2C_Mem_Read(_pI2C, RTC_SLAVE_ADDR << 1, 0x0B, I2C_MEMADD_SIZE_8BIT, tmp, 5, 100);
-
-		for (int i = 0; i < 5; ++i)
-		{
-			received = tmp[i];
-			if (received < 128)
-				chksum += received;
-		}		
-	} while (chksum != secondAlarm + minuteAlarm + hourAlarm + dayAlarm);
+		_pBus->MemWrite(_rtcDev, 0x0B, regs, 5);
+		_pBus->MemRead(_rtcDev, 0x0B, received, 5);
+	} while (memcmp(regs, received, 5) != 0);
 }
 
 // Turns off 5V and 3.3V output for timeInSeconds seconds
@@ -195,7 +240,7 @@ int NS_energyShield2::readVMPP()
 	uint8_t data[2];
 	do
 	{
-		HAL_I2C_Master_Receive(_pI2C, DAC_SLAVE_ADDR<<1, data, 2, 100);
+		_pBus->Receive(_dacDev, data, 2);
 	} while (!(data[0] & 0b10000000));
 
 	if (data[0] & 0b00000110)
@@ -216,7 +261,7 @@ void NS_energyShield2::setVMPP(int MPP_Voltage_mV, bool writeEEPROM)
 
 	do
 	{
-		HAL_I2C_Master_Receive(_pI2C, DAC_SLAVE_ADDR<<1, data, 2, 100);
+		_pBus->Receive(_dacDev, data, 2);
 	} while (!(data[0] & 0b10000000));
 
 
@@ -248,7 +293,7 @@ void NS_energyShield2::setVMPP(int MPP_Voltage_mV, bool writeEEPROM)
 		tmp[2] = Lbyte;
 
 		// Write value to DAC
-		HAL_I2C_Master_Transmit(_pI2C, DAC_SLAVE_ADDR<<1, tmp, 3, 100);
+		_pBus->Transmit(_dacDev, tmp, 3);
 	}
 
 	return;
@@ -297,6 +342,63 @@ uint16_t NS_energyShield2::remainingCapacity()
 	return remainingCapacity;
 }
 
+// Starts without cached fuel gauge values
+void NS_energyShield2::initSnapshot()
+{
+	memset(&_snapshot, 0, sizeof(_snapshot));
+	_snapshotValid = false;
+	_snapshotMaxAge = ES2_SNAPSHOT_MAX_AGE;
+}
+
+// Sets the default age up to which snapshot() reuses its last read
+void NS_energyShield2::setSnapshotMaxAge(uint32_t maxAge)
+{
+	_snapshotMaxAge = maxAge;
+}
+
+int NS_energyShield2::snapshot(ES2_Snapshot &snap)
+{
+	return snapshot(snap, _snapshotMaxAge);
+}
+
+// Reads the fuel gauge values in one transfer instead of one per command
+int NS_energyShield2::snapshot(ES2_Snapshot &snap, uint32_t maxAge)
+{
+	uint8_t buf[FG_BLOCK_LEN];
+	uint32_t now = HAL_GetTick();
+
+	if (_snapshotValid && maxAge != 0 && now - _snapshot.timestamp < maxAge)
+	{
+		snap = _snapshot;
+		return 0;
+	}
+
+	if (_pBus->MemRead(_fgDev, FG_BLOCK_START, buf, FG_BLOCK_LEN) != HAL_OK)
+	{
+		snap = _snapshot;
+		return 1;
+	}
+
+	// little endian words, offsets relative to FG_BLOCK_START
+	#define FG_WORD(cmd) (uint16_t) (buf[(cmd) - FG_BLOCK_START] | (buf[(cmd) - FG_BLOCK_START + 1] << 8))
+
+	_snapshot.timestamp = now;
+	_snapshot.temperature = FG_WORD(0x02) - 2732;
+	_snapshot.voltage = FG_WORD(0x04);
+	_snapshot.flags = FG_WORD(0x06);
+	_snapshot.remainingCapacity = FG_WORD(0x0C);
+	_snapshot.fullChargeCapacity = FG_WORD(0x0E);
+	_snapshot.current = FG_WORD(0x10);
+	_snapshot.averagePower = FG_WORD(0x18);
+	_snapshot.SOC = FG_WORD(0x1C);
+
+	#undef FG_WORD
+
+	_snapshotValid = true;
+	snap = _snapshot;
+	return 0;
+}
+
 // Sets GPOUT pin to BAT Low indication
 int NS_energyShield2::batteryAlert(uint8_t alarmSOC)
 {
@@ -422,25 +524,42 @@ int NS_energyShield2::batteryAlert(uint8_t alarmSOC)
 	return 0;
 }
 
+// Takes the input voltage from a running ADC scan instead of converting
+// on demand, index is the scan channel of A0
+void NS_energyShield2::attachAdc(AdcScan *pAdc, int index)
+{
+	_pAdc = pAdc;
+	_adcIndex = index;
+}
+
 // Returns solar/adapter input voltage in mV (default pin, A0)
 uint16_t NS_energyShield2::inputVoltage(uint8_t analogChannel)
 {
-	uint16_t voltage = 0;
+	uint32_t sum = 0;
+	int count = 0;
+
+	if (analogChannel != 0) 			// PA0 is configured ADC1_IN5
+		return 0;
 
-	if (analogChannel == 0) 			// PA0 is configured ADC1_IN5
+	if (_pAdc != NULL)
+		return (uint16_t) _pAdc->Get(_adcIndex);
+
+	HAL_ADC_Start(&hadc1);
+	for (int ix = 0; ix < 4; ix++)
 	{
-		HAL_ADC_Start(&hadc1);
-		for (int ix = 0; ix < 4; ix++)
+		if (HAL_ADC_PollForConversion(&hadc1, 10) == HAL_OK)
 		{
-			if (HAL_ADC_PollForConversion(&hadc1, 4000) == HAL_OK)
-			{
-				voltage += HAL_ADC_GetValue(&hadc1);
-			}
+			sum += HAL_ADC_GetValue(&hadc1);
+			count++;
 		}
-		voltage = (unsigned long) (voltage / 4) * 5;
 	}
+	HAL_ADC_Stop(&hadc1);
 
-	return voltage;
+	if (count == 0)
+		return 0;
+
+	// pin voltage at a nominal 3.3 V VDDA
+	return (uint16_t) ((sum / count) * 3300 / 4095 * ES2_INPUT_DIVIDER_NUM / ES2_INPUT_DIVIDER_DEN);
 }
 
 // Set up energyShield 2 for use
@@ -15,6 +15,9 @@
 
 #include <stdio.h>
 #include <stm32l4xx_hal.h>
+#include "I2cBus.h"
+#include "AdcScan.h"
+#include "Calendar.h"
 
 // Define RTC TWI slave address
 #ifndef RTC_SLAVE_ADDR 
@@ -31,6 +34,27 @@
 #define FG_SLAVE_ADDR 0x55
 #endif
 
+// Minimum time between two accesses to the RTC or the fuel gauge in ms
+#ifndef ES2_DELAY
+#define ES2_DELAY 1
+#endif
+
+// Divider of the solar/adapter input on A0, input mV = pin mV * NUM / DEN
+#ifndef ES2_INPUT_DIVIDER_NUM
+#define ES2_INPUT_DIVIDER_NUM 62
+#define ES2_INPUT_DIVIDER_DEN 10
+#endif
+
+// Standard commands read in one transfer by snapshot(): Temperature() at
+// 0x02 up to StateOfCharge() at 0x1C, the gauge increments the address
+#define FG_BLOCK_START 0x02
+#define FG_BLOCK_LEN 28
+
+// Age up to which snapshot() returns the cached values in ms
+#ifndef ES2_SNAPSHOT_MAX_AGE
+#define ES2_SNAPSHOT_MAX_AGE 1000
+#endif
+
 // Define capacity of battery in mAh
 #ifndef BATTERY_CAPACITY 
 #define BATTERY_CAPACITY 1800
@@ -51,16 +75,33 @@
 #define ALARM_SOC 10
 #endif
 
+// Fuel gauge values from one block read
+struct __attribute__((packed)) ES2_Snapshot
+{
+	uint32_t timestamp;				// HAL_GetTick() of the read
+	uint16_t voltage;				// mV
+	int16_t  current;				// 1 s average, mA
+	int16_t  averagePower;			// mW
+	int16_t  temperature;			// 0.1 C
+	uint16_t flags;
+	uint16_t remainingCapacity;		// mAh
+	uint16_t fullChargeCapacity;	// mAh
+	uint16_t SOC;					// %
+};
+
 class NS_energyShield2
 {
 public:
-	NS_energyShield2(I2C_HandleTypeDef *pI2C);
-	NS_energyShield2(I2C_HandleTypeDef *pI2C, uint16_t batteryCapacity_mAh);
+	NS_energyShield2(I2cBus *pBus);
+	NS_energyShield2(I2cBus *pBus, uint16_t batteryCapacity_mAh);
 
 	// RTC Functions
 	void setTimeDate(uint8_t second, uint8_t minute, uint8_t hour,
 			uint8_t dayOfMonth, uint8_t dayOfWeek, uint8_t month, uint8_t year);
 	void readClock();
+	// UTC in s since 1970 from one read of the RTC, 0 if it has lost the time
+	uint32_t readEpoch();
+	void setEpoch(uint32_t epoch);
 	uint8_t second();
 	uint8_t minute();
 	uint8_t hour();
@@ -77,6 +118,7 @@ public:
 	int readVMPP();
 	uint16_t inputVoltage();
 	uint16_t inputVoltage(uint8_t pin);
+	void attachAdc(AdcScan *pAdc, int index);
 
 	// Fuel gauge functions
 	uint16_t batteryVoltage();
@@ -87,6 +129,13 @@ public:
 	uint16_t remainingCapacity();
 	int batteryAlert(uint8_t alarmSOC);
 
+	// All fuel gauge values at once, re-read only when the cached ones are
+	// older than maxAge ms (0 forces a read). Returns 0, or 1 if the read
+	// failed and the old values were left in place.
+	int snapshot(ES2_Snapshot &snap, uint32_t maxAge);
+	int snapshot(ES2_Snapshot &snap);
+	void setSnapshotMaxAge(uint32_t maxAge);
+
 	// Setup function
 	int begin();
 
@@ -107,11 +156,25 @@ private:
 			uint16_t chargeTerminationCurrent_mA, uint8_t alarmSOC);
 	uint8_t  decodeBCD(uint8_t bcd);
 	uint8_t  encodeBCD(uint8_t value);
+	void 	 addDevices();
+	int 	 device(uint8_t slaveAddress);
+	void 	 initSnapshot();
+	uint32_t clockEpoch();
 
 
 	uint8_t _timeDate[7];
+	bool _clockValid;
 	uint16_t _batteryCapacity;
-	I2C_HandleTypeDef *_pI2C;
+	I2cBus *_pBus;
+	int _rtcDev;
+	int _dacDev;
+	int _fgDev;
+	AdcScan *_pAdc;
+	int _adcIndex;
+
+	ES2_Snapshot _snapshot;
+	bool _snapshotValid;
+	uint32_t _snapshotMaxAge;
 };
 
 #endif
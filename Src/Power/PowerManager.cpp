@@ -0,0 +1,233 @@
+/*
+ * PowerManager.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <string.h>
+#include "PowerManager.h"
+
+// manager that gets the LPTIM1 interrupts
+static PowerManager *Sleeping;
+
+PowerManager::PowerManager(LPTIM_HandleTypeDef *hlptim)
+{
+	m_hlptim = hlptim;
+	m_restoreClock = NULL;
+
+	memset(m_clients, 0, sizeof(m_clients));
+	m_count = 0;
+
+	m_timeout = false;
+	m_runStart = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+// LPTIM1 keeps counting in STOP2 only from LSI or LSE
+bool PowerManager::SelectLsi(void)
+{
+	RCC_PeriphCLKInitTypeDef PeriphClkInit = {0};
+
+	PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_LPTIM1;
+	PeriphClkInit.Lptim1ClockSelection = RCC_LPTIM1CLKSOURCE_LSI;
+
+	return (HAL_RCCEx_PeriphCLKConfig(&PeriphClkInit) == HAL_OK);
+}
+
+bool PowerManager::Begin(PowerFunc restoreClock)
+{
+	RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+
+	m_restoreClock = restoreClock;
+
+	RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_LSI;
+	RCC_OscInitStruct.LSIState = RCC_LSI_ON;
+	RCC_OscInitStruct.PLL.PLLState = RCC_PLL_NONE;
+	if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
+		return false;
+
+	if (!SelectLsi())
+		return false;
+
+	// the CubeMX setup counts external pulses, the wake up timer counts LSI
+	m_hlptim->Init.Clock.Source = LPTIM_CLOCKSOURCE_APBCLOCK_LPOSC;
+	m_hlptim->Init.Clock.Prescaler = POWER_LPTIM_PRESCALER;
+	m_hlptim->Init.Trigger.Source = LPTIM_TRIGSOURCE_SOFTWARE;
+	m_hlptim->Init.UpdateMode = LPTIM_UPDATE_IMMEDIATE;
+	m_hlptim->Init.CounterSource = LPTIM_COUNTERSOURCE_INTERNAL;
+	if (HAL_LPTIM_Init(m_hlptim) != HAL_OK)
+		return false;
+
+	// EXTI line 32 lets the LPTIM1 interrupt end a stop
+	SET_BIT(EXTI->IMR2, EXTI_IMR2_IM32);
+
+	HAL_NVIC_SetPriority(LPTIM1_IRQn, 1, 0);
+	HAL_NVIC_EnableIRQ(LPTIM1_IRQn);
+
+	// restart on HSI, the PLL source, to get back to speed quickly
+	__HAL_RCC_WAKEUPSTOP_CLK_CONFIG(RCC_STOP_WAKEUPCLOCK_HSI);
+
+	Sleeping = this;
+	m_runStart = HAL_GetTick();
+	return true;
+}
+
+int PowerManager::AddClient(const char *name, PowerLimitFunc limit, PowerFunc suspend,
+		PowerFunc resume, void *ctx)
+{
+	if (m_count >= POWER_MAX_CLIENTS)
+		return -1;
+
+	Client &client = m_clients[m_count];
+	client.name = name;
+	client.limit = limit;
+	client.suspend = suspend;
+	client.resume = resume;
+	client.ctx = ctx;
+
+	return m_count++;
+}
+
+// the deepest state all clients allow
+PowerStateEnum PowerManager::Limit(void)
+{
+	PowerStateEnum limit = powerStop2;
+
+	for (int i = 0; i < m_count; i++)
+	{
+		if (m_clients[i].limit == NULL)
+			continue;
+
+		PowerStateEnum client = m_clients[i].limit(m_clients[i].ctx);
+
+		if (client < limit)
+			limit = client;
+	}
+	return limit;
+}
+
+PowerStateEnum PowerManager::Plan(uint32_t idleMs, PowerStateEnum limit, uint32_t *stopMs)
+{
+	*stopMs = 0;
+
+	if (idleMs == 0 || limit == powerRun)
+		return powerRun;
+
+	if (limit == powerSleep || idleMs < POWER_STOP_MIN_MS)
+		return powerSleep;
+
+	uint32_t ms = idleMs - POWER_WAKE_MARGIN_MS;
+
+	*stopMs = (ms > POWER_STOP_MAX_MS) ? POWER_STOP_MAX_MS : ms;
+	return (limit < powerStop2) ? limit : powerStop2;
+}
+
+void PowerManager::Idle(uint32_t idleMs)
+{
+	uint32_t stopMs;
+	uint32_t start = HAL_GetTick();
+
+	m_stats.time[powerRun] += start - m_runStart;
+
+	PowerStateEnum limit = (idleMs >= POWER_STOP_MIN_MS) ? Limit() : powerStop2;
+	PowerStateEnum state = Plan(idleMs, limit, &stopMs);
+
+	if (limit < powerStop2)
+		m_stats.vetoes++;
+	m_stats.entries[state]++;
+
+	switch (state)
+	{
+	case powerSleep:
+		// the next SysTick ends it at the latest
+		HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+		m_stats.time[powerSleep] += HAL_GetTick() - start;
+		break;
+
+	case powerStop1:
+	case powerStop2:
+		m_stats.time[state] += Stop(state, stopMs);
+		break;
+
+	case powerRun:
+	default:
+		break;
+	}
+
+	m_runStart = HAL_GetTick();
+}
+
+// LPTIM1 runs asynchronously, a read is valid when two in a row agree
+uint32_t PowerManager::ReadCounter(void)
+{
+	uint32_t count, again;
+
+	again = HAL_LPTIM_ReadCounter(m_hlptim);
+	do
+	{
+		count = again;
+		again = HAL_LPTIM_ReadCounter(m_hlptim);
+	} while (count != again);
+
+	return count;
+}
+
+// returns the ms spent in STOP1 or STOP2
+uint32_t PowerManager::Stop(PowerStateEnum state, uint32_t stopMs)
+{
+	for (int i = 0; i < m_count; i++)
+	{
+		if (m_clients[i].suspend != NULL)
+			m_clients[i].suspend(m_clients[i].ctx);
+	}
+
+	m_timeout = false;
+	HAL_LPTIM_Counter_Start_IT(m_hlptim, stopMs - 1);
+
+	HAL_SuspendTick();
+	if (state == powerStop1)
+		HAL_PWREx_EnterSTOP1Mode(PWR_STOPENTRY_WFI);
+	else
+		HAL_PWREx_EnterSTOP2Mode(PWR_STOPENTRY_WFI);
+
+	// running on HSI from here
+	uint32_t elapsed = m_timeout ? stopMs : ReadCounter();
+	HAL_LPTIM_Counter_Stop_IT(m_hlptim);
+
+	if (!m_timeout)
+		m_stats.earlyWakes++;
+
+	// SysTick was stopped, catch the HAL tick up with the time asleep
+	uwTick += elapsed;
+
+	if (m_restoreClock != NULL)
+		m_restoreClock(NULL);
+	SelectLsi();
+	HAL_ResumeTick();
+
+	for (int i = m_count - 1; i >= 0; i--)
+	{
+		if (m_clients[i].resume != NULL)
+			m_clients[i].resume(m_clients[i].ctx);
+	}
+	return elapsed;
+}
+
+void PowerManager::GetStats(PowerStats &stats, bool reset)
+{
+	stats = m_stats;
+	if (reset)
+		memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void PowerManager::Wakeup(LPTIM_HandleTypeDef *hlptim)
+{
+	if (Sleeping != NULL && Sleeping->m_hlptim == hlptim)
+		Sleeping->m_timeout = true;
+}
+
+extern "C" void HAL_LPTIM_AutoReloadMatchCallback(LPTIM_HandleTypeDef *hlptim)
+{
+	PowerManager::Wakeup(hlptim);
+}
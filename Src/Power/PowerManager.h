@@ -0,0 +1,123 @@
+/*
+ * PowerManager.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef POWER_POWERMANAGER_H_
+#define POWER_POWERMANAGER_H_
+
+#include <stdint.h>
+#include <stm32l4xx_hal.h>
+
+// maximum number of clients
+#define POWER_MAX_CLIENTS	6
+
+// idle time below which STOP1 or STOP2 is not worth its wake up, ms
+#define POWER_STOP_MIN_MS	10
+
+// woken this much before the deadline to restore the clocks, ms
+#define POWER_WAKE_MARGIN_MS	2
+
+// LPTIM1 runs from LSI / 32 = 1 kHz, 16 bit counter
+#define POWER_LPTIM_PRESCALER	LPTIM_PRESCALER_DIV32
+#define POWER_STOP_MAX_MS	0xFFFF
+
+// from light to deep, a deeper state keeps fewer peripherals running
+typedef enum {powerRun, powerSleep, powerStop1, powerStop2, powerStates} PowerStateEnum;
+
+// returns the deepest state the client can work with right now, e.g.
+// powerSleep during a transfer
+typedef PowerStateEnum (*PowerLimitFunc)(void *ctx);
+
+// called before entering and after leaving STOP1 or STOP2, e.g. to pause a
+// peripheral
+typedef void (*PowerFunc)(void *ctx);
+
+// time spent in each state, all in ms
+struct PowerStats
+{
+	uint32_t 	time[powerStates];
+	uint32_t 	entries[powerStates];
+	uint32_t 	vetoes;				// STOP2 refused by a client
+	uint32_t 	earlyWakes;			// STOP1 or STOP2 left before its timeout
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	class PowerManager
+//
+//	tickless idle for the scheduler loop. Idle() gets the time until the
+//	next task is due and spends it in the deepest state that fits: a short
+//	wait or a busy client gives SLEEP (the core stops, peripherals and
+//	SysTick run on), a long one gives STOP2 with LPTIM1 as wake up timer.
+//
+//	SysTick stops in STOP1 and STOP2, so the HAL tick is advanced by the
+//	time counted by LPTIM1 and the scheduler finds the tasks due as planned.
+//	The PLLs are off after a stop, the restore function passed to Begin()
+//	brings the system clock back (SystemClock_Config()).
+//
+//	Peripherals that do not work in STOP2 register as clients: they limit
+//	the state while busy and get a call before and after a stop. The UART
+//	of the WiFi module can wake the MCU from STOP1 but not from STOP2, so
+//	it limits an idle WiFi to STOP1.
+//
+class PowerManager
+{
+public:
+	PowerManager(LPTIM_HandleTypeDef *hlptim);
+
+	// switches LPTIM1 to LSI and its wake up interrupt on
+	bool Begin(PowerFunc restoreClock);
+
+	// returns the client id, -1 if there are POWER_MAX_CLIENTS already
+	int AddClient(const char *name, PowerLimitFunc limit, PowerFunc suspend = NULL,
+			PowerFunc resume = NULL, void *ctx = NULL);
+
+	// spends up to idleMs (the result of TaskScheduler::Run()) in a low power state
+	void Idle(uint32_t idleMs);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	static PowerStateEnum Plan(uint32_t idleMs, PowerStateEnum limit, uint32_t *stopMs);
+	//
+	//	picks the state for an idle time, limit is the deepest state all
+	//	clients allow
+	//
+	//	returns the state, *stopMs is the LPTIM1 timeout for powerStop1 and
+	//	powerStop2
+	//
+	static PowerStateEnum Plan(uint32_t idleMs, PowerStateEnum limit, uint32_t *stopMs);
+
+	// copies the time accounting, optionally starting over
+	void GetStats(PowerStats &stats, bool reset = false);
+
+	// called from the LPTIM1 auto reload match interrupt
+	static void Wakeup(LPTIM_HandleTypeDef *hlptim);
+
+private:
+	struct Client
+	{
+		const char 		*name;
+		PowerLimitFunc 	limit;
+		PowerFunc 		suspend;
+		PowerFunc 		resume;
+		void 			*ctx;
+	};
+
+	PowerStateEnum Limit(void);
+	bool SelectLsi(void);
+	uint32_t Stop(PowerStateEnum state, uint32_t stopMs);
+	uint32_t ReadCounter(void);
+
+	LPTIM_HandleTypeDef *m_hlptim;
+	PowerFunc 			m_restoreClock;
+
+	Client 				m_clients[POWER_MAX_CLIENTS];
+	int 				m_count;
+
+	volatile bool 		m_timeout;		// LPTIM1 reached the end of the stop
+	uint32_t 			m_runStart;		// tick when the last idle ended
+	PowerStats 			m_stats;
+};
+
+#endif /* POWER_POWERMANAGER_H_ */
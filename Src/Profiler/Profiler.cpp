@@ -0,0 +1,110 @@
+/*
+ * Profiler.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "Profiler.h"
+
+static ProfRegion *Regions = nullptr;
+
+void Profiler::Begin(void)
+{
+#ifdef __arm__
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+int Profiler::Bucket(uint32_t ticks)
+{
+	int n = (ticks == 0) ? 0 : 31 - __builtin_clz(ticks);
+
+	return (n < PROF_BUCKETS) ? n : PROF_BUCKETS - 1;
+}
+
+void Profiler::Add(ProfRegion &region, uint32_t ticks)
+{
+	if (!region.linked)
+	{
+		region.linked = true;
+		region.next = Regions;
+		Regions = &region;
+	}
+
+	region.count++;
+	region.sum += ticks;
+	if (ticks < region.min)
+		region.min = ticks;
+	if (ticks > region.max)
+		region.max = ticks;
+	region.hist[Bucket(ticks)]++;
+}
+
+void Profiler::Reset(void)
+{
+	for (ProfRegion *p = Regions; p != nullptr; p = p->next)
+	{
+		p->count = 0;
+		p->min = 0xFFFFFFFF;
+		p->max = 0;
+		p->sum = 0;
+		memset(p->hist, 0, sizeof(p->hist));
+	}
+}
+
+ProfRegion *Profiler::First(void)
+{
+	return Regions;
+}
+
+uint32_t Profiler::TicksPerUs(void)
+{
+#ifdef __arm__
+	return SystemCoreClock / 1000000;
+#else
+	return 1000;
+#endif
+}
+
+void Profiler::Dump(ProfOutput out, void *ctx, bool reset)
+{
+	uint32_t scale = TicksPerUs();
+	char line[160];
+
+	for (ProfRegion *p = Regions; p != nullptr; p = p->next)
+	{
+		if (p->count == 0)
+			continue;
+
+		// times in 0.1 us
+		uint32_t min = p->min * 10 / scale;
+		uint32_t mean = (uint32_t) (p->sum * 10 / p->count / scale);
+		uint32_t max = (uint32_t) ((uint64_t) p->max * 10 / scale);
+
+		int n = snprintf(line, sizeof(line),
+				"Prof %-12s n %6lu  min %lu.%lu  mean %lu.%lu  max %lu.%lu us",
+				p->name, (unsigned long) p->count, (unsigned long) min / 10,
+				(unsigned long) min % 10, (unsigned long) mean / 10,
+				(unsigned long) mean % 10, (unsigned long) max / 10,
+				(unsigned long) max % 10);
+		if (n >= (int) sizeof(line))
+			n = sizeof(line) - 1;
+
+		int first = Bucket(p->min);
+		int last = Bucket(p->max);
+
+		n += snprintf(line + n, sizeof(line) - n, "  2^%d:", first);
+		for (int b = first; b <= last && n < (int) sizeof(line); b++)
+			n += snprintf(line + n, sizeof(line) - n, " %lu", (unsigned long) p->hist[b]);
+
+		out(ctx, line);
+	}
+
+	if (reset)
+		Reset();
+}
@@ -0,0 +1,164 @@
+/*
+ * Profiler.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef PROFILER_PROFILER_H_
+#define PROFILER_PROFILER_H_
+
+#include <stdint.h>
+
+// probes are compiled in with PROFILE_ENABLED=1 (Debug configuration)
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED		0
+#endif
+
+// log2 histogram, bucket n counts the times of 2^n to 2^(n+1) - 1 ticks,
+// the last one everything above
+#define PROF_BUCKETS		24
+
+#ifdef __arm__
+#include <stm32l4xx_hal.h>
+
+// core clock cycles, runs while the core runs
+inline uint32_t ProfNow(void) { return DWT->CYCCNT; }
+
+// core clock cycles from the HAL tick and the SysTick counter. SysTick runs
+// on in SLEEP, and PowerManager catches the HAL tick up with the time LPTIM1
+// counted in STOP1 and STOP2, so this one goes on where DWT->CYCCNT stops
+// (WFI); the cost is two HAL tick reads per call
+inline uint32_t ProfWallNow(void)
+{
+	uint32_t tick, val;
+
+	// a SysTick reload between the two reads shows in the tick
+	do
+	{
+		tick = HAL_GetTick();
+		val = SysTick->VAL;
+	} while (tick != HAL_GetTick());
+
+	return tick * (SysTick->LOAD + 1) + (SysTick->LOAD - val);
+}
+#else
+#include <chrono>
+
+// ns on the host, for the same probes in host builds
+inline uint32_t ProfNow(void)
+{
+	return (uint32_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint32_t ProfWallNow(void) { return ProfNow(); }
+#endif
+
+// takes one line of a dump
+typedef void (*ProfOutput)(void *ctx, const char *line);
+
+// times of one named region, in ticks of ProfNow()
+struct ProfRegion
+{
+	// constant initialized, a static region costs no guard on entry
+	constexpr ProfRegion(const char *name) :
+			name(name), next(nullptr), linked(false), count(0), min(0xFFFFFFFF),
+			max(0), sum(0), hist{} {}
+
+	const char 	*name;
+	ProfRegion 	*next;
+	bool 		linked;
+	uint32_t 	count;
+	uint32_t 	min;
+	uint32_t 	max;
+	uint64_t 	sum;
+	uint32_t 	hist[PROF_BUCKETS];
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	class Profiler
+//
+//	cycle counts of named code regions. A region is a static ProfRegion at
+//	its probe, it joins the list for Dump() with its first time, so there is
+//	no table to size and no registration call.
+//
+//		PROFILE_SCOPE(name)			times the rest of the enclosing block
+//		PROFILE_STAMP(var)			stores the start of a region that ends
+//		PROFILE_SINCE(name, var)	somewhere else, e.g. in a callback
+//
+//	The cycle counter stops while the core sleeps, so these only time code
+//	that runs through. A region that can last over PowerManager::Idle(),
+//	e.g. a transfer that ends in an interrupt, takes the _WALL variants of
+//	the last two: they read ProfWallNow(), in the same ticks.
+//
+//	Without PROFILE_ENABLED the probes compile to nothing. The probes are
+//	meant for the main loop context, not for interrupt handlers.
+//
+class Profiler
+{
+public:
+	// starts the DWT cycle counter
+	static void Begin(void);
+
+	static void Add(ProfRegion &region, uint32_t ticks);
+
+	// clears the times of all regions, they stay in the list
+	static void Reset(void);
+
+	// first region in the list, follow next for the others
+	static ProfRegion *First(void);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	void Dump(ProfOutput out, void *ctx, bool reset);
+	//
+	//	writes a line per region: count, min / mean / max in us and the
+	//	histogram buckets from the first to the last used one
+	//
+	static void Dump(ProfOutput out, void *ctx, bool reset = false);
+
+	// ProfNow() ticks per us
+	static uint32_t TicksPerUs(void);
+
+	// histogram bucket of a time
+	static int Bucket(uint32_t ticks);
+};
+
+// times the rest of the block it is in
+class ProfScope
+{
+public:
+	ProfScope(ProfRegion &region) : m_region(region), m_start(ProfNow()) {}
+	~ProfScope() { Profiler::Add(m_region, ProfNow() - m_start); }
+
+private:
+	ProfRegion 	&m_region;
+	uint32_t 	m_start;
+};
+
+#define PROF_CONCAT_(a, b)		a##b
+#define PROF_CONCAT(a, b)		PROF_CONCAT_(a, b)
+
+#if PROFILE_ENABLED
+#define PROFILE_SCOPE(name) \
+	static ProfRegion PROF_CONCAT(profRegion, __LINE__)(name); \
+	ProfScope PROF_CONCAT(profScope, __LINE__)(PROF_CONCAT(profRegion, __LINE__))
+#define PROFILE_STAMP(var)			((var) = ProfNow())
+#define PROFILE_SINCE(name, var) do { \
+		static ProfRegion profRegion(name); \
+		Profiler::Add(profRegion, ProfNow() - (var)); \
+	} while (0)
+#define PROFILE_STAMP_WALL(var)		((var) = ProfWallNow())
+#define PROFILE_SINCE_WALL(name, var) do { \
+		static ProfRegion profRegion(name); \
+		Profiler::Add(profRegion, ProfWallNow() - (var)); \
+	} while (0)
+#else
+#define PROFILE_SCOPE(name)			do {} while (0)
+#define PROFILE_STAMP(var)			do {} while (0)
+#define PROFILE_SINCE(name, var)	do {} while (0)
+#define PROFILE_STAMP_WALL(var)		do {} while (0)
+#define PROFILE_SINCE_WALL(name, var)	do {} while (0)
+#endif
+
+#endif /* PROFILER_PROFILER_H_ */
@@ -0,0 +1,129 @@
+/*
+ * TaskScheduler.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <string.h>
+#include "TaskScheduler.h"
+
+TaskScheduler::TaskScheduler(SchedTickSource tick)
+{
+	m_tick = tick;
+	m_count = 0;
+	memset(m_tasks, 0, sizeof(m_tasks));
+}
+
+int TaskScheduler::Add(const char *name, SchedTaskFunc func, void *ctx, uint32_t delay)
+{
+	if (m_count >= SCHED_MAX_TASKS)
+		return -1;
+
+	Task *pTask = &m_tasks[m_count];
+
+	memset(pTask, 0, sizeof(Task));
+	pTask->func = func;
+	pTask->ctx = ctx;
+	pTask->due = m_tick() + delay;
+	pTask->active = true;
+	pTask->stats.name = name;
+
+	return m_count++;
+}
+
+void TaskScheduler::Wake(int id, uint32_t delay)
+{
+	if (id < 0 || id >= m_count)
+		return;
+
+	m_tasks[id].due = m_tick() + delay;
+	m_tasks[id].active = true;
+}
+
+// Finds the active task with the earliest due time and the ms until it is due,
+// the tick wraps around so times are compared as signed differences
+int TaskScheduler::NextDue(uint32_t now, uint32_t *wait)
+{
+	int next = -1;
+	int32_t nextDiff = 0;
+
+	for (int i = 0; i < m_count; i++)
+	{
+		if (!m_tasks[i].active)
+			continue;
+
+		int32_t diff = (int32_t) (m_tasks[i].due - now);
+		if (next < 0 || diff < nextDiff)
+		{
+			next = i;
+			nextDiff = diff;
+		}
+	}
+
+	*wait = (next < 0) ? SCHED_STOP : (nextDiff > 0 ? nextDiff : 0);
+	return next;
+}
+
+uint32_t TaskScheduler::Run()
+{
+	uint32_t wait;
+	uint32_t now = m_tick();
+
+	// at most one step per task and call on average, so a task that is
+	// always due cannot keep the caller from its own work
+	for (int n = 0; n < m_count; n++)
+	{
+		int id = NextDue(now, &wait);
+		if (id < 0 || wait > 0)
+			return wait;
+
+		Task *pTask = &m_tasks[id];
+		SchedStats *pStats = &pTask->stats;
+
+		uint32_t latency = now - pTask->due;
+		uint32_t jitter = (latency > pTask->lastLatency) ?
+				latency - pTask->lastLatency : pTask->lastLatency - latency;
+
+		if (pStats->runs > 0 && jitter > pStats->jitterMax)
+			pStats->jitterMax = jitter;
+		if (latency > pStats->latencyMax)
+			pStats->latencyMax = latency;
+		pStats->latencySum += latency;
+		pStats->runs++;
+		pTask->lastLatency = latency;
+
+		uint32_t delay = pTask->func(pTask->ctx);
+
+		uint32_t end = m_tick();
+		if (end - now > pStats->execMax)
+			pStats->execMax = end - now;
+
+		if (delay == SCHED_STOP)
+			pTask->active = false;
+		else
+			pTask->due = end + delay;
+
+		now = end;
+	}
+
+	NextDue(now, &wait);
+	return wait;
+}
+
+bool TaskScheduler::GetStats(int id, SchedStats &stats, bool reset)
+{
+	if (id < 0 || id >= m_count)
+		return false;
+
+	stats = m_tasks[id].stats;
+
+	if (reset)
+	{
+		const char *name = m_tasks[id].stats.name;
+
+		memset(&m_tasks[id].stats, 0, sizeof(SchedStats));
+		m_tasks[id].stats.name = name;
+	}
+	return true;
+}
@@ -0,0 +1,96 @@
+/*
+ * TaskScheduler.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef SCHEDULER_TASKSCHEDULER_H_
+#define SCHEDULER_TASKSCHEDULER_H_
+
+#include <stdint.h>
+
+// maximum number of tasks
+#define SCHED_MAX_TASKS		12
+
+// returned by a task that does not want to run again
+#define SCHED_STOP			0xFFFFFFFF
+
+// returns the current time in ms, e.g. HAL_GetTick
+typedef uint32_t (*SchedTickSource)(void);
+
+// one step of a task, returns the delay in ms until its next step or SCHED_STOP
+typedef uint32_t (*SchedTaskFunc)(void *ctx);
+
+// timing of one task, all values in ms
+struct SchedStats
+{
+	const char 	*name;
+	uint32_t 	runs;
+	uint32_t 	latencyMax;		// how late a step started after its due time
+	uint32_t 	latencySum;		// divided by runs gives the average
+	uint32_t 	jitterMax;		// largest change of the latency between two steps
+	uint32_t 	execMax;		// longest step
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	class TaskScheduler
+//
+//	cooperative scheduler for short task steps. A task is written as a state
+//	machine: each call does one step (start a conversion, fetch a result...)
+//	and returns how long to wait before the next one, so the wait of one
+//	task is spent running the others instead of in HAL_Delay().
+//
+//	The time comes from the tick source passed to the constructor, it does
+//	not touch any hardware and runs unchanged on the host with a fake clock.
+//
+class TaskScheduler
+{
+public:
+	TaskScheduler(SchedTickSource tick);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	int Add(const char *name, SchedTaskFunc func, void *ctx, uint32_t delay);
+	//
+	//	adds a task, its first step is due after delay ms
+	//
+	//	returns the task id, -1 if there are SCHED_MAX_TASKS tasks already
+	//
+	int Add(const char *name, SchedTaskFunc func, void *ctx, uint32_t delay = 0);
+
+	// makes the next step of a task due after delay ms, also restarts a stopped task
+	void Wake(int id, uint32_t delay = 0);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	uint32_t Run();
+	//
+	//	runs one step of every task that is due, earliest due time first
+	//
+	//	returns the ms until the next task is due, SCHED_STOP if there is none
+	//
+	uint32_t Run();
+
+	// copies the timing of a task, optionally starting over
+	bool GetStats(int id, SchedStats &stats, bool reset = false);
+
+	int Count() { return m_count; }
+
+private:
+	struct Task
+	{
+		SchedTaskFunc 	func;
+		void 			*ctx;
+		uint32_t 		due;
+		bool 			active;
+		uint32_t 		lastLatency;
+		SchedStats 		stats;
+	};
+
+	int NextDue(uint32_t now, uint32_t *wait);
+
+	SchedTickSource m_tick;
+	Task 			m_tasks[SCHED_MAX_TASKS];
+	int 			m_count;
+};
+
+#endif /* SCHEDULER_TASKSCHEDULER_H_ */
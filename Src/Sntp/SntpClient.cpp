@@ -0,0 +1,335 @@
+/*
+ * SntpClient.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <string.h>
+#include "SntpClient.h"
+
+// first byte: leap indicator, version, mode
+#define SNTP_LI_ALARM		0xC0			// server not synchronized
+#define SNTP_VERSION		(4 << 3)
+#define SNTP_MODE_CLIENT	3
+#define SNTP_MODE_SERVER	4
+
+// timestamps in the packet
+#define SNTP_RECEIVE		32
+#define SNTP_TRANSMIT		40
+#define SNTP_ORIGIN			24
+
+static uint64_t GetU64(const uint8_t *p)
+{
+	uint64_t v = 0;
+
+	for (int i = 0; i < 8; i++)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+static void PutU64(uint8_t *p, uint64_t v)
+{
+	for (int i = 7; i >= 0; i--, v >>= 8)
+		p[i] = v & 0xFF;
+}
+
+SntpClient::SntpClient(UDP *pUdp, WallClock *pClock, WallTickSource tick)
+{
+	m_pUdp = pUdp;
+	m_pClock = pClock;
+	m_tick = tick;
+	m_onSync = NULL;
+	m_ctx = NULL;
+	m_receiveTick = NULL;
+	m_receiveCtx = NULL;
+
+	m_count = 0;
+	m_port = 0;
+	m_open = false;
+
+	m_state = sntpIdle;
+	m_dueTick = tick();
+	m_server = 0;
+	m_sample = 0;
+	m_origin = 0;
+	m_t1 = 0;
+	m_sentTick = 0;
+	memset(m_best, 0, sizeof(m_best));
+
+	m_synced = false;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool SntpClient::AddServer(const char *host)
+{
+	if (m_count >= SNTP_MAX_SERVERS)
+		return false;
+
+	m_servers[m_count++] = host;
+	return true;
+}
+
+void SntpClient::SetSyncHandler(SntpSyncHandler handler, void *ctx)
+{
+	m_onSync = handler;
+	m_ctx = ctx;
+}
+
+void SntpClient::SetReceiveTick(SntpReceiveTick receiveTick, void *ctx)
+{
+	m_receiveTick = receiveTick;
+	m_receiveCtx = ctx;
+}
+
+void SntpClient::Begin(uint16_t localPort)
+{
+	m_port = localPort;
+	Sync();
+}
+
+void SntpClient::Sync(void)
+{
+	if (m_state == sntpIdle)
+		m_dueTick = m_tick();
+}
+
+void SntpClient::GetStats(SntpStats &stats, bool reset)
+{
+	stats = m_stats;
+	if (reset)
+	{
+		memset(&m_stats, 0, sizeof(m_stats));
+		m_stats.lastOffset = stats.lastOffset;
+		m_stats.lastDelay = stats.lastDelay;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// state machine
+
+uint32_t SntpClient::Poll(void)
+{
+	uint32_t now = m_tick();
+
+	if ((int32_t) (m_dueTick - now) > 0)
+		return m_dueTick - now;
+
+	switch (m_state)
+	{
+	case sntpIdle:
+		if (m_count == 0)
+			return SNTP_INTERVAL_MS;
+
+		m_server = 0;
+		m_sample = 0;
+		memset(m_best, 0, sizeof(m_best));
+		m_state = sntpSend;
+		// fall through
+
+	case sntpSend:
+	{
+		uint8_t pkt[SNTP_PACKET_SIZE];
+
+		if (!m_open)
+			m_open = m_pUdp->begin(m_port);
+		if (!m_open)
+			return Finish();
+
+		// drop late replies to earlier requests
+		while (m_pUdp->parsePacket() > 0)
+			m_pUdp->flush();
+
+		m_origin = ToNtp(m_pClock->Now());
+		BuildRequest(pkt, m_origin);
+
+		m_stats.requests++;
+		if (!m_pUdp->beginPacket(m_servers[m_server], SNTP_PORT)
+				|| m_pUdp->write(pkt, sizeof(pkt)) != sizeof(pkt)
+				|| !m_pUdp->endPacket())
+		{
+			m_stats.timeouts++;
+			NextRequest();
+			break;
+		}
+
+		m_t1 = m_pClock->Now();
+		m_sentTick = m_tick();
+		m_state = sntpWait;
+		return SNTP_POLL_MS;
+	}
+
+	case sntpWait:
+	{
+		uint8_t pkt[SNTP_PACKET_SIZE];
+		SntpSample sample;
+
+		if (m_pUdp->parsePacket() >= SNTP_PACKET_SIZE)
+		{
+			int64_t t4 = m_pClock->Now();
+
+			// back to when the reply came in
+			if (m_receiveTick != NULL)
+				t4 -= (int32_t) (m_tick() - m_receiveTick(m_receiveCtx));
+
+			int len = m_pUdp->read(pkt, sizeof(pkt));
+
+			m_pUdp->flush();
+			if (!ParseReply(pkt, len, m_origin, m_t1, t4, sample))
+			{
+				m_stats.rejected++;
+				return SNTP_POLL_MS;
+			}
+
+			SntpSample &best = m_best[m_server];
+			if (!best.valid || sample.delay < best.delay)
+				best = sample;
+		}
+		else if ((now - m_sentTick) > SNTP_TIMEOUT_MS)
+			m_stats.timeouts++;
+		else
+			return SNTP_POLL_MS;
+
+		NextRequest();
+		break;
+	}
+	}
+
+	if (m_state == sntpIdle)
+		return Finish();
+
+	m_dueTick = m_tick() + SNTP_SPACING_MS;
+	return SNTP_SPACING_MS;
+}
+
+// moves on to the next sample or server, back to idle after the last one
+void SntpClient::NextRequest(void)
+{
+	m_state = sntpSend;
+	if (++m_sample < SNTP_SAMPLES)
+		return;
+
+	m_sample = 0;
+	if (++m_server < m_count)
+		return;
+
+	m_state = sntpIdle;
+}
+
+// applies the round's result and schedules the next one
+uint32_t SntpClient::Finish(void)
+{
+	int64_t offset;
+	uint32_t delay = SNTP_RETRY_MS;
+
+	m_state = sntpIdle;
+
+	if (Combine(m_best, m_count, &offset))
+	{
+		m_pClock->Discipline(offset);
+		m_synced = true;
+		m_stats.syncs++;
+		m_stats.lastOffset = offset;
+		for (int i = 0; i < m_count; i++)
+		{
+			if (m_best[i].valid)
+			{
+				m_stats.lastDelay = m_best[i].delay;
+				break;
+			}
+		}
+		delay = SNTP_INTERVAL_MS;
+
+		if (m_onSync != NULL)
+			m_onSync(m_ctx, offset);
+	}
+	else
+		m_stats.failures++;
+
+	m_dueTick = m_tick() + delay;
+	return delay;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// protocol
+
+uint64_t SntpClient::ToNtp(int64_t epochMs)
+{
+	uint64_t secs = epochMs / 1000 + SNTP_UNIX_OFFSET;
+	uint64_t frac = ((uint64_t) (epochMs % 1000) << 32) / 1000;
+
+	return (secs << 32) | frac;
+}
+
+int64_t SntpClient::FromNtp(uint64_t ntp)
+{
+	int64_t secs = ntp >> 32;
+	uint64_t frac = ntp & 0xFFFFFFFF;
+
+	// era 1 starts in 2036, the seconds then restart from 0
+	if (secs < 0x80000000LL)
+		secs += 0x100000000LL;
+
+	return (secs - SNTP_UNIX_OFFSET) * 1000 + (int64_t) ((frac * 1000 + 0x80000000) >> 32);
+}
+
+void SntpClient::BuildRequest(uint8_t *pkt, uint64_t transmit)
+{
+	memset(pkt, 0, SNTP_PACKET_SIZE);
+	pkt[0] = SNTP_VERSION | SNTP_MODE_CLIENT;
+	PutU64(pkt + SNTP_TRANSMIT, transmit);
+}
+
+bool SntpClient::ParseReply(const uint8_t *pkt, int len, uint64_t origin, int64_t t1,
+		int64_t t4, SntpSample &sample)
+{
+	sample.valid = false;
+
+	if (len < SNTP_PACKET_SIZE)
+		return false;
+	if ((pkt[0] & 0x07) != SNTP_MODE_SERVER || (pkt[0] & 0x38) == 0
+			|| (pkt[0] & SNTP_LI_ALARM) == SNTP_LI_ALARM)
+		return false;
+	// stratum 0 is a kiss of death, 16 unsynchronized
+	if (pkt[1] == 0 || pkt[1] > 15)
+		return false;
+	if (GetU64(pkt + SNTP_ORIGIN) != origin || GetU64(pkt + SNTP_TRANSMIT) == 0)
+		return false;
+
+	int64_t t2 = FromNtp(GetU64(pkt + SNTP_RECEIVE));
+	int64_t t3 = FromNtp(GetU64(pkt + SNTP_TRANSMIT));
+	int64_t delay = (t4 - t1) - (t3 - t2);
+	int64_t offset = ((t2 - t1) + (t3 - t4)) / 2;
+
+	if (delay < 0 || delay > SNTP_MAX_DELAY_MS || t3 < t2)
+		return false;
+	sample.valid = true;
+	sample.offset = offset;
+	sample.delay = (int32_t) delay;
+	sample.stratum = pkt[1];
+	return true;
+}
+
+bool SntpClient::Combine(const SntpSample *samples, int count, int64_t *offset)
+{
+	int64_t sorted[SNTP_MAX_SERVERS];
+	int n = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		if (!samples[i].valid)
+			continue;
+
+		// insertion sort, there are a few at most
+		int j = n++;
+		for (; j > 0 && sorted[j - 1] > samples[i].offset; j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = samples[i].offset;
+	}
+
+	if (n == 0)
+		return false;
+
+	*offset = (n & 1) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+	return true;
+}
@@ -0,0 +1,165 @@
+/*
+ * SntpClient.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef SNTP_SNTPCLIENT_H_
+#define SNTP_SNTPCLIENT_H_
+
+#include <stdint.h>
+#include <Udp.h>
+#include "WallClock.h"
+
+#define SNTP_PORT			123
+#define SNTP_PACKET_SIZE	48
+#define SNTP_MAX_SERVERS	4
+#define SNTP_SAMPLES		4			// requests per server, the fastest reply counts
+#define SNTP_SPACING_MS		2000		// between two requests, servers rate limit
+#define SNTP_TIMEOUT_MS		1500
+#define SNTP_POLL_MS		2			// checks for the reply, sets the receive time error
+#define SNTP_MAX_DELAY_MS	1000		// round trips above are not trusted
+#define SNTP_INTERVAL_MS	3600000
+#define SNTP_RETRY_MS		60000
+
+// seconds from 1900 (NTP era 0) to 1970
+#define SNTP_UNIX_OFFSET	2208988800UL
+
+// called after each successful sync with the offset applied
+typedef void (*SntpSyncHandler)(void *ctx, int64_t offsetMs);
+
+// tick source value at which the datagram last returned by parsePacket()
+// was received
+typedef uint32_t (*SntpReceiveTick)(void *ctx);
+
+// result of one request
+struct SntpSample
+{
+	bool 		valid;
+	int64_t 	offset;			// ms, server - local
+	int32_t 	delay;			// ms, round trip without the server's time
+	uint8_t 	stratum;
+};
+
+struct SntpStats
+{
+	uint32_t 	syncs;
+	uint32_t 	failures;		// rounds without a usable reply
+	uint32_t 	requests;
+	uint32_t 	timeouts;
+	uint32_t 	rejected;		// replies that failed the checks
+	int64_t 	lastOffset;		// ms
+	int32_t 	lastDelay;		// ms, of the best sample of the first server used
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	class SntpClient
+//
+//	SNTP (RFC 4330) as a state machine, Poll() sends a request or checks for
+//	the reply and returns at once. Each sync round asks every server
+//	SNTP_SAMPLES times, spaced out, and keeps the reply with the shortest
+//	round trip of each: the queueing delays are the main error and the
+//	fastest exchange has the least of them. The clock is then disciplined
+//	by the median offset of the servers, so that one wrong server cannot
+//	pull it away.
+//
+//	With t1 the local send time, t2 and t3 the server's receive and transmit
+//	times and t4 the local receive time:
+//
+//		offset = ((t2 - t1) + (t3 - t4)) / 2
+//		delay  = (t4 - t1) - (t3 - t2)
+//
+//	t1 is taken when endPacket() returns, after the datagram is out. t4 is
+//	the time the reply was received if the UDP can tell (SetReceiveTick()),
+//	otherwise when Poll() finds it, so that the poll period adds to the
+//	error.
+//
+class SntpClient
+{
+public:
+	SntpClient(UDP *pUdp, WallClock *pClock, WallTickSource tick);
+
+	// adds a server address, returns false if there are SNTP_MAX_SERVERS
+	bool AddServer(const char *host);
+
+	void SetSyncHandler(SntpSyncHandler handler, void *ctx);
+
+	// gives the receive time of a reply, in ticks of the tick source
+	void SetReceiveTick(SntpReceiveTick receiveTick, void *ctx);
+
+	// local port of the socket, it is opened with the first request
+	void Begin(uint16_t localPort);
+
+	// starts a sync round now
+	void Sync(void);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	uint32_t Poll();
+	//
+	//	runs one step of the sync round, call it while the network is up
+	//
+	//	returns the ms until the next step is due
+	//
+	uint32_t Poll(void);
+
+	bool IsSynced(void) { return m_synced; }
+
+	void GetStats(SntpStats &stats, bool reset = false);
+
+	//////////////////////////////// protocol //////////////////////////////////
+
+	static uint64_t ToNtp(int64_t epochMs);
+	static int64_t FromNtp(uint64_t ntp);
+
+	// fills a client request carrying the transmit time
+	static void BuildRequest(uint8_t *pkt, uint64_t transmit);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	static bool ParseReply(pkt, len, origin, t1, t4, sample);
+	//
+	//	checks a reply against the request with transmit time origin and
+	//	computes offset and delay, t1 and t4 in epoch ms
+	//
+	//	returns false if the reply is not usable (kiss of death, unsynchronized
+	//	server, not an answer to our request...)
+	//
+	static bool ParseReply(const uint8_t *pkt, int len, uint64_t origin, int64_t t1,
+			int64_t t4, SntpSample &sample);
+
+	// median offset of the valid samples, returns false if there is none
+	static bool Combine(const SntpSample *samples, int count, int64_t *offset);
+
+private:
+	enum SntpState {sntpIdle, sntpSend, sntpWait};
+
+	void NextRequest(void);
+	uint32_t Finish(void);
+
+	UDP 			*m_pUdp;
+	WallClock 		*m_pClock;
+	WallTickSource 	m_tick;
+	SntpSyncHandler m_onSync;
+	void 			*m_ctx;
+	SntpReceiveTick m_receiveTick;
+	void 			*m_receiveCtx;
+
+	const char 		*m_servers[SNTP_MAX_SERVERS];
+	int 			m_count;
+	uint16_t 		m_port;
+	bool 			m_open;
+
+	SntpState 		m_state;
+	uint32_t 		m_dueTick;		// next step
+	int 			m_server;
+	int 			m_sample;
+	uint64_t 		m_origin;		// transmit time of the request out
+	int64_t 		m_t1;
+	uint32_t 		m_sentTick;
+	SntpSample 		m_best[SNTP_MAX_SERVERS];
+
+	bool 			m_synced;
+	SntpStats 		m_stats;
+};
+
+#endif /* SNTP_SNTPCLIENT_H_ */
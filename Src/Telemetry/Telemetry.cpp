@@ -0,0 +1,116 @@
+/*
+ * Telemetry.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <string.h>
+#include "Telemetry.h"
+#include "VarintCodec.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// encoder
+
+TelemetryEncoder::TelemetryEncoder()
+{
+	m_seq = 0;
+	m_sinceKey = TLM_KEY_INTERVAL;
+	memset(&m_last, 0, sizeof(m_last));
+}
+
+int TelemetryEncoder::Encode(const TelemetrySample &sample, uint8_t *buf, int size)
+{
+	bool key = (m_sinceKey >= TLM_KEY_INTERVAL || sample.count != m_last.count);
+	int n = 0;
+
+	if (sample.count > TLM_MAX_FIELDS || size < TLM_MAX_FRAME)
+		return 0;
+
+	buf[n++] = TLM_VERSION;
+	buf[n++] = key ? TLM_FLAG_KEY : 0;
+	buf[n++] = m_seq;
+
+	n += VarintPut(buf + n, key ? sample.time : ZigZagEncode(sample.time - m_last.time));
+	buf[n++] = sample.count;
+
+	for (int i = 0; i < sample.count; i++)
+	{
+		uint32_t v = (uint32_t) sample.values[i];
+		if (!key)
+			v -= (uint32_t) m_last.values[i];
+		n += VarintPut(buf + n, ZigZagEncode(v));
+	}
+
+	uint16_t crc = Crc16Ccitt(buf, n);
+	buf[n++] = crc & 0xFF;
+	buf[n++] = crc >> 8;
+
+	m_seq++;
+	m_sinceKey = key ? 1 : m_sinceKey + 1;
+	m_last = sample;
+	return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// decoder
+
+TelemetryDecoder::TelemetryDecoder()
+{
+	m_based = false;
+	m_seq = 0;
+	memset(&m_last, 0, sizeof(m_last));
+}
+
+int TelemetryDecoder::Decode(const uint8_t *buf, int len, TelemetrySample &sample)
+{
+	uint32_t v;
+	int n, pos = TLM_HEADER;
+
+	if (len < TLM_HEADER + 2 + 2)
+		return TLM_ERR_FORMAT;
+	if (Crc16Ccitt(buf, len - 2) != (buf[len - 2] | (buf[len - 1] << 8)))
+		return TLM_ERR_CRC;
+	if (buf[0] != TLM_VERSION)
+		return TLM_ERR_VERSION;
+
+	len -= 2;
+	bool key = (buf[1] & TLM_FLAG_KEY) != 0;
+
+	// a delta needs the frame right before it
+	if (!key && (!m_based || buf[2] != (uint8_t) (m_seq + 1)))
+	{
+		m_based = false;
+		return TLM_ERR_BASE;
+	}
+
+	if ((n = VarintGet(buf + pos, len - pos, &v)) == 0)
+		return TLM_ERR_FORMAT;
+	pos += n;
+	sample.time = key ? v : m_last.time + ZigZagDecode(v);
+
+	if (pos >= len)
+		return TLM_ERR_FORMAT;
+	sample.count = buf[pos++];
+	if (sample.count > TLM_MAX_FIELDS || (!key && sample.count != m_last.count))
+		return TLM_ERR_FORMAT;
+
+	for (int i = 0; i < sample.count; i++)
+	{
+		if ((n = VarintGet(buf + pos, len - pos, &v)) == 0)
+			return TLM_ERR_FORMAT;
+		pos += n;
+
+		v = ZigZagDecode(v);
+		if (!key)
+			v += (uint32_t) m_last.values[i];
+		sample.values[i] = (int32_t) v;
+	}
+	if (pos != len)
+		return TLM_ERR_FORMAT;
+
+	m_based = true;
+	m_seq = buf[2];
+	m_last = sample;
+	return TLM_OK;
+}
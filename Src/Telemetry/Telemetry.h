@@ -0,0 +1,113 @@
+/*
+ * Telemetry.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef TELEMETRY_TELEMETRY_H_
+#define TELEMETRY_TELEMETRY_H_
+
+#include <stdint.h>
+
+// frame header: version, flags and sequence number
+#define TLM_VERSION			1
+#define TLM_HEADER			3
+#define TLM_FLAG_KEY		0x01			// full values, no base needed
+
+#define TLM_MAX_FIELDS		16
+#define TLM_MAX_FRAME		(TLM_HEADER + 5 + 1 + 5 * TLM_MAX_FIELDS + 2)
+#define TLM_KEY_INTERVAL	16				// a key frame at least every n frames
+
+// decoder results
+#define TLM_OK				0
+#define TLM_ERR_CRC			-1
+#define TLM_ERR_VERSION		-2
+#define TLM_ERR_FORMAT		-3
+#define TLM_ERR_BASE		-4				// delta without the frame before it
+
+// station values in fixed point, in frame order
+enum TlmField
+{
+	TLM_BATTERY_VOLTAGE,		// mV
+	TLM_BATTERY_CURRENT,		// mA, negative while discharging
+	TLM_STATE_OF_CHARGE,		// %
+	TLM_REMAINING_CAPACITY,		// mAh
+	TLM_FULL_CAPACITY,			// mAh
+	TLM_INPUT_VOLTAGE,			// mV
+	TLM_BATTERY_TEMP,			// 0.1 C
+	TLM_BMP_TEMP,				// 0.1 C
+	TLM_BMP_PRESSURE,			// Pa
+	TLM_DHT_TEMP,				// 0.1 C
+	TLM_DHT_HUMIDITY,			// 0.1 %
+	TLM_MCU_TEMP,				// 0.1 C
+	TLM_WIND_VOLTAGE,			// mV
+	TLM_RAIN_VOLTAGE,			// mV
+	TLM_FIELDS
+};
+
+// one station sample
+struct TelemetrySample
+{
+	uint32_t 	time;			// s
+	uint8_t 	count;
+	int32_t 	values[TLM_MAX_FIELDS];
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	class TelemetryEncoder
+//
+//	packs samples into self contained binary frames for the uplink:
+//
+//		version, flags, sequence number
+//		time as varint, absolute or zig-zag change
+//		count of values
+//		values as zig-zag varints, absolute or change
+//		CRC-16 of all of the above, low byte first
+//
+//	A key frame holds the absolute values, the frames after it only the
+//	change from the frame before, which takes a byte for most of the slowly
+//	moving weather values. The sequence number lets the receiver notice a
+//	lost frame; it then waits for the next key frame, one comes at least
+//	every TLM_KEY_INTERVAL frames or after ForceKey().
+//
+class TelemetryEncoder
+{
+public:
+	TelemetryEncoder();
+
+	// encodes sample into buf, returns the frame length or 0 if it did not fit
+	int Encode(const TelemetrySample &sample, uint8_t *buf, int size);
+
+	// the next frame is a key frame, e.g. after a failed send
+	void ForceKey(void) { m_sinceKey = TLM_KEY_INTERVAL; }
+
+private:
+	uint8_t 		m_seq;
+	int 			m_sinceKey;		// delta frames since the last key frame
+	TelemetrySample m_last;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	class TelemetryDecoder
+//
+//	the receiving side, keeps the last frame as base for the deltas
+//
+class TelemetryDecoder
+{
+public:
+	TelemetryDecoder();
+
+	// decodes one frame into sample, returns TLM_OK or a TLM_ERR_ code
+	int Decode(const uint8_t *buf, int len, TelemetrySample &sample);
+
+	// forgets the base, deltas are refused until the next key frame
+	void Reset(void) { m_based = false; }
+
+private:
+	bool 			m_based;
+	uint8_t 		m_seq;
+	TelemetrySample m_last;
+};
+
+#endif /* TELEMETRY_TELEMETRY_H_ */
@@ -0,0 +1,78 @@
+/*
+ * VarintCodec.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef TELEMETRY_VARINTCODEC_H_
+#define TELEMETRY_VARINTCODEC_H_
+
+#include <stdint.h>
+
+// longest varint of a 32 bit value
+#define VARINT_MAX_LEN	5
+
+//////////////////////////////////////////////////////////////////////////////
+//	variable length integers, 7 bits per byte with the top bit set on all
+//	bytes but the last, low bits first. Signed values go through zig-zag
+//	first so that small magnitudes of either sign stay short.
+//
+//	Shared by the flash log and the telemetry frames, no hardware involved.
+//
+
+// returns the number of bytes written to buf
+inline int VarintPut(uint8_t *buf, uint32_t value)
+{
+	int n = 0;
+
+	while (value >= 0x80)
+	{
+		buf[n++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	buf[n++] = value;
+	return n;
+}
+
+// returns the number of bytes read, 0 if buf ends within the value
+inline int VarintGet(const uint8_t *buf, int len, uint32_t *value)
+{
+	uint32_t v = 0;
+
+	for (int n = 0; n < len && n < VARINT_MAX_LEN; n++)
+	{
+		v |= (uint32_t) (buf[n] & 0x7F) << (7 * n);
+		if (!(buf[n] & 0x80))
+		{
+			*value = v;
+			return n + 1;
+		}
+	}
+	return 0;
+}
+
+// 0, -1, 1, -2... to 0, 1, 2, 3...; works on differences that wrapped
+inline uint32_t ZigZagEncode(uint32_t v)
+{
+	return (v << 1) ^ (uint32_t) ((int32_t) v >> 31);
+}
+
+inline uint32_t ZigZagDecode(uint32_t v)
+{
+	return (v >> 1) ^ (uint32_t) -(int32_t) (v & 1);
+}
+
+// CRC-16/CCITT, polynomial 0x1021; chain blocks by passing the last result
+inline uint16_t Crc16Ccitt(const uint8_t *data, int len, uint16_t crc = 0xFFFF)
+{
+	for (int i = 0; i < len; i++)
+	{
+		crc ^= data[i] << 8;
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+#endif /* TELEMETRY_VARINTCODEC_H_ */
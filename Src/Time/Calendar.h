@@ -0,0 +1,173 @@
+/*
+ * Calendar.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef TIME_CALENDAR_H_
+#define TIME_CALENDAR_H_
+
+#include <stdint.h>
+
+#define SECS_PER_DAY		86400L
+
+// broken down UTC time
+struct CalendarTime
+{
+	uint16_t 	year;			// 1970...
+	uint8_t 	month;			// 1-12
+	uint8_t 	day;			// 1-31
+	uint8_t 	hour;
+	uint8_t 	minute;
+	uint8_t 	second;
+	uint8_t 	weekday;		// 0 = Sunday
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	conversions between days since 1970-01-01 and the Gregorian calendar
+//	without loops or tables: the year is shifted to start in March, so that
+//	the leap day comes last, and counted in 400 year eras of 146097 days.
+//	Valid for every date from 1970 on, no hardware involved.
+//
+
+inline int32_t DaysFromCivil(int y, unsigned m, unsigned d)
+{
+	y -= m <= 2;
+	int era = (y >= 0 ? y : y - 399) / 400;
+	unsigned yoe = (unsigned) (y - era * 400);						// 0-399
+	unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;	// 0-365
+	unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;			// 0-146096
+
+	return era * 146097 + (int32_t) doe - 719468;
+}
+
+inline void CivilFromDays(int32_t days, int *y, unsigned *m, unsigned *d)
+{
+	days += 719468;
+	int era = (days >= 0 ? days : days - 146096) / 146097;
+	unsigned doe = (unsigned) (days - era * 146097);
+	unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	unsigned mp = (5 * doy + 2) / 153;
+
+	*d = doy - (153 * mp + 2) / 5 + 1;
+	*m = mp < 10 ? mp + 3 : mp - 9;
+	*y = (int) yoe + era * 400 + (*m <= 2);
+}
+
+// seconds since 1970 to calendar
+inline void EpochToCalendar(uint32_t epoch, CalendarTime &cal)
+{
+	int32_t days = epoch / SECS_PER_DAY;
+	uint32_t secs = epoch % SECS_PER_DAY;
+	int y;
+	unsigned m, d;
+
+	CivilFromDays(days, &y, &m, &d);
+	cal.year = y;
+	cal.month = m;
+	cal.day = d;
+	cal.hour = secs / 3600;
+	cal.minute = secs / 60 % 60;
+	cal.second = secs % 60;
+	cal.weekday = (days + 4) % 7;			// 1970-01-01 was a Thursday
+}
+
+// calendar to seconds since 1970, the weekday is ignored
+inline uint32_t CalendarToEpoch(const CalendarTime &cal)
+{
+	return (uint32_t) DaysFromCivil(cal.year, cal.month, cal.day) * SECS_PER_DAY
+			+ cal.hour * 3600L + cal.minute * 60 + cal.second;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	class CalendarCache
+//
+//	EpochToCalendar() for a clock that is asked many times per second: the
+//	last result is kept, within the same day only the time of day is
+//	worked out again.
+//
+class CalendarCache
+{
+public:
+	CalendarCache() : m_epoch(0), m_day(-1) {}
+
+	const CalendarTime &Get(uint32_t epoch)
+	{
+		int32_t day = epoch / SECS_PER_DAY;
+
+		if (day != m_day)
+		{
+			EpochToCalendar(epoch, m_cal);
+			m_day = day;
+		}
+		else if (epoch != m_epoch)
+		{
+			uint32_t secs = epoch % SECS_PER_DAY;
+
+			m_cal.hour = secs / 3600;
+			m_cal.minute = secs / 60 % 60;
+			m_cal.second = secs % 60;
+		}
+		m_epoch = epoch;
+		return m_cal;
+	}
+
+private:
+	CalendarTime 	m_cal;
+	uint32_t 		m_epoch;
+	int32_t 		m_day;
+};
+
+// fields compared by a calendar alarm
+#define ALARM_MATCH_SECOND	0x01
+#define ALARM_MATCH_MINUTE	0x02
+#define ALARM_MATCH_HOUR	0x04
+#define ALARM_MATCH_DAY		0x08
+
+// the same day of the month comes back after 28 days at the earliest
+#define ALARM_MAX_DELAY		(28 * SECS_PER_DAY - 1)
+
+// alarm of an RTC that fires when all enabled fields match the time
+struct CalendarAlarm
+{
+	uint8_t 	second;
+	uint8_t 	minute;
+	uint8_t 	hour;
+	uint8_t 	day;			// of the month
+	uint8_t 	match;			// ALARM_MATCH_* of the enabled fields
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	Sets up alarm to fire delay s after now. The fields are those of the
+//	target time, and only as many of them are enabled as it takes for the
+//	target to be their first match after now: the seconds alone repeat
+//	every minute, with the minutes every hour and so on. Delays from 1 s to
+//	ALARM_MAX_DELAY, others are clamped. Returns the delay set up.
+//
+inline uint32_t CalendarAlarmIn(uint32_t now, uint32_t delay, CalendarAlarm &alarm)
+{
+	CalendarTime cal;
+
+	if (delay < 1)
+		delay = 1;
+	else if (delay > ALARM_MAX_DELAY)
+		delay = ALARM_MAX_DELAY;
+
+	EpochToCalendar(now + delay, cal);
+	alarm.second = cal.second;
+	alarm.minute = cal.minute;
+	alarm.hour = cal.hour;
+	alarm.day = cal.day;
+	alarm.match = ALARM_MATCH_SECOND;
+	if (delay >= 60)
+		alarm.match |= ALARM_MATCH_MINUTE;
+	if (delay >= 3600)
+		alarm.match |= ALARM_MATCH_HOUR;
+	if (delay >= SECS_PER_DAY)
+		alarm.match |= ALARM_MATCH_DAY;
+	return delay;
+}
+
+#endif /* TIME_CALENDAR_H_ */
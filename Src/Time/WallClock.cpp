@@ -0,0 +1,87 @@
+/*
+ * WallClock.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include "WallClock.h"
+
+WallClock::WallClock(WallTickSource tick)
+{
+	m_tick = tick;
+	m_lastTick = tick();
+	m_us = 0;
+	m_slewUs = 0;
+	m_ppm = 0;
+	m_ppmRest = 0;
+	m_set = false;
+	m_lastSync = 0;
+}
+
+int64_t WallClock::Now(void)
+{
+	uint32_t tick = m_tick();
+	int64_t elapsed = (uint32_t) (tick - m_lastTick);
+
+	m_lastTick = tick;
+	if (elapsed == 0)
+		return m_us / 1000;
+
+	// ms * ppm gives ns, the rest below 1 us is carried over
+	int64_t ns = elapsed * m_ppm + m_ppmRest;
+	int64_t us = elapsed * 1000 + ns / 1000;
+
+	m_ppmRest = ns % 1000;
+	int64_t max = elapsed * WALL_SLEW_PPM / 1000;
+	int64_t slew = m_slewUs;
+
+	if (slew > max)
+		slew = max;
+	else if (slew < -max)
+		slew = -max;
+	m_slewUs -= slew;
+
+	m_us += us + slew;
+	return m_us / 1000;
+}
+
+void WallClock::Set(int64_t epochMs)
+{
+	Now();
+	m_us = epochMs * 1000;
+	m_slewUs = 0;
+	m_set = true;
+}
+
+void WallClock::Discipline(int64_t offsetMs)
+{
+	int64_t now = Now();
+
+	if (!m_set || offsetMs > WALL_STEP_MS || offsetMs < -WALL_STEP_MS)
+	{
+		// too far off to trust the interval for a frequency estimate
+		Set(now + offsetMs);
+		m_lastSync = now + offsetMs;
+		return;
+	}
+
+	// the offset gathered since the last sync, less what was still to slew
+	// in from then, is the frequency error
+	if (m_lastSync != 0 && now > m_lastSync)
+	{
+		int64_t drift = offsetMs * 1000 - m_slewUs;
+		int64_t ppm = drift * 1000 / (now - m_lastSync);
+		int64_t half = (1 << WALL_FREQ_GAIN) / 2;
+
+		// rounded, a truncated step would stall a few ppm short
+		m_ppm += (int32_t) ((ppm + (ppm < 0 ? -half : half)) / (1 << WALL_FREQ_GAIN));
+		if (m_ppm > WALL_MAX_PPM)
+			m_ppm = WALL_MAX_PPM;
+		else if (m_ppm < -WALL_MAX_PPM)
+			m_ppm = -WALL_MAX_PPM;
+	}
+
+	m_slewUs = offsetMs * 1000;
+	m_lastSync = now;
+}
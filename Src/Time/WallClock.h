@@ -0,0 +1,72 @@
+/*
+ * WallClock.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef TIME_WALLCLOCK_H_
+#define TIME_WALLCLOCK_H_
+
+#include <stdint.h>
+
+// offsets beyond this are stepped, smaller ones slewed
+#define WALL_STEP_MS		1000
+// fastest slew: 5 ms per s
+#define WALL_SLEW_PPM		5000
+// the tick runs from HSI16, in STOP2 from the LSI, both are off by up to a few %
+#define WALL_MAX_PPM		50000
+// share of a measured frequency error applied per sync, as a shift
+#define WALL_FREQ_GAIN		2
+
+// returns the current time in ms, e.g. HAL_GetTick
+typedef uint32_t (*WallTickSource)(void);
+
+//////////////////////////////////////////////////////////////////////////////
+//	class WallClock
+//
+//	UTC in ms, extrapolated from the tick. The tick goes on through STOP2
+//	(the power manager adds the LPTIM time), so the clock keeps running at
+//	ms resolution in all modes, just with the error of the oscillators.
+//
+//	Discipline(offset) corrects it from a time source such as SNTP: a large
+//	offset is stepped, a small one slewed at WALL_SLEW_PPM so the time never
+//	jumps back, and each offset also trims the frequency correction by the
+//	rate it implies since the last sync.
+//
+//	Now() must be called at least once per 49 days, the tick wraps.
+//
+class WallClock
+{
+public:
+	WallClock(WallTickSource tick);
+
+	// ms since 1970, counts from 0 until the clock is set
+	int64_t Now(void);
+
+	// s since 1970
+	uint32_t Seconds(void) { return (uint32_t) (Now() / 1000); }
+
+	bool IsSet(void) { return m_set; }
+
+	// steps to a time, e.g. from the RTC
+	void Set(int64_t epochMs);
+
+	// corrects by the measured offset (true time - Now()) in ms
+	void Discipline(int64_t offsetMs);
+
+	// frequency correction in use
+	int32_t GetPpm(void) { return m_ppm; }
+
+private:
+	WallTickSource 	m_tick;
+	uint32_t 		m_lastTick;
+	int64_t 		m_us;			// time at m_lastTick in us
+	int64_t 		m_slewUs;		// offset still to slew in
+	int32_t 		m_ppm;
+	int32_t 		m_ppmRest;		// ns of the correction not in m_us yet
+	bool 			m_set;
+	int64_t 		m_lastSync;		// time of the last discipline, 0 if none
+};
+
+#endif /* TIME_WALLCLOCK_H_ */
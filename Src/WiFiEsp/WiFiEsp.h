@@ -30,7 +30,6 @@ along with The Arduino WiFiEsp library.  If not, see
 #include "WiFiEspClient.h"
 #include "WiFiEspServer.h"
 #include "utility/EspDrv.h"
-#include "utility/RingBuffer.h"
 #include "utility/debug.h"
 
 
@@ -256,6 +255,21 @@ public:
 	* Ping a host.
 	*/
 	bool ping(const char *host);
+
+	/**
+	* Process module output and queued commands, call it regularly from the
+	* main loop while asynchronous transfers are pending.
+	*/
+	void poll() { m_espDrv->poll(); }
+
+	/**
+	* Connection status as last reported by the module, without the AT+CIPSTATUS
+	* round trip of status(). Kept current by poll().
+	*
+	* return: one of the value defined in wl_status_t
+	*/
+	uint8_t linkStatus() { return m_espDrv->linkStatus(); }
+
 	EspDrv *GetDrv(void) { return m_espDrv; }
 
 	int16_t m_state[MAX_SOCK_NUM];
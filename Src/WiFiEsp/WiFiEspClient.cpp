@@ -136,6 +136,18 @@ size_t WiFiEspClient::write(const uint8_t *buf, size_t size)
 	return size;
 }
 
+bool WiFiEspClient::writeAsync(const uint8_t *buf, size_t size, AtDoneHandler onDone,
+		void *ctx)
+{
+	if (m_sock >= MAX_SOCK_NUM or size == 0)
+	{
+		setWriteError();
+		return false;
+	}
+
+	return m_wifi->GetDrv()->sendDataAsync(m_sock, buf, size, onDone, ctx);
+}
+
 int WiFiEspClient::available()
 {
 	if (m_sock != 255)
@@ -193,15 +205,34 @@ int WiFiEspClient::peek()
 	return b;
 }
 
+int WiFiEspClient::peekBuffer(const uint8_t **buf)
+{
+	if (m_sock == 255)
+		return 0;
+
+	return m_wifi->GetDrv()->peekData(m_sock, buf);
+}
+
+void WiFiEspClient::consume(size_t size)
+{
+	if (m_sock == 255)
+		return;
+
+	m_wifi->GetDrv()->consumeData(m_sock, size);
+}
+
 bool WiFiEspClient::flush(unsigned int maxWaitMs)
 {
-	int timer = HAL_GetTick();
+	uint32_t timer = HAL_GetTick();
+	const uint8_t *buf;
+	int len;
 
-	while (available())
+	// drop whole spans instead of reading byte by byte
+	while ((len = peekBuffer(&buf)) > 0)
 	{
+		consume(len);
 		if ((HAL_GetTick() - timer) > maxWaitMs)
-			return false;
-		read();
+			return available() == 0;
 	}
 
 	return true;
@@ -261,7 +292,7 @@ uint8_t WiFiEspClient::status()
 IPAddress WiFiEspClient::remoteIP()
 {
 	IPAddress ret;
-	m_wifi->GetDrv()->getRemoteIpAddress(ret);
+	m_wifi->GetDrv()->getRemoteIpAddress(ret, m_sock);
 	return ret;
 }
 
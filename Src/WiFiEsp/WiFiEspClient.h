@@ -25,6 +25,7 @@ along with The Arduino WiFiEsp library.  If not, see
 #include "Client.h"
 #include "IPAddress.h"
 #include "WiFiEsp.h"
+#include "utility/EspCmdEngine.h"
 
 class WiFiEspClass;
 
@@ -77,6 +78,14 @@ public:
   */
   virtual size_t write(const uint8_t *buf, size_t size);
 
+  /*
+  * Queue data for the server and return at once, the transfer runs while
+  * WiFi.poll() is called. The buffer is not copied and must stay valid until
+  * onDone is called with the result (TAG_SENDOK on success).
+  * Returns true if the data was queued.
+  */
+  bool writeAsync(const uint8_t *buf, size_t size, AtDoneHandler onDone, void *ctx = NULL);
+
 
   virtual int available();
 
@@ -94,6 +103,15 @@ public:
   */
   virtual int peek();
 
+  /*
+  * Gives direct access to the received data: returns the number of contiguous
+  * bytes at *buf, 0 if none. The data stays buffered until consume() releases
+  * it; a second peekBuffer() after the consume returns the part behind the
+  * buffer wrap point.
+  */
+  int peekBuffer(const uint8_t **buf);
+  void consume(size_t size);
+
   /*
   * Discard any bytes that have been written to the client but not yet read.
   */
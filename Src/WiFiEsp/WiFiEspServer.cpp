@@ -28,6 +28,9 @@ WiFiEspServer::WiFiEspServer(uint16_t port, WiFiEspClass *_wifi)
 {
 	m_port = port;
 	m_wifi = _wifi;
+	m_sock = 0;
+	m_started = false;
+	m_lastSock = SOCK_NOT_AVAIL;
 }
 
 void WiFiEspServer::begin()
@@ -64,12 +67,15 @@ WiFiEspClient WiFiEspServer::available(uint8_t* status)
 	// TODO the original method seems to handle automatic server restart
 	EspDrv *espDrv = m_wifi->GetDrv();
 
-	int bytes = espDrv->availData(0);
-	if (bytes > 0)
+	// start after the socket served last time so that a busy
+	// connection cannot starve the others
+	uint8_t sock = espDrv->nextDataSocket(m_lastSock);
+	if (sock != SOCK_NOT_AVAIL)
 	{
-		LOGINFO1D("New client", espDrv->m_connId);
-		m_wifi->allocateSocket(espDrv->m_connId);
-		WiFiEspClient client(m_wifi, espDrv->m_connId);
+		LOGINFO1D("New client", sock);
+		m_lastSock = sock;
+		m_wifi->allocateSocket(sock);
+		WiFiEspClient client(m_wifi, sock);
 		return client;
 	}
 
@@ -56,6 +56,7 @@ public:
 private:
 	uint16_t m_port;
 	uint8_t m_sock;
+	uint8_t m_lastSock;		// last socket handed out, clients take turns
 	bool m_started;
 	WiFiEspClass *m_wifi;
 
@@ -28,6 +28,16 @@ WiFiEspUDP::WiFiEspUDP(WiFiEspClass *wifi)
 	m_sock = NO_SOCKET_AVAIL;
 	m_wifi = wifi;
 	m_espDrv = wifi->GetDrv();
+	m_packetLeft = 0;
+	m_packetPort = 0;
+	m_packetTick = 0;
+	memset(m_packetIp, 0, sizeof(m_packetIp));
+	m_txStart = 0;
+	m_txLen = 0;
+	m_txOpen = false;
+	m_batch = false;
+	m_txPending = 0;
+	m_txFailed = 0;
 }
 
 
@@ -57,16 +67,7 @@ uint8_t WiFiEspUDP::begin(uint16_t port)
    will return zero if parsePacket hasn't been called yet */
 int WiFiEspUDP::available()
 {
-	 if (m_sock != NO_SOCKET_AVAIL)
-	 {
-		int bytes = m_wifi->GetDrv()->availData(m_sock);
-		if (bytes>0)
-		{
-			return bytes;
-		}
-	}
-
-	return 0;
+	return m_packetLeft;
 }
 
 /* Release any resources being used by this WiFiUDP instance */
@@ -75,6 +76,9 @@ void WiFiEspUDP::stop()
 	  if (m_sock == NO_SOCKET_AVAIL)
 	    return;
 
+      // Let queued datagrams complete, they refer to this object
+      waitTx();
+
       // Discard data that might be in the incoming buffer
       flush();
       
@@ -94,8 +98,16 @@ int WiFiEspUDP::beginPacket(const char *host, uint16_t port)
   {
 	  //EspDrv::startClient(host, port, m_sock, UDP_MODE);
 	  m_remotePort = port;
-	  strcpy(m_remoteHost, host);
+	  strncpy(m_remoteHost, host, sizeof(m_remoteHost) - 1);
+	  m_remoteHost[sizeof(m_remoteHost) - 1] = 0;
 	  m_wifi->allocateSocket(m_sock);
+
+	  // queued datagrams keep their part of the buffer, the new one follows
+	  if (!m_batch)
+		  m_txStart = 0;
+	  m_txLen = 0;
+	  m_txOpen = true;
+	  clearWriteError();
 	  return 1;
   }
   return 0;
@@ -113,7 +125,60 @@ int WiFiEspUDP::beginPacket(IPAddress ip, uint16_t port)
 
 int WiFiEspUDP::endPacket()
 {
-	return 1; //ServerDrv::sendUdpData(m_sock);
+	if (!m_txOpen)
+		return 0;
+	m_txOpen = false;
+
+	// a datagram cut short by a full buffer is not sent
+	if (getWriteError())
+	{
+		if (m_batch)
+			m_txFailed++;
+		return 0;
+	}
+
+	if (!m_batch)
+		return m_espDrv->sendDataUdp(m_sock, m_remoteHost, m_remotePort,
+				&m_txBuf[m_txStart], m_txLen) ? 1 : 0;
+
+	// wait for a free slot when the command queue is full
+	uint32_t start = HAL_GetTick();
+	while (!m_espDrv->sendDataUdpAsync(m_sock, m_remoteHost, m_remotePort,
+			&m_txBuf[m_txStart], m_txLen, txDone, this))
+	{
+		if ((HAL_GetTick() - start) > UDP_TX_QUEUE_WAIT_MS)
+		{
+			m_txFailed++;
+			return 0;
+		}
+		m_espDrv->poll();
+	}
+
+	m_txPending++;
+	m_txStart += m_txLen;
+	m_txLen = 0;
+	return 1;
+}
+
+void WiFiEspUDP::beginBatch()
+{
+	waitTx();
+
+	m_batch = true;
+	m_txStart = 0;
+	m_txFailed = 0;
+}
+
+int WiFiEspUDP::endBatch()
+{
+	waitTx();
+
+	int ret = (m_txFailed == 0) ? 1 : 0;
+
+	m_batch = false;
+	m_txStart = 0;
+	m_txFailed = 0;
+	return ret;
 }
 
 size_t WiFiEspUDP::write(uint8_t byte)
@@ -123,70 +188,131 @@ size_t WiFiEspUDP::write(uint8_t byte)
 
 size_t WiFiEspUDP::write(const uint8_t *buffer, size_t size)
 {
-	bool r = m_wifi->GetDrv()->sendDataUdp(m_sock, m_remoteHost, m_remotePort, buffer, size);
-	if (!r)
-	{
+	if (!m_txOpen)
 		return 0;
+
+	size_t room = UDP_TX_BUFFER_SIZE - m_txStart - m_txLen;
+
+	// in batch mode the buffer is reused once the queued datagrams are out
+	if (size > room && m_batch && m_txStart > 0)
+	{
+		waitTx();
+
+		memmove(m_txBuf, &m_txBuf[m_txStart], m_txLen);
+		m_txStart = 0;
+		room = UDP_TX_BUFFER_SIZE - m_txLen;
 	}
 
+	if (size > room)
+	{
+		setWriteError();
+		size = room;
+	}
+
+	memcpy(&m_txBuf[m_txStart + m_txLen], buffer, size);
+	m_txLen += size;
 	return size;
 }
 
 int WiFiEspUDP::parsePacket()
 {
-	return available();
+	if (m_sock == NO_SOCKET_AVAIL)
+		return 0;
+
+	// skip what is left of the previous packet
+	flush();
+
+	int len = m_espDrv->nextPacket(m_sock, m_packetIp, &m_packetPort, &m_packetTick);
+	if (len <= 0)
+		return 0;
+
+	m_packetLeft = len;
+	return len;
+}
+
+int WiFiEspUDP::peekBuffer(const uint8_t **buffer)
+{
+	if (m_packetLeft == 0)
+		return 0;
+
+	int len = m_espDrv->peekData(m_sock, buffer);
+	return (len < m_packetLeft) ? len : m_packetLeft;
+}
+
+void WiFiEspUDP::consume(size_t len)
+{
+	if (len > m_packetLeft)
+		len = m_packetLeft;
+
+	m_espDrv->consumeData(m_sock, len);
+	m_packetLeft -= len;
 }
 
 int WiFiEspUDP::read()
 {
-	uint8_t b;
-	if (!available())
-		return -1;
+	const uint8_t *ptr;
 
-	bool connClose = false;
-	
-    // Read the data and handle the timeout condition
-	if (! m_wifi->GetDrv()->getData(m_sock, &b, false, &connClose))
-      return -1;  // Timeout occured
+	if (peekBuffer(&ptr) == 0)
+		return -1;
 
+	uint8_t b = *ptr;
+	consume(1);
 	return b;
 }
 
 int WiFiEspUDP::read(uint8_t* buf, size_t size)
 {
-	if (!available())
-		return -1;
-	return m_wifi->GetDrv()->getDataBuf(m_sock, buf, size);
+	const uint8_t *ptr;
+	size_t cnt = 0;
+
+	// at most two spans, the packet may wrap around the buffer end
+	while (cnt < size)
+	{
+		size_t len = peekBuffer(&ptr);
+		if (len == 0)
+			break;
+		if (len > size - cnt)
+			len = size - cnt;
+
+		memcpy(buf + cnt, ptr, len);
+		consume(len);
+		cnt += len;
+	}
+	return cnt;
 }
 
 int WiFiEspUDP::peek()
 {
-  uint8_t b=0;
-  if (!available())
-    return -1;
+	const uint8_t *ptr;
+
+	if (peekBuffer(&ptr) == 0)
+		return -1;
 
-  return b;
+	return *ptr;
 }
 
 void WiFiEspUDP::flush()
 {
-	  // Discard all input data
-	  int count = available();
-	  while (count-- > 0)
-	    read();
+	// Discard the rest of the current packet
+	const uint8_t *ptr;
+	int len;
+
+	while ((len = peekBuffer(&ptr)) > 0)
+		consume(len);
+
+	// the payload of a complete datagram is always buffered
+	m_packetLeft = 0;
 }
 
 
-IPAddress  WiFiEspUDP::remoteIP()
+IPAddress  WiFiEspUDP::remoteIP() const
 {
-	IPAddress ret;
-	m_wifi->GetDrv()->getRemoteIpAddress(ret);
-	return ret;
+	return IPAddress(m_packetIp);
 }
 
-uint16_t  WiFiEspUDP::remotePort()
+uint16_t  WiFiEspUDP::remotePort() const
 {
-	return m_wifi->GetDrv()->getRemotePort();
+	return m_packetPort;
 }
 
 
@@ -195,4 +321,19 @@ uint16_t  WiFiEspUDP::remotePort()
 // Private Methods
 ////////////////////////////////////////////////////////////////////////////////
 
+// Polls the driver until all queued datagrams are completed, every
+// command ends with its result or a timeout
+void WiFiEspUDP::waitTx()
+{
+	while (m_txPending > 0)
+		m_espDrv->poll();
+}
+
+void WiFiEspUDP::txDone(void *ctx, int tag)
+{
+	WiFiEspUDP *udp = (WiFiEspUDP *) ctx;
 
+	if (tag != TAG_SENDOK)
+		udp->m_txFailed++;
+	udp->m_txPending--;
+}
@@ -23,6 +23,11 @@ along with The Arduino WiFiEsp library.  If not, see
 
 #define UDP_TX_PACKET_MAX_SIZE 24
 
+// buffer for outgoing datagrams, in batch mode it holds all queued ones
+#define UDP_TX_BUFFER_SIZE 512
+// how long endPacket() waits for room in the command queue in batch mode
+#define UDP_TX_QUEUE_WAIT_MS 2000
+
 class WiFiEspUDP : public UDP {
 private:
   uint8_t m_sock;  // socket ID for Wiz5100
@@ -31,6 +36,24 @@ private:
   
   uint16_t m_remotePort;
   char m_remoteHost[30];
+
+  // datagram returned by parsePacket()
+  uint16_t m_packetLeft;	// bytes of it not yet read
+  uint8_t m_packetIp[4];	// its sender
+  uint16_t m_packetPort;
+  uint32_t m_packetTick;	// when it was received
+
+  // datagram being built between beginPacket() and endPacket()
+  uint8_t m_txBuf[UDP_TX_BUFFER_SIZE];
+  uint16_t m_txStart;		// its offset in m_txBuf
+  uint16_t m_txLen;
+  bool m_txOpen;
+  bool m_batch;				// endPacket() queues instead of waiting
+  uint8_t m_txPending;		// queued datagrams not yet completed
+  uint8_t m_txFailed;
+
+  void waitTx();
+  static void txDone(void *ctx, int tag);
   
 
 public:
@@ -50,9 +73,17 @@ public:
   virtual int beginPacket(const char *host, uint16_t port);
 
   // Finish off this packet and send it
-  // Returns 1 if the packet was sent successfully, 0 if there was an error
+  // Returns 1 if the packet was sent successfully, 0 if there was an error,
+  // also when write() could not take all of it (getWriteError() is set)
   virtual int endPacket();
 
+  // Batch mode: the packets of a burst are queued to the command pipeline
+  // by endPacket() without waiting for each SEND OK. Their data stays in the
+  // packet buffer until endBatch(), which waits for all of them.
+  // endBatch() returns 1 if every packet was sent, 0 otherwise
+  void beginBatch();
+  int endBatch();
+
   // Write a single byte into the packet
   virtual size_t write(uint8_t);
 
@@ -82,13 +113,21 @@ public:
   // Return the next byte from the current packet without moving on to the next byte
   virtual int peek();
 
+  // Direct access to the current packet: returns the number of contiguous
+  // bytes at *buffer, consume() releases them. Never goes past the packet end.
+  int peekBuffer(const uint8_t **buffer);
+  void consume(size_t len);
+
   virtual void flush();	// Finish reading the current packet
 
   // Return the IP address of the host who sent the current incoming packet
-  virtual IPAddress remoteIP();
+  virtual IPAddress remoteIP() const;
 
   // Return the port of the host who sent the current incoming packet
-  virtual uint16_t remotePort();
+  virtual uint16_t remotePort() const;
+
+  // HAL tick at which the current incoming packet was received
+  uint32_t packetTick() const { return m_packetTick; }
 
 
   friend class WiFiEspServer;
@@ -0,0 +1,50 @@
+/*
+ * DmaRxRing.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include "DmaRxRing.h"
+
+DmaRxRing::DmaRxRing(const uint8_t *buf, int size)
+{
+	m_buf = buf;
+	m_size = size;
+	m_pos = 0;
+}
+
+void DmaRxRing::Reset(int pos)
+{
+	m_pos = (pos >= m_size) ? 0 : pos;
+}
+
+int DmaRxRing::Advance(int pos, DmaChunkHandler handler, void *ctx)
+{
+	int cnt = 0;
+
+	// CNDTR reads 0 for a moment before the circular reload
+	if (pos >= m_size)
+		pos = 0;
+
+	if (pos > m_pos)
+	{
+		cnt = pos - m_pos;
+		handler(ctx, m_buf + m_pos, cnt);
+	}
+	else if (pos < m_pos)
+	{
+		// wrapped, tail of the buffer first
+		cnt = m_size - m_pos;
+		handler(ctx, m_buf + m_pos, cnt);
+		if (pos > 0)
+		{
+			handler(ctx, m_buf, pos);
+			cnt += pos;
+		}
+	}
+
+	m_pos = pos;
+
+	return cnt;
+}
@@ -0,0 +1,57 @@
+/*
+ * DmaRxRing.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef WIFIESP_UTILITY_DMARXRING_H_
+#define WIFIESP_UTILITY_DMARXRING_H_
+
+#include <stdint.h>
+
+// called for every contiguous chunk of new data in the DMA buffer
+typedef void (*DmaChunkHandler)(void *ctx, const uint8_t *data, int len);
+
+//////////////////////////////////////////////////////////////////////////////
+//	class DmaRxRing
+//
+//	keeps track of the part of a circular DMA receive buffer that has already
+//	been handed over. It does not touch any hardware, the caller passes in
+//	the DMA write position, so it runs unchanged on the host.
+//
+//	The DMA overwrites data that has not been handed over if more than the
+//	buffer size arrives between two calls to Advance(). With the half and
+//	full transfer interrupts enabled this cannot happen as long as the
+//	interrupt latency stays below half a buffer worth of bytes.
+//
+class DmaRxRing
+{
+public:
+	DmaRxRing(const uint8_t *buf, int size);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	int Advance(int pos, DmaChunkHandler handler, void *ctx);
+	//
+	//	hands everything between the last position and pos to the handler, in
+	//	one chunk or in two if the DMA has wrapped around
+	//
+	//		pos		index the DMA writes next, i.e. size - CNDTR
+	//
+	//	returns the number of bytes handed over
+	//
+	int Advance(int pos, DmaChunkHandler handler, void *ctx);
+
+	// forget everything up to pos
+	void Reset(int pos = 0);
+
+	int Pos() { return m_pos; }
+	int Size() { return m_size; }
+
+private:
+	const uint8_t 	*m_buf;
+	int 			m_size;
+	int 			m_pos;
+};
+
+#endif /* WIFIESP_UTILITY_DMARXRING_H_ */
@@ -0,0 +1,420 @@
+/*
+ * EspCmdEngine.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ *
+ *  AT command engine for the ESP8266.
+ *
+ *  Commands are queued with a completion callback and a timeout and go out
+ *  back to back: the next command is written as soon as the previous one
+ *  returned its final result line, there is no fixed settle delay. Everything
+ *  the module sends on its own (+IPD frames, <id>,CONNECT / <id>,CLOSED and
+ *  the WIFI status lines) is sorted out of the stream and handed to the URC
+ *  handler instead of being flushed away. The stream is split into lines and
+ *  result tags by EspTokenizer in a single pass.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "EspCmdEngine.h"
+#include "debug.h"
+#include "Profiler.h"
+
+EspCmdEngine::EspCmdEngine(Serial *serial)
+{
+	m_pSerial = serial;
+
+	m_head = 0;
+	m_count = 0;
+	m_sent = false;
+	m_prompted = false;
+	m_sentTick = 0;
+
+	m_ipdRemaining = 0;
+	m_ipdConnId = 0;
+	m_ipdChunkLen = 0;
+
+	m_resync = false;
+	m_lastRxTick = 0;
+
+	m_urcHandler = NULL;
+	m_urcCtx = NULL;
+}
+
+void EspCmdEngine::SetUrcHandler(AtUrcHandler handler, void *ctx)
+{
+	m_urcHandler = handler;
+	m_urcCtx = ctx;
+}
+
+bool EspCmdEngine::Submit(const char *cmd, uint32_t timeoutMs, AtLineHandler onLine,
+		AtDoneHandler onDone, void *ctx, const uint8_t *payload, uint16_t payloadLen,
+		bool payloadCrLf)
+{
+	if (m_count == AT_CMD_QUEUE_SIZE)
+		return false;
+
+	int len = strlen(cmd);
+	if (len > AT_CMD_BUFFER_SIZE - 3)
+	{
+		LOGERROR("AT command too long");
+		return false;
+	}
+
+	AtCmd *pCmd = &m_queue[(m_head + m_count) % AT_CMD_QUEUE_SIZE];
+
+	memcpy(pCmd->cmd, cmd, len);
+	pCmd->cmd[len++] = '\r';
+	pCmd->cmd[len++] = '\n';
+	pCmd->cmd[len] = 0;
+	pCmd->len = len;
+
+	pCmd->flags = 0;
+	if (payload != NULL)
+		pCmd->flags |= AT_FLAG_PAYLOAD;
+	if (payloadCrLf)
+		pCmd->flags |= AT_FLAG_PAYLOAD_CRLF;
+
+	pCmd->timeout = timeoutMs;
+	pCmd->onLine = onLine;
+	pCmd->onDone = onDone;
+	pCmd->ctx = ctx;
+	pCmd->payload = payload;
+	pCmd->payloadLen = payloadLen;
+
+	m_count++;
+
+	StartNext();
+
+	return true;
+}
+
+struct ExecuteResult
+{
+	bool done;
+	int tag;
+};
+
+static void ExecuteDone(void *ctx, int tag)
+{
+	ExecuteResult *result = (ExecuteResult *) ctx;
+
+	result->tag = tag;
+	result->done = true;
+}
+
+int EspCmdEngine::Execute(const char *cmd, uint32_t timeoutMs, AtLineHandler onLine,
+		void *ctx, const uint8_t *payload, uint16_t payloadLen, bool payloadCrLf)
+{
+	ExecuteResult result = { false, TAG_TIMEOUT };
+
+	LOGDEBUG("----------------------------------------------");
+	LOGDEBUG1(">>", cmd);
+
+	// wait for a free slot if other commands are still in flight
+	while (!Submit(cmd, timeoutMs, onLine, ExecuteDone, &result, payload,
+			payloadLen, payloadCrLf))
+		Poll();
+
+	while (!result.done)
+		Poll();
+
+	LOGDEBUG1D("---------------------------------------------- >", result.tag);
+
+	return result.tag;
+}
+
+bool EspCmdEngine::Idle()
+{
+	Poll();
+
+	return (m_count == 0) && (m_ipdRemaining == 0)
+			&& (HAL_GetTick() - m_lastRxTick) >= AT_IDLE_QUIET_MS;
+}
+
+void EspCmdEngine::Poll()
+{
+	const uint8_t *data;
+	int len;
+
+	// straight out of the receive ring, no copy
+	while ((len = m_pSerial->PeekContiguous(&data)) > 0)
+	{
+		for (int i = 0; i < len; i++)
+			Feed(data[i]);
+		m_pSerial->Commit(len);
+
+		m_lastRxTick = HAL_GetTick();
+	}
+
+	// hand partial payload over now, the reader should not wait for the whole frame
+	FlushIpdData();
+
+	// the DMA may still read the command or its payload from the queue slot,
+	// it is not released before the transmission has finished
+	if (m_sent && (HAL_GetTick() - m_sentTick) > m_queue[m_head].timeout
+			&& (m_pSerial->TxPending() == 0))
+	{
+		LOGWARN(">>> TIMEOUT >>>");
+
+		// a late answer must not be taken for the result of the next command
+		m_resync = true;
+		Complete(TAG_TIMEOUT);
+	}
+
+	StartNext();
+}
+
+void EspCmdEngine::ResetStream()
+{
+	m_tokenizer.Reset();
+	m_ipdRemaining = 0;
+	m_ipdChunkLen = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// Private methods
+////////////////////////////////////////////////////////////////////////////
+
+void EspCmdEngine::Feed(uint8_t c)
+{
+	// +IPD payload is raw data, it is not split into lines
+	if (m_ipdRemaining > 0)
+	{
+		m_ipdChunk[m_ipdChunkLen++] = c;
+		m_ipdRemaining--;
+
+		if ((m_ipdChunkLen == sizeof(m_ipdChunk)) || (m_ipdRemaining == 0))
+			FlushIpdData();
+		return;
+	}
+
+	int tok = m_tokenizer.Feed(c);
+
+	switch (tok)
+	{
+	case TOK_NONE:
+		break;
+
+	case TOK_LINE:
+		DispatchLine(m_tokenizer.Line(), m_tokenizer.LineLen());
+		break;
+
+	case TOK_PROMPT:
+		// AT+CIPSEND prompt, it is not followed by a line end
+		if (m_sent && !m_prompted && (m_queue[m_head].flags & AT_FLAG_PAYLOAD))
+			SendPayload();
+		break;
+
+	case TOK_IPD:
+		// +IPD,<id>,<len>[,<remote IP>,<remote port>]:<data>
+		ParseIpdHeader(m_tokenizer.Line());
+
+		// the payload bypasses the tokenizer, it starts over behind it
+		m_tokenizer.Reset();
+		break;
+
+	case TOK_WIFI_DISCONNECT:
+		Notify(URC_WIFI_DISCONNECT);
+		break;
+
+	case TOK_WIFI_CONNECTED:
+		Notify(URC_WIFI_CONNECTED);
+		break;
+
+	case TOK_WIFI_GOT_IP:
+		Notify(URC_WIFI_GOT_IP);
+		break;
+
+	default:
+		DispatchResult(tok);
+		break;
+	}
+}
+
+void EspCmdEngine::DispatchLine(const char *line, int len)
+{
+	// the prompt leaves a blank behind, blank lines carry nothing
+	int i = 0;
+	while ((i < len) && (line[i] == ' '))
+		i++;
+	if (i == len)
+		return;
+
+	if (ParseUrc(line, len))
+		return;
+
+	if (!m_sent)
+	{
+		LOGDEBUG1("Unsolicited:", line);
+		return;
+	}
+
+	AtCmd *pCmd = &m_queue[m_head];
+
+	if (pCmd->onLine != NULL)
+		pCmd->onLine(pCmd->ctx, line, len);
+}
+
+void EspCmdEngine::DispatchResult(int tag)
+{
+	if (!m_sent)
+	{
+		LOGDEBUG1("Unsolicited:", m_tokenizer.Line());
+		return;
+	}
+
+	// AT+CIPSEND answers OK before the prompt, the result is SEND OK
+	if ((m_queue[m_head].flags & AT_FLAG_PAYLOAD) && (tag == TAG_OK))
+		return;
+
+	Complete(tag);
+}
+
+void EspCmdEngine::SendPayload()
+{
+	AtCmd *pCmd = &m_queue[m_head];
+
+	// the payload is sent from the caller's buffer, it is valid until the
+	// command completes and the module answers only after the last byte
+	m_prompted = true;
+	m_pSerial->WriteRef(pCmd->payload, pCmd->payloadLen);
+	if (pCmd->flags & AT_FLAG_PAYLOAD_CRLF)
+		m_pSerial->WriteRef((const uint8_t *) "\r\n", 2);
+
+	// the module has the whole timeout again to answer SEND OK
+	m_sentTick = HAL_GetTick();
+}
+
+void EspCmdEngine::Notify(UrcEnum type, uint8_t connId)
+{
+	AtUrc urc;
+
+	memset(&urc, 0, sizeof(urc));
+	urc.type = type;
+	urc.connId = connId;
+
+	if (m_urcHandler != NULL)
+		m_urcHandler(m_urcCtx, urc);
+}
+
+bool EspCmdEngine::ParseUrc(const char *line, int len)
+{
+	// <id>,CONNECT / <id>,CLOSED / <id>,CONNECT FAIL
+	if ((len < 3) || !isdigit(line[0]) || (line[1] != ','))
+		return false;
+
+	if (strcmp(&line[2], "CONNECT") == 0)
+		Notify(URC_CONNECT, line[0] - '0');
+	else if ((strcmp(&line[2], "CLOSED") == 0)
+			|| (strcmp(&line[2], "CONNECT FAIL") == 0))
+		Notify(URC_CLOSED, line[0] - '0');
+	else
+		return false;
+
+	return true;
+}
+
+bool EspCmdEngine::ParseIpdHeader(const char *header)
+{
+	PROFILE_SCOPE("ipd header");
+	AtUrc urc;
+	char *p = (char *) header;
+
+	memset(&urc, 0, sizeof(urc));
+	urc.type = URC_IPD;
+
+	urc.connId = (uint8_t) strtol(p, &p, 10);
+	if (*p++ != ',')
+		return false;
+
+	urc.len = (uint16_t) strtol(p, &p, 10);
+
+	// remote IP and port are only there with AT+CIPDINFO=1
+	if (*p == ',')
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			urc.remoteIp[i] = (uint8_t) strtol(p + 1, &p, 10);
+		}
+		if (*p == ',')
+			urc.remotePort = (uint16_t) strtol(p + 1, &p, 10);
+	}
+
+	m_ipdConnId = urc.connId;
+	m_ipdRemaining = urc.len;
+	m_ipdChunkLen = 0;
+
+	LOGDEBUG2DD("Data packet", urc.connId, urc.len);
+
+	if (m_urcHandler != NULL)
+		m_urcHandler(m_urcCtx, urc);
+
+	return true;
+}
+
+void EspCmdEngine::FlushIpdData()
+{
+	if (m_ipdChunkLen == 0)
+		return;
+
+	if (m_urcHandler != NULL)
+	{
+		AtUrc urc;
+
+		memset(&urc, 0, sizeof(urc));
+		urc.type = URC_IPD_DATA;
+		urc.connId = m_ipdConnId;
+		urc.data = m_ipdChunk;
+		urc.dataLen = m_ipdChunkLen;
+
+		m_urcHandler(m_urcCtx, urc);
+	}
+	m_ipdChunkLen = 0;
+}
+
+void EspCmdEngine::StartNext()
+{
+	if (m_sent || (m_count == 0))
+		return;
+
+	if (m_resync)
+	{
+		if ((HAL_GetTick() - m_lastRxTick) < AT_RESYNC_QUIET_MS)
+			return;
+		m_resync = false;
+		m_tokenizer.Reset();
+	}
+
+	AtCmd *pCmd = &m_queue[m_head];
+
+	m_sent = true;
+	m_prompted = false;
+	m_sentTick = HAL_GetTick();
+	// the answer may come after the MCU slept
+	PROFILE_STAMP_WALL(m_profStart);
+
+	// the queue slot holds the command until it completes
+	m_pSerial->WriteRef((const uint8_t *) pCmd->cmd, pCmd->len);
+}
+
+void EspCmdEngine::Complete(int tag)
+{
+	AtCmd *pCmd = &m_queue[m_head];
+	AtDoneHandler onDone = pCmd->onDone;
+	void *ctx = pCmd->ctx;
+
+	PROFILE_SINCE_WALL("at command", m_profStart);
+
+	// free the slot first, the handler may queue the next command
+	m_head = (m_head + 1) % AT_CMD_QUEUE_SIZE;
+	m_count--;
+	m_sent = false;
+	m_prompted = false;
+
+	if (onDone != NULL)
+		onDone(ctx, tag);
+}
@@ -0,0 +1,179 @@
+/*
+ * EspCmdEngine.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef WIFIESP_UTILITY_ESPCMDENGINE_H_
+#define WIFIESP_UTILITY_ESPCMDENGINE_H_
+
+#include <stdint.h>
+#include <stm32l4xx_hal.h>
+
+#include "Serial.h"
+#include "EspTokenizer.h"
+
+// number of AT commands that can be queued at once
+#define AT_CMD_QUEUE_SIZE		4
+
+// maximum size of AT command
+#define AT_CMD_BUFFER_SIZE		200
+
+// after a timeout the next command is held back until the link was quiet this long
+#define AT_RESYNC_QUIET_MS		100
+
+// silence on the line after which the module is taken as idle, ms
+#define AT_IDLE_QUIET_MS		50
+
+// result of a command, the first entries match the final response tokens
+typedef enum
+{
+	TAG_TIMEOUT = -1,
+	TAG_OK = TOK_OK,
+	TAG_ERROR = TOK_ERROR,
+	TAG_FAIL = TOK_FAIL,
+	TAG_SENDOK = TOK_SENDOK,
+	TAG_SENDFAIL = TOK_SENDFAIL
+} TagsEnum;
+
+// command flags
+#define AT_FLAG_PAYLOAD		0x01	// wait for '>' then send the payload and wait for SEND OK
+#define AT_FLAG_PAYLOAD_CRLF	0x02	// send CR/LF after the payload
+
+// unsolicited result codes sorted out of the response stream
+typedef enum
+{
+	URC_IPD,				// +IPD header, payload follows in URC_IPD_DATA chunks
+	URC_IPD_DATA,
+	URC_CONNECT,			// <id>,CONNECT
+	URC_CLOSED,				// <id>,CLOSED
+	URC_WIFI_CONNECTED,
+	URC_WIFI_GOT_IP,
+	URC_WIFI_DISCONNECT
+} UrcEnum;
+
+struct AtUrc
+{
+	UrcEnum 		type;
+	uint8_t 		connId;
+	uint16_t 		len;			// +IPD payload length
+	uint8_t 		remoteIp[4];
+	uint16_t 		remotePort;
+	const uint8_t 	*data;			// URC_IPD_DATA payload chunk
+	uint16_t 		dataLen;
+};
+
+// called for every response line of the command, CR/LF stripped
+typedef void (*AtLineHandler)(void *ctx, const char *line, int len);
+// called once when the command completes with one of TagsEnum
+typedef void (*AtDoneHandler)(void *ctx, int tag);
+// called for every unsolicited result code
+typedef void (*AtUrcHandler)(void *ctx, const AtUrc &urc);
+
+class EspCmdEngine
+{
+public:
+	EspCmdEngine(Serial *serial);
+
+	void SetUrcHandler(AtUrcHandler handler, void *ctx);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	bool Submit(cmd, timeoutMs, onLine, onDone, ctx, payload, payloadLen, payloadCrLf);
+	//
+	//	queues an AT command (without CR/LF) and returns immediately. The command
+	//	is transmitted as soon as the commands ahead of it have completed.
+	//
+	//		payload		data sent after the '>' prompt (AT+CIPSEND), NULL if none.
+	//					It must stay valid until the command completes.
+	//		payloadCrLf	send CR/LF after the payload, it must be included in the
+	//					length announced by the command
+	//
+	//	returns false if the queue is full
+	//
+	bool Submit(const char *cmd, uint32_t timeoutMs, AtLineHandler onLine = NULL,
+			AtDoneHandler onDone = NULL, void *ctx = NULL,
+			const uint8_t *payload = NULL, uint16_t payloadLen = 0,
+			bool payloadCrLf = false);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	int Execute(cmd, timeoutMs, onLine, ctx, payload, payloadLen, payloadCrLf);
+	//
+	//	queues the command and polls until it has completed. Must not be called
+	//	from a line, done or URC handler.
+	//
+	//	returns the TagsEnum result
+	//
+	int Execute(const char *cmd, uint32_t timeoutMs, AtLineHandler onLine = NULL,
+			void *ctx = NULL, const uint8_t *payload = NULL, uint16_t payloadLen = 0,
+			bool payloadCrLf = false);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	void Poll();
+	//
+	//	consumes everything in the receive buffer, dispatches response lines and
+	//	URCs, expires timed out commands and starts the next queued command.
+	//	Must be called regularly; all EspDrv entry points do so.
+	//
+	void Poll();
+
+	bool Busy() { return m_count > 0; }
+	int  Pending() { return m_count; }
+
+	// no command queued, no +IPD payload expected and the line has been
+	// silent for AT_IDLE_QUIET_MS
+	bool Idle();
+
+	// discard the partial line and any +IPD payload still expected
+	void ResetStream();
+
+private:
+	struct AtCmd
+	{
+		char 			cmd[AT_CMD_BUFFER_SIZE];
+		uint16_t 		len;
+		uint8_t 		flags;
+		uint32_t 		timeout;
+		AtLineHandler 	onLine;
+		AtDoneHandler 	onDone;
+		void 			*ctx;
+		const uint8_t 	*payload;
+		uint16_t 		payloadLen;
+	};
+
+	void Feed(uint8_t c);
+	void DispatchLine(const char *line, int len);
+	void DispatchResult(int tag);
+	void SendPayload();
+	void Notify(UrcEnum type, uint8_t connId = 0);
+	bool ParseUrc(const char *line, int len);
+	bool ParseIpdHeader(const char *header);
+	void StartNext();
+	void Complete(int tag);
+	void FlushIpdData();
+
+	Serial 			*m_pSerial;
+
+	AtCmd 			m_queue[AT_CMD_QUEUE_SIZE];
+	int 			m_head;
+	int 			m_count;
+	bool 			m_sent;				// head of the queue is on the wire
+	bool 			m_prompted;			// payload of the head command is on the wire
+	uint32_t 		m_sentTick;
+	uint32_t 		m_profStart;	// ProfWallNow() when sent, with PROFILE_ENABLED
+
+	EspTokenizer 	m_tokenizer;
+
+	uint16_t 		m_ipdRemaining;		// payload bytes of the current +IPD frame
+	uint8_t 		m_ipdConnId;
+	uint8_t 		m_ipdChunk[64];
+	uint16_t 		m_ipdChunkLen;
+
+	bool 			m_resync;
+	uint32_t 		m_lastRxTick;
+
+	AtUrcHandler 	m_urcHandler;
+	void 			*m_urcCtx;
+};
+
+#endif /* WIFIESP_UTILITY_ESPCMDENGINE_H_ */
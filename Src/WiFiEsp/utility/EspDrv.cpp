@@ -24,21 +24,27 @@
 #include <stdarg.h>     /* va_list, va_start, va_arg, va_end */
 
 #include "EspDrv.h"
-#include "queue.h"
-#include "serial.h"
-#include "RingBuffer.h"
+#include "SpscRing.h"
+#include "Serial.h"
+#include "EspCmdEngine.h"
 #include "debug.h"
 
-#define NUMESPTAGS 5
-
-const char* ESPTAGS[] =
-{ "\r\nOK\r\n", "\r\nERROR\r\n", "\r\nFAIL\r\n", "\r\nSEND OK\r\n",
-		" CONNECT\r\n" };
-
-typedef enum
+// context of a sendCmdGet line handler
+struct CmdGetCtx
 {
-	TAG_OK, TAG_ERROR, TAG_FAIL, TAG_SENDOK, TAG_CONNECT
-} TagsEnum;
+	const char* startTag;
+	const char* endTag;
+	char* outStr;
+	int outStrLen;
+	bool found;
+};
+
+// context of the AT+CWLAP line handler
+struct ScanCtx
+{
+	EspDrv* drv;
+	uint8_t count;
+};
 
 EspDrv::EspDrv()
 {
@@ -65,22 +71,31 @@ EspDrv::EspDrv()
 	for (uint ix = 0; ix < sizeof(m_fwVersion); ix++)
 		m_fwVersion[ix] = 0;
 
-	m_bufPos = 0;
+	m_pSerial = NULL;
+	m_pEngine = NULL;
+	m_pSockets = NULL;
 	m_connId = 0;
-
-	m_remotePort = 0;
-	for (uint ix = 0; ix < sizeof(m_remoteIp); ix++)
-		m_remoteIp[ix] = 0;
-
-	m_pRingBuf = new RingBuffer(32);
-
+	m_linkStatus = WL_IDLE_STATUS;
 }
 void EspDrv::wifiDriverInit(UART_HandleTypeDef *_espUART)
 {
 	LOGDEBUG("> wifiDriverInit");
 
 	m_espUART = _espUART;
-	m_pSerial = new Serial(m_espUART, 256, 256);
+	m_pSerial = new Serial(m_espUART);
+	m_pSockets = new EspSocket[MAX_SOCK_NUM];
+	for (int ix = 0; ix < MAX_SOCK_NUM; ix++)
+	{
+		m_pSockets[ix].closed = false;
+		m_pSockets[ix].remotePort = 0;
+		m_pSockets[ix].mode = TCP_MODE;
+		m_pSockets[ix].frameLen = 0;
+		m_pSockets[ix].frameLeft = 0;
+		m_pSockets[ix].frameDrop = false;
+		memset(m_pSockets[ix].remoteIp, 0, WL_IPV4_LENGTH);
+	}
+	m_pEngine = new EspCmdEngine(m_pSerial);
+	m_pEngine->SetUrcHandler(urcHandler, this);
 
 	bool initOK = false;
 
@@ -163,14 +178,13 @@ bool EspDrv::wifiConnect(const char* ssid, const char* passphrase)
 	if (ret == TAG_OK)
 	{
 		LOGINFO1("Connected to", ssid);
+		m_linkStatus = WL_CONNECTED;
 		return true;
 	}
 
 	LOGWARN1("Failed connecting to", ssid);
 
-	// clean additional messages logged after the FAIL tag
-	HAL_Delay(1000);
-	espEmptyBuf(false);
+	// additional messages logged after the FAIL tag are sorted out by the engine
 
 	return false;
 }
@@ -215,13 +229,9 @@ int8_t EspDrv::disconnect()
 {
 	LOGDEBUG("> disconnect");
 
-	if (sendCmd("AT+CWQAP") == TAG_OK)
-		return WL_DISCONNECTED;
-
-	// wait and clear any additional message
-	HAL_Delay(2000);
-	espEmptyBuf(false);
+	sendCmd("AT+CWQAP");
 
+	m_linkStatus = WL_DISCONNECTED;
 	return WL_DISCONNECTED;
 }
 
@@ -308,17 +318,26 @@ uint8_t EspDrv::getConnectionStatus()
 
 	int s = atoi(buf);
 	if (s == 2 or s == 3 or s == 4)
-		return WL_CONNECTED;
+		m_linkStatus = WL_CONNECTED;
 	else if (s == 5)
-		return WL_DISCONNECTED;
+		m_linkStatus = WL_DISCONNECTED;
+	else
+		m_linkStatus = WL_IDLE_STATUS;
 
-	return WL_IDLE_STATUS;
+	return m_linkStatus;
 }
 
 uint8_t EspDrv::getClientState(uint8_t sock)
 {
 	LOGDEBUG1D("> getClientState", sock);
 
+	// the module reported <id>,CLOSED, no need to ask
+	if (sock < MAX_SOCK_NUM && m_pSockets[sock].closed)
+	{
+		LOGDEBUG("Not connected");
+		return false;
+	}
+
 	char findBuf[20];
 	sprintf(findBuf, "+CIPSTATUS:%d,", sock);
 
@@ -462,53 +481,18 @@ int32_t EspDrv::getCurrentRSSI()
 
 uint8_t EspDrv::getScanNetworks()
 {
-	uint8_t ssidListNum = 0;
-	int idx;
-
-	espEmptyBuf();
+	ScanCtx scan = { this, 0 };
 
-	LOGDEBUG("----------------------------------------------");
-	LOGDEBUG(">> AT+CWLAP");
+	LOGDEBUG("> getScanNetworks");
 
-	println("AT+CWLAP");
+	int idx = m_pEngine->Execute("AT+CWLAP", 10000, scanLine, &scan);
 
-	idx = readUntil(10000, "+CWLAP:(");
-
-	while (idx == NUMESPTAGS)
-	{
-		m_networkEncr[ssidListNum] = m_pSerial->ParseInt();
-
-		// discard , and " characters
-		readUntil(1000, "\"");
-
-		idx = readUntil(1000, "\"", false);
-		if (idx == NUMESPTAGS)
-		{
-			memset(m_networkSsid[ssidListNum], 0, WL_SSID_MAX_LENGTH);
-			m_pRingBuf->getStrN(m_networkSsid[ssidListNum], 1,
-					WL_SSID_MAX_LENGTH - 1);
-		}
-
-		// discard , character
-		readUntil(1000, ",");
-
-		m_networkRssi[ssidListNum] = m_pSerial->ParseInt();
-
-		idx = readUntil(1000, "+CWLAP:(");
-
-		if (ssidListNum == WL_NETWORKS_LIST_MAXNUM - 1)
-			break;
-
-		ssidListNum++;
-	}
-
-	if (idx == -1)
+	if (idx == TAG_TIMEOUT)
 		return -1;
 
-	LOGDEBUG1D("---------------------------------------------- >", ssidListNum);
-	LOGDEBUG("\n");
+	LOGDEBUG1D("networks found >", scan.count);
 
-	return ssidListNum;
+	return scan.count;
 }
 
 bool EspDrv::getNetmask(IPAddress& mask)
@@ -611,6 +595,12 @@ bool EspDrv::startClient(const char* host, uint16_t port, uint8_t sock,
 	// for UDP we set a dummy remote port and UDP mode to 2
 	// this allows to specify the target host/port in CIPSEND
 
+	// a new connection starts with an empty buffer
+	m_pSockets[sock].closed = false;
+	m_pSockets[sock].mode = protMode;
+	m_pSockets[sock].rxData.Clear();
+	m_pSockets[sock].packets.Clear();
+
 	int ret = -1;
 	if (protMode == TCP_MODE)
 		ret = sendCmd("AT+CIPSTART=%d,\"TCP\",\"%s\",%u", 5000, sock, host,
@@ -635,6 +625,9 @@ void EspDrv::stopClient(uint8_t sock)
 	LOGDEBUG1D("> stopClient", sock);
 
 	sendCmd("AT+CIPCLOSE=%d", 4000, sock);
+
+	if (sock < MAX_SOCK_NUM)
+		m_pSockets[sock].closed = true;
 }
 
 uint8_t EspDrv::getServerState(uint8_t sock)
@@ -646,116 +639,116 @@ uint8_t EspDrv::getServerState(uint8_t sock)
 // TCP/IP functions
 ////////////////////////////////////////////////////////////////////////////
 
-uint16_t EspDrv::availData(uint8_t connId)
+void EspDrv::poll()
 {
-	uint8_t c;
+	m_pEngine->Poll();
+}
 
-	// if there is data in the buffer
-	if (m_pSerial->Available() != 0)
+bool EspDrv::isIdle()
+{
+	if (!m_pEngine->Idle())
+		return false;
+
+	for (int i = 0; i < MAX_SOCK_NUM; i++)
 	{
-		if (m_connId == connId)
-			return m_pSerial->Available();
-		else if (m_connId == 0)
-			return m_pSerial->Available();
+		if (!m_pSockets[i].rxData.IsEmpty())
+			return false;
 	}
+	return true;
+}
 
-	int bytes = m_pSerial->Available();
+uint16_t EspDrv::availData(uint8_t connId)
+{
+	// +IPD headers and payload are sorted out of the stream by the engine
+	m_pEngine->Poll();
+
+	if (connId >= MAX_SOCK_NUM)
+		return 0;
+
+	return m_pSockets[connId].rxData.Size();
+}
+
+uint8_t EspDrv::nextDataSocket(uint8_t after)
+{
+	m_pEngine->Poll();
 
-	if (bytes)
+	for (int i = 1; i <= MAX_SOCK_NUM; i++)
 	{
-		//LOGDEBUG1("Bytes in the serial buffer: ", bytes);
-		//if (find((char *) "+IPD,"))
-		{
-			// format is : +IPD,<id>,<len>:<data>
-			// format is : +IPD,<ID>,<len>[,<remote IP>,<remote port>]:<data>
-
-			m_connId = m_pSerial->ParseInt();    // <ID>
-			m_pSerial->Read(&c, 1);
-			m_bufPos = m_pSerial->ParseInt();    // <len>
-			m_pSerial->Read(&c, 1);
-			m_remoteIp[0] = m_pSerial->ParseInt();    // <remote IP>
-			m_pSerial->Read(&c, 1);
-			m_remoteIp[1] = m_pSerial->ParseInt();
-			m_pSerial->Read(&c, 1);
-			m_remoteIp[2] = m_pSerial->ParseInt();
-			m_pSerial->Read(&c, 1);
-			m_remoteIp[3] = m_pSerial->ParseInt();
-			m_pSerial->Read(&c, 1);
-			m_pSerial->Read(&c, 1);
-			m_remotePort = m_pSerial->ParseInt();     // <remote port>
-
-			m_pSerial->Read(&c, 1);
-
-			LOGDEBUG("");
-			LOGDEBUG2DL("Data packet", m_connId, m_bufPos);
-
-			if (m_connId == connId || connId == 0)
-				return m_bufPos;
-		}
-	}
-	return 0;
+		uint8_t sock = (after >= MAX_SOCK_NUM) ? i - 1 : (after + i) % MAX_SOCK_NUM;
 
+		if (!m_pSockets[sock].rxData.IsEmpty())
+			return sock;
+	}
+	return SOCK_NOT_AVAIL;
 }
 
 bool EspDrv::getData(uint8_t connId, uint8_t *data, bool peek, bool* connClose)
 {
-	if (connId != m_connId)
+	if (connId >= MAX_SOCK_NUM)
 		return false;
 
-	long startTick = HAL_GetTick();
-	do
+	EspSocket *pSock = &m_pSockets[connId];
+
+	if (pSock->rxData.IsEmpty())
+		m_pEngine->Poll();
+
+	bool ok = peek ? pSock->rxData.Peek(data) : pSock->rxData.Pop(data);
+	if (!ok)
 	{
-		if (m_pSerial->Available())
-		{
-			if (peek)
-			{
-				*data = (char) m_pSerial->Peek();
-			}
-			else
-			{
-				*data = (char) m_pSerial->GetChar();
-			}
-			//Serial.print((char)*data);
+		*data = 0;
+		return false;
+	}
 
-			if (m_pSerial->Available())
-			{
-				// after the data packet a ",CLOSED" string may be received
-				// this means that the socket is now closed
-
-				HAL_Delay(5);
-
-				if (m_pSerial->Available())
-				{
-					//LOGDEBUG(".2");
-					//LOGDEBUG(espSerial->peek());
-
-					// 48 = '0'
-					if (m_pSerial->Peek() == ('0' + connId))	// QD convert to ASCII
-					{
-						int idx = readUntil(500, ",CLOSED\r\n", false);
-						if (idx != NUMESPTAGS)
-						{
-							LOGERROR("Tag CLOSED not found");
-						}
-
-						LOGDEBUG("Connection closed");
-
-						*connClose = true;
-					}
-				}
-			}
+	// the <id>,CLOSED notification following the data packet has
+	// already been seen by the engine, report it with the last byte
+	if (pSock->rxData.IsEmpty() && pSock->closed)
+	{
+		LOGDEBUG("Connection closed");
 
-			return true;
-		}
-	} while ((HAL_GetTick() - startTick) < 2000);
+		*connClose = true;
+	}
 
-	// timed out, reset the buffer
-	LOGERROR1D("TIMEOUT:", m_pSerial->Available());
+	return true;
+}
 
-	m_connId = 0;
-	*data = 0;
+int EspDrv::peekData(uint8_t sock, const uint8_t **ptr)
+{
+	if (sock >= MAX_SOCK_NUM)
+		return 0;
 
-	return false;
+	if (m_pSockets[sock].rxData.IsEmpty())
+		m_pEngine->Poll();
+
+	return m_pSockets[sock].rxData.PeekContiguous(ptr);
+}
+
+void EspDrv::consumeData(uint8_t sock, uint16_t len)
+{
+	if (sock >= MAX_SOCK_NUM)
+		return;
+
+	int size = m_pSockets[sock].rxData.Size();
+	m_pSockets[sock].rxData.Commit(len < size ? len : size);
+}
+
+int EspDrv::nextPacket(uint8_t sock, uint8_t *remoteIp, uint16_t *remotePort,
+		uint32_t *rxTick)
+{
+	if (sock >= MAX_SOCK_NUM)
+		return -1;
+
+	m_pEngine->Poll();
+
+	uint8_t rec[IPD_PACKET_SIZE];
+	if (m_pSockets[sock].packets.Read(rec, IPD_PACKET_SIZE) < IPD_PACKET_SIZE)
+		return -1;
+
+	*remotePort = rec[2] | (rec[3] << 8);
+	memcpy(remoteIp, &rec[4], WL_IPV4_LENGTH);
+	if (rxTick != NULL)
+		memcpy(rxTick, &rec[8], sizeof(*rxTick));
+
+	return rec[0] | (rec[1] << 8);
 }
 
 /**
@@ -765,12 +758,12 @@ bool EspDrv::getData(uint8_t connId, uint8_t *data, bool peek, bool* connClose)
  */
 int EspDrv::getDataBuf(uint8_t connId, uint8_t *buf, uint16_t bufSize)
 {
-	if (connId != m_connId)
-		return false;
+	if (connId >= MAX_SOCK_NUM)
+		return -1;
 
-	bufSize = m_pSerial->Read(buf, bufSize, 0);	// read no wait
+	m_pEngine->Poll();
 
-	return bufSize;
+	return m_pSockets[connId].rxData.Read(buf, bufSize);
 }
 
 bool EspDrv::sendData(uint8_t sock, const uint8_t *data, uint16_t len)
@@ -779,26 +772,13 @@ bool EspDrv::sendData(uint8_t sock, const uint8_t *data, uint16_t len)
 
 	LOGDEBUG2DD("> sendData:", sock, len);
 
-	sprintf(cmdBuf, "AT+CIPSEND=%d,%u\n", sock, len);
-	m_pSerial->Write((uint8_t*)cmdBuf, sizeof(cmdBuf));
-
-	// read chars until we see '>'
-
-	int idx = readUntil(1000, (char *) ">", false);
+	sprintf(cmdBuf, "AT+CIPSEND=%d,%u", sock, len);
 
-	// if something other timed out first then something other than NUMESPTAGS is returned for an error
-	if (idx != NUMESPTAGS)
-	{
-		LOGERROR("Data packet send error (1)");
-		return false;
-	}
-
-	m_pSerial->Write((uint8_t*)data, len, 1000);
-
-	idx = readUntil(2000);
+	// the payload goes out when the '>' prompt arrives
+	int idx = m_pEngine->Execute(cmdBuf, 2000, NULL, NULL, data, len);
 	if (idx != TAG_SENDOK)
 	{
-		LOGERROR("Data packet send error (2)");
+		LOGERROR1D("Data packet send error", idx);
 		return false;
 	}
 
@@ -813,33 +793,42 @@ bool EspDrv::sendData(uint8_t sock, const char *data, uint16_t len,
 
 	LOGDEBUG2DD("> sendData:", sock, len);
 
-	sprintf(cmdBuf, "AT+CIPSEND=%d,%u\n", sock, len);
-	m_pSerial->Write((uint8_t*)cmdBuf, strlen(cmdBuf));
-
-	int idx = readUntil(1000, (char *) ">", false);
+	// the CR/LF is part of the packet, announce it in the length
+	sprintf(cmdBuf, "AT+CIPSEND=%d,%u", sock, appendCrLf ? len + 2 : len);
 
-	if (idx != NUMESPTAGS)
+	int idx = m_pEngine->Execute(cmdBuf, 2000, NULL, NULL, (const uint8_t*) data,
+			len, appendCrLf);
+	if (idx != TAG_SENDOK)
 	{
-		LOGERROR("Data packet send error (1)");
+		LOGERROR1D("Data packet send error", idx);
 		return false;
 	}
 
-	m_pSerial->Write((uint8_t*)data, len, 1000);
+	return true;
+}
 
-	if (appendCrLf)
-	{
-		sprintf(cmdBuf, "\r\n");
-		m_pSerial->Write((uint8_t*)cmdBuf, strlen(cmdBuf));
-	}
+bool EspDrv::sendDataAsync(uint8_t sock, const uint8_t *data, uint16_t len,
+		AtDoneHandler onDone, void *ctx)
+{
+	char cmdBuf[32];
 
-	idx = readUntil(2000);
-	if (idx != TAG_SENDOK)
-	{
-		LOGERROR("Data packet send error (2)");
-		return false;
-	}
+	LOGDEBUG2DD("> sendDataAsync:", sock, len);
 
-	return true;
+	sprintf(cmdBuf, "AT+CIPSEND=%d,%u", sock, len);
+
+	return m_pEngine->Submit(cmdBuf, 2000, NULL, onDone, ctx, data, len);
+}
+
+bool EspDrv::sendDataUdpAsync(uint8_t sock, const char* host, uint16_t port,
+		const uint8_t *data, uint16_t len, AtDoneHandler onDone, void *ctx)
+{
+	LOGDEBUG2DD("> sendDataUdpAsync:", sock, len);
+
+	char cmdBuf[CMD_BUFFER_SIZE];
+	snprintf(cmdBuf, sizeof(cmdBuf), "AT+CIPSEND=%d,%u,\"%s\",%u", sock, len,
+			host, port);
+
+	return m_pEngine->Submit(cmdBuf, 2000, NULL, onDone, ctx, data, len);
 }
 
 bool EspDrv::sendDataUdp(uint8_t sock, const char* host, uint16_t port,
@@ -848,37 +837,31 @@ bool EspDrv::sendDataUdp(uint8_t sock, const char* host, uint16_t port,
 	LOGDEBUG2DD("> sendDataUdp:", sock, len);
 	LOGDEBUG2SD("> sendDataUdp:", host, port);
 
-	char cmdBuf[40];
-	sprintf(cmdBuf, "AT+CIPSEND=%d,%u,\"%s\",%u\n", sock, len, host, port);
-	m_pSerial->Write((uint8_t*)cmdBuf, strlen(cmdBuf));
-
-	int idx = readUntil(1000, (char *) ">", false);
-	if (idx != NUMESPTAGS)
-	{
-		LOGERROR("Data packet send error (1)");
-		return false;
-	}
-
-	m_pSerial->Write((uint8_t*)data, len);
+	char cmdBuf[CMD_BUFFER_SIZE];
+	snprintf(cmdBuf, sizeof(cmdBuf), "AT+CIPSEND=%d,%u,\"%s\",%u", sock, len,
+			host, port);
 
-	idx = readUntil(2000);
+	int idx = m_pEngine->Execute(cmdBuf, 2000, NULL, NULL, data, len);
 	if (idx != TAG_SENDOK)
 	{
-		LOGERROR("Data packet send error (2)");
+		LOGERROR1D("Data packet send error", idx);
 		return false;
 	}
 
 	return true;
 }
 
-void EspDrv::getRemoteIpAddress(IPAddress& ip)
+void EspDrv::getRemoteIpAddress(IPAddress& ip, uint8_t sock)
 {
-	ip = m_remoteIp;
+	if (sock < MAX_SOCK_NUM)
+		ip = m_pSockets[sock].remoteIp;
 }
 
-uint16_t EspDrv::getRemotePort()
+uint16_t EspDrv::getRemotePort(uint8_t sock)
 {
-	return m_remotePort;
+	if (sock >= MAX_SOCK_NUM)
+		return 0;
+	return m_pSockets[sock].remotePort;
 }
 
 ////////////////////////////////////////////////////////////////////////////
@@ -886,68 +869,38 @@ uint16_t EspDrv::getRemotePort()
 ////////////////////////////////////////////////////////////////////////////
 
 /*
- * Sends the AT command and stops if any of the TAGS is found.
+ * Sends the AT command and waits for its final result.
  * Extract the string enclosed in the passed tags and returns it in the outStr buffer.
+ * An endTag of "\r\n" takes the rest of the response line.
  * Returns true if the string is extracted, false if tags are not found of timed out.
  */
 bool EspDrv::sendCmdGet(const char* cmd, const char* startTag,
 		const char* endTag, char* outStr, int outStrLen)
 {
-	int idx;
-	bool ret = false;
+	CmdGetCtx get = { startTag, endTag, outStr, outStrLen, false };
 
 	outStr[0] = 0;
 
-	espEmptyBuf();
+	int idx = m_pEngine->Execute(cmd, 3000, cmdGetLine, &get);
 
-	LOGDEBUG("----------------------------------------------");
-	LOGDEBUG1(">>", cmd);
-
-	// send AT command to ESP
-	//espSerial->println(cmd);
-
-	// read result until the startTag is found
-	idx = readUntil(1000, startTag);
-
-	if (idx == NUMESPTAGS)
+	if (!get.found)
 	{
-		// clean the buffer to get a clean string
-		//m_pRingBuf->init();
-
-		// start tag found, search the endTag
-		idx = readUntil(500, endTag);
-
-		if (idx == NUMESPTAGS)
+		if (idx == TAG_TIMEOUT)
 		{
-			// end tag found
-			// copy result to output buffer avoiding overflow
-			m_pRingBuf->getStrN(outStr, strlen(endTag), outStrLen - 1);
-
-			// read the remaining part of the response
-			readUntil(2000);
-
-			ret = true;
+			// the command has not returned
+			LOGWARN("No tag found");
 		}
 		else
 		{
-			LOGWARN("End tag not found");
+			// the command has returned but no start tag is found
+			LOGDEBUG1D("No start tag found:", idx);
 		}
 	}
-	else if (idx >= 0 and idx < NUMESPTAGS)
-	{
-		// the command has returned but no start tag is found
-		LOGDEBUG1D("No start tag found:", idx);
-	}
-	else
-	{
-		// the command has returned but no tag is found
-		LOGWARN("No tag found");
-	}
 
 	LOGDEBUG1("---------------------------------------------- >", outStr);
 	LOGDEBUG("");
 
-	return ret;
+	return get.found;
 }
 
 /*
@@ -956,19 +909,7 @@ bool EspDrv::sendCmdGet(const char* cmd, const char* startTag,
  */
 int EspDrv::sendCmd(const char* cmd, int timeout)
 {
-	espEmptyBuf();
-
-	LOGDEBUG("----------------------------------------------");
-	LOGDEBUG1(">>", cmd);
-
-	m_pSerial->Write((uint8_t*) cmd, strlen(cmd), timeout);
-
-	int idx = readUntil(timeout);
-
-	LOGDEBUG1D("---------------------------------------------- >", idx);
-	LOGDEBUG("");
-
-	return idx;
+	return m_pEngine->Execute(cmd, timeout);
 }
 
 /*
@@ -985,84 +926,194 @@ int EspDrv::sendCmd(const char* cmd, int timeout, ...)
 	vsnprintf(cmdBuf, CMD_BUFFER_SIZE, (char*) cmd, args);
 	va_end(args);
 
-	espEmptyBuf();
+	return m_pEngine->Execute(cmdBuf, timeout);
+}
 
-	LOGDEBUG("----------------------------------------------");
-	LOGDEBUG1(">>", cmdBuf);
+// Discard everything received so far, used after the module has rebooted
+void EspDrv::espEmptyBuf(bool warn)
+{
+	int i = m_pSerial->Available();
 
-	println(cmdBuf);
+	if (i > 0 and warn == true)
+	{
+		LOGDEBUG("");
+		LOGDEBUG1D("Dirty characters in the serial buffer! >", i);
+	}
+	m_pSerial->Flush();
+	m_pEngine->ResetStream();
+}
 
-	int idx = readUntil(timeout);
+// Queues the record of a completely received datagram
+void EspDrv::packetDone(EspSocket *pSock)
+{
+	uint8_t rec[IPD_PACKET_SIZE];
 
-	LOGDEBUG1D("---------------------------------------------- >", idx);
-	LOGDEBUG("");
+	rec[0] = pSock->frameLen & 0xff;
+	rec[1] = pSock->frameLen >> 8;
+	rec[2] = pSock->remotePort & 0xff;
+	rec[3] = pSock->remotePort >> 8;
+	memcpy(&rec[4], pSock->remoteIp, WL_IPV4_LENGTH);
+	memcpy(&rec[8], &pSock->frameTick, sizeof(pSock->frameTick));
 
-	return idx;
+	pSock->packets.Write(rec, IPD_PACKET_SIZE);
 }
 
-// Read from serial until one of the tags is found
-// Returns:
-//   the index of the tag found in the ESPTAGS array
-//   -1 if no tag was found (timeout)
-int EspDrv::readUntil(unsigned int timeout, const char* tag, bool findTags)
+// Receives +IPD data and connection events sorted out by the command engine
+void EspDrv::urcHandler(void *ctx, const AtUrc &urc)
 {
-	m_pRingBuf->reset();
+	EspDrv *drv = (EspDrv *) ctx;
 
-	char c;
-	unsigned long start = HAL_GetTick();
-	int ret = -1;
-
-	while (((HAL_GetTick() - start) < timeout) && (ret < 0))
+	switch (urc.type)
 	{
-		if (m_pSerial->Available() != 0)
-		{
-			c = m_pSerial->GetChar();
-			// c = (char) m_espSerial->read();
-			LOGDEBUG0C(c);
+	case URC_IPD:
+	{
+		// format is : +IPD,<ID>,<len>[,<remote IP>,<remote port>]:<data>
+		if (urc.connId >= MAX_SOCK_NUM)
+			break;
+		EspSocket *pSock = &drv->m_pSockets[urc.connId];
 
-			if (tag != NULL)
-			{
-				if (m_pRingBuf->endsWith(tag))
-				{
-					ret = NUMESPTAGS;
-					//LOGDEBUG1("xxx");
-				}
-			}
-			if (findTags)
+		drv->m_connId = urc.connId;
+		memcpy(pSock->remoteIp, urc.remoteIp, WL_IPV4_LENGTH);
+		pSock->remotePort = urc.remotePort;
+		pSock->frameLen = urc.len;
+		pSock->frameLeft = urc.len;
+		pSock->frameTick = HAL_GetTick();
+		pSock->frameDrop = false;
+
+		if (pSock->mode == UDP_MODE)
+		{
+			// a datagram is kept whole or not at all
+			if (pSock->rxData.Free() < urc.len || pSock->packets.Free() < IPD_PACKET_SIZE)
 			{
-				for (int i = 0; i < NUMESPTAGS; i++)
-				{
-					if (m_pRingBuf->endsWith(ESPTAGS[i]))
-					{
-						ret = i;
-						break;
-					}
-				}
+				LOGERROR1D("Datagram dropped on socket", urc.connId);
+				pSock->frameDrop = true;
 			}
+			else if (urc.len == 0)
+				drv->packetDone(pSock);
 		}
+		break;
 	}
 
-	if ((HAL_GetTick() - start) >= timeout)
+	case URC_IPD_DATA:
 	{
-		LOGWARN(">>> TIMEOUT >>>");
+		// every chunk carries the id of its frame, the payload goes to its socket
+		if (urc.connId >= MAX_SOCK_NUM)
+			break;
+		EspSocket *pSock = &drv->m_pSockets[urc.connId];
+
+		pSock->frameLeft -= (urc.dataLen < pSock->frameLeft) ? urc.dataLen : pSock->frameLeft;
+		if (pSock->frameDrop)
+			break;
+
+		if (pSock->rxData.Write(urc.data, urc.dataLen) < urc.dataLen)
+			LOGERROR1D("Receive buffer overrun on socket", urc.connId);
+
+		// the datagram is readable once all of it is in
+		if (pSock->mode == UDP_MODE && pSock->frameLeft == 0)
+			drv->packetDone(pSock);
+		break;
 	}
 
-	return ret;
+	case URC_CONNECT:
+		if (urc.connId < MAX_SOCK_NUM)
+			drv->m_pSockets[urc.connId].closed = false;
+		break;
+
+	case URC_CLOSED:
+		LOGDEBUG1D("Connection closed", urc.connId);
+		if (urc.connId < MAX_SOCK_NUM)
+			drv->m_pSockets[urc.connId].closed = true;
+		break;
+
+	case URC_WIFI_GOT_IP:
+		drv->m_linkStatus = WL_CONNECTED;
+		break;
+
+	case URC_WIFI_DISCONNECT:
+		LOGINFO("WiFi disconnected");
+		drv->m_linkStatus = WL_DISCONNECTED;
+		break;
+
+	default:
+		break;
+	}
 }
 
-void EspDrv::espEmptyBuf(bool warn)
+// Extracts the string between startTag and endTag from a response line
+void EspDrv::cmdGetLine(void *ctx, const char *line, int len)
 {
-	int i = 0;
+	CmdGetCtx *get = (CmdGetCtx *) ctx;
 
-	HAL_Delay(1000);
-	i = m_pSerial->Available();
+	if (get->found)
+		return;
 
-	if (i > 0 and warn == true)
+	const char *start = strstr(line, get->startTag);
+	if (start == NULL)
+		return;
+	start += strlen(get->startTag);
+
+	// the engine has stripped the line end already
+	const char *end;
+	if (strcmp(get->endTag, "\r\n") == 0)
+		end = line + len;
+	else
+		end = strstr(start, get->endTag);
+
+	if (end == NULL)
 	{
-		LOGDEBUG("");
-		LOGDEBUG1D("Dirty characters in the serial buffer! >", i);
+		LOGWARN("End tag not found");
+		return;
 	}
-	m_pSerial->Flush();
+
+	// copy result to output buffer avoiding overflow
+	int n = end - start;
+	if (n > get->outStrLen - 1)
+		n = get->outStrLen - 1;
+	memcpy(get->outStr, start, n);
+	get->outStr[n] = 0;
+
+	get->found = true;
+}
+
+// Parses one +CWLAP:(<ecn>,"<ssid>",<rssi>,...) line
+void EspDrv::scanLine(void *ctx, const char *line, int len)
+{
+	ScanCtx *scan = (ScanCtx *) ctx;
+	EspDrv *drv = scan->drv;
+
+	if (strncmp(line, "+CWLAP:(", 8) != 0)
+		return;
+
+	if (scan->count == WL_NETWORKS_LIST_MAXNUM)
+		return;
+
+	char *p;
+	uint8_t enc = (uint8_t) strtol(line + 8, &p, 10);
+
+	// discard , and " characters
+	if (p[0] != ',' || p[1] != '"')
+		return;
+	p += 2;
+
+	char *ssid = drv->m_networkSsid[scan->count];
+	int n = 0;
+
+	memset(ssid, 0, WL_SSID_MAX_LENGTH);
+	while (*p != 0 && *p != '"')
+	{
+		if (n < WL_SSID_MAX_LENGTH - 1)
+			ssid[n++] = *p;
+		p++;
+	}
+
+	// discard " and , characters
+	if (p[0] != '"' || p[1] != ',')
+		return;
+
+	drv->m_networkEncr[scan->count] = enc;
+	drv->m_networkRssi[scan->count] = strtol(p + 2, NULL, 10);
+
+	scan->count++;
 }
 
 bool EspDrv::available(void)
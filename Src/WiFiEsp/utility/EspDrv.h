@@ -27,9 +27,9 @@ along with The Arduino WiFiEsp library.  If not, see
 #include "IPAddress.h"
 
 
-#include "queue.h"
-#include "serial.h"
-#include "RingBuffer.h"
+#include "SpscRing.h"
+#include "Serial.h"
+#include "EspCmdEngine.h"
 
 
 // Maximum size of a SSID
@@ -59,11 +59,36 @@ along with The Arduino WiFiEsp library.  If not, see
 
 
 // maximum size of AT command
-#define CMD_BUFFER_SIZE 200
+#define CMD_BUFFER_SIZE AT_CMD_BUFFER_SIZE
+
+// size of the buffer holding received +IPD payload, one per socket
+#define IPD_BUFFER_SIZE 1024
+
+// UDP datagrams remembered per socket, IPD_PACKET_SIZE bytes each
+#define IPD_PACKET_RING		128		// power of two, 10 records
+#define IPD_PACKET_SIZE		12		// length, remote port, remote IP, receive tick
 
 
 typedef enum eProtMode {TCP_MODE, UDP_MODE, SSL_MODE} tProtMode;
 
+// receive side of one connection, filled from its +IPD frames
+struct EspSocket
+{
+	SpscRing<IPD_BUFFER_SIZE> rxData;		// payload not yet read
+	bool 	closed;							// <id>,CLOSED was reported
+	uint8_t remoteIp[WL_IPV4_LENGTH];		// sender of the last frame, with AT+CIPDINFO=1
+	uint16_t remotePort;
+	uint8_t mode;							// tProtMode of the connection
+
+	// UDP only: one record per complete datagram in rxData, so that the
+	// packet boundaries survive the byte stream
+	SpscRing<IPD_PACKET_RING> packets;
+	uint16_t frameLen;						// size of the frame being received
+	uint32_t frameTick;						// HAL tick its +IPD header came in
+	uint16_t frameLeft;						// its bytes still to come
+	bool 	frameDrop;						// no room, the frame is skipped
+};
+
 
 typedef enum {
         WL_FAILURE = -1,
@@ -161,12 +186,22 @@ public:
     int8_t disconnect();
 
     /*
-     *
+     * Asks the module with AT+CIPSTATUS, which blocks for a round trip, and
+     * updates the link status kept by linkStatus().
      *
      * return: one value of wl_status_t enum
      */
     uint8_t getConnectionStatus();
 
+    /*
+     * The station link as last reported: set by connecting and by
+     * getConnectionStatus(), then kept up to date by the WIFI GOT IP and
+     * WIFI DISCONNECT messages of the module. Costs no AT command.
+     *
+     * return: WL_CONNECTED, WL_DISCONNECTED or WL_IDLE_STATUS before the first report
+     */
+    uint8_t linkStatus() { return m_linkStatus; }
+
     /*
      * Get the interface MAC address.
      *
@@ -278,25 +313,78 @@ public:
     bool sendData(uint8_t sock, const uint8_t *data, uint16_t len);
     bool sendData(uint8_t sock, const char *data, uint16_t len, bool appendCrLf=false);
 	bool sendDataUdp(uint8_t sock, const char* host, uint16_t port, const uint8_t *data, uint16_t len);
+
+    /*
+     * Queues data for a socket and returns at once, the transfer runs from
+     * poll(). The data is sent straight from the caller's buffer, it must stay
+     * valid until onDone is called with the result (TAG_SENDOK on success).
+     * Returns false if the command queue is full.
+     */
+    bool sendDataAsync(uint8_t sock, const uint8_t *data, uint16_t len,
+    		AtDoneHandler onDone, void *ctx);
+    // same for one UDP datagram to host:port
+    bool sendDataUdpAsync(uint8_t sock, const char* host, uint16_t port,
+    		const uint8_t *data, uint16_t len, AtDoneHandler onDone, void *ctx);
     uint16_t availData(uint8_t connId);
 
+    /*
+     * Returns the next socket after 'after' (round robin) that has received
+     * data, SOCK_NOT_AVAIL if there is none.
+     */
+    uint8_t nextDataSocket(uint8_t after = SOCK_NOT_AVAIL);
+
+    /*
+     * Zero copy access to the received data of a socket: peekData() returns
+     * the number of contiguous bytes at *ptr, consumeData() releases len of
+     * them. The span ends at the wrap point of the buffer, a second call
+     * returns the rest.
+     */
+    int peekData(uint8_t sock, const uint8_t **ptr);
+    void consumeData(uint8_t sock, uint16_t len);
+
+    /*
+     * UDP only: dequeues the next complete datagram of a socket and returns
+     * its length, -1 if there is none. Its payload is the next 'length' bytes
+     * of the socket data. rxTick gets the HAL tick at which its +IPD header
+     * was received.
+     */
+    int nextPacket(uint8_t sock, uint8_t *remoteIp, uint16_t *remotePort,
+    		uint32_t *rxTick = NULL);
+
 	bool ping(const char *host);
     void reset();
 
-    void getRemoteIpAddress(IPAddress& ip);
-    uint16_t getRemotePort();
+    void getRemoteIpAddress(IPAddress& ip, uint8_t sock);
+    uint16_t getRemotePort(uint8_t sock);
     uint8_t getConnId() {return m_connId;};
 
+    /*
+     * Process everything received from the module: command responses,
+     * +IPD data and connection events. Call it regularly from the main loop.
+     */
+    void poll();
+
+    /*
+     * True when nothing is in flight: no command, no +IPD frame being
+     * received and no received data left unread. The MCU must only stop
+     * then, and only in STOP1, where the UART can wake it up.
+     */
+    bool isIdle();
+
+    /*
+     * Lets data from the module wake the MCU from STOP1, see Serial::StopWake.
+     */
+    void stopWake(bool enable) { m_pSerial->StopWake(enable); }
+
 ////////////////////////////////////////////////////////////////////////////////
 
 private:
 	UART_HandleTypeDef *m_espUART;
 	Serial *m_pSerial;
-	long m_bufPos;
-	uint8_t m_connId;
-
-	uint16_t m_remotePort;
-	uint8_t  m_remoteIp[WL_IPV4_LENGTH];
+	EspCmdEngine *m_pEngine;
+	EspSocket *m_pSockets;		// MAX_SOCK_NUM receive buffers
+	uint8_t m_connId;			// socket of the last +IPD frame
+	uint8_t m_linkStatus;		// wl_status_t of the station link, see linkStatus()
 
 
 	// firmware version string
@@ -313,7 +401,6 @@ private:
 	uint8_t m_bssid[WL_MAC_ADDR_LENGTH];
 	uint8_t m_mac[WL_MAC_ADDR_LENGTH];
 	uint8_t m_localIp[WL_IPV4_LENGTH];
-	RingBuffer *m_pRingBuf;
 
 	// ring buffers are in serial class
 
@@ -323,10 +410,13 @@ private:
 
 	bool sendCmdGet(const char* cmd, const char* startTag, const char* endTag, char* outStr, int outStrLen);
 
-	int readUntil(unsigned int timeout, const char* tag=NULL, bool findTags=true);
-
 	void espEmptyBuf(bool warn=true);
 
+	static void urcHandler(void *ctx, const AtUrc &urc);
+	void packetDone(EspSocket *pSock);
+	static void cmdGetLine(void *ctx, const char *line, int len);
+	static void scanLine(void *ctx, const char *line, int len);
+
 	int timedRead();
 	int print(const char *str, uint32_t timeout = 1000);
 	int println(const char *str, uint32_t timeout = 1000);
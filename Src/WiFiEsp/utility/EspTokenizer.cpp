@@ -0,0 +1,233 @@
+/*
+ * EspTokenizer.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ *
+ *  The transition table is generated by the compiler from ESP_TOKENS. Every
+ *  tag starts with '\n' so it only matches a whole line. The tags are put
+ *  into a trie, then the failure links are computed breadth first and folded
+ *  into the missing transitions (Aho-Corasick), which leaves a plain DFA.
+ *  Bytes that occur in no tag share character class 0 to keep the table
+ *  small.
+ */
+
+#include <string.h>
+
+#include "EspTokenizer.h"
+
+namespace
+{
+
+// tags in TokenEnum order
+constexpr const char* ESP_TOKENS[] =
+{
+	"\nOK\r\n",
+	"\nERROR\r\n",
+	"\nFAIL\r\n",
+	"\nSEND OK\r\n",
+	"\nSEND FAIL\r\n",
+	"\nWIFI DISCONNECT\r\n",
+	"\nWIFI CONNECTED\r\n",
+	"\nWIFI GOT IP\r\n",
+	"\n+IPD,",
+	"\n>"
+};
+
+constexpr int NUM_TOKENS = sizeof(ESP_TOKENS) / sizeof(ESP_TOKENS[0]);
+
+static_assert(NUM_TOKENS == TOK_LINE, "ESP_TOKENS does not match TokenEnum");
+
+// number of distinct bytes in the tags plus class 0 for all others
+constexpr int countClasses()
+{
+	bool seen[128] = { };
+	int n = 1;
+
+	for (int p = 0; p < NUM_TOKENS; p++)
+	{
+		for (const char *s = ESP_TOKENS[p]; *s; s++)
+		{
+			if (!seen[(int) *s])
+			{
+				seen[(int) *s] = true;
+				n++;
+			}
+		}
+	}
+	return n;
+}
+
+// upper bound of the trie size, tags sharing a prefix need fewer
+constexpr int countStates()
+{
+	int n = 1;
+
+	for (int p = 0; p < NUM_TOKENS; p++)
+	{
+		for (const char *s = ESP_TOKENS[p]; *s; s++)
+			n++;
+	}
+	return n;
+}
+
+constexpr int NUM_CLASSES = countClasses();
+constexpr int NUM_STATES = countStates();
+
+static_assert(NUM_STATES <= 256, "tag table too large for uint8_t states");
+
+struct EspTokenTable
+{
+	uint8_t next[NUM_STATES][NUM_CLASSES];
+	int8_t accept[NUM_STATES];
+	uint8_t cls[128];
+};
+
+constexpr EspTokenTable makeTable()
+{
+	EspTokenTable t = { };
+	uint8_t fail[NUM_STATES] = { };
+	uint8_t queue[NUM_STATES] = { };
+	int classes = 1;
+	int states = 1;
+
+	for (int s = 0; s < NUM_STATES; s++)
+		t.accept[s] = -1;
+
+	// goto function, a zero transition means no child yet
+	for (int p = 0; p < NUM_TOKENS; p++)
+	{
+		int s = 0;
+
+		for (const char *c = ESP_TOKENS[p]; *c; c++)
+		{
+			if (t.cls[(int) *c] == 0)
+				t.cls[(int) *c] = classes++;
+
+			uint8_t &to = t.next[s][t.cls[(int) *c]];
+			if (to == 0)
+				to = states++;
+			s = to;
+		}
+		t.accept[s] = p;
+	}
+
+	// breadth first, every state inherits the transitions of its failure state
+	int head = 0;
+	int tail = 0;
+
+	for (int c = 0; c < NUM_CLASSES; c++)
+	{
+		if (t.next[0][c] != 0)
+			queue[tail++] = t.next[0][c];
+	}
+
+	while (head < tail)
+	{
+		int r = queue[head++];
+
+		if (t.accept[r] < 0)
+			t.accept[r] = t.accept[fail[r]];
+
+		for (int c = 0; c < NUM_CLASSES; c++)
+		{
+			uint8_t u = t.next[r][c];
+
+			if (u != 0)
+			{
+				fail[u] = t.next[fail[r]][c];
+				queue[tail++] = u;
+			}
+			else
+				t.next[r][c] = t.next[fail[r]][c];
+		}
+	}
+
+	return t;
+}
+
+constexpr EspTokenTable TABLE = makeTable();
+
+// state after a line end
+constexpr uint8_t LINE_START = TABLE.next[0][TABLE.cls['\n']];
+
+}
+
+EspTokenizer::EspTokenizer()
+{
+	m_truncated = 0;
+	Reset();
+}
+
+void EspTokenizer::Reset()
+{
+	m_state = LINE_START;
+	m_ipdHeader = false;
+	m_lineDone = false;
+	m_overflow = false;
+	m_lineLen = 0;
+	m_line[0] = 0;
+}
+
+int EspTokenizer::Feed(uint8_t c)
+{
+	if (m_lineDone)
+	{
+		m_lineDone = false;
+		m_overflow = false;
+		m_lineLen = 0;
+	}
+
+	m_state = TABLE.next[m_state][c < 128 ? TABLE.cls[c] : 0];
+	int tag = TABLE.accept[m_state];
+
+	if (m_ipdHeader)
+	{
+		// +IPD,<id>,<len>[,<remote IP>,<remote port>]:
+		if (c == ':')
+		{
+			m_ipdHeader = false;
+			m_lineDone = true;
+			return TOK_IPD;
+		}
+	}
+	else if (tag == TOK_IPD)
+	{
+		m_ipdHeader = true;
+		m_lineLen = 0;
+		m_line[0] = 0;
+		return TOK_NONE;
+	}
+	else if (tag == TOK_PROMPT)
+	{
+		// not followed by a line end
+		m_lineDone = true;
+		return TOK_PROMPT;
+	}
+	else if (c == '\n')
+	{
+		m_lineDone = true;
+
+		// a tag always ends on the line end and replaces the line
+		if (tag >= 0)
+			return tag;
+
+		return m_lineLen > 0 ? TOK_LINE : TOK_NONE;
+	}
+
+	if (c == '\r')
+		return TOK_NONE;
+
+	if (m_lineLen < AT_LINE_BUFFER_SIZE - 1)
+	{
+		m_line[m_lineLen++] = c;
+		m_line[m_lineLen] = 0;
+	}
+	else if (!m_overflow)
+	{
+		m_overflow = true;
+		m_truncated++;
+	}
+
+	return TOK_NONE;
+}
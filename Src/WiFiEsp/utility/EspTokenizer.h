@@ -0,0 +1,77 @@
+/*
+ * EspTokenizer.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef WIFIESP_UTILITY_ESPTOKENIZER_H_
+#define WIFIESP_UTILITY_ESPTOKENIZER_H_
+
+#include <stdint.h>
+
+// longest response line handed out, longer lines are truncated
+#define AT_LINE_BUFFER_SIZE		128
+
+// tags recognised in the response stream, in the order of ESP_TOKENS
+typedef enum
+{
+	TOK_OK = 0,
+	TOK_ERROR,
+	TOK_FAIL,
+	TOK_SENDOK,
+	TOK_SENDFAIL,
+	TOK_WIFI_DISCONNECT,
+	TOK_WIFI_CONNECTED,
+	TOK_WIFI_GOT_IP,
+	TOK_IPD,				// +IPD header, Line() holds the text between "+IPD," and ':'
+	TOK_PROMPT,				// '>' of AT+CIPSEND
+	TOK_LINE,				// any other response line, CR/LF stripped
+	TOK_NONE
+} TokenEnum;
+
+//////////////////////////////////////////////////////////////////////////////
+//	class EspTokenizer
+//
+//	single pass tokenizer for the ESP8266 response stream. The tags are matched
+//	by a DFA built at compile time from ESP_TOKENS (Aho-Corasick goto function
+//	with the failure links folded in), so every received byte costs one table
+//	lookup no matter how many tags there are. Tags are anchored at the start
+//	of a line.
+//
+class EspTokenizer
+{
+public:
+	EspTokenizer();
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	int Feed(uint8_t c);
+	//
+	//	advances the automaton by one received byte
+	//
+	//	returns TOK_NONE until a tag or a line is complete
+	//
+	int Feed(uint8_t c);
+
+	// text of the last TOK_LINE or TOK_IPD, zero terminated
+	const char *Line() { return m_line; }
+	int LineLen() { return m_lineLen; }
+
+	// number of lines that did not fit into the line buffer
+	uint32_t Truncated() { return m_truncated; }
+
+	// start over at the beginning of a line, e.g. after raw +IPD payload
+	void Reset();
+
+private:
+	uint8_t 	m_state;
+	bool 		m_ipdHeader;		// collecting +IPD header up to ':'
+	bool 		m_lineDone;			// m_line was handed out, start a new one
+	bool 		m_overflow;
+
+	char 		m_line[AT_LINE_BUFFER_SIZE];
+	int 		m_lineLen;
+	uint32_t 	m_truncated;
+};
+
+#endif /* WIFIESP_UTILITY_ESPTOKENIZER_H_ */
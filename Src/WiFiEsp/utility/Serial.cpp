@@ -5,13 +5,93 @@
  *      Author: Archer
  */
 
+#include <string.h>
+#include <atomic>
+
 #include <utility/Serial.h>
 
-Queue *TxBuf = new Queue(256);
-Queue *RxBuf = new Queue(256);
+#include "DmaRxRing.h"
+
+// the TX ring is filled by Write and drained by the TXE interrupt, the RX
+// ring the other way around
+static SpscRing<SERIAL_TX_SIZE> TxBuf;
+static SpscRing<SERIAL_RX_SIZE> RxBuf;
+
+static SerialStats Stats;
+
+// the UART the rings belong to, the HAL callbacks are shared by all UARTs
+static UART_HandleTypeDef *SerialUart = NULL;
+
+// transmit mode of the Serial, for the interrupt handler; in DMA mode
+// TxBuf holds spans the DMA has not sent yet
+static volatile enumTxMode SerialTxMode = txModeIrq;
+
+// circular DMA receive buffer, only used in rxModeDma
+static DMA_HandleTypeDef DmaRx;
+static uint8_t DmaRxBuf[SERIAL_DMA_RX_SIZE];
+static DmaRxRing RxRing(DmaRxBuf, sizeof(DmaRxBuf));
+
+// DMA transmit descriptors, queued by the main loop and retired by the
+// transmit complete interrupt. Write queues spans of TxBuf, WriteRef the
+// caller's buffer.
+struct TxDesc
+{
+	const uint8_t 	*data;
+	uint16_t 		len;
+	bool 			ring;		// data is a span of TxBuf
+	SerialTxDone 	done;
+	void 			*ctx;
+};
+
+static_assert((SERIAL_TX_DESC & (SERIAL_TX_DESC - 1)) == 0, "SERIAL_TX_DESC must be a power of two");
+
+static DMA_HandleTypeDef DmaTx;
+static TxDesc TxDescs[SERIAL_TX_DESC];
+static std::atomic<uint32_t> TxDescHead(0);		// next free, owned by the main loop
+static std::atomic<uint32_t> TxDescTail(0);		// on the wire, owned by the interrupt
+static volatile bool TxDmaBusy = false;
 
 ////////////////////////////////////// INTERRUPT HANDLER /////////////////////////////////////
 
+// moves a chunk of the DMA buffer into the receive queue
+static void RxChunk(void *ctx, const uint8_t *data, int len)
+{
+	Stats.overruns += len - RxBuf.Write(data, len);
+	Stats.bytes += len;
+}
+
+// starts the DMA on the oldest descriptor, the DMA interrupt must be kept out
+static void TxDmaStart(UART_HandleTypeDef *uart)
+{
+	uint32_t tail = TxDescTail.load(std::memory_order_relaxed);
+
+	if (TxDmaBusy || (TxDescHead.load(std::memory_order_acquire) == tail))
+		return;
+
+	TxDesc *desc = &TxDescs[tail & (SERIAL_TX_DESC - 1)];
+
+	TxDmaBusy = true;
+	if (HAL_UART_Transmit_DMA(uart, (uint8_t *) desc->data, desc->len) != HAL_OK)
+		TxDmaBusy = false;		// UART busy, the next kick retries
+}
+
+static void TxDmaKick(UART_HandleTypeDef *uart)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	TxDmaStart(uart);
+	__set_PRIMASK(primask);
+}
+
+static void DmaRxEvent(UART_HandleTypeDef *uart)
+{
+	int pos = SERIAL_DMA_RX_SIZE - __HAL_DMA_GET_COUNTER(uart->hdmarx);
+
+	if (RxRing.Advance(pos, RxChunk, NULL) > 0)
+		Stats.interrupts++;
+}
+
 extern "C"
 {
 	void Serial_IRQHandler(UART_HandleTypeDef *uart)
@@ -21,26 +101,23 @@ extern "C"
 
 
 		ISR = uart->Instance->ISR;								// read interrupt and status register
-		if (ISR & USART_ISR_RXNE)
+		// in DMA mode RXNE is only set until the DMA has fetched the byte
+		if ((ISR & USART_ISR_RXNE) && (uart->Instance->CR1 & USART_CR1_RXNEIE))
 		{                  // read interrupt
 			data = (uint8_t)(uart->Instance->RDR & 0xff);				// read the register clears the interrupt
-			enumErrFlag error = (enumErrFlag)(ISR & 0x0F);				// bottom 4 bit have receive error bits
 
-			if (!RxBuf->IsFull())
-			{
-				RxBuf->Push(data);
-				if(error != 0)
-					RxBuf->SetError(error);
-			}
-			else
-				RxBuf->SetError(errOverrun);
+			Stats.interrupts++;
+			Stats.bytes++;
+			if (!RxBuf.Push(data))
+				Stats.overruns++;
 
 		}
-		if (ISR & USART_ISR_TXE)
+		// TXE is set whenever TDR is empty, it is only ours while TXEIE is on
+		if ((ISR & USART_ISR_TXE) && (uart->Instance->CR1 & USART_CR1_TXEIE)
+				&& (SerialTxMode != txModeDma))
 		{
-			if (!TxBuf->IsEmpty())
+			if (TxBuf.Pop(&data))
 			{
-				data = TxBuf->Pop();
 				uart->Instance->TDR = (data & 0xFF);
 			}
 			else
@@ -50,19 +127,104 @@ extern "C"
 			}
 		}
 	}
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	void Serial_UartIRQHandler(UART_HandleTypeDef *uart);
+	//
+	//	called from the USART interrupt ahead of HAL_UART_IRQHandler. Receive
+	//	errors are counted and cleared here, the HAL would otherwise abort the
+	//	reception on an overrun. In DMA mode an IDLE line hands over whatever
+	//	the DMA has received so far.
+	//
+	void Serial_UartIRQHandler(UART_HandleTypeDef *uart)
+	{
+		unsigned int ISR = uart->Instance->ISR;
+		enumErrFlag error = (enumErrFlag)(ISR & 0x0F);				// bottom 4 bit have receive error bits
+
+		if (error != errNone)
+		{
+			if (error & errOverrun)
+				Stats.overruns++;
+			if (error & (errParity | errFrame | errNoise))
+				Stats.errors++;
+			uart->Instance->ICR = USART_ICR_PECF | USART_ICR_FECF | USART_ICR_NCF | USART_ICR_ORECF;
+		}
+
+		if ((ISR & USART_ISR_IDLE) && (uart->Instance->CR1 & USART_CR1_IDLEIE))
+		{
+			uart->Instance->ICR = USART_ICR_IDLECF;
+			DmaRxEvent(uart);
+		}
+	}
+
+	// half and full transfer of the circular receive DMA
+	void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *uart)
+	{
+		if (uart == SerialUart)
+			DmaRxEvent(uart);
+	}
+
+	void HAL_UART_RxCpltCallback(UART_HandleTypeDef *uart)
+	{
+		if (uart == SerialUart)
+			DmaRxEvent(uart);
+	}
+
+	// the last byte of a DMA transmission has left the shift register
+	void HAL_UART_TxCpltCallback(UART_HandleTypeDef *uart)
+	{
+		if (uart != SerialUart)
+			return;
+
+		uint32_t tail = TxDescTail.load(std::memory_order_relaxed);
+		TxDesc *desc = &TxDescs[tail & (SERIAL_TX_DESC - 1)];
+		SerialTxDone done = desc->done;
+		void *ctx = desc->ctx;
+
+		if (desc->ring)
+			TxBuf.Commit(desc->len);
+		TxDescTail.store(tail + 1, std::memory_order_release);
+
+		TxDmaBusy = false;
+		TxDmaStart(uart);
+
+		if (done != NULL)
+			done(ctx);
+	}
 }
 
 ////////////////////////////////////// Serial Class ////////////////////////////////////////////
 
-Serial::Serial(UART_HandleTypeDef *uart, int txSize, int rxSize)
+Serial::Serial(UART_HandleTypeDef *uart, enumRxMode rxMode, enumTxMode txMode)
 {
 	m_uart = uart;
+	SerialUart = uart;
+	m_rxMode = rxMode;
+	m_txMode = txMode;
+	SerialTxMode = txMode;
 
 	// init HAL Uart -- done by STM32Cube code
-	TxBuf->Init();
-	RxBuf->Init();
+	TxBuf.Clear();
+	RxBuf.Clear();
 	uart->RxISR = Serial_IRQHandler;
 	uart->TxISR = Serial_IRQHandler;
+
+	// wake up on a start bit, the UART is disabled meanwhile so this comes
+	// before the DMA is started
+	UART_WakeUpTypeDef wakeUp = {0};
+
+	wakeUp.WakeUpEvent = UART_WAKEUP_ON_STARTBIT;
+	HAL_UARTEx_StopModeWakeUpSourceConfig(uart, wakeUp);
+	// EXTI line 27 lets the USART2 wake up interrupt end STOP1
+	SET_BIT(EXTI->IMR1, EXTI_IMR1_IM27);
+
+	if (m_rxMode == rxModeDma)
+		StartRxDma();
+	else
+		__HAL_UART_ENABLE_IT(uart, UART_IT_RXNE);
+
+	if (m_txMode == txModeDma)
+		StartTxDma();
 }
 
 Serial::~Serial()
@@ -90,32 +252,43 @@ int Serial::Read(uint8_t *ptr, int  count, int waitMs)
 	int cnt = 0;
 	unsigned int startTick = HAL_GetTick();
 
-	for(cnt = 0; cnt < count; )
+	while (cnt < count)
 	{
-		while(Available() && (cnt < count))
-		{
-			*(ptr + cnt) = RxBuf->Pop();
-			cnt++;
-		}
-		if((cnt < count) && (waitMs < 0))
-			continue;
-		if((cnt < count) && (waitMs > 0))
-		{
-			unsigned int curTick = HAL_GetTick();
-			if((int)(curTick - startTick) > waitMs)
-				break;
-		}
+		cnt += RxBuf.Read(ptr + cnt, count - cnt);
+		if ((cnt == count) || (waitMs == 0))
+			break;
+		if ((waitMs > 0) && ((int)(HAL_GetTick() - startTick) > waitMs))
+			break;
 	}
 	return cnt;
 }
 
 uint8_t Serial::GetChar(void)
 {
-	if(Available() > 0)
-		return RxBuf->Pop();
+	uint8_t data = 0;
 
-	return 0;
+	RxBuf.Pop(&data);
+	return data;
 }
+
+uint8_t Serial::Peek(void)
+{
+	uint8_t data = 0;
+
+	RxBuf.Peek(&data);
+	return data;
+}
+
+int Serial::PeekContiguous(const uint8_t **ptr)
+{
+	return RxBuf.PeekContiguous(ptr);
+}
+
+void Serial::Commit(int len)
+{
+	RxBuf.Commit(len);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Write(uint8_t *ptr, int  count, int waitMs);
 //
@@ -138,23 +311,81 @@ int Serial::Write(uint8_t *ptr, int count, int waitMs)
 	int cnt = 0;
 	unsigned int startTick = HAL_GetTick();
 
-	for(cnt = 0; cnt < count; )
+	while (cnt < count)
 	{
-		if(!TxBuf->IsFull())
-			TxBuf->Push(*(ptr + cnt++));
-		else if (waitMs == 0)
+		int n;
+
+		if (m_txMode == txModeDma)
+		{
+			// copy into the TX ring and let the DMA send it from there
+			uint8_t *span;
+
+			n = TxBuf.PeekWritable(&span);
+			if (n > count - cnt)
+				n = count - cnt;
+			if ((n > 0) && (TxPending() < SERIAL_TX_DESC))
+			{
+				memcpy(span, ptr + cnt, n);
+				TxBuf.CommitWrite(n);
+				QueueTx(span, n, true, NULL, NULL);
+			}
+			else
+				n = 0;
+		}
+		else
+		{
+			n = TxBuf.Write(ptr + cnt, count - cnt);
+			if (n > 0)
+				m_uart->Instance->CR1 |= USART_CR1_TXEIE;	// TXE fires right away if the UART is idle
+		}
+
+		cnt += n;
+		if ((cnt == count) || (waitMs == 0))
 			break;
-		else if(waitMs < 0)
-			continue;
-		else if((int)(startTick - HAL_GetTick()) > waitMs)
+		if ((waitMs > 0) && ((int)(HAL_GetTick() - startTick) > waitMs))
 			break;
 	}
-	if(TxBuf->Size() > 0)
+	return cnt;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// WriteRef(const uint8_t *ptr, int count, SerialTxDone done, void *ctx, int waitMs);
+//
+// queues a buffer for transmission without copying it. In DMA mode the
+// DMA reads straight from ptr, so the buffer must stay valid until done
+// is called. Without DMA the data is copied like Write does and done
+// is called before WriteRef returns.
+//
+//	returns false if the buffer could not be queued
+//
+bool Serial::WriteRef(const uint8_t *ptr, int count, SerialTxDone done, void *ctx,
+		int waitMs)
+{
+	if ((m_txMode != txModeDma) || (count <= 0))
 	{
-		USART2->TDR = TxBuf->Pop();	// send the data
-		USART2->CR1 |= USART_CR1_TXEIE;	// enable TX interrupt if data to send
+		if (Write((uint8_t *) ptr, count, waitMs) != count)
+			return false;
+		if (done != NULL)
+			done(ctx);
+		return true;
 	}
-	return cnt;
+
+	unsigned int startTick = HAL_GetTick();
+
+	while (!QueueTx(ptr, count, false, done, ctx))
+	{
+		if (waitMs == 0)
+			return false;
+		if ((waitMs > 0) && ((int)(HAL_GetTick() - startTick) > waitMs))
+			return false;
+	}
+	return true;
+}
+
+int Serial::TxPending()
+{
+	return (int) (TxDescHead.load(std::memory_order_relaxed)
+			- TxDescTail.load(std::memory_order_acquire));
 }
 
 
@@ -166,7 +397,7 @@ int Serial::Write(uint8_t *ptr, int count, int waitMs)
 //
 int  Serial::Available()
 {
-	return RxBuf->Size();
+	return RxBuf.Size();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -197,8 +428,7 @@ unsigned int Serial::ParseInt(uint8_t radix, int waitMs)
 	// get the character string
 	while(cnt < (int)sizeof(buf))
 	{
-		if(!RxBuf->IsEmpty())
-			data = RxBuf->Pop();
+		RxBuf.Pop(&data);
 		if(radix == 16)
 		{
 			if(isxdigit(data) || (data == 'X') || (data == 'x') || (data == 'h'))
@@ -267,7 +497,149 @@ unsigned int Serial::ParseInt(uint8_t radix, int waitMs)
 //
 void Serial::Flush()
 {
-	TxBuf->Init();
-	RxBuf->Init();
+	// the TX ring may only be drained here while its interrupt is off, data
+	// queued for DMA is left to go out, its buffers are still referenced
+	if (m_txMode != txModeDma)
+	{
+		m_uart->Instance->CR1 &= ~USART_CR1_TXEIE;
+		TxBuf.Clear();
+	}
+	RxBuf.Clear();
+	if (m_rxMode == rxModeDma)
+		RxRing.Reset(SERIAL_DMA_RX_SIZE - __HAL_DMA_GET_COUNTER(m_uart->hdmarx));
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//	void GetStats(SerialStats *stats, bool reset = false);
+//
+//	copies the receive statistics, optionally clearing them
+//
+void Serial::GetStats(SerialStats *stats, bool reset)
+{
+	*stats = Stats;
+	if (reset)
+		memset(&Stats, 0, sizeof(Stats));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	void StopWake(bool enable);
+//
+//	UESM keeps HSI16 requested, so it is only set for the time of a stop.
+//	HAL_UART_IRQHandler clears the wake up flag.
+//
+void Serial::StopWake(bool enable)
+{
+	if (enable)
+	{
+		__HAL_UART_CLEAR_FLAG(m_uart, UART_CLEAR_WUF);
+		__HAL_UART_ENABLE_IT(m_uart, UART_IT_WUF);
+		HAL_UARTEx_EnableStopMode(m_uart);
+	}
+	else
+	{
+		HAL_UARTEx_DisableStopMode(m_uart);
+		__HAL_UART_DISABLE_IT(m_uart, UART_IT_WUF);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	void StartRxDma();
+//
+//	starts the circular receive DMA. USART2_RX is wired to DMA1 channel 6,
+//	request 2. The error interrupt stays off so an overrun cannot make the
+//	HAL abort the transfer; Serial_UartIRQHandler counts the errors instead.
+//
+void Serial::StartRxDma()
+{
+	__HAL_RCC_DMA1_CLK_ENABLE();
+
+	DmaRx.Instance = DMA1_Channel6;
+	DmaRx.Init.Request = DMA_REQUEST_2;
+	DmaRx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+	DmaRx.Init.PeriphInc = DMA_PINC_DISABLE;
+	DmaRx.Init.MemInc = DMA_MINC_ENABLE;
+	DmaRx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	DmaRx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	DmaRx.Init.Mode = DMA_CIRCULAR;
+	DmaRx.Init.Priority = DMA_PRIORITY_HIGH;
+	if (HAL_DMA_Init(&DmaRx) != HAL_OK)
+	{
+		// fall back to one interrupt per byte
+		m_rxMode = rxModeIrq;
+		__HAL_UART_ENABLE_IT(m_uart, UART_IT_RXNE);
+		return;
+	}
+	__HAL_LINKDMA(m_uart, hdmarx, DmaRx);
+
+	HAL_NVIC_SetPriority(DMA1_Channel6_IRQn, 0, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+
+	RxRing.Reset();
+	HAL_UART_Receive_DMA(m_uart, DmaRxBuf, sizeof(DmaRxBuf));
+	CLEAR_BIT(m_uart->Instance->CR3, USART_CR3_EIE);
+
+	__HAL_UART_CLEAR_IDLEFLAG(m_uart);
+	__HAL_UART_ENABLE_IT(m_uart, UART_IT_IDLE);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	void StartTxDma();
+//
+//	sets up the transmit DMA, USART2_TX is wired to DMA1 channel 7, request 2.
+//	Each queued buffer is one normal mode transfer, the next one is started
+//	from the transmit complete interrupt of the previous.
+//
+void Serial::StartTxDma()
+{
+	__HAL_RCC_DMA1_CLK_ENABLE();
+
+	DmaTx.Instance = DMA1_Channel7;
+	DmaTx.Init.Request = DMA_REQUEST_2;
+	DmaTx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+	DmaTx.Init.PeriphInc = DMA_PINC_DISABLE;
+	DmaTx.Init.MemInc = DMA_MINC_ENABLE;
+	DmaTx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	DmaTx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	DmaTx.Init.Mode = DMA_NORMAL;
+	DmaTx.Init.Priority = DMA_PRIORITY_MEDIUM;
+	if (HAL_DMA_Init(&DmaTx) != HAL_OK)
+	{
+		// fall back to one interrupt per byte
+		m_txMode = txModeIrq;
+		SerialTxMode = txModeIrq;
+		return;
+	}
+	__HAL_LINKDMA(m_uart, hdmatx, DmaTx);
+
+	HAL_NVIC_SetPriority(DMA1_Channel7_IRQn, 0, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Channel7_IRQn);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	bool QueueTx(const uint8_t *ptr, int count, bool ring, SerialTxDone done, void *ctx);
+//
+//	appends a descriptor and starts the DMA if it is idle
+//
+//	returns false if all descriptors are in use
+//
+bool Serial::QueueTx(const uint8_t *ptr, int count, bool ring, SerialTxDone done,
+		void *ctx)
+{
+	uint32_t head = TxDescHead.load(std::memory_order_relaxed);
+
+	if (head - TxDescTail.load(std::memory_order_acquire) == SERIAL_TX_DESC)
+		return false;
+
+	TxDesc *desc = &TxDescs[head & (SERIAL_TX_DESC - 1)];
+
+	desc->data = ptr;
+	desc->len = count;
+	desc->ring = ring;
+	desc->done = done;
+	desc->ctx = ctx;
+	TxDescHead.store(head + 1, std::memory_order_release);
+
+	TxDmaKick(m_uart);
+
+	return true;
+}
@@ -12,13 +12,68 @@
 #include <stdio.h>
 #include <stm32l4xx_hal.h>
 
-#include "Queue.h"
+#include "SpscRing.h"
+
+// receive error bits, as in the bottom of USART_ISR
+enum enumErrFlag {
+		errNone = 0,
+		errParity 	= (1<<0),
+		errFrame 	= (1<<1),
+		errNoise	= (1<<2),
+		errOverrun	= (1<<3)
+};
+
+// ring sizes, powers of two
+#define SERIAL_TX_SIZE		256
+#define SERIAL_RX_SIZE		512
+
+// receive modes
+enum enumRxMode {
+		rxModeIrq = 0,		// one interrupt per received byte
+		rxModeDma			// circular DMA, chunks handed over on IDLE line and half/full transfer
+};
+
+// receive mode unless the constructor is told otherwise
+#ifndef SERIAL_RX_MODE
+#define SERIAL_RX_MODE		rxModeDma
+#endif
+
+// size of the circular DMA receive buffer
+#define SERIAL_DMA_RX_SIZE	256
+
+// transmit modes
+enum enumTxMode {
+		txModeIrq = 0,		// one TXE interrupt per byte out of the TX ring
+		txModeDma			// DMA straight from the queued buffers
+};
+
+// transmit mode unless the constructor is told otherwise
+#ifndef SERIAL_TX_MODE
+#define SERIAL_TX_MODE		txModeDma
+#endif
+
+// number of buffers queued for DMA transmission, power of two
+#define SERIAL_TX_DESC		8
+
+// called from interrupt context once a buffer passed to WriteRef is on the wire
+typedef void (*SerialTxDone)(void *ctx);
+
+// receive statistics, bytes / interrupts gives the bytes per interrupt
+struct SerialStats
+{
+	uint32_t	interrupts;		// receive interrupts that handed over data
+	uint32_t	bytes;			// bytes received
+	uint32_t	overruns;		// UART overruns and bytes dropped on a full receive buffer
+	uint32_t	errors;			// parity, framing and noise errors
+};
 
 
 class Serial
 {
 public:
-	Serial(UART_HandleTypeDef *uart, int txSize, int rxSize);
+	// the rings are SERIAL_TX_SIZE and SERIAL_RX_SIZE bytes, fixed at compile time
+	Serial(UART_HandleTypeDef *uart, enumRxMode rxMode = SERIAL_RX_MODE,
+			enumTxMode txMode = SERIAL_TX_MODE);
 	~Serial();
 
 	//////////////////////////////////////////////////////////////////////////////
@@ -56,6 +111,26 @@ public:
 	//
 	int Write(uint8_t *ptr, int count, int waitMs = -1);
 
+	//////////////////////////////////////////////////////////////////////////////
+	// WriteRef(const uint8_t *ptr, int count, SerialTxDone done, void *ctx, int waitMs);
+	//
+	// queues a buffer for transmission without copying it. In DMA mode the
+	// DMA reads straight from ptr, so the buffer must stay valid until done
+	// is called. Buffers and data passed to Write go out in the order they
+	// were queued. Without DMA the data is copied like Write does and done
+	// is called before WriteRef returns.
+	//
+	//		done	completion callback, NULL if none
+	// 		waitMs	time to wait for a free descriptor, as for Write
+	//
+	//	returns false if the buffer could not be queued
+	//
+	bool WriteRef(const uint8_t *ptr, int count, SerialTxDone done = NULL,
+			void *ctx = NULL, int waitMs = -1);
+
+	// number of queued buffers not yet transmitted
+	int TxPending();
+
 
 	//////////////////////////////////////////////////////////////////////////////
 	//	int Available();
@@ -96,8 +171,45 @@ public:
 
 	uint8_t GetChar();	// simply reads 1 character from the queue
 
+	//////////////////////////////////////////////////////////////////////////////
+	//	int PeekContiguous(const uint8_t **ptr);
+	//	void Commit(int len);
+	//
+	//	zero copy access to the receive ring. PeekContiguous points ptr at the
+	//	oldest received byte and returns how many follow it without a wrap,
+	//	Commit releases len of them.
+	//
+	int PeekContiguous(const uint8_t **ptr);
+	void Commit(int len);
+
+	enumRxMode RxMode() { return m_rxMode; }
+	enumTxMode TxMode() { return m_txMode; }
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	void GetStats(SerialStats *stats, bool reset = false);
+	//
+	//	copies the receive statistics, optionally clearing them
+	//
+	void GetStats(SerialStats *stats, bool reset = false);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//	void StopWake(bool enable);
+	//
+	//	lets a start bit wake the MCU from STOP1 while enabled. The UART keeps
+	//	receiving on its HSI16 kernel clock, the byte is in RDR for the DMA
+	//	when the clocks are back. Enable it right before a stop and disable
+	//	it after; USART2 cannot wake the MCU from STOP2.
+	//
+	void StopWake(bool enable);
+
 private:
+	void StartRxDma();
+	void StartTxDma();
+	bool QueueTx(const uint8_t *ptr, int count, bool ring, SerialTxDone done, void *ctx);
+
 	UART_HandleTypeDef *m_uart;
+	enumRxMode 	m_rxMode;
+	enumTxMode 	m_txMode;
 
 };
 
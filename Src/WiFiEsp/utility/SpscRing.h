@@ -0,0 +1,183 @@
+/*
+ * SpscRing.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef WIFIESP_UTILITY_SPSCRING_H_
+#define WIFIESP_UTILITY_SPSCRING_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+//////////////////////////////////////////////////////////////////////////////
+//	class SpscRing<N>
+//
+//	single producer / single consumer byte ring, e.g. an interrupt handler on
+//	one side and the main loop on the other. No locks and no disabled
+//	interrupts: the producer owns m_head, the consumer owns m_tail, and each
+//	side publishes its index with release semantics after the data is in
+//	place. The indices run freely and are masked on access, N must be a power
+//	of two so the mask replaces the modulo.
+//
+//	Bulk transfers can go without a copy through the span calls:
+//	PeekContiguous()/Commit() on the consumer side, PeekWritable()/
+//	CommitWrite() on the producer side. A span ends at the wrap point, so a
+//	full transfer may take two of them.
+//
+template<unsigned N>
+class SpscRing
+{
+	static_assert((N != 0) && ((N & (N - 1)) == 0), "SpscRing size must be a power of two");
+
+public:
+	SpscRing() : m_head(0), m_tail(0) {}
+
+	////////////////////////////// producer side //////////////////////////////
+
+	bool Push(uint8_t val)
+	{
+		uint32_t head = m_head.load(std::memory_order_relaxed);
+
+		if (head - m_tail.load(std::memory_order_acquire) == N)
+			return false;
+
+		m_buf[head & (N - 1)] = val;
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// copies as much of data as fits, returns the number of bytes written
+	int Write(const uint8_t *data, int len)
+	{
+		int cnt = 0;
+
+		while (cnt < len)
+		{
+			uint8_t *ptr;
+			int n = PeekWritable(&ptr);
+
+			if (n == 0)
+				break;
+			if (n > len - cnt)
+				n = len - cnt;
+			memcpy(ptr, data + cnt, n);
+			CommitWrite(n);
+			cnt += n;
+		}
+		return cnt;
+	}
+
+	// contiguous free space at the write position
+	int PeekWritable(uint8_t **ptr)
+	{
+		uint32_t head = m_head.load(std::memory_order_relaxed);
+		uint32_t free = N - (head - m_tail.load(std::memory_order_acquire));
+		uint32_t toEnd = N - (head & (N - 1));
+
+		*ptr = &m_buf[head & (N - 1)];
+		return (int) (free < toEnd ? free : toEnd);
+	}
+
+	// publishes len bytes written through PeekWritable()
+	void CommitWrite(int len)
+	{
+		m_head.store(m_head.load(std::memory_order_relaxed) + len,
+				std::memory_order_release);
+	}
+
+	////////////////////////////// consumer side //////////////////////////////
+
+	bool Pop(uint8_t *val)
+	{
+		uint32_t tail = m_tail.load(std::memory_order_relaxed);
+
+		if (m_head.load(std::memory_order_acquire) == tail)
+			return false;
+
+		*val = m_buf[tail & (N - 1)];
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Peek(uint8_t *val)
+	{
+		uint32_t tail = m_tail.load(std::memory_order_relaxed);
+
+		if (m_head.load(std::memory_order_acquire) == tail)
+			return false;
+
+		*val = m_buf[tail & (N - 1)];
+		return true;
+	}
+
+	// copies up to len bytes out, returns the number of bytes read
+	int Read(uint8_t *data, int len)
+	{
+		int cnt = 0;
+
+		while (cnt < len)
+		{
+			const uint8_t *ptr;
+			int n = PeekContiguous(&ptr);
+
+			if (n == 0)
+				break;
+			if (n > len - cnt)
+				n = len - cnt;
+			memcpy(data + cnt, ptr, n);
+			Commit(n);
+			cnt += n;
+		}
+		return cnt;
+	}
+
+	// contiguous data at the read position
+	int PeekContiguous(const uint8_t **ptr)
+	{
+		uint32_t tail = m_tail.load(std::memory_order_relaxed);
+		uint32_t used = m_head.load(std::memory_order_acquire) - tail;
+		uint32_t toEnd = N - (tail & (N - 1));
+
+		*ptr = &m_buf[tail & (N - 1)];
+		return (int) (used < toEnd ? used : toEnd);
+	}
+
+	// releases len bytes obtained through PeekContiguous()
+	void Commit(int len)
+	{
+		m_tail.store(m_tail.load(std::memory_order_relaxed) + len,
+				std::memory_order_release);
+	}
+
+	// drops everything queued so far
+	void Clear()
+	{
+		m_tail.store(m_head.load(std::memory_order_acquire), std::memory_order_release);
+	}
+
+	//////////////////////////////// either side ///////////////////////////////
+
+	// exact on either side, a third party may see a slightly stale value
+	int Size()
+	{
+		uint32_t tail = m_tail.load(std::memory_order_acquire);
+		uint32_t used = m_head.load(std::memory_order_acquire) - tail;
+
+		return (int) (used < N ? used : N);
+	}
+
+	int Capacity() { return N; }
+	int Free() { return N - Size(); }
+	bool IsEmpty() { return Size() == 0; }
+	bool IsFull() { return Size() == (int) N; }
+
+private:
+	uint8_t 				m_buf[N];
+	std::atomic<uint32_t> 	m_head;		// next write, owned by the producer
+	std::atomic<uint32_t> 	m_tail;		// next read, owned by the consumer
+};
+
+#endif /* WIFIESP_UTILITY_SPSCRING_H_ */
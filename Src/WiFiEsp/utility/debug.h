@@ -20,6 +20,7 @@ along with The Arduino WiFiEsp library.  If not, see
 #define EspDebug_H
 
 #include <stdio.h>
+#include "DLog.h"
 
 // Change _ESPLOGLEVEL_ to set tracing and logging verbosity
 // 0: DISABLED: no logging
@@ -33,26 +34,28 @@ along with The Arduino WiFiEsp library.  If not, see
 #endif
 
 
-#define LOGERROR(x)    if(_ESPLOGLEVEL_>0) { printf("[WiFiEsp] %s\n", x); }
-#define LOGERROR1(x,y) if(_ESPLOGLEVEL_>2) { printf("[WiFiEsp] %s %s\n", x, y); }
-#define LOGERROR1D(x,y) if(_ESPLOGLEVEL_>2) { printf("[WiFiEsp] %s %d\n", x, y); }
-#define LOGERROR1L(x,y) if(_ESPLOGLEVEL_>2) { printf("[WiFiEsp] %s %ld\n", x, y); }
-#define LOGWARN(x)     if(_ESPLOGLEVEL_>1) { printf("[WiFiEsp] %s\n", x); }
-#define LOGWARN1(x,y)  if(_ESPLOGLEVEL_>2) { printf("[WiFiEsp] %s %s\n", x, y); }
-#define LOGINFO(x)     if(_ESPLOGLEVEL_>2) { printf("[WiFiEsp] %s\n", x); }
-#define LOGINFO1(x,y)  if(_ESPLOGLEVEL_>2) { printf("[WiFiEsp] %s %s\n", x, y); }
-#define LOGINFO1D(x,y)  if(_ESPLOGLEVEL_>2) { printf("[WiFiEsp] %s %d\n", x, y); }
-
-#define LOGDEBUG(x)      if(_ESPLOGLEVEL_>3) { printf("Dbg: %s\n", x); }
-#define LOGDEBUG0(x)     if(_ESPLOGLEVEL_>3) { printf("Dbg: %s\n", x); }
-#define LOGDEBUG0C(x)     if(_ESPLOGLEVEL_>3) { printf("%c", x); }
-#define LOGDEBUG1(x,y)   if(_ESPLOGLEVEL_>3) { printf("Dbg: %s %s\n", x, y);  }
-#define LOGDEBUG1D(x,y)   if(_ESPLOGLEVEL_>3) { printf("Dbg: %s %d\n", x, y);  }
-#define LOGDEBUG2(x,y,z) if(_ESPLOGLEVEL_>3) { printf("Dbg: %s %s %s\n", x, y, z); }
-#define LOGDEBUG2SD(x,y,z) if(_ESPLOGLEVEL_>3) { printf("Dbg: %s %s %d\n", x, y, z); }
-#define LOGDEBUG2DD(x,y,z) if(_ESPLOGLEVEL_>3) { printf("Dbg: %s %d %d\n", x, y, z); }
-#define LOGDEBUG2LD(x,y,z) if(_ESPLOGLEVEL_>3) { printf("Dbg: %s %ld %d\n", x, y, z); }
-#define LOGDEBUG2DL(x,y,z) if(_ESPLOGLEVEL_>3) { printf("Dbg: %s %d %ld\n", x, y, z); }
-
+// The messages go through the deferred log: the literal first argument
+// becomes part of the format string, the others are recorded raw.
+
+#define LOGERROR(x)    if(_ESPLOGLEVEL_>0) { DLOG_ERROR("[WiFiEsp] " x "\n"); }
+#define LOGERROR1(x,y) if(_ESPLOGLEVEL_>2) { DLOG_ERROR("[WiFiEsp] " x " %s\n", y); }
+#define LOGERROR1D(x,y) if(_ESPLOGLEVEL_>2) { DLOG_ERROR("[WiFiEsp] " x " %d\n", y); }
+#define LOGERROR1L(x,y) if(_ESPLOGLEVEL_>2) { DLOG_ERROR("[WiFiEsp] " x " %ld\n", y); }
+#define LOGWARN(x)     if(_ESPLOGLEVEL_>1) { DLOG_WARN("[WiFiEsp] " x "\n"); }
+#define LOGWARN1(x,y)  if(_ESPLOGLEVEL_>2) { DLOG_WARN("[WiFiEsp] " x " %s\n", y); }
+#define LOGINFO(x)     if(_ESPLOGLEVEL_>2) { DLOG_INFO("[WiFiEsp] " x "\n"); }
+#define LOGINFO1(x,y)  if(_ESPLOGLEVEL_>2) { DLOG_INFO("[WiFiEsp] " x " %s\n", y); }
+#define LOGINFO1D(x,y)  if(_ESPLOGLEVEL_>2) { DLOG_INFO("[WiFiEsp] " x " %d\n", y); }
+
+#define LOGDEBUG(x)      if(_ESPLOGLEVEL_>3) { DLOG_DEBUG("Dbg: " x "\n"); }
+#define LOGDEBUG0(x)     if(_ESPLOGLEVEL_>3) { DLOG_DEBUG("Dbg: " x "\n"); }
+#define LOGDEBUG0C(x)     if(_ESPLOGLEVEL_>3) { DLOG_DEBUG("%c", x); }
+#define LOGDEBUG1(x,y)   if(_ESPLOGLEVEL_>3) { DLOG_DEBUG("Dbg: " x " %s\n", y);  }
+#define LOGDEBUG1D(x,y)   if(_ESPLOGLEVEL_>3) { DLOG_DEBUG("Dbg: " x " %d\n", y);  }
+#define LOGDEBUG2(x,y,z) if(_ESPLOGLEVEL_>3) { DLOG_DEBUG("Dbg: " x " %s %s\n", y, z); }
+#define LOGDEBUG2SD(x,y,z) if(_ESPLOGLEVEL_>3) { DLOG_DEBUG("Dbg: " x " %s %d\n", y, z); }
+#define LOGDEBUG2DD(x,y,z) if(_ESPLOGLEVEL_>3) { DLOG_DEBUG("Dbg: " x " %d %d\n", y, z); }
+#define LOGDEBUG2LD(x,y,z) if(_ESPLOGLEVEL_>3) { DLOG_DEBUG("Dbg: " x " %ld %d\n", y, z); }
+#define LOGDEBUG2DL(x,y,z) if(_ESPLOGLEVEL_>3) { DLOG_DEBUG("Dbg: " x " %d %ld\n", y, z); }
 
 #endif
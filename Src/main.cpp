@@ -32,18 +32,97 @@
 /* USER CODE BEGIN Includes */
 #include "NS_energyShield2.h"
 #include "SFE_BMP180.h"
+#include "BmpBurst.h"
+#include "dht11.h"
 #include "dwt_stm32_delay.h"
 #include "WiFiEsp.h"
+#include "TaskScheduler.h"
+#include "I2cBus.h"
+#include "AdcScan.h"
+#include "PowerManager.h"
+#include "FlashL4.h"
+#include "FlashLog.h"
+#include "WiFiEspUdp.h"
+#include "Telemetry.h"
+#include "DLog.h"
+#include "Profiler.h"
+#include "WallClock.h"
+#include "Calendar.h"
+#include "SntpClient.h"
+#include <stdlib.h>
+#include <string.h>
 
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
 /* USER CODE BEGIN PTD */
+// latest values of all sensors, updated by the acquisition tasks
+struct Readings
+{
+	uint16_t batteryVoltage;	// mV
+	int16_t batteryCurrent;		// mA
+	uint16_t fullCapacity;		// mAh
+	uint16_t remainingCapacity;	// mAh
+	uint16_t stateOfCharge;		// %
+	uint16_t inputVoltage;		// mV
+	int16_t batteryTemp;		// 0.1 C
+	float bmpTemp;				// C
+	float bmpPressure;			// mbar
+	float dhtTemp;				// C
+	float dhtHumidity;			// %
+	int16_t mcuTemp;			// 0.1 C
+	uint16_t vdda;				// mV
+	uint16_t windVoltage;		// mV
+	uint16_t rainVoltage;		// mV
+};
 
 /* USER CODE END PTD */
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define SENSOR_PERIOD_MS	2000	// one full set of readings
+#define WIFI_POLL_MS		5		// while the module is busy
+#define WIFI_IDLE_POLL_MS	250
+#define STATS_PERIOD		15		// report scheduler timing every n readings
+
+// BMP180 burst: 2 pressures at OSS 0 per output, a new temperature every
+// 8 of them (4 outputs), outputs low pass filtered with 1/4. That converts
+// 2 * 5 + 5 / 4 = 11.25 ms per output, less than the temperature and OSS 1
+// pressure of a single read (13 ms), at 0.042 hPa RMS before the filter
+// against 0.05 hPa for the single read
+#define BMP_OSS				0
+#define BMP_PRESS_PER_TEMP	8
+#define BMP_SAMPLES			2
+#define BMP_FILTER_SHIFT	2
+
+// sample log in flash, drained to a UDP collector while WiFi is up
+#define LOG_PERIOD_MS		60000
+#define UPLOAD_PERIOD_MS	30000
+#define UPLOAD_STEP_MS		20		// between two datagrams, the other tasks run meanwhile
+#define UPLOAD_BATCH		16		// frames per datagram at most
+#define UPLOAD_HOST			"192.168.1.10"
+#define UPLOAD_PORT			5005
+#define UPLOAD_LOCAL_PORT	5006
+
+// time servers, addresses since the AT firmware sends datagrams to IPs only
+#define SNTP_SERVER1		"162.159.200.1"		// time.cloudflare.com
+#define SNTP_SERVER2		"216.239.35.0"		// time.google.com
+#define SNTP_SERVER3		"129.6.15.28"		// time-a-g.nist.gov
+#define SNTP_LOCAL_PORT		4123
+#define SNTP_WAIT_WIFI_MS	1000
+#define RTC_ALIGN_MS		5		// the RTC is set within this of a full second
+#define RTC_RESYNC_MS		3600000	// wall clock from the RTC while there is no SNTP
+#define RTC_TOLERANCE_MS	1000	// the RTC has whole seconds only
+
+// analog scan, each new scan weighs 1/8 in the filtered values
+#define ADC_FILTER_SHIFT	3
+#define ANALOG_POLL_MS		250
+
+// deferred log, formatted on the console or sent raw to ITM port 1 for
+// Tools/dlog_decode.py
+#define DLOG_BINARY			0
+#define DLOG_DRAIN_MS		100
+#define DLOG_DRAIN_BATCH	8		// records per step
 
 /* USER CODE END PD */
 
@@ -54,19 +133,451 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN PV */
-NS_energyShield2 Es2(&hi2c3);		// use 3rd I2C
-SFE_BMP180 Bmp(&hi2c3);
+I2cBus Bus3(&hi2c3);				// 3rd I2C, shared by the sensors
+NS_energyShield2 Es2(&Bus3);
+SFE_BMP180 Bmp(&Bus3);
+BmpBurst BmpAcq(&Bmp);
+DHT11 Dht(&htim3, TIM_CHANNEL_3, GPIOB, GPIO_PIN_0);
 WiFiEspClass WiFiEsp(GPIOA, GPIO_PIN_10, GPIOA, GPIO_PIN_8);
+TaskScheduler Sched(HAL_GetTick);
+AdcScan Analog(&hadc1);
+PowerManager Power(&hlptim1);
+FlashL4 LogFlash;
+FlashLog Log(&LogFlash);
+WiFiEspUDP Upload(&WiFiEsp);
+TelemetryEncoder UploadEncoder;
+WallClock Clock(HAL_GetTick);		// UTC, from SNTP once it is in
+WiFiEspUDP NtpUdp(&WiFiEsp);
+SntpClient Sntp(&NtpUdp, &Clock, HAL_GetTick);
+int RtcTaskId = -1;
+bool RtcPending = false;
+CalendarCache ClockCalendar;
+bool UploadOpen = false;
+int UploadLen = 0;					// bytes in the datagram being filled
+uint32_t LogUnset = 0;				// samples not logged, the clock was not set
+
+// scan channels
+int AdcSolar, AdcMcuTemp, AdcWind, AdcRain;
+
+Readings Values;
+int ReportCount = 0;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 /* USER CODE BEGIN PFP */
+static void RestoreClock(void *ctx);
+static uint32_t WifiTask(void *ctx);
+static uint32_t BmpTask(void *ctx);
+static uint32_t Es2Task(void *ctx);
+static uint32_t DhtTask(void *ctx);
+static uint32_t AnalogTask(void *ctx);
+static uint32_t LogTask(void *ctx);
+static uint32_t UploadTask(void *ctx);
+static uint32_t DLogTask(void *ctx);
+static uint32_t SntpTask(void *ctx);
+static uint32_t RtcTask(void *ctx);
+static uint32_t ReportTask(void *ctx);
 
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
+// Serves the ESP8266: command responses, +IPD data and queued sends. Polled
+// slowly when nothing is going on, so that the MCU can stop in between.
+static uint32_t WifiTask(void *ctx)
+{
+	WiFiEsp.poll();
+	return WiFiEsp.GetDrv()->isIdle() ? WIFI_IDLE_POLL_MS : WIFI_POLL_MS;
+}
+
+// PLLs are off after a stop
+static void RestoreClock(void *ctx)
+{
+	SystemClock_Config();
+}
+
+// power clients: the WiFi UART and the I2C bus must not stop in the middle
+// of a transfer, the ADC scan is paused once a scan is complete. An idle
+// WiFi UART still has to hear the +IPD of a datagram or an HTTP request,
+// its start bit wakes the MCU from STOP1.
+static PowerStateEnum WifiLimit(void *ctx)
+{
+	return WiFiEsp.GetDrv()->isIdle() ? powerStop1 : powerSleep;
+}
+
+static void WifiSuspend(void *ctx)
+{
+	WiFiEsp.GetDrv()->stopWake(true);
+}
+
+static void WifiResume(void *ctx)
+{
+	WiFiEsp.GetDrv()->stopWake(false);
+}
+
+static PowerStateEnum I2cLimit(void *ctx)
+{
+	return Bus3.IsIdle() ? powerStop2 : powerSleep;
+}
+
+static PowerStateEnum AnalogLimit(void *ctx)
+{
+	return Analog.IsBusy() ? powerSleep : powerStop2;
+}
+
+static void AnalogSuspend(void *ctx)
+{
+	Analog.Suspend();
+}
+
+static void AnalogResume(void *ctx)
+{
+	Analog.Resume();
+}
+
+// BMP180 in burst mode: each step fetches a result and starts the next
+// conversion, the conversion time is returned as the task delay
+static uint32_t BmpTask(void *ctx)
+{
+	int32_t pressure, temperature;
+
+	uint32_t delay = BmpAcq.Step(HAL_GetTick());
+
+	if (BmpAcq.Read(pressure, temperature))
+	{
+		Values.bmpTemp = temperature / 10.0f;
+		Values.bmpPressure = pressure / 100.0f;
+	}
+	return delay;
+}
+
+// energyShield2: the fuel gauge values in one block read, the time comes
+// from the wall clock
+static uint32_t Es2Task(void *ctx)
+{
+	ES2_Snapshot snap;
+
+	if (Es2.snapshot(snap) == 0)
+	{
+		Values.batteryVoltage = snap.voltage;
+		Values.batteryCurrent = snap.current;
+		Values.fullCapacity = snap.fullChargeCapacity;
+		Values.remainingCapacity = snap.remainingCapacity;
+		Values.stateOfCharge = snap.SOC;
+		Values.batteryTemp = snap.temperature;
+	}
+	return SENSOR_PERIOD_MS;
+}
+
+// DHT11: start signal, then the frame is captured by TIM3 and DMA, the task
+// only checks back until it is complete
+static uint32_t DhtTask(void *ctx)
+{
+	static bool reading = false;
+
+	if (!reading)
+	{
+		Dht.Start();
+		reading = true;
+		return DHT11_START_MS + 1;
+	}
+
+	int ret = Dht.Poll();
+	if (ret == DHT_BUSY)
+		return 1;
+
+	reading = false;
+	if (ret == DHT_OK)
+	{
+		Values.dhtTemp = Dht.GetTemperature();
+		Values.dhtHumidity = Dht.GetHumidity();
+	}
+	return SENSOR_PERIOD_MS;
+}
+
+// Filters the scans completed by the ADC DMA, the values are always current
+static uint32_t AnalogTask(void *ctx)
+{
+	if (Analog.Poll())
+	{
+		Values.inputVoltage = Analog.Get(AdcSolar);
+		Values.mcuTemp = Analog.GetTemperature(AdcMcuTemp);
+		Values.vdda = Analog.GetVdda();
+		Values.windVoltage = Analog.Get(AdcWind);
+		Values.rainVoltage = Analog.Get(AdcRain);
+	}
+	return ANALOG_POLL_MS;
+}
+
+// Stores a frame of the current readings in the flash log, in telemetry units.
+// Not before the RTC or SNTP has set the clock: until then Seconds() is the
+// uptime, and a frame stamped with it would land in 1970 on the server.
+static uint32_t LogTask(void *ctx)
+{
+	TelemetrySample sample;
+
+	if (!Clock.IsSet())
+	{
+		LogUnset++;
+		return LOG_PERIOD_MS;
+	}
+
+	sample.time = Clock.Seconds();
+	sample.count = TLM_FIELDS;
+	sample.values[TLM_BATTERY_VOLTAGE] = Values.batteryVoltage;
+	sample.values[TLM_BATTERY_CURRENT] = Values.batteryCurrent;
+	sample.values[TLM_STATE_OF_CHARGE] = Values.stateOfCharge;
+	sample.values[TLM_REMAINING_CAPACITY] = Values.remainingCapacity;
+	sample.values[TLM_FULL_CAPACITY] = Values.fullCapacity;
+	sample.values[TLM_INPUT_VOLTAGE] = Values.inputVoltage;
+	sample.values[TLM_BATTERY_TEMP] = Values.batteryTemp;
+	sample.values[TLM_BMP_TEMP] = (int32_t) (Values.bmpTemp * 10);
+	sample.values[TLM_BMP_PRESSURE] = (int32_t) (Values.bmpPressure * 100);
+	sample.values[TLM_DHT_TEMP] = (int32_t) (Values.dhtTemp * 10);
+	sample.values[TLM_DHT_HUMIDITY] = (int32_t) (Values.dhtHumidity * 10);
+	sample.values[TLM_MCU_TEMP] = Values.mcuTemp;
+	sample.values[TLM_WIND_VOLTAGE] = Values.windVoltage;
+	sample.values[TLM_RAIN_VOLTAGE] = Values.rainVoltage;
+
+	Log.Append(sample.time, sample.values, sample.count);
+	return LOG_PERIOD_MS;
+}
+
+// Adds one logged frame to the datagram being filled, as a length byte and
+// a binary telemetry frame. The first frame of a datagram is a key frame,
+// so that a lost datagram takes no frames of the others with it.
+static bool UploadFrame(void *ctx, const LogFrame &frame)
+{
+	TelemetrySample sample;
+	uint8_t buf[1 + TLM_MAX_FRAME];
+
+	if (UploadLen + (int) sizeof(buf) > UDP_TX_BUFFER_SIZE)
+		return false;
+
+	sample.time = frame.time;
+	sample.count = frame.count;
+	memcpy(sample.values, frame.values, frame.count * sizeof(frame.values[0]));
+
+	if (UploadLen == 0)
+		UploadEncoder.ForceKey();
+	int len = UploadEncoder.Encode(sample, buf + 1, sizeof(buf) - 1);
+	if (len == 0)
+		return false;
+	buf[0] = len;
+
+	if (Upload.write(buf, len + 1) != (size_t) len + 1)
+		return false;
+	UploadLen += len + 1;
+	return true;
+}
+
+// sends the datagram, the log moves on only when it went out
+static bool UploadCommit(void *ctx)
+{
+	return Upload.endPacket() == 1;
+}
+
+// Drains the log while WiFi is up, a datagram of up to UPLOAD_BATCH frames
+// per step until it is empty: one AT+CIPSEND round trip and one ack record
+// in the log per datagram, and the sensor tasks run between two of them
+static uint32_t UploadTask(void *ctx)
+{
+	if (!Log.Pending() || WiFiEsp.linkStatus() != WL_CONNECTED)
+		return UPLOAD_PERIOD_MS;
+
+	if (!UploadOpen)
+		UploadOpen = Upload.begin(UPLOAD_LOCAL_PORT);
+
+	if (!UploadOpen || !Upload.beginPacket(UPLOAD_HOST, UPLOAD_PORT))
+		return UPLOAD_PERIOD_MS;
+	UploadLen = 0;
+
+	if (Log.Drain(UploadFrame, NULL, UPLOAD_BATCH, UploadCommit) < 1)
+		return UPLOAD_PERIOD_MS;
+
+	return Log.Pending() ? UPLOAD_STEP_MS : UPLOAD_PERIOD_MS;
+}
+
+// Keeps the wall clock in sync while WiFi is up. Polled every few ms while
+// a reply is due, the link state is the one kept from the module's messages.
+static uint32_t SntpTask(void *ctx)
+{
+	if (WiFiEsp.linkStatus() != WL_CONNECTED)
+		return SNTP_WAIT_WIFI_MS;
+
+	return Sntp.Poll();
+}
+
+// when the +IPD of the reply came in, not when SntpTask got to it
+static uint32_t NtpReceiveTick(void *ctx)
+{
+	return NtpUdp.packetTick();
+}
+
+static void OnSntpSync(void *ctx, int64_t offsetMs)
+{
+	// the shield RTC has whole seconds only, set it at the next one
+	RtcPending = true;
+	Sched.Wake(RtcTaskId, 1000 - Clock.Now() % 1000);
+}
+
+// Brings the wall clock back to the RTC, its crystal beats the oscillators
+// behind the tick. Only when off by more than the RTC resolution.
+static void RtcResync(void)
+{
+	uint32_t epoch = Es2.readEpoch();
+
+	if (epoch == 0)
+		return;
+
+	// the RTC second is half over on average
+	int64_t offset = (int64_t) epoch * 1000 + 500 - Clock.Now();
+
+	if (!Clock.IsSet() || offset > RTC_TOLERANCE_MS || offset < -RTC_TOLERANCE_MS)
+		Clock.Discipline(offset);
+}
+
+// Copies the wall clock into the shield RTC right at a full second after an
+// SNTP sync, until the first one keeps the wall clock on the RTC
+static uint32_t RtcTask(void *ctx)
+{
+	if (!RtcPending)
+	{
+		if (Sntp.IsSynced())
+			return SCHED_STOP;
+		RtcResync();
+		return RTC_RESYNC_MS;
+	}
+
+	int64_t now = Clock.Now();
+	uint32_t ms = now % 1000;
+
+	if (ms > RTC_ALIGN_MS)
+		return 1000 - ms;
+
+	Es2.setEpoch(now / 1000);
+	RtcPending = false;
+	return SCHED_STOP;
+}
+
+// Formats the deferred log records, a batch per step until the ring is empty
+static uint32_t DLogTask(void *ctx)
+{
+	if (DLog::Drain(DLOG_DRAIN_BATCH) < DLOG_DRAIN_BATCH)
+		return DLOG_DRAIN_MS;
+
+	return 0;
+}
+
+static void PrintLine(void *ctx, const char *line)
+{
+	printf("%s\n", line);
+}
+
+static void PrintStats()
+{
+	SchedStats stats;
+
+	for (int id = 0; id < Sched.Count(); id++)
+	{
+		if (!Sched.GetStats(id, stats, true) || stats.runs == 0)
+			continue;
+
+		printf("Task %-8s runs %5lu  latency avg %lu max %lu ms  jitter %lu ms  exec %lu ms\n",
+				stats.name, stats.runs, stats.latencySum / stats.runs,
+				stats.latencyMax, stats.jitterMax, stats.execMax);
+	}
+
+	I2cStats i2c;
+
+	for (int dev = 0; Bus3.GetStats(dev, i2c, true); dev++)
+	{
+		if (i2c.count == 0)
+			continue;
+
+		printf("I2C 0x%02x  transfers %5lu  errors %lu  latency avg %lu max %lu ms\n",
+				i2c.addr, i2c.count, i2c.errors, i2c.latencySum / i2c.count,
+				i2c.latencyMax);
+	}
+
+	PowerStats power;
+
+	Power.GetStats(power, true);
+	printf("Power run %lu ms, sleep %lu ms (%lu), stop1 %lu ms (%lu), stop2 %lu ms (%lu)  vetoes %lu  early wakes %lu\n",
+			power.time[powerRun], power.time[powerSleep], power.entries[powerSleep],
+			power.time[powerStop1], power.entries[powerStop1],
+			power.time[powerStop2], power.entries[powerStop2], power.vetoes,
+			power.earlyWakes);
+
+	LogStats log;
+
+	Log.GetStats(log, true);
+	printf("Log appended %lu  drained %lu  erases %lu  lost %lu  errors %lu  unset clock %lu\n",
+			log.appended, log.drained, log.erases, log.lost, log.errors, LogUnset);
+	LogUnset = 0;
+
+	DhtStats dht;
+
+	Dht.GetStats(dht, true);
+	printf("DHT11 reads %lu  timeouts %lu  frame errors %lu  checksum errors %lu\n",
+			dht.reads, dht.timeouts, dht.frameErrors, dht.checksumErrors);
+
+	DLogStats dlog;
+
+	DLog::GetStats(dlog, true);
+	printf("DLog records %lu  dropped %lu  max used %lu bytes\n",
+			dlog.records, dlog.dropped, dlog.maxUsed);
+
+	SntpStats sntp;
+
+	Sntp.GetStats(sntp, true);
+	printf("SNTP syncs %lu  failures %lu  requests %lu  timeouts %lu  rejected %lu  offset %ld ms  delay %ld ms  drift %ld ppm\n",
+			sntp.syncs, sntp.failures, sntp.requests, sntp.timeouts, sntp.rejected,
+			(long) sntp.lastOffset, (long) sntp.lastDelay, (long) Clock.GetPpm());
+
+	Profiler::Dump(PrintLine, NULL, true);
+}
+
+static uint32_t ReportTask(void *ctx)
+{
+	int iBattVolt = Values.batteryVoltage / 1000;
+	int nBattVolt = Values.batteryVoltage % 1000;
+	float temperature = (float) Values.batteryTemp / 10;
+
+	// Print Results
+	printf("Battery Voltage    = %f V\n", (float) Values.batteryVoltage / 1000.0);
+	printf("Battery Voltage    = %d.%03d V\n", iBattVolt, nBattVolt);
+	printf("Battery Current    = %f V\n", (float) Values.batteryCurrent / 1000.0);
+	printf("Full Capacity      = %d mAh\n", Values.fullCapacity);
+	printf("Remaining Capacity = %d mAh\n", Values.remainingCapacity);
+	printf("State of Charge    = %d %% \n", Values.stateOfCharge);
+	printf("Input Voltage      = %f V\n", (float) Values.inputVoltage / 1000);
+	printf("Batt. Temp         = %f F\n", (temperature * 9.0 / 5.0) + 32.0);
+
+	printf("BMP180 Temp = %f C, %f F\n", Values.bmpTemp, ((Values.bmpTemp * 9.0) / 5) + 32);
+	printf("BMP180 Pressure = %f mbar\n", Values.bmpPressure);
+	printf("MCU Temp = %d.%d C, VDDA = %d mV\n", Values.mcuTemp / 10, abs(Values.mcuTemp % 10), Values.vdda);
+	printf("Wind = %d mV, Rain = %d mV\n", Values.windVoltage, Values.rainVoltage);
+	printf("DHT11 Temp = %f C, Humidity = %f %%\n", Values.dhtTemp, Values.dhtHumidity);
+
+	// Print time and date from the wall clock
+	const CalendarTime &cal = ClockCalendar.Get(Clock.Seconds());
+
+	printf("\n\tTime:: %d:%d:%d \t Date:: %d-%d-%d\n", cal.hour,
+			cal.minute, cal.second, cal.month, cal.day, cal.year % 100);
+
+	if (++ReportCount >= STATS_PERIOD)
+	{
+		ReportCount = 0;
+		PrintStats();
+	}
+
+	// Print carriage return to start new line
+	printf("\n\n\n");
+
+	return SENSOR_PERIOD_MS;
+}
 
 /* USER CODE END 0 */
 
@@ -105,6 +616,9 @@ int main(void)
 	MX_TIM3_Init();
 	/* USER CODE BEGIN 2 */
 
+	DLog::Begin(HAL_GetTick, DLOG_BINARY ? DLog::ItmWriter : NULL);
+	Profiler::Begin();
+
 	Bmp.Begin();
 	byte wait = Bmp.StartTemperature();
 	HAL_Delay(wait);
@@ -118,71 +632,78 @@ int main(void)
 		while (1)
 			;
 	}
+	// the one full read of the RTC, from here on the wall clock runs on
+	RtcResync();
+	if (!Clock.IsSet())
+		printf("MAIN: RTC has lost the time, waiting for SNTP\n");
 	if (Es2.readVMPP() != -1)
 		Es2.setVMPP(-1, 1); // Disable VMPP regulation to allow charging from any power supply (7V - 23V) and prevent excessive EEPROM writes
 
-	// initialize Wifi
+	BmpAcq.Begin(BMP_OSS, BMP_PRESS_PER_TEMP, BMP_SAMPLES, SENSOR_PERIOD_MS,
+			BMP_FILTER_SHIFT);
+
+	if (!Dht.Begin())
+		printf("! DHT11 capture setup failed !\n");
+
+	// solar input on A0 (PA0), wind and rain sensors on PA1 and PA4
+	AdcSolar = Analog.AddChannel(ADC_CHANNEL_5, NULL, 0, ES2_INPUT_DIVIDER_NUM,
+			ES2_INPUT_DIVIDER_DEN);
+	AdcMcuTemp = Analog.AddChannel(ADC_CHANNEL_TEMPSENSOR);
+	AdcWind = Analog.AddChannel(ADC_CHANNEL_6, GPIOA, GPIO_PIN_1);
+	AdcRain = Analog.AddChannel(ADC_CHANNEL_9, GPIOA, GPIO_PIN_4);
+	if (Analog.Begin(ADC_FILTER_SHIFT))
+		Es2.attachAdc(&Analog, AdcSolar);
+	else
+		printf("! ADC scan setup failed !\n");
+
+	// initialize Wifi, the module joins the network by itself: ask once for
+	// the link state, its messages keep it current from here
 	WiFiEsp.init(&huart2);
+	WiFiEsp.status();
+
+	Sntp.AddServer(SNTP_SERVER1);
+	Sntp.AddServer(SNTP_SERVER2);
+	Sntp.AddServer(SNTP_SERVER3);
+	Sntp.SetSyncHandler(OnSntpSync, NULL);
+	Sntp.SetReceiveTick(NtpReceiveTick, NULL);
+	Sntp.Begin(SNTP_LOCAL_PORT);
+
+	if (!Log.Mount())
+		printf("MAIN: sample log is empty\n");
+
+	if (Power.Begin(RestoreClock))
+	{
+		Power.AddClient("wifi", WifiLimit, WifiSuspend, WifiResume);
+		Power.AddClient("i2c3", I2cLimit);
+		Power.AddClient("adc", AnalogLimit, AnalogSuspend, AnalogResume);
+	}
+	else
+		printf("! Low power setup failed !\n");
 
 	/* USER CODE END 2 */
 
 	/* Infinite loop */
 	/* USER CODE BEGIN WHILE */
+	Sched.Add("wifi", WifiTask, NULL);
+	Sched.Add("bmp180", BmpTask, NULL);
+	Sched.Add("es2", Es2Task, NULL);
+	Sched.Add("dht11", DhtTask, NULL);
+	Sched.Add("analog", AnalogTask, NULL);
+	Sched.Add("log", LogTask, NULL, LOG_PERIOD_MS);
+	Sched.Add("upload", UploadTask, NULL, UPLOAD_PERIOD_MS);
+	Sched.Add("dlog", DLogTask, NULL);
+	Sched.Add("sntp", SntpTask, NULL);
+	RtcTaskId = Sched.Add("rtc", RtcTask, NULL, RTC_RESYNC_MS);
+	// first report once the first set of readings is in
+	Sched.Add("report", ReportTask, NULL, SENSOR_PERIOD_MS / 2);
+
 	while (1)
 	{
-		//double pressure = 0.0;
 		/* USER CODE END WHILE */
 
 		/* USER CODE BEGIN 3 */
-		// Read values from energyShield2
-		int batVal = Es2.batteryVoltage();
-		int iBattVolt = batVal / 1000;
-		int nBattVolt = batVal % 1000;
-		float batteryVoltage = (float) batVal / 1000.0;
-
-		float batteryCurrent = (float) Es2.batteryCurrent() / 1000.0;
-		uint16_t fullCapacity = Es2.fullChargeCapacity();
-		uint16_t remainingCapacity = Es2.remainingCapacity();
-		uint16_t stateOfCharge = Es2.SOC();
-		float inputVoltage = (float) Es2.inputVoltage(0) / 1000;
-		float temperature = (float) Es2.temperature() / 10;
-
-		// Print Results
-		printf("Battery Voltage    = %f V\n", batteryVoltage);
-		printf("Battery Voltage    = %d.%03d V\n", iBattVolt, nBattVolt);
-		printf("Battery Current    = %f V\n", batteryCurrent);
-		printf("Full Capacity      = %d mAh\n", fullCapacity);
-		printf("Remaining Capacity = %d mAh\n", remainingCapacity);
-		printf("State of Charge    = %d %% \n", stateOfCharge);
-		printf("Input Voltage      = %f V\n", inputVoltage);
-		printf("Batt. Temp         = %f F\n", (temperature * 9.0 / 5.0) + 32.0);
-
-		// check pressure from BMP180
-		wait = Bmp.StartTemperature();
-		HAL_Delay(wait);
-		temp = 0.0;
-		Bmp.GetTemperature(temp);
-		printf("BMP180 Temp = %f C, %f F\n", temp, ((temp * 9.0) / 5) + 32);
-		wait = Bmp.StartPressure(1);
-		HAL_Delay(wait);
-		float pressure;
-		Bmp.GetPressure(pressure, temp);
-
-		// Read time and date from energyShield and store locally
-		// Local values will not update until readClock is called again
-		Es2.readClock();
-
-		// Print time and date from locally stored values
-		printf("\n\tTime:: %d:%d:%d \t Date:: %d-%d-%d\n", Es2.hour(),
-				Es2.minute(), Es2.second(), Es2.month(), Es2.dayOfMonth(),
-				Es2.year());
-
-		// Print carriage return to start new line
-		printf("\n\n\n");
-
-		// Wait between reads
-		HAL_Delay(2000);
-
+		Bus3.Poll();
+		Power.Idle(Sched.Run());
 	}
 	/* USER CODE END 3 */
 }
@@ -229,7 +750,8 @@ void SystemClock_Config(void)
   PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_USART2|RCC_PERIPHCLK_LPTIM1
                               |RCC_PERIPHCLK_I2C1|RCC_PERIPHCLK_I2C3
                               |RCC_PERIPHCLK_ADC;
-  PeriphClkInit.Usart2ClockSelection = RCC_USART2CLKSOURCE_PCLK1;
+  // HSI16 keeps USART2 receiving in STOP1
+  PeriphClkInit.Usart2ClockSelection = RCC_USART2CLKSOURCE_HSI;
   PeriphClkInit.I2c1ClockSelection = RCC_I2C1CLKSOURCE_PCLK1;
   PeriphClkInit.I2c3ClockSelection = RCC_I2C3CLKSOURCE_PCLK1;
   PeriphClkInit.Lptim1ClockSelection = RCC_LPTIM1CLKSOURCE_HSI;
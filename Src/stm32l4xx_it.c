@@ -47,6 +47,8 @@
 
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN PFP */
+void Serial_UartIRQHandler(UART_HandleTypeDef *uart);
+void FlashL4_EccError(uint32_t eccr);
 
 /* USER CODE END PFP */
 
@@ -58,6 +60,10 @@
 /* External variables --------------------------------------------------------*/
 extern UART_HandleTypeDef huart2;
 /* USER CODE BEGIN EV */
+extern I2C_HandleTypeDef hi2c3;
+extern TIM_HandleTypeDef htim3;
+extern ADC_HandleTypeDef hadc1;
+extern LPTIM_HandleTypeDef hlptim1;
 
 /* USER CODE END EV */
 
@@ -70,6 +76,13 @@ extern UART_HandleTypeDef huart2;
 void NMI_Handler(void)
 {
   /* USER CODE BEGIN NonMaskableInt_IRQn 0 */
+  // a double word torn by a power loss fails its ECC when read, the flag
+  // must be cleared or the NMI comes right back
+  if (__HAL_FLASH_GET_FLAG(FLASH_FLAG_ECCD))
+  {
+    FlashL4_EccError(READ_REG(FLASH->ECCR));
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ECCD);
+  }
 
   /* USER CODE END NonMaskableInt_IRQn 0 */
   /* USER CODE BEGIN NonMaskableInt_IRQn 1 */
@@ -203,6 +216,7 @@ void SysTick_Handler(void)
 void USART2_IRQHandler(void)
 {
   /* USER CODE BEGIN USART2_IRQn 0 */
+  Serial_UartIRQHandler(&huart2);
 
   /* USER CODE END USART2_IRQn 0 */
   HAL_UART_IRQHandler(&huart2);
@@ -213,5 +227,61 @@ void USART2_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles DMA1 channel6 global interrupt (USART2 RX).
+  */
+void DMA1_Channel6_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(huart2.hdmarx);
+}
+
+/**
+  * @brief This function handles DMA1 channel7 global interrupt (USART2 TX).
+  */
+void DMA1_Channel7_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(huart2.hdmatx);
+}
+
+/**
+  * @brief This function handles I2C3 event interrupt.
+  */
+void I2C3_EV_IRQHandler(void)
+{
+  HAL_I2C_EV_IRQHandler(&hi2c3);
+}
+
+/**
+  * @brief This function handles I2C3 error interrupt.
+  */
+void I2C3_ER_IRQHandler(void)
+{
+  HAL_I2C_ER_IRQHandler(&hi2c3);
+}
+
+/**
+  * @brief This function handles DMA1 channel2 global interrupt (TIM3 CH3 capture).
+  */
+void DMA1_Channel2_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(htim3.hdma[TIM_DMA_ID_CC3]);
+}
+
+/**
+  * @brief This function handles DMA1 channel1 global interrupt (ADC1 scan).
+  */
+void DMA1_Channel1_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(hadc1.DMA_Handle);
+}
+
+/**
+  * @brief This function handles LPTIM1 global interrupt (STOP2 wake up).
+  */
+void LPTIM1_IRQHandler(void)
+{
+  HAL_LPTIM_IRQHandler(&hlptim1);
+}
+
 /* USER CODE END 1 */
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,94 @@
+/*
+ * FakeBmp180.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef HOST_FAKEBMP180_H_
+#define HOST_FAKEBMP180_H_
+
+#include <string.h>
+#include "HalFake.h"
+
+// raw pressures handed out one per conversion, then the last one again
+#define FAKE_BMP_SAMPLES	16
+
+//////////////////////////////////////////////////////////////////////////////
+//	struct FakeBmp180
+//
+//	BMP180 on the fake I2C bus, with the calibration of the data sheet
+//	example. A conversion command puts ut or the next raw pressure, with
+//	the oversampling of the command, into the result registers.
+//
+struct FakeBmp180
+{
+	uint8_t 			regs[256];
+	int32_t 			ut;
+	int32_t 			up[FAKE_BMP_SAMPLES];
+	int 				upCount;
+	int 				temperatures;		// conversions started
+	int 				pressures;
+	HAL_StatusTypeDef 	status;				// of every transfer
+
+	FakeBmp180()
+	{
+		static const int16_t cal[11] = {408, -72, -14383, (int16_t) 32741,
+				(int16_t) 32757, 23153, 6190, 4, -32768, -8711, 2868};
+
+		memset(regs, 0, sizeof(regs));
+		for (int i = 0; i < 11; i++)
+		{
+			regs[0xAA + 2 * i] = (uint16_t) cal[i] >> 8;
+			regs[0xAB + 2 * i] = cal[i] & 0xFF;
+		}
+		ut = 27898;
+		up[0] = 23843;
+		upCount = 1;
+		temperatures = 0;
+		pressures = 0;
+		status = HAL_OK;
+	}
+
+	void Attach()
+	{
+		Fake.i2cSlave = Slave;
+		Fake.i2cSlaveCtx = this;
+	}
+
+	void Convert(uint8_t cmd)
+	{
+		if (cmd == 0x2E)
+		{
+			regs[0xF6] = ut >> 8;
+			regs[0xF7] = ut & 0xFF;
+			temperatures++;
+			return;
+		}
+
+		int oss = cmd >> 6;
+		int n = (pressures < upCount) ? pressures : upCount - 1;
+		uint32_t raw = (uint32_t) up[n] << (8 - oss);
+
+		regs[0xF6] = raw >> 16;
+		regs[0xF7] = (raw >> 8) & 0xFF;
+		regs[0xF8] = raw & 0xFF;
+		pressures++;
+	}
+
+	static HAL_StatusTypeDef Slave(void *ctx, const FakeI2cXfer &xfer, uint8_t *data)
+	{
+		FakeBmp180 *pBmp = (FakeBmp180 *) ctx;
+
+		if (xfer.addr != 0x77 || pBmp->status != HAL_OK)
+			return pBmp->status != HAL_OK ? pBmp->status : HAL_ERROR;
+
+		if (xfer.read)
+			memcpy(data, &pBmp->regs[xfer.reg], xfer.len);
+		else if (xfer.reg == 0xF4)
+			pBmp->Convert(data[0]);
+		return HAL_OK;
+	}
+};
+
+#endif /* HOST_FAKEBMP180_H_ */
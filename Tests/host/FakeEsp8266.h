@@ -0,0 +1,228 @@
+/*
+ * FakeEsp8266.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef HOST_FAKEESP8266_H_
+#define HOST_FAKEESP8266_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FakeUart.h"
+
+// size of the answers and +IPD frames waiting to go out
+#define FAKE_ESP_OUT		16384
+
+// bytes put on the line per step, about what the UART receives while the
+// main loop runs once; the Serial's receive ring must not overflow
+#define FAKE_ESP_CHUNK		128
+
+// payload bytes kept per socket
+#define FAKE_ESP_PAYLOAD	4096
+
+//////////////////////////////////////////////////////////////////////////////
+//	struct FakeEsp8266
+//
+//	AT responder on a FakeUart, the module with ATE0. It takes what the
+//	Serial transmits, answers every command line with OK (ERROR for the
+//	commands starting with failPrefix, nothing while mute) and runs the
+//	AT+CIPSEND prompt and payload. The answers, and the +IPD frames and
+//	connection events queued with Ipd() and Closed(), are put on the line
+//	by Step(), FAKE_ESP_CHUNK bytes at a time, after the transmissions in
+//	flight are complete. Attach() runs Step() from HAL_GetTick(), so that
+//	the module answers while the code under test polls.
+//
+struct FakeEsp8266
+{
+	FakeUart 		&uart;
+
+	char 			line[256];			// command being received
+	int 			lineLen;
+	int 			payloadLeft;		// of AT+CIPSEND
+	int 			payloadSock;
+	int 			payloadLen;
+
+	uint8_t 		out[FAKE_ESP_OUT];
+	int 			outHead;
+	int 			outLen;
+
+	int 			commands;			// command lines received
+	char 			lastCmd[256];
+	uint8_t 		payload[4][FAKE_ESP_PAYLOAD];
+	int 			payloadBytes[4];	// per socket, also past the buffer
+	int 			sends;				// SEND OK answered
+
+	bool 			mute;
+	const char 		*failPrefix;
+
+	FakeEsp8266(FakeUart &uart) : uart(uart)
+	{
+		lineLen = 0;
+		payloadLeft = 0;
+		payloadSock = 0;
+		payloadLen = 0;
+		outHead = 0;
+		outLen = 0;
+		commands = 0;
+		lastCmd[0] = 0;
+		memset(payloadBytes, 0, sizeof(payloadBytes));
+		sends = 0;
+		mute = false;
+		failPrefix = NULL;
+	}
+
+	void Attach()
+	{
+		Fake.uartTx = Transmitted;
+		Fake.uartTxCtx = this;
+		Fake.tickHook = Tick;
+		Fake.tickHookCtx = this;
+	}
+
+	void Queue(const uint8_t *data, int len)
+	{
+		if (outHead > 0)
+		{
+			memmove(out, out + outHead, outLen);
+			outHead = 0;
+		}
+		if (outLen + len > FAKE_ESP_OUT)
+		{
+			fprintf(stderr, "FakeEsp8266: output overflow\n");
+			abort();
+		}
+		memcpy(out + outLen, data, len);
+		outLen += len;
+	}
+
+	void Queue(const char *text)
+	{
+		Queue((const uint8_t *) text, strlen(text));
+	}
+
+	// +IPD,<sock>,<len>:<data>
+	void Ipd(int sock, const uint8_t *data, int len)
+	{
+		char header[32];
+
+		snprintf(header, sizeof(header), "\r\n+IPD,%d,%d:", sock, len);
+		Queue(header);
+		Queue(data, len);
+	}
+
+	void Ipd(int sock, const char *text)
+	{
+		Ipd(sock, (const uint8_t *) text, strlen(text));
+	}
+
+	void Closed(int sock)
+	{
+		char text[16];
+
+		snprintf(text, sizeof(text), "%d,CLOSED\r\n", sock);
+		Queue(text);
+	}
+
+	bool Pending()
+	{
+		return (outLen > 0) || Fake.uartTxBusy;
+	}
+
+	void Step()
+	{
+		uart.CompleteTx();
+
+		int n = (outLen < FAKE_ESP_CHUNK) ? outLen : FAKE_ESP_CHUNK;
+		if (n > 0)
+		{
+			// the answer may queue more, take the chunk out first
+			uint8_t chunk[FAKE_ESP_CHUNK];
+
+			memcpy(chunk, out + outHead, n);
+			outHead += n;
+			outLen -= n;
+			uart.Receive(chunk, n);
+		}
+	}
+
+	void Command()
+	{
+		line[lineLen] = 0;
+		commands++;
+		strcpy(lastCmd, line);
+
+		if (mute)
+			return;
+		if ((failPrefix != NULL) && (strncmp(line, failPrefix, strlen(failPrefix)) == 0))
+		{
+			Queue("\r\nERROR\r\n");
+			return;
+		}
+
+		if (strncmp(line, "AT+CIPSEND=", 11) == 0)
+		{
+			// <id>,<len>[,<host>,<port>]
+			char *p;
+
+			payloadSock = strtol(line + 11, &p, 10);
+			payloadLen = (*p == ',') ? strtol(p + 1, &p, 10) : 0;
+			payloadLeft = payloadLen;
+			Queue("\r\nOK\r\n> ");
+			return;
+		}
+		if (strcmp(line, "AT+CIPSTATUS") == 0)
+		{
+			Queue("STATUS:2\r\n\r\nOK\r\n");
+			return;
+		}
+		Queue("\r\nOK\r\n");
+	}
+
+	void Payload(uint8_t c)
+	{
+		int &n = payloadBytes[payloadSock & 3];
+
+		if (n < FAKE_ESP_PAYLOAD)
+			payload[payloadSock & 3][n] = c;
+		n++;
+
+		if (--payloadLeft == 0)
+		{
+			char text[48];
+
+			snprintf(text, sizeof(text), "\r\nRecv %d bytes\r\n\r\nSEND OK\r\n", payloadLen);
+			Queue(text);
+			sends++;
+		}
+	}
+
+	static void Transmitted(void *ctx, const uint8_t *data, int len)
+	{
+		FakeEsp8266 *esp = (FakeEsp8266 *) ctx;
+
+		for (int i = 0; i < len; i++)
+		{
+			if (esp->payloadLeft > 0)
+				esp->Payload(data[i]);
+			else if (data[i] == '\n')
+			{
+				if ((esp->lineLen > 0) && (esp->line[esp->lineLen - 1] == '\r'))
+					esp->lineLen--;
+				esp->Command();
+				esp->lineLen = 0;
+			}
+			else if (esp->lineLen < (int) sizeof(esp->line) - 1)
+				esp->line[esp->lineLen++] = data[i];
+		}
+	}
+
+	static void Tick(void *ctx)
+	{
+		((FakeEsp8266 *) ctx)->Step();
+	}
+};
+
+#endif /* HOST_FAKEESP8266_H_ */
@@ -0,0 +1,150 @@
+/*
+ * FakeFlash.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef HOST_FAKEFLASH_H_
+#define HOST_FAKEFLASH_H_
+
+#include <string.h>
+#include <vector>
+#include "FlashStore.h"
+
+// how a program cut by the power loss ends up in the flash
+enum FakeTearEnum
+{
+	tearHalf,		// the low half of the double word is programmed
+	tearEcc			// all of it, with an uncorrectable ECC error
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	class FakeFlash
+//
+//	FlashStore in RAM with the rules of the STM32L4 flash: a double word is
+//	programmed once after an erase. The power can be cut at the n-th
+//	program or erase: that one is torn, all later ones fail until
+//	PowerOn(), as after a restart.
+//
+class FakeFlash : public FlashStore
+{
+public:
+	FakeFlash(int pages, int pageSize) :
+			m_pages(pages), m_pageSize(pageSize), m_data(pages * pageSize, 0xFF),
+			m_ecc(pages * pageSize / 8, false)
+	{
+		programs = 0;
+		erases = 0;
+		cutAt = -1;
+		tear = tearHalf;
+		m_ops = 0;
+		m_powered = true;
+	}
+
+	virtual int PageSize() { return m_pageSize; }
+	virtual int Pages() { return m_pages; }
+
+	virtual const uint8_t *Page(int page)
+	{
+		return &m_data[page * m_pageSize];
+	}
+
+	virtual bool Program(int page, int offset, uint64_t data)
+	{
+		uint8_t *p = &m_data[page * m_pageSize + offset];
+		uint64_t old;
+
+		if (!m_powered || offset % 8 != 0 || offset + 8 > m_pageSize)
+			return false;
+
+		memcpy(&old, p, 8);
+		if (old != 0xFFFFFFFFFFFFFFFFULL)
+			return false;
+
+		if (Cut())
+		{
+			if (tear == tearHalf)
+				data |= 0xFFFFFFFF00000000ULL;
+			else
+				m_ecc[(page * m_pageSize + offset) / 8] = true;
+			memcpy(p, &data, 8);
+			return false;
+		}
+
+		memcpy(p, &data, 8);
+		programs++;
+		return true;
+	}
+
+	virtual bool Erase(int page)
+	{
+		if (!m_powered)
+			return false;
+
+		// a cut erase only gets through the first half
+		int len = Cut() ? m_pageSize / 2 : m_pageSize;
+
+		memset(&m_data[page * m_pageSize], 0xFF, len);
+		for (int i = 0; i < len / 8; i++)
+			m_ecc[page * m_pageSize / 8 + i] = false;
+
+		if (!m_powered)
+			return false;
+		erases++;
+		return true;
+	}
+
+	virtual bool ReadError(int page, int offset, int len)
+	{
+		for (int i = offset / 8; i <= (offset + len - 1) / 8; i++)
+		{
+			if (m_ecc[page * m_pageSize / 8 + i])
+				return true;
+		}
+		return false;
+	}
+
+	// cuts the power at the n-th program or erase from now on
+	void CutAfter(int n)
+	{
+		cutAt = m_ops + n;
+	}
+
+	// an ECC error in the double word at offset, as a worn cell would give
+	void SetEccError(int page, int offset)
+	{
+		m_ecc[(page * m_pageSize + offset) / 8] = true;
+	}
+
+	void PowerOn()
+	{
+		m_powered = true;
+		cutAt = -1;
+	}
+
+	bool Powered() { return m_powered; }
+
+	int 			programs;
+	int 			erases;
+	int 			cutAt;
+	FakeTearEnum 	tear;
+
+private:
+	bool Cut()
+	{
+		if (m_ops++ != cutAt)
+			return false;
+		m_powered = false;
+		return true;
+	}
+
+	int 					m_pages;
+	int 					m_pageSize;
+	std::vector<uint8_t> 	m_data;
+	std::vector<bool> 		m_ecc;
+	int 					m_ops;
+	bool 					m_powered;
+};
+
+#endif /* HOST_FAKEFLASH_H_ */
@@ -0,0 +1,142 @@
+/*
+ * FakeUart.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef HOST_FAKEUART_H_
+#define HOST_FAKEUART_H_
+
+#include <string.h>
+#include "HalFake.h"
+
+extern "C"
+{
+	void Serial_IRQHandler(UART_HandleTypeDef *uart);
+	void Serial_UartIRQHandler(UART_HandleTypeDef *uart);
+	void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *uart);
+	void HAL_UART_RxCpltCallback(UART_HandleTypeDef *uart);
+	void HAL_UART_TxCpltCallback(UART_HandleTypeDef *uart);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	struct FakeUart
+//
+//	USART2 for the Serial class, its registers in the RAM of HalFake. It
+//	plays the part of the hardware and of the interrupts: Receive puts
+//	bytes on the line, into the circular DMA buffer or through RXNE, and
+//	ends them with an IDLE line; CompleteTx finishes the DMA transmissions
+//	and DrainTxe the TXE interrupts of the interrupt mode. A byte the
+//	interrupt handler writes to TDR goes on the wire and is counted in
+//	tdrWrites.
+//
+struct FakeUart
+{
+	UART_HandleTypeDef 	huart;
+	int 				tdrWrites;
+
+	// after FakeReset(), before the Serial is constructed
+	FakeUart()
+	{
+		memset(&huart, 0, sizeof(huart));
+		huart.Instance = USART2;
+		huart.Instance->ISR = USART_ISR_TXE | USART_ISR_TC;		// idle
+		tdrWrites = 0;
+	}
+
+	// a Serial left busy would not start the next test's transmissions
+	~FakeUart()
+	{
+		CompleteTx();
+	}
+
+	void Receive(const uint8_t *data, int len, bool idle = true)
+	{
+		if (huart.Instance->CR1 & USART_CR1_RXNEIE)
+		{
+			for (int i = 0; i < len; i++)
+			{
+				huart.Instance->RDR = data[i];
+				huart.Instance->ISR |= USART_ISR_RXNE;
+				Irq();
+				huart.Instance->ISR &= ~USART_ISR_RXNE;
+			}
+			return;
+		}
+
+		// the DMA counts CNDTR down and reloads it at the end of the buffer
+		DMA_Channel_TypeDef *dma = huart.hdmarx->Instance;
+		int size = Fake.uartRxSize;
+
+		for (int i = 0; i < len; i++)
+		{
+			int pos = size - dma->CNDTR;
+
+			Fake.uartRxBuf[pos++] = data[i];
+			dma->CNDTR = (pos == size) ? size : size - pos;
+			if (pos == size / 2)
+				HAL_UART_RxHalfCpltCallback(&huart);
+			else if (pos == size)
+				HAL_UART_RxCpltCallback(&huart);
+		}
+
+		if (idle)
+			Idle();
+	}
+
+	void Receive(const char *text, bool idle = true)
+	{
+		Receive((const uint8_t *) text, strlen(text), idle);
+	}
+
+	void Idle()
+	{
+		huart.Instance->ISR |= USART_ISR_IDLE;
+		if (huart.Instance->CR1 & USART_CR1_IDLEIE)
+			Serial_UartIRQHandler(&huart);
+		huart.Instance->ISR &= ~USART_ISR_IDLE;
+	}
+
+	// returns the transmissions finished
+	int CompleteTx()
+	{
+		int n = 0;
+
+		while (Fake.uartTxBusy)
+		{
+			Fake.uartTxBusy = false;
+			HAL_UART_TxCpltCallback(&huart);
+			n++;
+		}
+		return n;
+	}
+
+	// one USART interrupt, returns true if it wrote TDR
+	bool Irq()
+	{
+		huart.Instance->TDR = 0xFFFF;
+		Serial_IRQHandler(&huart);
+		if (huart.Instance->TDR == 0xFFFF)
+			return false;
+
+		if (Fake.uartWireLen < FAKE_UART_WIRE)
+			Fake.uartWire[Fake.uartWireLen++] = huart.Instance->TDR;
+		Fake.uartTxBytes++;
+		tdrWrites++;
+		return true;
+	}
+
+	// TXE interrupts until TXEIE is off, returns the bytes sent
+	int DrainTxe()
+	{
+		int n = 0;
+
+		huart.Instance->ISR |= USART_ISR_TXE;
+		while (huart.Instance->CR1 & USART_CR1_TXEIE)
+			n += Irq();
+		return n;
+	}
+};
+
+#endif /* HOST_FAKEUART_H_ */
@@ -0,0 +1,215 @@
+/*
+ * FakeUdp.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef HOST_FAKEUDP_H_
+#define HOST_FAKEUDP_H_
+
+#include <string.h>
+#include <Udp.h>
+
+#define FAKE_UDP_SERVERS	4
+#define FAKE_UDP_QUEUE		8
+#define FAKE_UDP_SIZE		64
+
+// what a server does with its n-th request
+enum FakeAnswerEnum
+{
+	answerReply,
+	answerDrop,
+	answerKiss,			// a reply with stratum 0
+	answerLate			// a reply that comes after the client gave up
+};
+
+// an SNTP server: its time at tick t is base + t, the request and the reply
+// take delays[n] ticks each way for the n-th request, 1 tick in between
+struct FakeServer
+{
+	const char 		*host;
+	int64_t 		base;
+	const int 		*delays;
+	const FakeAnswerEnum *answers;		// NULL for all answerReply
+	int 			requests;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	class FakeUdp
+//
+//	UDP with SNTP servers behind it, on the tick of the test. A request
+//	goes out at endPacket(), the reply is queued and parsePacket() returns
+//	it once the tick has reached its arrival. ReceiveTick() is that tick,
+//	for SntpClient::SetReceiveTick().
+//
+class FakeUdp : public UDP
+{
+public:
+	FakeUdp(const uint32_t *tick) : m_tick(tick)
+	{
+		memset(servers, 0, sizeof(servers));
+		count = 0;
+		opens = 0;
+		refuse = false;
+		sent = 0;
+		late = 0;
+		memset(m_queue, 0, sizeof(m_queue));
+		m_queued = 0;
+		m_len = 0;
+		m_pos = 0;
+		m_arrival = 0;
+		m_server = NULL;
+		m_out = 0;
+	}
+
+	void AddServer(const char *host, int64_t base, const int *delays,
+			const FakeAnswerEnum *answers = NULL)
+	{
+		FakeServer &s = servers[count++];
+		s.host = host;
+		s.base = base;
+		s.delays = delays;
+		s.answers = answers;
+		s.requests = 0;
+	}
+
+	uint32_t ReceiveTick() { return m_arrival; }
+
+	virtual uint8_t begin(uint16_t port) { opens++; return !refuse; }
+	virtual void stop() {}
+
+	virtual int beginPacket(IPAddress ip, uint16_t port) { return 0; }
+	virtual int beginPacket(const char *host, uint16_t port)
+	{
+		m_server = NULL;
+		for (int i = 0; i < count; i++)
+		{
+			if (strcmp(servers[i].host, host) == 0)
+				m_server = &servers[i];
+		}
+		m_out = 0;
+		return m_server != NULL && port == 123;
+	}
+
+	virtual int endPacket()
+	{
+		if (m_server == NULL || m_out != 48)
+			return 0;
+
+		sent++;
+		Answer(*m_server, m_server->requests++);
+		return 1;
+	}
+
+	virtual size_t write(uint8_t c) { return write(&c, 1); }
+	virtual size_t write(const uint8_t *buffer, size_t size)
+	{
+		if (m_out + size > sizeof(m_request))
+			size = sizeof(m_request) - m_out;
+		memcpy(m_request + m_out, buffer, size);
+		m_out += size;
+		return size;
+	}
+
+	virtual int parsePacket()
+	{
+		m_len = 0;
+		m_pos = 0;
+		if (m_queued == 0 || (int32_t) (*m_tick - m_queue[0].arrival) < 0)
+			return 0;
+
+		memcpy(m_packet, m_queue[0].data, sizeof(m_packet));
+		m_len = m_queue[0].len;
+		m_arrival = m_queue[0].arrival;
+		memmove(m_queue, m_queue + 1, --m_queued * sizeof(m_queue[0]));
+		return m_len;
+	}
+
+	virtual int available() { return m_len - m_pos; }
+	virtual int read() { return (m_pos < m_len) ? m_packet[m_pos++] : -1; }
+	virtual int read(unsigned char *buffer, size_t len)
+	{
+		int n = ((int) len < m_len - m_pos) ? (int) len : m_len - m_pos;
+		memcpy(buffer, m_packet + m_pos, n);
+		m_pos += n;
+		return n;
+	}
+	virtual int read(char *buffer, size_t len) { return read((unsigned char *) buffer, len); }
+	virtual int peek() { return (m_pos < m_len) ? m_packet[m_pos] : -1; }
+	virtual void flush() { m_pos = m_len; }
+
+	virtual IPAddress remoteIP() const { return IPAddress(192, 168, 1, 1); }
+	virtual uint16_t remotePort() const { return 123; }
+
+	FakeServer 	servers[FAKE_UDP_SERVERS];
+	int 		count;
+	int 		opens;
+	bool 		refuse;			// begin() fails
+	int 		sent;
+	int 		late;			// late replies still queued at the next request
+
+private:
+	struct Datagram
+	{
+		uint32_t 	arrival;
+		int 		len;
+		uint8_t 	data[FAKE_UDP_SIZE];
+	};
+
+	static void PutU64(uint8_t *p, uint64_t v)
+	{
+		for (int i = 7; i >= 0; i--, v >>= 8)
+			p[i] = v & 0xFF;
+	}
+
+	static uint64_t ToNtp(int64_t ms)
+	{
+		uint64_t secs = ms / 1000 + 2208988800ULL;
+
+		return (secs << 32) | (((uint64_t) (ms % 1000) << 32) / 1000);
+	}
+
+	void Answer(FakeServer &s, int n)
+	{
+		FakeAnswerEnum answer = (s.answers != NULL) ? s.answers[n] : answerReply;
+		uint32_t now = *m_tick;
+		int delay = s.delays[n];
+
+		for (int i = 0; i < m_queued; i++)
+		{
+			if ((int32_t) (now - m_queue[i].arrival) >= 0)
+				late++;
+		}
+		if (answer == answerDrop || m_queued == FAKE_UDP_QUEUE)
+			return;
+		if (answer == answerLate)
+			delay = 1000;
+
+		// the transmit time of the request is the origin of the reply
+		Datagram &d = m_queue[m_queued++];
+		int64_t t2 = s.base + now + delay;
+
+		memset(d.data, 0, sizeof(d.data));
+		d.data[0] = (4 << 3) | 4;
+		d.data[1] = (answer == answerKiss) ? 0 : 2;
+		memcpy(d.data + 24, m_request + 40, 8);
+		PutU64(d.data + 32, ToNtp(t2));
+		PutU64(d.data + 40, ToNtp(t2 + 1));
+		d.len = 48;
+		d.arrival = now + 2 * delay + 1;
+	}
+
+	const uint32_t 	*m_tick;
+	Datagram 		m_queue[FAKE_UDP_QUEUE];
+	int 			m_queued;
+	uint8_t 		m_packet[FAKE_UDP_SIZE];
+	int 			m_len;
+	int 			m_pos;
+	uint32_t 		m_arrival;
+	FakeServer 		*m_server;
+	uint8_t 		m_request[48];
+	size_t 			m_out;
+};
+
+#endif /* HOST_FAKEUDP_H_ */
@@ -0,0 +1,365 @@
+/*
+ * HalFake.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "HalFake.h"
+
+// APB1, APB2 and the AHB1 peripherals up to RCC and the flash interface
+#define FAKE_PERIPH_SIZE	0x30000
+
+FakeHal Fake;
+__IO uint32_t uwTick;
+
+// RAM at the peripheral addresses of the device header, mapped on the
+// first reset
+static void *FakePeripherals(void)
+{
+	static void *periph = NULL;
+
+	if (periph == NULL)
+	{
+		periph = mmap((void *) PERIPH_BASE, FAKE_PERIPH_SIZE, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (periph != (void *) PERIPH_BASE)
+		{
+			fprintf(stderr, "HalFake: peripheral range 0x%08lx is taken\n",
+					(unsigned long) PERIPH_BASE);
+			abort();
+		}
+	}
+	return periph;
+}
+
+void FakeReset(void)
+{
+	memset(&Fake, 0, sizeof(Fake));
+	Fake.i2cStartStatus = HAL_OK;
+	uwTick = 0;
+	memset(FakePeripherals(), 0, FAKE_PERIPH_SIZE);
+}
+
+uint32_t FakeGetPrimask(void)
+{
+	return Fake.primask;
+}
+
+void FakeSetPrimask(uint32_t primask)
+{
+	Fake.primask = primask;
+}
+
+const FakeI2cXfer &FakeI2cLast(int n)
+{
+	return Fake.i2cLog[(Fake.i2cStarts - 1 - n) % FAKE_I2C_LOG];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// HAL
+////////////////////////////////////////////////////////////////////////////////
+
+uint32_t HAL_GetTick(void)
+{
+	static bool inHook = false;
+	uint32_t tick = Fake.tick;
+
+	Fake.tick += Fake.tickStep;
+	if ((Fake.tickHook != NULL) && !inHook)
+	{
+		inHook = true;
+		Fake.tickHook(Fake.tickHookCtx);
+		inHook = false;
+	}
+	return tick;
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+	Fake.tick += Delay;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// I2C
+////////////////////////////////////////////////////////////////////////////////
+
+static HAL_StatusTypeDef I2cStart(I2C_HandleTypeDef *hi2c, uint16_t addr, int reg,
+		bool read, uint8_t *data, uint16_t len)
+{
+	if (Fake.i2cStartStatus != HAL_OK)
+		return Fake.i2cStartStatus;
+
+	FakeI2cXfer &xfer = Fake.i2cLog[Fake.i2cStarts++ % FAKE_I2C_LOG];
+
+	xfer.hi2c = hi2c;
+	xfer.addr = addr >> 1;
+	xfer.reg = reg;
+	xfer.read = read;
+	xfer.len = len;
+
+	if (Fake.i2cSlave == NULL)
+		return HAL_OK;
+
+	HAL_StatusTypeDef status = Fake.i2cSlave(Fake.i2cSlaveCtx, xfer, data);
+	if (status == HAL_TIMEOUT)
+		return HAL_OK;
+
+	if (status != HAL_OK)
+		HAL_I2C_ErrorCallback(hi2c);
+	else if (reg < 0)
+		read ? HAL_I2C_MasterRxCpltCallback(hi2c) : HAL_I2C_MasterTxCpltCallback(hi2c);
+	else
+		read ? HAL_I2C_MemRxCpltCallback(hi2c) : HAL_I2C_MemTxCpltCallback(hi2c);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c)
+{
+	Fake.i2cInits++;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c)
+{
+	Fake.i2cDeInits++;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress,
+		uint8_t *pData, uint16_t Size)
+{
+	return I2cStart(hi2c, DevAddress, -1, false, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress,
+		uint8_t *pData, uint16_t Size)
+{
+	return I2cStart(hi2c, DevAddress, -1, true, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress,
+		uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	return I2cStart(hi2c, DevAddress, MemAddress, false, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress,
+		uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	return I2cStart(hi2c, DevAddress, MemAddress, true, pData, Size);
+}
+
+void HAL_SuspendTick(void)
+{
+}
+
+void HAL_ResumeTick(void)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// UART and DMA
+////////////////////////////////////////////////////////////////////////////////
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma)
+{
+	return Fake.dmaInitStatus;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+	if (Fake.uartTxBusy)
+		return HAL_BUSY;
+
+	Fake.uartTxBusy = true;
+	Fake.uartTxStarts++;
+	Fake.uartTxBytes += Size;
+	for (int i = 0; (i < Size) && (Fake.uartWireLen < FAKE_UART_WIRE); i++)
+		Fake.uartWire[Fake.uartWireLen++] = pData[i];
+
+	if (Fake.uartTx != NULL)
+		Fake.uartTx(Fake.uartTxCtx, pData, Size);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+	Fake.uartRxBuf = pData;
+	Fake.uartRxSize = Size;
+	huart->hdmarx->Instance->CNDTR = Size;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_StopModeWakeUpSourceConfig(UART_HandleTypeDef *huart,
+		UART_WakeUpTypeDef WakeUpSelection)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_EnableStopMode(UART_HandleTypeDef *huart)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_DisableStopMode(UART_HandleTypeDef *huart)
+{
+	return HAL_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// low power
+////////////////////////////////////////////////////////////////////////////////
+
+void HAL_PWR_EnterSLEEPMode(uint32_t Regulator, uint8_t SLEEPEntry)
+{
+	Fake.sleeps++;
+}
+
+void HAL_PWREx_EnterSTOP1Mode(uint8_t STOPEntry)
+{
+	Fake.stop1s++;
+}
+
+void HAL_PWREx_EnterSTOP2Mode(uint8_t STOPEntry)
+{
+	Fake.stop2s++;
+}
+
+HAL_StatusTypeDef HAL_LPTIM_Counter_Start_IT(LPTIM_HandleTypeDef *hlptim, uint32_t Period)
+{
+	Fake.lptimRunning = true;
+	Fake.lptimPeriod = Period;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_LPTIM_Counter_Stop_IT(LPTIM_HandleTypeDef *hlptim)
+{
+	Fake.lptimRunning = false;
+	return HAL_OK;
+}
+
+uint32_t HAL_LPTIM_ReadCounter(LPTIM_HandleTypeDef *hlptim)
+{
+	return Fake.lptimCounter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// not run by the tests, for the link only
+////////////////////////////////////////////////////////////////////////////////
+
+uint32_t SystemCoreClock = 80000000;
+ADC_HandleTypeDef hadc1;
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Init(TIM_HandleTypeDef *htim)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_ConfigChannel(TIM_HandleTypeDef *htim, TIM_IC_InitTypeDef *sConfig,
+		uint32_t Channel)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_SlaveConfigSynchronization(TIM_HandleTypeDef *htim,
+		TIM_SlaveConfigTypeDef *sSlaveConfig)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Start_DMA(TIM_HandleTypeDef *htim, uint32_t Channel, uint32_t *pData,
+		uint16_t Length)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Stop_DMA(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Init(ADC_HandleTypeDef *hadc)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_DeInit(ADC_HandleTypeDef *hadc)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef *hadc, ADC_ChannelConfTypeDef *sConfig)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADCEx_Calibration_Start(ADC_HandleTypeDef *hadc, uint32_t SingleDiff)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start(ADC_HandleTypeDef *hadc)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Stop(ADC_HandleTypeDef *hadc)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_PollForConversion(ADC_HandleTypeDef *hadc, uint32_t Timeout)
+{
+	return HAL_OK;
+}
+
+uint32_t HAL_ADC_GetValue(ADC_HandleTypeDef *hadc)
+{
+	return 0;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *pData, uint32_t Length)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Stop_DMA(ADC_HandleTypeDef *hadc)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_LPTIM_Init(LPTIM_HandleTypeDef *hlptim)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCCEx_PeriphCLKConfig(RCC_PeriphCLKInitTypeDef *PeriphClkInit)
+{
+	return HAL_OK;
+}
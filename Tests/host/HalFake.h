@@ -0,0 +1,101 @@
+/*
+ * HalFake.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#ifndef HOST_HALFAKE_H_
+#define HOST_HALFAKE_H_
+
+#include <stdint.h>
+#include <stm32l4xx_hal.h>
+
+// transactions kept in the I2C log
+#define FAKE_I2C_LOG		32
+
+// one transaction started on the fake I2C, reg -1 for a plain transfer
+struct FakeI2cXfer
+{
+	I2C_HandleTypeDef 	*hi2c;
+	uint16_t 			addr;		// 7 bit
+	int 				reg;
+	bool 				read;
+	uint16_t 			len;
+};
+
+// bytes of the UART transmissions kept in Fake.uartWire
+#define FAKE_UART_WIRE		4096
+
+// a slave on the fake bus, fills or takes data; HAL_OK or HAL_ERROR raise
+// the completion or error callback at once, HAL_TIMEOUT never completes
+typedef HAL_StatusTypeDef (*FakeI2cSlave)(void *ctx, const FakeI2cXfer &xfer, uint8_t *data);
+
+// runs what the hardware does meanwhile, see FakeHal
+typedef void (*FakeTickHook)(void *ctx);
+
+// sees every DMA transmission of the fake UART as it is started
+typedef void (*FakeUartTx)(void *ctx, const uint8_t *data, int len);
+
+//////////////////////////////////////////////////////////////////////////////
+//	struct FakeHal
+//
+//	state of the HAL functions of HalFake.cpp. HAL_GetTick() returns tick
+//	and adds tickStep to it, so that a loop polling for a timeout ends.
+//	It then calls tickHook, which stands for the hardware and interrupts
+//	that run while the code under test waits.
+//	Without a slave an I2C transfer only starts, the test raises the
+//	completion callback itself, as the interrupt would. A stop returns at
+//	once, with lptimCounter as the time it lasted.
+//
+//	The peripheral address range is backed by RAM, so code that sets up
+//	registers through the device header runs and the tests read back what
+//	it wrote. A UART DMA transmission stays busy until the test raises
+//	HAL_UART_TxCpltCallback; the circular receive DMA is only recorded,
+//	FakeUart.h moves data into it.
+//
+struct FakeHal
+{
+	uint32_t 			tick;
+	uint32_t 			tickStep;
+	FakeTickHook 		tickHook;
+	void 				*tickHookCtx;
+
+	HAL_StatusTypeDef 	i2cStartStatus;		// returned by the _IT calls
+	FakeI2cSlave 		i2cSlave;
+	void 				*i2cSlaveCtx;
+	FakeI2cXfer 		i2cLog[FAKE_I2C_LOG];
+	int 				i2cStarts;
+	int 				i2cInits;
+	int 				i2cDeInits;
+
+	int 				sleeps;				// low power entries
+	int 				stop1s;
+	int 				stop2s;
+	bool 				lptimRunning;
+	uint32_t 			lptimPeriod;
+	uint32_t 			lptimCounter;		// read after a stop
+
+	uint32_t 			primask;
+	HAL_StatusTypeDef 	dmaInitStatus;
+
+	uint8_t 			uartWire[FAKE_UART_WIRE];
+	int 				uartWireLen;
+	uint32_t 			uartTxBytes;		// all transmitted, also past the wire
+	int 				uartTxStarts;
+	bool 				uartTxBusy;
+	FakeUartTx 			uartTx;
+	void 				*uartTxCtx;
+	uint8_t 			*uartRxBuf;			// of HAL_UART_Receive_DMA
+	uint16_t 			uartRxSize;
+};
+
+extern FakeHal Fake;
+
+// back to tick 0 with nothing logged, the peripheral registers zeroed
+void FakeReset(void);
+
+// the transaction started n starts ago, 0 the last one
+const FakeI2cXfer &FakeI2cLast(int n = 0);
+
+#endif /* HOST_HALFAKE_H_ */
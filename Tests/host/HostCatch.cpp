@@ -0,0 +1,10 @@
+/*
+ * HostCatch.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+// main() of the host tests
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
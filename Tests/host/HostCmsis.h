@@ -0,0 +1,35 @@
+/*
+ * HostCmsis.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ *
+ *  included ahead of every host source (-include). The CMSIS intrinsics
+ *  that touch the core registers are ARM assembly; the header is read once
+ *  with them and the calls are then routed to HalFake.cpp, which keeps
+ *  PRIMASK in Fake.primask.
+ */
+
+#ifndef HOST_HOSTCMSIS_H_
+#define HOST_HOSTCMSIS_H_
+
+#include <stdint.h>
+#include <stm32l4xx.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t FakeGetPrimask(void);
+void FakeSetPrimask(uint32_t primask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define __get_PRIMASK()			FakeGetPrimask()
+#define __set_PRIMASK(primask)	FakeSetPrimask(primask)
+#define __disable_irq()			FakeSetPrimask(1)
+#define __enable_irq()			FakeSetPrimask(0)
+
+#endif /* HOST_HOSTCMSIS_H_ */
@@ -0,0 +1,38 @@
+/*
+ * Arduino.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ *
+ *  what the ESP8266 core sources linked into the host tests (String, Print,
+ *  Stream, IPAddress) take from Arduino.h, on top of the HAL
+ */
+
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <stm32l4xx_hal.h>
+
+#include "stdlib_noniso.h"
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+
+typedef bool boolean;
+
+inline unsigned long millis(void)
+{
+	return HAL_GetTick();
+}
+
+inline void yield(void)
+{
+}
+
+#endif /* HOST_ARDUINO_H_ */
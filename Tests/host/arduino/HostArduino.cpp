@@ -0,0 +1,12 @@
+/*
+ * HostArduino.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+// lwIP's, IPAddress compares against it
+const ip_addr_t ip_addr_any = IPADDR4_INIT(IPADDR_ANY);
@@ -0,0 +1,85 @@
+/*
+ * test_AdcScan.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include "AdcScan.h"
+
+// typical VREFINT calibration, the result at 3.0 V
+#define VREF_CAL	1655
+
+TEST_CASE("AdcScan VDDA from the internal reference", "[AdcScan]")
+{
+	CHECK(AdcScan::Vdda(VREF_CAL * ADC_OVS_SCALE, VREF_CAL) == 3000);
+
+	// at 3.3 V the reference reads 3.0 / 3.3 of its calibration value
+	CHECK(AdcScan::Vdda(VREF_CAL * ADC_OVS_SCALE * 3000 / 3300, VREF_CAL) == 3300);
+	CHECK(AdcScan::Vdda(VREF_CAL * ADC_OVS_SCALE * 3000 / 1800, VREF_CAL) == 1800);
+	CHECK(AdcScan::Vdda(0, VREF_CAL) == 0);
+}
+
+TEST_CASE("AdcScan millivolts", "[AdcScan]")
+{
+	CHECK(AdcScan::ToMillivolts(0, 3300) == 0);
+	CHECK(AdcScan::ToMillivolts(ADC_FULL_SCALE, 3300) == 3300);
+	CHECK(AdcScan::ToMillivolts(ADC_FULL_SCALE / 2, 3300) == 1650);
+	// one LSB of the oversampled result is below 1 mV
+	CHECK(AdcScan::ToMillivolts(1000 * ADC_OVS_SCALE, 3000) == 733);
+	CHECK(AdcScan::ToMillivolts(1000 * ADC_OVS_SCALE + 8, 3000) == 733);
+}
+
+TEST_CASE("AdcScan temperature sensor", "[AdcScan]")
+{
+	const uint16_t cal1 = 1034, cal2 = 1372;
+
+	CHECK(AdcScan::Temperature(cal1 * ADC_OVS_SCALE, 3000, cal1, cal2) == TEMPSENSOR_CAL1_TEMP * 10);
+	CHECK(AdcScan::Temperature(cal2 * ADC_OVS_SCALE, 3000, cal1, cal2) == TEMPSENSOR_CAL2_TEMP * 10);
+	CHECK(AdcScan::Temperature((cal1 + cal2) * ADC_OVS_SCALE / 2, 3000, cal1, cal2) ==
+			(TEMPSENSOR_CAL1_TEMP + TEMPSENSOR_CAL2_TEMP) * 5);
+
+	// the same temperature read at 3.3 V
+	int32_t t = AdcScan::Temperature(cal1 * ADC_OVS_SCALE * 3000 / 3300, 3300, cal1, cal2);
+	CHECK(t >= 299);
+	CHECK(t <= 301);
+
+	// no calibration
+	CHECK(AdcScan::Temperature(cal1 * ADC_OVS_SCALE, 3000, cal1, cal1) == 0);
+}
+
+TEST_CASE("AdcScan low pass", "[AdcScan]")
+{
+	int32_t state = 0;
+
+	// without a shift the sample passes, the first one seeds the state
+	CHECK(AdcScan::Filter(state, 1234, 0) == 1234);
+	CHECK(AdcScan::Filter(state, 1000, 0) == 1000);
+
+	state = 0;
+	CHECK(AdcScan::Filter(state, 1000, 3) == 1000);
+	CHECK(state == 1000 << 3);
+
+	// a step moves 1/8 of the way per scan and settles on the new value
+	CHECK(AdcScan::Filter(state, 2000, 3) == 1125);
+	CHECK(AdcScan::Filter(state, 2000, 3) == 1234);
+	uint32_t out = 0;
+	for (int i = 0; i < 100; i++)
+		out = AdcScan::Filter(state, 2000, 3);
+	CHECK(out == 2000);
+
+	// noise of +-80 is averaged down
+	for (int i = 0; i < 100; i++)
+	{
+		out = AdcScan::Filter(state, (i & 1) ? 2080 : 1920, 3);
+		CHECK(out >= 1985);
+		CHECK(out <= 2015);
+	}
+
+	// a full scale oversampled result does not overflow the state
+	state = 0;
+	for (int i = 0; i < 100; i++)
+		out = AdcScan::Filter(state, 0xFFFF, 8);
+	CHECK(out == 0xFFFF);
+}
@@ -0,0 +1,225 @@
+/*
+ * test_BmpBurst.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include "HalFake.h"
+#include "FakeBmp180.h"
+#include "BmpBurst.h"
+
+// the compensated pressure of one raw value at OSS 0, in Pa
+static int32_t Pressure(SFE_BMP180 &bmp, int32_t up)
+{
+	FakeBmp180 sensor;
+	int32_t t, p = 0;
+
+	sensor.up[0] = up;
+	sensor.Attach();
+	bmp.StartTemperature();
+	bmp.GetTemperature(t);
+	bmp.StartPressure(0);
+	bmp.GetPressure(p);
+	return p;
+}
+
+TEST_CASE("BmpBurst runs the conversions back to back", "[BmpBurst]")
+{
+	FakeReset();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	FakeBmp180 sensor;
+	SFE_BMP180 bmp(&bus);
+	BmpBurst burst(&bmp);
+	int32_t p, t;
+
+	sensor.Attach();
+	REQUIRE(bmp.Begin());
+	burst.Begin(0, 2, 4, 0, 0);
+
+	// temperature, then 2 pressures per temperature
+	REQUIRE(burst.Step(0) == 5);
+	CHECK(sensor.temperatures == 1);
+	REQUIRE(burst.Step(5) == 5);
+	CHECK(sensor.pressures == 1);
+	REQUIRE(burst.Step(10) == 5);
+	CHECK(sensor.pressures == 2);
+	REQUIRE(burst.Step(15) == 5);
+	CHECK(sensor.temperatures == 2);
+	REQUIRE(!burst.Read(p, t));
+	REQUIRE(burst.Step(20) == 5);
+	REQUIRE(burst.Step(25) == 5);
+	CHECK(sensor.pressures == 4);
+
+	// the 4th pressure ends the block, the next one starts at once
+	REQUIRE(burst.Step(30) == 0);
+	REQUIRE(burst.Read(p, t));
+	CHECK(p == 69964);
+	CHECK(t == 150);
+	REQUIRE(!burst.Read(p, t));
+
+	REQUIRE(burst.Step(30) == 5);
+	CHECK(sensor.temperatures == 3);
+	REQUIRE(burst.Errors() == 0);
+}
+
+TEST_CASE("BmpBurst waits for the output period", "[BmpBurst]")
+{
+	FakeReset();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	FakeBmp180 sensor;
+	SFE_BMP180 bmp(&bus);
+	BmpBurst burst(&bmp);
+	uint32_t now = 1000;
+
+	sensor.Attach();
+	REQUIRE(bmp.Begin());
+	burst.Begin(3, 8, 2, 500, 0);
+
+	now += burst.Step(now);
+	now += burst.Step(now);
+	CHECK(now == 1000 + 5 + 26);
+	now += burst.Step(now);
+	REQUIRE(burst.Step(now) == 500 - (5 + 26 + 26));
+}
+
+TEST_CASE("BmpBurst keeps a temperature across blocks", "[BmpBurst]")
+{
+	FakeReset();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	FakeBmp180 sensor;
+	SFE_BMP180 bmp(&bus);
+	BmpBurst burst(&bmp);
+	int32_t p, t;
+	uint32_t now = 0;
+
+	sensor.Attach();
+	REQUIRE(bmp.Begin());
+	burst.Begin(0, 8, 2, 0, 0);
+
+	// the first block measures the temperature, the next three use it
+	for (int block = 0; block < 4; block++)
+	{
+		uint32_t start = now;
+		uint32_t wait;
+
+		while ((wait = burst.Step(now)) != 0)
+			now += wait;
+		REQUIRE(burst.Read(p, t));
+		CHECK(p == 69964);
+		CHECK(t == 150);
+		uint32_t took = now - start;
+		CHECK(took == (block == 0 ? 15U : 10U));
+	}
+	CHECK(sensor.temperatures == 1);
+	CHECK(sensor.pressures == 8);
+
+	// the fifth needs a new one
+	REQUIRE(burst.Step(now) == 5);
+	CHECK(sensor.temperatures == 2);
+	REQUIRE(burst.Errors() == 0);
+}
+
+TEST_CASE("BmpBurst averages a block", "[BmpBurst]")
+{
+	FakeReset();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	FakeBmp180 sensor;
+	SFE_BMP180 bmp(&bus);
+	BmpBurst burst(&bmp);
+	int32_t expected = 0;
+	int32_t p, t;
+	uint32_t now = 0;
+
+	sensor.Attach();
+	REQUIRE(bmp.Begin());
+	for (int i = 0; i < 4; i++)
+	{
+		sensor.up[i] = 23843 + 10 * i;
+		expected += Pressure(bmp, sensor.up[i]);
+	}
+	expected = (expected + 2) / 4;
+	sensor.upCount = 4;
+
+	sensor.Attach();
+	burst.Begin(0, 4, 4, 0, 0);
+	for (int i = 0; i < 5; i++)
+		now += burst.Step(now);
+	REQUIRE(burst.Step(now) == 0);
+	REQUIRE(burst.Read(p, t));
+	CHECK(p == expected);
+	CHECK(p != 69964);
+}
+
+TEST_CASE("BmpBurst low pass", "[BmpBurst]")
+{
+	FakeReset();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	FakeBmp180 sensor;
+	SFE_BMP180 bmp(&bus);
+	BmpBurst burst(&bmp);
+	int32_t p, t;
+	uint32_t now = 0;
+
+	sensor.Attach();
+	REQUIRE(bmp.Begin());
+	int32_t low = Pressure(bmp, 23843);
+	int32_t high = Pressure(bmp, 23943);
+
+	sensor.Attach();
+	burst.Begin(0, 1, 1, 0, 2);
+
+	// the first block primes the filter
+	now += burst.Step(now);
+	now += burst.Step(now);
+	burst.Step(now);
+	REQUIRE(burst.Read(p, t));
+	CHECK(p == low);
+
+	// then a new block weighs 1/4
+	sensor.up[0] = 23943;
+	now += burst.Step(now);
+	now += burst.Step(now);
+	burst.Step(now);
+	REQUIRE(burst.Read(p, t));
+	CHECK(p == (3 * low + high + 2) / 4);
+}
+
+TEST_CASE("BmpBurst drops the block on a bus error", "[BmpBurst]")
+{
+	FakeReset();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	FakeBmp180 sensor;
+	SFE_BMP180 bmp(&bus);
+	BmpBurst burst(&bmp);
+	int32_t p, t;
+
+	sensor.Attach();
+	REQUIRE(bmp.Begin());
+	burst.Begin(0, 1, 2, 0, 0);
+
+	REQUIRE(burst.Step(0) == 5);
+	REQUIRE(burst.Step(5) == 5);
+	sensor.status = HAL_ERROR;
+	REQUIRE(burst.Step(10) == BMP_BURST_RETRY_MS);
+	CHECK(burst.Errors() == 1);
+
+	// starts over with a temperature
+	sensor.status = HAL_OK;
+	int temperatures = sensor.temperatures;
+	REQUIRE(burst.Step(110) == 5);
+	CHECK(sensor.temperatures == temperatures + 1);
+	REQUIRE(burst.Step(115) == 5);
+	REQUIRE(burst.Step(120) == 5);
+	REQUIRE(burst.Step(125) == 5);
+	REQUIRE(burst.Step(130) == 0);
+	REQUIRE(burst.Read(p, t));
+	CHECK(p == 69964);
+}
@@ -0,0 +1,166 @@
+/*
+ * test_Calendar.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include "Calendar.h"
+
+static bool IsLeap(int year)
+{
+	return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static unsigned DaysInMonth(int year, unsigned month)
+{
+	static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+	return month == 2 && IsLeap(year) ? 29 : days[month - 1];
+}
+
+static bool Same(const CalendarTime &a, const CalendarTime &b)
+{
+	return a.year == b.year && a.month == b.month && a.day == b.day && a.hour == b.hour
+			&& a.minute == b.minute && a.second == b.second && a.weekday == b.weekday;
+}
+
+// the seconds of now + 1 on that match the enabled fields of the alarm,
+// the way the RTC compares them, up to a limit
+static uint32_t NextMatch(uint32_t now, const CalendarAlarm &alarm, uint32_t limit)
+{
+	CalendarCache cache;
+
+	for (uint32_t t = now + 1; t <= now + limit; t++)
+	{
+		const CalendarTime &cal = cache.Get(t);
+
+		if ((alarm.match & ALARM_MATCH_SECOND) && cal.second != alarm.second)
+			continue;
+		if ((alarm.match & ALARM_MATCH_MINUTE) && cal.minute != alarm.minute)
+			continue;
+		if ((alarm.match & ALARM_MATCH_HOUR) && cal.hour != alarm.hour)
+			continue;
+		if ((alarm.match & ALARM_MATCH_DAY) && cal.day != alarm.day)
+			continue;
+		return t;
+	}
+	return 0;
+}
+
+TEST_CASE("Calendar days against a walk through the calendar", "[Calendar]")
+{
+	int32_t days = 0;
+	int weekday = 4;						// 1970-01-01 was a Thursday
+	int32_t wrong = -1;						// first day that differs
+
+	for (int y = 1970; y < 2200 && wrong < 0; y++)
+	{
+		for (unsigned m = 1; m <= 12; m++)
+		{
+			for (unsigned d = 1; d <= DaysInMonth(y, m); d++, days++)
+			{
+				CalendarTime cal;
+				int year;
+				unsigned month, day;
+
+				CivilFromDays(days, &year, &month, &day);
+				if (DaysFromCivil(y, m, d) != days || year != y || month != m || day != d)
+					wrong = days;
+
+				if (days < (int32_t) (UINT32_MAX / SECS_PER_DAY))
+				{
+					EpochToCalendar(days * SECS_PER_DAY + 3723, cal);
+					if (cal.weekday != weekday || cal.hour != 1 || cal.minute != 2 || cal.second != 3)
+						wrong = days;
+				}
+				weekday = (weekday + 1) % 7;
+			}
+		}
+	}
+	CHECK(wrong == -1);
+	CHECK(days == DaysFromCivil(2200, 1, 1));
+}
+
+TEST_CASE("Calendar epoch conversions", "[Calendar]")
+{
+	struct
+	{
+		uint32_t 		epoch;
+		CalendarTime 	cal;
+	} dates[] =
+	{
+		{0, 			{1970, 1, 1, 0, 0, 0, 4}},
+		{951782400, 	{2000, 2, 29, 0, 0, 0, 2}},
+		{1792310400, 	{2026, 10, 18, 8, 0, 0, 0}},
+		{1798761590, 	{2026, 12, 31, 23, 59, 50, 4}},
+		{4102444799u, 	{2099, 12, 31, 23, 59, 59, 4}},
+		{4294967295u, 	{2106, 2, 7, 6, 28, 15, 0}},
+	};
+
+	for (auto &date : dates)
+	{
+		CalendarTime cal;
+
+		EpochToCalendar(date.epoch, cal);
+		CHECK(Same(cal, date.cal));
+		CHECK(CalendarToEpoch(date.cal) == date.epoch);
+	}
+}
+
+TEST_CASE("CalendarCache gives the same as a full conversion", "[Calendar]")
+{
+	CalendarCache cache;
+	CalendarTime cal;
+	uint32_t epoch = 1798761590;
+
+	// seconds across midnight and new year, then jumps both ways
+	for (int i = 0; i < 30; i++, epoch++)
+	{
+		EpochToCalendar(epoch, cal);
+		REQUIRE(Same(cache.Get(epoch), cal));
+	}
+
+	uint32_t seed = 7;
+	for (int i = 0; i < 2000; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		epoch = (i & 1) ? epoch + (seed >> 20) : seed;
+		EpochToCalendar(epoch, cal);
+		REQUIRE(Same(cache.Get(epoch), cal));
+		REQUIRE(Same(cache.Get(epoch), cal));
+	}
+}
+
+TEST_CASE("CalendarAlarmIn fires first at the target time", "[Calendar]")
+{
+	CalendarAlarm alarm;
+	const uint32_t starts[] = {1798761590, 951695999, 1792310400, 1798675199};
+	const uint32_t delays[] = {1, 9, 10, 59, 60, 61, 3599, 3600, 3601, 7199,
+			86399, 86400, 86401, 2 * 86400 + 1, 27 * 86400, ALARM_MAX_DELAY};
+
+	for (uint32_t now : starts)
+	{
+		for (uint32_t delay : delays)
+		{
+			INFO("now " << now << " delay " << delay);
+			REQUIRE(CalendarAlarmIn(now, delay, alarm) == delay);
+			REQUIRE(NextMatch(now, alarm, delay + 1) == now + delay);
+		}
+	}
+
+	// clamped
+	CHECK(CalendarAlarmIn(1798761590, 0, alarm) == 1);
+	CHECK(CalendarAlarmIn(1798761590, ALARM_MAX_DELAY + 100, alarm) == ALARM_MAX_DELAY);
+	CHECK(alarm.match == (ALARM_MATCH_SECOND | ALARM_MATCH_MINUTE | ALARM_MATCH_HOUR
+			| ALARM_MATCH_DAY));
+
+	// over the end of the year: 2027-01-01 00:00:05
+	CalendarAlarmIn(1798761590, 15, alarm);
+	CHECK(alarm.second == 5);
+	CHECK(alarm.minute == 0);
+	CHECK(alarm.hour == 0);
+	CHECK(alarm.day == 1);
+	CHECK(alarm.match == ALARM_MATCH_SECOND);
+}
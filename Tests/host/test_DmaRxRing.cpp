@@ -0,0 +1,189 @@
+/*
+ * test_DmaRxRing.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include "FakeUart.h"
+#include "DmaRxRing.h"
+#include "Serial.h"
+
+// the chunks handed over, and their bytes in order
+struct ChunkLog
+{
+	int offsets[8];
+	int lens[8];
+	int count;
+	uint8_t data[1024];
+	int len;
+	const uint8_t *buf;
+};
+
+static void LogChunk(void *ctx, const uint8_t *data, int len)
+{
+	ChunkLog *log = (ChunkLog *) ctx;
+
+	log->offsets[log->count] = data - log->buf;
+	log->lens[log->count++] = len;
+	memcpy(log->data + log->len, data, len);
+	log->len += len;
+}
+
+TEST_CASE("DmaRxRing hands over at half, full and IDLE", "[DmaRxRing]")
+{
+	uint8_t buf[64];
+	ChunkLog log = {};
+
+	for (int i = 0; i < (int) sizeof(buf); i++)
+		buf[i] = i;
+	log.buf = buf;
+
+	DmaRxRing ring(buf, sizeof(buf));
+
+	// IDLE after 10 bytes, then half transfer, then the full transfer with
+	// CNDTR still reading 0 ahead of the reload
+	CHECK(ring.Advance(10, LogChunk, &log) == 10);
+	CHECK(ring.Advance(32, LogChunk, &log) == 22);
+	CHECK(ring.Advance(64, LogChunk, &log) == 32);
+	CHECK(ring.Pos() == 0);
+
+	REQUIRE(log.count == 3);
+	CHECK(log.offsets[0] == 0);
+	CHECK(log.lens[0] == 10);
+	CHECK(log.offsets[1] == 10);
+	CHECK(log.lens[1] == 22);
+	CHECK(log.offsets[2] == 32);
+	CHECK(log.lens[2] == 32);
+	REQUIRE(log.len == 64);
+	CHECK(memcmp(log.data, buf, 64) == 0);
+
+	// nothing new, e.g. an IDLE right after the full transfer
+	CHECK(ring.Advance(0, LogChunk, &log) == 0);
+	CHECK(ring.Advance(64, LogChunk, &log) == 0);
+	CHECK(log.count == 3);
+}
+
+TEST_CASE("DmaRxRing hands over a wrap as two chunks", "[DmaRxRing]")
+{
+	uint8_t buf[64];
+	ChunkLog log = {};
+
+	for (int i = 0; i < (int) sizeof(buf); i++)
+		buf[i] = i;
+	log.buf = buf;
+
+	DmaRxRing ring(buf, sizeof(buf));
+
+	ring.Reset(50);
+	CHECK(ring.Advance(5, LogChunk, &log) == 19);
+
+	REQUIRE(log.count == 2);
+	CHECK(log.offsets[0] == 50);
+	CHECK(log.lens[0] == 14);
+	CHECK(log.offsets[1] == 0);
+	CHECK(log.lens[1] == 5);
+	CHECK(ring.Pos() == 5);
+
+	// a wrap that ends right at the start is one chunk
+	log.count = 0;
+	ring.Reset(60);
+	CHECK(ring.Advance(0, LogChunk, &log) == 4);
+	CHECK(log.count == 1);
+
+	// Reset to the end is the start
+	ring.Reset(64);
+	CHECK(ring.Pos() == 0);
+}
+
+TEST_CASE("Serial receive DMA delivers the bytes in order across wraps", "[DmaRxRing]")
+{
+	FakeReset();
+	FakeUart uart;
+	Serial serial(&uart.huart, rxModeDma);
+	uint8_t sent[3 * SERIAL_DMA_RX_SIZE + 17];
+	uint8_t got[sizeof(sent)];
+	int gotLen = 0;
+
+	REQUIRE(serial.RxMode() == rxModeDma);
+	REQUIRE(Fake.uartRxSize == SERIAL_DMA_RX_SIZE);
+
+	// the statistics outlive a Serial
+	SerialStats stats;
+	serial.GetStats(&stats, true);
+
+	for (int i = 0; i < (int) sizeof(sent); i++)
+		sent[i] = (i * 13) ^ (i >> 8);
+
+	// bursts of odd sizes end with an IDLE line, the half and full transfer
+	// interrupts fall in between
+	int pos = 0;
+	for (int burst = 1; pos < (int) sizeof(sent); burst += 37)
+	{
+		int n = (burst % 200 < (int) sizeof(sent) - pos) ? burst % 200 : (int) sizeof(sent) - pos;
+
+		uart.Receive(sent + pos, n);
+		pos += n;
+		gotLen += serial.Read(got + gotLen, sizeof(got) - gotLen, 0);
+	}
+
+	REQUIRE(gotLen == (int) sizeof(sent));
+	CHECK(memcmp(got, sent, sizeof(sent)) == 0);
+
+	serial.GetStats(&stats);
+	CHECK(stats.bytes == sizeof(sent));
+	CHECK(stats.overruns == 0);
+	CHECK(stats.errors == 0);
+	// more than one interrupt per burst only where a half or full point is crossed
+	CHECK(stats.interrupts > 0);
+	CHECK(stats.interrupts < sizeof(sent) / 8);
+}
+
+TEST_CASE("Serial counts overruns of the receive ring and the UART", "[DmaRxRing]")
+{
+	FakeReset();
+	FakeUart uart;
+	Serial serial(&uart.huart, rxModeDma);
+	uint8_t data[SERIAL_RX_SIZE + 100];
+	SerialStats stats;
+
+	serial.GetStats(&stats, true);
+	for (int i = 0; i < (int) sizeof(data); i++)
+		data[i] = i;
+
+	// nobody reads, the receive ring takes SERIAL_RX_SIZE bytes
+	for (int pos = 0; pos < (int) sizeof(data); pos += 100)
+	{
+		int n = (int) sizeof(data) - pos < 100 ? (int) sizeof(data) - pos : 100;
+		uart.Receive(data + pos, n);
+	}
+
+	serial.GetStats(&stats, true);
+	CHECK(stats.bytes == sizeof(data));
+	CHECK(stats.overruns == sizeof(data) - SERIAL_RX_SIZE);
+	CHECK(serial.Available() == SERIAL_RX_SIZE);
+
+	// the oldest bytes are kept
+	uint8_t first[4];
+	REQUIRE(serial.Read(first, 4, 0) == 4);
+	CHECK(first[0] == 0);
+	CHECK(first[3] == 3);
+
+	// an overrun and a framing error of the UART itself
+	uart.huart.Instance->ISR |= USART_ISR_ORE | USART_ISR_FE;
+	Serial_UartIRQHandler(&uart.huart);
+	uart.huart.Instance->ISR &= ~(USART_ISR_ORE | USART_ISR_FE);
+
+	serial.GetStats(&stats, true);
+	CHECK(stats.overruns == 1);
+	CHECK(stats.errors == 1);
+	CHECK(uart.huart.Instance->ICR == (USART_ICR_PECF | USART_ICR_FECF | USART_ICR_NCF
+			| USART_ICR_ORECF));
+
+	// cleared by the reset
+	serial.GetStats(&stats);
+	CHECK(stats.overruns == 0);
+	CHECK(stats.errors == 0);
+}
@@ -0,0 +1,254 @@
+/*
+ * test_EspCmdEngine.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <stdio.h>
+#include <string.h>
+#include "FakeEsp8266.h"
+#include "EspCmdEngine.h"
+#include "Profiler.h"
+
+struct DoneLog
+{
+	int tags[8];
+	int count;
+};
+
+static void LogDone(void *ctx, int tag)
+{
+	DoneLog *log = (DoneLog *) ctx;
+
+	log->tags[log->count++] = tag;
+}
+
+// +IPD payload and events as the URC handler gets them
+struct UrcLog
+{
+	char data[4][256];
+	int dataLen[4];
+	long bytes;
+	int headers;
+	int closed;
+};
+
+static void LogUrc(void *ctx, const AtUrc &urc)
+{
+	UrcLog *log = (UrcLog *) ctx;
+
+	switch (urc.type)
+	{
+	case URC_IPD:
+		log->headers++;
+		break;
+	case URC_IPD_DATA:
+		if (log->dataLen[urc.connId] + urc.dataLen <= (int) sizeof(log->data[0]))
+			memcpy(log->data[urc.connId] + log->dataLen[urc.connId], urc.data, urc.dataLen);
+		log->dataLen[urc.connId] += urc.dataLen;
+		log->bytes += urc.dataLen;
+		break;
+	case URC_CLOSED:
+		log->closed++;
+		break;
+	default:
+		break;
+	}
+}
+
+// a line of Profiler::Dump()
+static void PrintProf(void *ctx, const char *line)
+{
+	printf("%s\n", line);
+}
+
+TEST_CASE("AT commands go out back to back and complete in order", "[EspCmdEngine]")
+{
+	FakeReset();
+	Fake.tickStep = 1;
+	FakeUart uart;
+	Serial serial(&uart.huart);
+	FakeEsp8266 esp(uart);
+	EspCmdEngine engine(&serial);
+	DoneLog log = {};
+
+	esp.Attach();
+	esp.failPrefix = "AT+CWJAP";
+
+	REQUIRE(engine.Submit("AT", 1000, NULL, LogDone, &log));
+	REQUIRE(engine.Submit("AT+CWMODE=1", 1000, NULL, LogDone, &log));
+	REQUIRE(engine.Submit("AT+CWJAP=\"x\",\"y\"", 1000, NULL, LogDone, &log));
+	REQUIRE(engine.Submit("AT+CIPMUX=1", 1000, NULL, LogDone, &log));
+	CHECK_FALSE(engine.Submit("AT+CIPMUX=1", 1000, NULL, LogDone, &log));
+
+	// one command on the line at a time
+	const char first[] = "AT\r\n";
+	CHECK(Fake.uartWireLen == (int) strlen(first));
+
+	for (int i = 0; (i < 100) && engine.Busy(); i++)
+		engine.Poll();
+
+	REQUIRE(log.count == 4);
+	CHECK(log.tags[0] == TAG_OK);
+	CHECK(log.tags[1] == TAG_OK);
+	CHECK(log.tags[2] == TAG_ERROR);
+	CHECK(log.tags[3] == TAG_OK);
+
+	const char wire[] = "AT\r\nAT+CWMODE=1\r\nAT+CWJAP=\"x\",\"y\"\r\nAT+CIPMUX=1\r\n";
+	REQUIRE(Fake.uartWireLen == (int) strlen(wire));
+	CHECK(memcmp(Fake.uartWire, wire, strlen(wire)) == 0);
+	CHECK(esp.commands == 4);
+}
+
+TEST_CASE("AT+CIPSEND payload goes out after the prompt", "[EspCmdEngine]")
+{
+	FakeReset();
+	Fake.tickStep = 1;
+	FakeUart uart;
+	Serial serial(&uart.huart);
+	FakeEsp8266 esp(uart);
+	EspCmdEngine engine(&serial);
+	const uint8_t hello[] = "hello";
+
+	esp.Attach();
+
+	CHECK(engine.Execute("AT+CIPSEND=1,7", 1000, NULL, NULL, hello, 5, true) == TAG_SENDOK);
+	CHECK(esp.sends == 1);
+	REQUIRE(esp.payloadBytes[1] == 7);
+	CHECK(memcmp(esp.payload[1], "hello\r\n", 7) == 0);
+
+	// the engine is ready for the next one
+	CHECK(engine.Execute("AT", 1000) == TAG_OK);
+}
+
+TEST_CASE("AT command times out and the next one waits for a quiet line", "[EspCmdEngine]")
+{
+	FakeReset();
+	Fake.tickStep = 1;
+	FakeUart uart;
+	Serial serial(&uart.huart);
+	FakeEsp8266 esp(uart);
+	EspCmdEngine engine(&serial);
+
+	esp.Attach();
+	esp.mute = true;
+
+	uint32_t start = Fake.tick;
+	CHECK(engine.Execute("AT+CWLAP", 200) == TAG_TIMEOUT);
+	uint32_t took = Fake.tick - start;
+	CHECK(took > 200);
+	CHECK(took < 400);
+
+	// the late answer of the module must not complete the next command
+	esp.mute = false;
+	esp.Queue("\r\nOK\r\n");
+	esp.Step();
+	engine.Poll();
+
+	DoneLog log = {};
+	int wire = Fake.uartWireLen;
+	start = Fake.tick;
+	REQUIRE(engine.Submit("AT", 1000, NULL, LogDone, &log));
+	CHECK(Fake.uartWireLen == wire);
+
+	while (engine.Busy())
+		engine.Poll();
+	took = Fake.tick - start;
+	CHECK(took >= AT_RESYNC_QUIET_MS);
+	REQUIRE(log.count == 1);
+	CHECK(log.tags[0] == TAG_OK);
+	CHECK(esp.commands == 2);
+	CHECK_FALSE(esp.Pending());
+}
+
+TEST_CASE("+IPD frames are sorted out of the command answers", "[EspCmdEngine]")
+{
+	FakeReset();
+	Fake.tickStep = 1;
+	FakeUart uart;
+	Serial serial(&uart.huart);
+	FakeEsp8266 esp(uart);
+	EspCmdEngine engine(&serial);
+	UrcLog urcs = {};
+
+	esp.Attach();
+	engine.SetUrcHandler(LogUrc, &urcs);
+
+	// the frames arrive ahead of the answer, one of them holds "OK" lines
+	esp.Ipd(0, "GET / HTTP/1.1\r\n\r\n");
+	esp.Ipd(2, "\r\nOK\r\n\r\nERROR\r\n");
+	esp.Closed(0);
+
+	CHECK(engine.Execute("AT+CIPSTATUS", 1000) == TAG_OK);
+	for (int i = 0; (i < 10) && esp.Pending(); i++)
+	{
+		esp.Step();
+		engine.Poll();
+	}
+
+	CHECK(urcs.headers == 2);
+	CHECK(urcs.closed == 1);
+	REQUIRE(urcs.dataLen[0] == 18);
+	CHECK(memcmp(urcs.data[0], "GET / HTTP/1.1\r\n\r\n", 18) == 0);
+	REQUIRE(urcs.dataLen[2] == 15);
+	CHECK(memcmp(urcs.data[2], "\r\nOK\r\n\r\nERROR\r\n", 15) == 0);
+}
+
+TEST_CASE("Command engine latency and +IPD throughput", "[EspCmdEngine][bench]")
+{
+	FakeReset();
+	Fake.tickStep = 1;
+	FakeUart uart;
+	Serial serial(&uart.huart);
+	FakeEsp8266 esp(uart);
+	EspCmdEngine engine(&serial);
+	UrcLog urcs = {};
+
+	esp.Attach();
+	engine.SetUrcHandler(LogUrc, &urcs);
+	Profiler::Reset();
+
+	// round trips of a short command, the module answering at once
+	const int commands = 20000;
+	int ok = 0;
+	uint32_t start = ProfNow();
+	for (int i = 0; i < commands; i++)
+		ok += engine.Execute("AT", 1000) == TAG_OK;
+	uint32_t cmdNs = ProfNow() - start;
+	CHECK(ok == commands);
+
+	// 1 MB of 1024 byte frames to the four sockets
+	const int frames = 1024;
+	uint8_t frame[1024];
+	for (int i = 0; i < (int) sizeof(frame); i++)
+		frame[i] = i * 7;
+
+	long wireBytes = Fake.uartTxBytes;
+	start = ProfNow();
+	for (int i = 0; i < frames; i++)
+	{
+		esp.Ipd(i & 3, frame, sizeof(frame));
+		while (esp.Pending())
+		{
+			esp.Step();
+			engine.Poll();
+		}
+	}
+	uint32_t ipdNs = ProfNow() - start;
+
+	SerialStats stats;
+	serial.GetStats(&stats);
+
+	printf("command engine: %.0f ns per AT round trip, +IPD %.1f MB/s "
+		"(%.0f bytes per receive interrupt)\n",
+		(double) cmdNs / commands, urcs.bytes / (ipdNs / 1e3),
+		(double) stats.bytes / stats.interrupts);
+	Profiler::Dump(PrintProf, NULL);
+
+	CHECK(urcs.headers == frames);
+	CHECK(urcs.bytes == (long) frames * sizeof(frame));
+	CHECK(stats.overruns == 0);
+	CHECK(Fake.uartTxBytes == wireBytes);
+}
@@ -0,0 +1,191 @@
+/*
+ * test_EspDrv.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include "FakeEsp8266.h"
+#include "EspDrv.h"
+
+// frames of a socket and their payload bytes, different per socket
+#define FRAMES		8
+
+static int FrameLen(int sock, int frame)
+{
+	return 17 + (sock * 53 + frame * 29) % 97;
+}
+
+static uint8_t PayloadByte(int sock, int n)
+{
+	return (uint8_t) ('A' + sock * 8 + n % 7) ^ (n >> 3);
+}
+
+// the driver through wifiDriverInit(), the module answering from a FakeEsp8266;
+// after the start the line moves only with Deliver() or a Step() of the test,
+// a chunk per poll, so that the reader keeps up as it does at the baud rate
+struct DrvRig
+{
+	FakeUart 	uart;
+	FakeEsp8266 esp;
+	EspDrv 		drv;
+
+	DrvRig() : esp(uart)
+	{
+		esp.Attach();
+		drv.wifiDriverInit(&uart.huart);
+		Fake.tickHook = NULL;
+	}
+
+	void Deliver()
+	{
+		for (int i = 0; (i < 1000) && esp.Pending(); i++)
+		{
+			esp.Step();
+			drv.poll();
+		}
+	}
+};
+
+TEST_CASE("EspDrv sorts interleaved +IPD frames of four sockets", "[EspDrv]")
+{
+	FakeReset();
+	Fake.tickStep = 1;
+	DrvRig rig;
+	uint8_t frame[128];
+	int sent[MAX_SOCK_NUM] = {};
+
+	REQUIRE(rig.esp.commands > 0);
+	CHECK(strcmp(rig.esp.lastCmd, "AT+GMR") == 0);
+
+	// the frames go out in turns, 1 is closed halfway through, 3 after its
+	// last frame; the line chunks split headers and payloads anywhere
+	for (int f = 0; f < FRAMES; f++)
+	{
+		for (int sock = 0; sock < MAX_SOCK_NUM; sock++)
+		{
+			if (sock == 1 && f >= FRAMES / 2)
+				continue;
+
+			int len = FrameLen(sock, f);
+			for (int i = 0; i < len; i++)
+				frame[i] = PayloadByte(sock, sent[sock] + i);
+			rig.esp.Ipd(sock, frame, len);
+			sent[sock] += len;
+		}
+		if (f == FRAMES / 2 - 1)
+			rig.esp.Closed(1);
+	}
+	rig.esp.Closed(3);
+	rig.Deliver();
+
+	for (int sock = 0; sock < MAX_SOCK_NUM; sock++)
+	{
+		INFO("socket " << sock);
+		REQUIRE(sent[sock] < IPD_BUFFER_SIZE);
+		CHECK(rig.drv.availData(sock) == sent[sock]);
+	}
+
+	// round robin over the sockets with data
+	CHECK(rig.drv.nextDataSocket() == 0);
+	CHECK(rig.drv.nextDataSocket(0) == 1);
+	CHECK(rig.drv.nextDataSocket(3) == 0);
+
+	// the closed ones are known without asking the module
+	int commands = rig.esp.commands;
+	CHECK_FALSE(rig.drv.getClientState(1));
+	CHECK_FALSE(rig.drv.getClientState(3));
+	CHECK(rig.esp.commands == commands);
+
+	// byte by byte, the close comes with the last byte and not before
+	for (int sock = 0; sock < MAX_SOCK_NUM; sock++)
+	{
+		INFO("socket " << sock);
+		bool closed = false;
+		int errors = 0;
+		int early = 0;
+
+		for (int n = 0; n < sent[sock]; n++)
+		{
+			uint8_t c;
+			REQUIRE(rig.drv.getData(sock, &c, false, &closed));
+			if (c != PayloadByte(sock, n))
+				errors++;
+			if (closed && n < sent[sock] - 1)
+				early++;
+		}
+		CHECK(errors == 0);
+		CHECK(early == 0);
+		CHECK(closed == (sock == 1 || sock == 3));
+		CHECK(rig.drv.availData(sock) == 0);
+	}
+
+	CHECK(rig.drv.nextDataSocket() == SOCK_NOT_AVAIL);
+	HAL_Delay(AT_IDLE_QUIET_MS);
+	CHECK(rig.drv.isIdle());
+}
+
+TEST_CASE("EspDrv keeps the sockets apart while they are read in between", "[EspDrv]")
+{
+	FakeReset();
+	Fake.tickStep = 1;
+	DrvRig rig;
+	uint8_t frame[128];
+	int sent[MAX_SOCK_NUM] = {};
+	int got[MAX_SOCK_NUM] = {};
+	int errors = 0;
+
+	// far more than a socket buffers, read as it comes in: spans of 2 through
+	// peekData(), the others through getDataBuf()
+	for (int f = 0; f < 100; f++)
+	{
+		int sock = (f * 3 + f / 4) % MAX_SOCK_NUM;
+		int len = FrameLen(sock, f);
+
+		for (int i = 0; i < len; i++)
+			frame[i] = PayloadByte(sock, sent[sock] + i);
+		rig.esp.Ipd(sock, frame, len);
+		sent[sock] += len;
+
+		rig.esp.Step();
+		for (uint8_t s = rig.drv.nextDataSocket(); s != SOCK_NOT_AVAIL;
+				s = rig.drv.nextDataSocket(s))
+		{
+			uint8_t buf[64];
+			const uint8_t *span = buf;
+			int n;
+
+			if (s == 2)
+				n = rig.drv.peekData(s, &span);
+			else
+				n = rig.drv.getDataBuf(s, buf, sizeof(buf));
+			for (int i = 0; i < n; i++)
+			{
+				if (span[i] != PayloadByte(s, got[s] + i))
+					errors++;
+			}
+			if (s == 2)
+				rig.drv.consumeData(s, n);
+			got[s] += n;
+		}
+	}
+	rig.esp.Closed(0);
+	rig.Deliver();
+
+	for (int sock = 0; sock < MAX_SOCK_NUM; sock++)
+	{
+		uint8_t buf[IPD_BUFFER_SIZE];
+		got[sock] += rig.drv.getDataBuf(sock, buf, sizeof(buf));
+	}
+
+	CHECK(errors == 0);
+	for (int sock = 0; sock < MAX_SOCK_NUM; sock++)
+	{
+		INFO("socket " << sock);
+		CHECK(sent[sock] > IPD_BUFFER_SIZE);
+		CHECK(got[sock] == sent[sock]);
+	}
+	CHECK_FALSE(rig.drv.getClientState(0));
+}
@@ -0,0 +1,99 @@
+/*
+ * test_EspTokenizer.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "EspTokenizer.h"
+#include "Profiler.h"
+
+// what the module sent over a session of the station, the make runs the
+// tests from Tests/host
+#define TRANSCRIPT		"fixtures/esp8266_transcript.txt"
+
+static int LoadTranscript(uint8_t *buf, int size)
+{
+	FILE *f = fopen(TRANSCRIPT, "rb");
+
+	if (f == NULL)
+		return -1;
+	int len = fread(buf, 1, size, f);
+	fclose(f);
+	return len;
+}
+
+// tokens of one pass; the +IPD payload is skipped the way EspCmdEngine does
+static void Tokenize(EspTokenizer &tokenizer, const uint8_t *data, int len, long counts[])
+{
+	int skip = 0;
+
+	for (int i = 0; i < len; i++)
+	{
+		if (skip > 0)
+		{
+			skip--;
+			continue;
+		}
+
+		int tok = tokenizer.Feed(data[i]);
+		counts[tok]++;
+		if (tok == TOK_IPD)
+		{
+			// <id>,<len>[,<remote IP>,<remote port>]
+			const char *comma = strchr(tokenizer.Line(), ',');
+			skip = (comma != NULL) ? atoi(comma + 1) : 0;
+			tokenizer.Reset();
+		}
+	}
+}
+
+TEST_CASE("Tokenizer splits a recorded module session", "[EspTokenizer]")
+{
+	static uint8_t transcript[65536];
+	int len = LoadTranscript(transcript, sizeof(transcript));
+	REQUIRE(len > 0);
+
+	EspTokenizer tokenizer;
+	long counts[TOK_NONE + 1] = {};
+
+	Tokenize(tokenizer, transcript, len, counts);
+
+	CHECK(counts[TOK_OK] == 83);
+	CHECK(counts[TOK_ERROR] == 1);
+	CHECK(counts[TOK_FAIL] == 0);
+	CHECK(counts[TOK_SENDOK] == 66);
+	CHECK(counts[TOK_SENDFAIL] == 0);
+	CHECK(counts[TOK_WIFI_DISCONNECT] == 2);
+	CHECK(counts[TOK_WIFI_CONNECTED] == 2);
+	CHECK(counts[TOK_WIFI_GOT_IP] == 2);
+	CHECK(counts[TOK_IPD] == 66);
+	CHECK(counts[TOK_PROMPT] == 66);
+	CHECK(tokenizer.Truncated() == 0);
+}
+
+TEST_CASE("Tokenizer throughput on the recorded session", "[EspTokenizer][bench]")
+{
+	static uint8_t transcript[65536];
+	int len = LoadTranscript(transcript, sizeof(transcript));
+	REQUIRE(len > 0);
+
+	EspTokenizer tokenizer;
+	long counts[TOK_NONE + 1] = {};
+	const int passes = 2000;
+
+	uint32_t start = ProfNow();
+	for (int i = 0; i < passes; i++)
+		Tokenize(tokenizer, transcript, len, counts);
+	uint32_t ns = ProfNow() - start;
+
+	double bytes = (double) len * passes;
+	printf("tokenizer: %.1f MB/s over %d passes of the %d byte session, %.1f ns per byte\n",
+		bytes * 1e3 / ns, passes, len, ns / bytes);
+
+	CHECK(counts[TOK_IPD] == 66L * passes);
+}
@@ -0,0 +1,466 @@
+/*
+ * test_FlashLog.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include <vector>
+#include "FakeFlash.h"
+#include "FlashLog.h"
+
+#define FIELDS		4
+#define TIME0		1792310400
+#define PERIOD		60
+
+static uint32_t TimeOf(int n)
+{
+	return TIME0 + PERIOD * n;
+}
+
+// values of frame n, small and large changes of both signs
+static void ValuesOf(int n, int32_t *values)
+{
+	values[0] = 20000 + 3 * n;
+	values[1] = -n;
+	values[2] = n * n;
+	values[3] = (n & 1) ? 100000 : -100000;
+}
+
+static bool AppendFrame(FlashLog &log, int n, uint32_t time)
+{
+	int32_t values[FIELDS];
+
+	ValuesOf(n, values);
+	return log.Append(time, values, FIELDS);
+}
+
+static bool AppendFrame(FlashLog &log, int n)
+{
+	return AppendFrame(log, n, TimeOf(n));
+}
+
+// number of a frame written by AppendFrame(), -1 if it is not one
+static int FrameNumber(const LogFrame &frame)
+{
+	int32_t values[FIELDS];
+	int n = (frame.time - TIME0) / PERIOD;
+
+	// frames logged with a time of 0 carry their number in the first value
+	if (frame.time == 0)
+		n = (frame.values[0] - 20000) / 3;
+
+	ValuesOf(n, values);
+	if (frame.count != FIELDS || memcmp(frame.values, values, sizeof(values)) != 0)
+		return -1;
+	return n;
+}
+
+// numbers of the frames from time on
+static std::vector<int> ReadAll(FlashLog &log, uint32_t time = 0)
+{
+	std::vector<int> frames;
+	LogCursor cursor;
+	LogFrame frame;
+
+	log.Seek(cursor, time);
+	while (log.Read(cursor, frame))
+		frames.push_back(FrameNumber(frame));
+	return frames;
+}
+
+// takes up to limit frames, the commit fails while fail is set
+struct Collect
+{
+	std::vector<int> 	frames;
+	int 				limit;
+	bool 				fail;
+};
+
+static bool CollectFrame(void *ctx, const LogFrame &frame)
+{
+	Collect *pCollect = (Collect *) ctx;
+
+	if ((int) pCollect->frames.size() >= pCollect->limit)
+		return false;
+	pCollect->frames.push_back(FrameNumber(frame));
+	return true;
+}
+
+static bool InOrder(const std::vector<int> &frames, int first, int count)
+{
+	if ((int) frames.size() != count)
+		return false;
+	for (int i = 0; i < count; i++)
+	{
+		if (frames[i] != first + i)
+			return false;
+	}
+	return true;
+}
+
+TEST_CASE("FlashLog appends and reads back after a restart", "[FlashLog]")
+{
+	FakeFlash flash(8, 256);
+	FlashLog log(&flash);
+	LogStats stats;
+
+	REQUIRE(!log.Mount());
+	REQUIRE(ReadAll(log).empty());
+	REQUIRE(!log.Pending());
+
+	for (int n = 0; n < 20; n++)
+		REQUIRE(AppendFrame(log, n));
+	REQUIRE(InOrder(ReadAll(log), 0, 20));
+
+	// the deltas are short, the 20 frames fit in few pages
+	CHECK(flash.erases <= 3);
+
+	FlashLog again(&flash);
+	REQUIRE(again.Mount());
+	REQUIRE(InOrder(ReadAll(again), 0, 20));
+
+	// and goes on with deltas from the last frame
+	for (int n = 20; n < 25; n++)
+		REQUIRE(AppendFrame(again, n));
+	REQUIRE(InOrder(ReadAll(again), 0, 25));
+
+	again.GetStats(stats);
+	CHECK(stats.appended == 5);
+	CHECK(stats.errors == 0);
+	CHECK(stats.lost == 0);
+}
+
+TEST_CASE("FlashLog frames of another size", "[FlashLog]")
+{
+	FakeFlash flash(4, 256);
+	FlashLog log(&flash);
+	LogCursor cursor;
+	LogFrame frame;
+	int32_t values[LOG_MAX_FIELDS];
+
+	for (int i = 0; i < LOG_MAX_FIELDS; i++)
+		values[i] = -1000 * i;
+
+	log.Mount();
+	REQUIRE(AppendFrame(log, 0));
+	REQUIRE(log.Append(TimeOf(1), values, LOG_MAX_FIELDS));
+	REQUIRE(log.Append(TimeOf(2), values, 1));
+	REQUIRE(!log.Append(TimeOf(3), values, LOG_MAX_FIELDS + 1));
+
+	log.Seek(cursor, 0);
+	REQUIRE(log.Read(cursor, frame));
+	CHECK(FrameNumber(frame) == 0);
+	REQUIRE(log.Read(cursor, frame));
+	CHECK(frame.count == LOG_MAX_FIELDS);
+	CHECK(memcmp(frame.values, values, sizeof(values)) == 0);
+	REQUIRE(log.Read(cursor, frame));
+	CHECK(frame.count == 1);
+	CHECK(frame.time == TimeOf(2));
+	REQUIRE(!log.Read(cursor, frame));
+}
+
+TEST_CASE("FlashLog wraps around and counts the frames lost", "[FlashLog]")
+{
+	FakeFlash flash(4, 256);
+	FlashLog log(&flash);
+	LogStats stats;
+
+	log.Mount();
+	for (int n = 0; n < 200; n++)
+		REQUIRE(AppendFrame(log, n));
+
+	// the newest frames, in order, the older ones erased
+	std::vector<int> frames = ReadAll(log);
+	REQUIRE(!frames.empty());
+	int first = frames.front();
+	REQUIRE(first > 0);
+	REQUIRE(InOrder(frames, first, 200 - first));
+
+	log.GetStats(stats);
+	CHECK(stats.lost == (uint32_t) first);
+	CHECK(stats.erases == (uint32_t) flash.erases);
+	CHECK(flash.erases > 4);
+
+	FlashLog again(&flash);
+	REQUIRE(again.Mount());
+	REQUIRE(InOrder(ReadAll(again), first, 200 - first));
+
+	Collect up = {{}, 1000};
+	REQUIRE(again.Drain(CollectFrame, &up, 1000) == 200 - first);
+	REQUIRE(InOrder(up.frames, first, 200 - first));
+}
+
+TEST_CASE("FlashLog drains and keeps the upload position", "[FlashLog]")
+{
+	FakeFlash flash(8, 256);
+	FlashLog log(&flash);
+	LogStats stats;
+
+	log.Mount();
+	for (int n = 0; n < 10; n++)
+		REQUIRE(AppendFrame(log, n));
+
+	Collect up = {{}, 4};
+	REQUIRE(log.Drain(CollectFrame, &up, 100) == 4);
+	REQUIRE(InOrder(up.frames, 0, 4));
+	REQUIRE(log.Pending());
+
+	// a sink that takes nothing moves nothing
+	REQUIRE(log.Drain(CollectFrame, &up, 100) == 0);
+	REQUIRE(log.Drain(CollectFrame, &up, 0) == 0);
+
+	// the position survives a restart
+	FlashLog again(&flash);
+	REQUIRE(again.Mount());
+	REQUIRE(again.Pending());
+	Collect rest = {{}, 100};
+	REQUIRE(again.Drain(CollectFrame, &rest, 3) == 3);
+	REQUIRE(again.Drain(CollectFrame, &rest, 100) == 3);
+	REQUIRE(InOrder(rest.frames, 4, 6));
+	REQUIRE(!again.Pending());
+	REQUIRE(again.Drain(CollectFrame, &rest, 100) == 0);
+
+	again.GetStats(stats);
+	CHECK(stats.drained == 6);
+
+	// the acks are not frames
+	REQUIRE(InOrder(ReadAll(again), 0, 10));
+}
+
+static bool CommitFrames(void *ctx)
+{
+	return !((Collect *) ctx)->fail;
+}
+
+TEST_CASE("FlashLog keeps the upload position when a commit fails", "[FlashLog]")
+{
+	FakeFlash flash(8, 256);
+	FlashLog log(&flash);
+	LogStats stats;
+
+	log.Mount();
+	for (int n = 0; n < 10; n++)
+		REQUIRE(AppendFrame(log, n));
+	log.GetStats(stats, true);
+
+	Collect lost = {{}, 100, true};
+	REQUIRE(log.Drain(CollectFrame, &lost, 4, CommitFrames) == 0);
+	CHECK(InOrder(lost.frames, 0, 4));
+	log.GetStats(stats);
+	CHECK(stats.drained == 0);
+
+	// the same frames again
+	Collect up = {{}, 100, false};
+	REQUIRE(log.Drain(CollectFrame, &up, 4, CommitFrames) == 4);
+	REQUIRE(InOrder(up.frames, 0, 4));
+
+	// and after a restart
+	FlashLog again(&flash);
+	REQUIRE(again.Mount());
+	Collect rest = {{}, 100, false};
+	REQUIRE(again.Drain(CollectFrame, &rest, 100, CommitFrames) == 6);
+	REQUIRE(InOrder(rest.frames, 4, 6));
+	CHECK(!again.Pending());
+}
+
+TEST_CASE("FlashLog page headers hold the time of their first frame", "[FlashLog]")
+{
+	// whatever the fill of the head page when the ack comes
+	for (int count = 1; count < 40; count++)
+	{
+		FakeFlash flash(8, 256);
+		FlashLog log(&flash);
+
+		log.Mount();
+		for (int n = 0; n < count; n++)
+			REQUIRE(AppendFrame(log, n));
+
+		Collect up = {{}, 1000};
+		REQUIRE(log.Drain(CollectFrame, &up, 1000) == count);
+		REQUIRE(AppendFrame(log, count));
+
+		for (int page = 0; page < flash.Pages(); page++)
+		{
+			const uint8_t *p = flash.Page(page);
+			uint32_t magic, time;
+
+			memcpy(&magic, p, 4);
+			memcpy(&time, p + 8, 4);
+			if (magic == LOG_PAGE_MAGIC)
+				CHECK(time != 0);
+		}
+
+		// a restart with the ack on its way uploads the last frame again at most
+		FlashLog again(&flash);
+		REQUIRE(again.Mount());
+		Collect rest = {{}, 1000};
+		again.Drain(CollectFrame, &rest, 1000);
+		REQUIRE(!rest.frames.empty());
+		CHECK(rest.frames.front() >= count - 1);
+		CHECK(rest.frames.back() == count);
+	}
+}
+
+TEST_CASE("FlashLog seeks by time", "[FlashLog]")
+{
+	FakeFlash flash(8, 256);
+	FlashLog log(&flash);
+	LogCursor cursor;
+	LogFrame frame;
+
+	log.Mount();
+	for (int n = 0; n < 60; n++)
+		REQUIRE(AppendFrame(log, n));
+	REQUIRE(flash.erases > 2);
+
+	for (int n = 0; n < 60; n++)
+	{
+		log.Seek(cursor, TimeOf(n));
+		REQUIRE(log.Read(cursor, frame));
+		CHECK(FrameNumber(frame) == n);
+
+		log.Seek(cursor, TimeOf(n) - PERIOD / 2);
+		REQUIRE(log.Read(cursor, frame));
+		CHECK(FrameNumber(frame) == n);
+	}
+
+	log.Seek(cursor, 0);
+	REQUIRE(log.Read(cursor, frame));
+	CHECK(FrameNumber(frame) == 0);
+
+	log.Seek(cursor, TimeOf(59) + 1);
+	REQUIRE(!log.Read(cursor, frame));
+}
+
+TEST_CASE("FlashLog seeks past pages logged without a time", "[FlashLog]")
+{
+	FakeFlash flash(8, 256);
+	FlashLog log(&flash);
+	LogCursor cursor;
+	LogFrame frame;
+
+	// before the clock was set, then with the time
+	log.Mount();
+	for (int n = 0; n < 25; n++)
+		REQUIRE(AppendFrame(log, n, 0));
+	for (int n = 25; n < 60; n++)
+		REQUIRE(AppendFrame(log, n));
+
+	std::vector<int> all = ReadAll(log);
+	REQUIRE(InOrder(all, 0, 60));
+
+	for (int n = 25; n < 60; n++)
+	{
+		log.Seek(cursor, TimeOf(n));
+		REQUIRE(log.Read(cursor, frame));
+		CHECK(FrameNumber(frame) == n);
+	}
+}
+
+TEST_CASE("FlashLog skips a record with an ECC error", "[FlashLog]")
+{
+	FakeFlash flash(8, 256);
+	FlashLog log(&flash);
+
+	log.Mount();
+	for (int n = 0; n < 40; n++)
+		REQUIRE(AppendFrame(log, n));
+
+	// the first record of page 1, its deltas up to the end of the page go too
+	flash.SetEccError(1, LOG_PAGE_HEADER);
+	std::vector<int> frames = ReadAll(log);
+	REQUIRE(frames.size() < 40);
+	REQUIRE(frames.back() == 39);
+	for (size_t i = 1; i < frames.size(); i++)
+		REQUIRE(frames[i] > frames[i - 1]);
+
+	// a header with an ECC error takes the page out
+	FakeFlash other(8, 256);
+	FlashLog log2(&other);
+
+	log2.Mount();
+	for (int n = 0; n < 40; n++)
+		REQUIRE(AppendFrame(log2, n));
+	other.SetEccError(0, 0);
+
+	FlashLog again(&other);
+	REQUIRE(again.Mount());
+	frames = ReadAll(again);
+	REQUIRE(!frames.empty());
+	REQUIRE(frames.front() > 0);
+	REQUIRE(InOrder(frames, frames.front(), 40 - frames.front()));
+}
+
+// writes frames with uploads in between until the power goes at write cut
+static void RunTorn(FakeTearEnum tear, int cut, bool &cutHit)
+{
+	FakeFlash flash(8, 256);
+	FlashLog log(&flash);
+	Collect up = {{}, 1000};
+	int written = 0;
+
+	flash.tear = tear;
+	log.Mount();
+	flash.CutAfter(cut);
+	for (int n = 0; n < 30 && flash.Powered(); n++)
+	{
+		if (!AppendFrame(log, n))
+			break;
+		written = n + 1;
+
+		if (n % 5 == 4)
+		{
+			up.limit = up.frames.size() + 3;
+			log.Drain(CollectFrame, &up, 3);
+		}
+	}
+	cutHit = !flash.Powered();
+
+	// restart
+	flash.PowerOn();
+	FlashLog after(&flash);
+	after.Mount();
+
+	// the frames written in full; the one cut may have made it, unless the
+	// ECC error gives it away
+	std::vector<int> frames = ReadAll(after);
+	INFO("tear " << tear << " cut " << cut << " written " << written);
+	REQUIRE(frames.size() >= (size_t) written);
+	REQUIRE(frames.size() <= (size_t) written + (tear == tearHalf ? 1 : 0));
+	REQUIRE(InOrder(frames, 0, frames.size()));
+
+	// no frame is skipped by the upload, a few may come again
+	Collect rest = {{}, 1000};
+	after.Drain(CollectFrame, &rest, 1000);
+	if (rest.frames.empty())
+		REQUIRE(up.frames.size() >= frames.size());
+	else
+	{
+		REQUIRE(rest.frames.front() <= (int) up.frames.size());
+		REQUIRE(InOrder(rest.frames, rest.frames.front(), frames.size() - rest.frames.front()));
+	}
+
+	// and the log goes on
+	for (int n = 30; n < 33; n++)
+		REQUIRE(AppendFrame(after, n));
+	frames = ReadAll(after);
+	REQUIRE(frames.size() >= 3);
+	REQUIRE(frames[frames.size() - 3] == 30);
+	REQUIRE(frames.back() == 32);
+}
+
+TEST_CASE("FlashLog survives a power loss at any write", "[FlashLog]")
+{
+	FakeTearEnum tears[] = {tearHalf, tearEcc};
+
+	for (FakeTearEnum tear : tears)
+	{
+		bool cutHit = true;
+
+		for (int cut = 0; cutHit; cut++)
+			RunTorn(tear, cut, cutHit);
+	}
+}
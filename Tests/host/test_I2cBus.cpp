@@ -0,0 +1,299 @@
+/*
+ * test_I2cBus.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include "HalFake.h"
+#include "I2cBus.h"
+
+#define ID(n)	((void *) (intptr_t) (n))
+
+// completions in the order reported
+static int DoneIds[16];
+static HAL_StatusTypeDef DoneStatus[16];
+static int DoneCount;
+
+static void OnDone(void *ctx, HAL_StatusTypeDef status)
+{
+	DoneIds[DoneCount] = (int) (intptr_t) ctx;
+	DoneStatus[DoneCount] = status;
+	DoneCount++;
+}
+
+static void ResetDone(void)
+{
+	DoneCount = 0;
+}
+
+TEST_CASE("I2cBus runs the queue one transaction at a time", "[I2cBus]")
+{
+	FakeReset();
+	ResetDone();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	int bmp = bus.AddDevice(0x77);
+	int gauge = bus.AddDevice(0x36);
+	uint8_t buf[3][2];
+
+	REQUIRE(bus.AddDevice(0x77) == bmp);
+	REQUIRE(bus.Submit(bmp, i2cRead, 0xF6, buf[0], 2, OnDone, ID(1)));
+	REQUIRE(bus.Submit(gauge, i2cWrite, I2C_NO_REG, buf[1], 1, OnDone, ID(2)));
+	REQUIRE(bus.Submit(bmp, i2cWrite, 0xF4, buf[2], 1, OnDone, ID(3)));
+
+	REQUIRE(Fake.i2cStarts == 1);
+	CHECK(FakeI2cLast().addr == 0x77);
+	CHECK(FakeI2cLast().reg == 0xF6);
+	CHECK(FakeI2cLast().read);
+	CHECK(FakeI2cLast().len == 2);
+
+	// nothing happens before the interrupt
+	bus.Poll();
+	REQUIRE(Fake.i2cStarts == 1);
+	REQUIRE(DoneCount == 0);
+
+	HAL_I2C_MemRxCpltCallback(&hi2c);
+	bus.Poll();
+	REQUIRE(DoneCount == 1);
+	CHECK(DoneIds[0] == 1);
+	CHECK(DoneStatus[0] == HAL_OK);
+	REQUIRE(Fake.i2cStarts == 2);
+	CHECK(FakeI2cLast().addr == 0x36);
+	CHECK(FakeI2cLast().reg == I2C_NO_REG);
+	CHECK(!FakeI2cLast().read);
+
+	HAL_I2C_MasterTxCpltCallback(&hi2c);
+	bus.Poll();
+	REQUIRE(Fake.i2cStarts == 3);
+	CHECK(FakeI2cLast().reg == 0xF4);
+
+	HAL_I2C_ErrorCallback(&hi2c);
+	bus.Poll();
+	REQUIRE(DoneCount == 3);
+	CHECK(DoneIds[2] == 3);
+	CHECK(DoneStatus[2] == HAL_ERROR);
+	REQUIRE(bus.IsIdle());
+}
+
+TEST_CASE("I2cBus queue limits", "[I2cBus]")
+{
+	FakeReset();
+	ResetDone();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	int dev = bus.AddDevice(0x77);
+	uint8_t data;
+
+	for (int i = 0; i < I2C_QUEUE_SIZE; i++)
+		REQUIRE(bus.Submit(dev, i2cRead, 0, &data, 1, OnDone, ID(i)));
+	REQUIRE(!bus.Submit(dev, i2cRead, 0, &data, 1));
+	REQUIRE(!bus.Submit(dev + 1, i2cRead, 0, &data, 1));
+	REQUIRE(!bus.Submit(-1, i2cRead, 0, &data, 1));
+
+	// a completion makes room
+	HAL_I2C_MemRxCpltCallback(&hi2c);
+	bus.Poll();
+	REQUIRE(bus.Submit(dev, i2cRead, 0, &data, 1));
+
+	for (int i = 1; i < I2C_MAX_DEVICES; i++)
+		REQUIRE(bus.AddDevice(0x10 + i) == i);
+	REQUIRE(bus.AddDevice(0x40) == -1);
+}
+
+TEST_CASE("I2cBus keeps the gap of a device and serves the others meanwhile", "[I2cBus]")
+{
+	FakeReset();
+	ResetDone();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	int gauge = bus.AddDevice(0x36, 10);
+	int bmp = bus.AddDevice(0x77);
+	uint8_t data[4];
+
+	Fake.tick = 100;
+	REQUIRE(bus.Submit(gauge, i2cRead, 0x02, &data[0], 1, OnDone, ID(1)));
+	REQUIRE(Fake.i2cStarts == 1);
+	REQUIRE(bus.Submit(gauge, i2cRead, 0x04, &data[1], 1, OnDone, ID(2)));
+	REQUIRE(bus.Submit(gauge, i2cRead, 0x06, &data[2], 1, OnDone, ID(3)));
+	REQUIRE(bus.Submit(bmp, i2cRead, 0xF6, &data[3], 1, OnDone, ID(4)));
+
+	Fake.tick = 102;
+	HAL_I2C_MemRxCpltCallback(&hi2c);
+	bus.Poll();
+	REQUIRE(Fake.i2cStarts == 2);
+	CHECK(FakeI2cLast().addr == 0x77);
+
+	Fake.tick = 105;
+	HAL_I2C_MemRxCpltCallback(&hi2c);
+	bus.Poll();
+	REQUIRE(Fake.i2cStarts == 2);
+	REQUIRE(!bus.IsIdle());
+
+	// 10 ms after the end of the first one, in submit order
+	Fake.tick = 112;
+	bus.Poll();
+	REQUIRE(Fake.i2cStarts == 3);
+	CHECK(FakeI2cLast().reg == 0x04);
+
+	HAL_I2C_MemRxCpltCallback(&hi2c);
+	bus.Poll();
+	Fake.tick = 121;
+	bus.Poll();
+	REQUIRE(Fake.i2cStarts == 3);
+	Fake.tick = 122;
+	bus.Poll();
+	REQUIRE(Fake.i2cStarts == 4);
+	CHECK(FakeI2cLast().reg == 0x06);
+
+	HAL_I2C_MemRxCpltCallback(&hi2c);
+	bus.Poll();
+	REQUIRE(DoneCount == 4);
+	CHECK(DoneIds[0] == 1);
+	CHECK(DoneIds[1] == 4);
+	CHECK(DoneIds[2] == 2);
+	CHECK(DoneIds[3] == 3);
+}
+
+TEST_CASE("I2cBus aborts a stuck transfer and resets the peripheral", "[I2cBus]")
+{
+	FakeReset();
+	ResetDone();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	int dev = bus.AddDevice(0x77);
+	uint8_t data[2];
+
+	REQUIRE(bus.Submit(dev, i2cRead, 0xF6, &data[0], 1, OnDone, ID(1)));
+	REQUIRE(bus.Submit(dev, i2cRead, 0xF7, &data[1], 1, OnDone, ID(2)));
+
+	Fake.tick = I2C_XFER_TIMEOUT_MS;
+	bus.Poll();
+	REQUIRE(DoneCount == 0);
+	REQUIRE(Fake.i2cDeInits == 0);
+
+	Fake.tick = I2C_XFER_TIMEOUT_MS + 1;
+	bus.Poll();
+	REQUIRE(DoneCount == 1);
+	CHECK(DoneStatus[0] == HAL_TIMEOUT);
+	CHECK(Fake.i2cDeInits == 1);
+	CHECK(Fake.i2cInits == 1);
+
+	// the next one runs on the fresh peripheral
+	REQUIRE(Fake.i2cStarts == 2);
+	HAL_I2C_MemRxCpltCallback(&hi2c);
+	bus.Poll();
+	REQUIRE(DoneCount == 2);
+	CHECK(DoneStatus[1] == HAL_OK);
+
+	// one the HAL refuses to start ends at once
+	Fake.i2cStartStatus = HAL_BUSY;
+	REQUIRE(bus.Submit(dev, i2cRead, 0xF6, &data[0], 1, OnDone, ID(3)));
+	REQUIRE(DoneCount == 3);
+	CHECK(DoneStatus[2] == HAL_BUSY);
+	REQUIRE(bus.IsIdle());
+}
+
+TEST_CASE("I2cBus ignores the callbacks of another peripheral", "[I2cBus]")
+{
+	FakeReset();
+	ResetDone();
+	I2C_HandleTypeDef hi2c = {};
+	I2C_HandleTypeDef other = {};
+	I2cBus bus(&hi2c);
+	int dev = bus.AddDevice(0x77);
+	uint8_t data;
+
+	REQUIRE(bus.Submit(dev, i2cRead, 0xF6, &data, 1, OnDone, ID(1)));
+	HAL_I2C_MemRxCpltCallback(&other);
+	bus.Poll();
+	REQUIRE(DoneCount == 0);
+	HAL_I2C_MemRxCpltCallback(&hi2c);
+	bus.Poll();
+	REQUIRE(DoneCount == 1);
+}
+
+TEST_CASE("I2cBus statistics", "[I2cBus]")
+{
+	FakeReset();
+	ResetDone();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	int dev = bus.AddDevice(0x77);
+	uint8_t data[2];
+	I2cStats stats;
+
+	REQUIRE(bus.Submit(dev, i2cRead, 0xF6, &data[0], 1));
+	REQUIRE(bus.Submit(dev, i2cRead, 0xF7, &data[1], 1));
+	Fake.tick = 3;
+	HAL_I2C_MemRxCpltCallback(&hi2c);
+	bus.Poll();
+	Fake.tick = 10;
+	HAL_I2C_ErrorCallback(&hi2c);
+	bus.Poll();
+
+	REQUIRE(bus.GetStats(dev, stats, true));
+	CHECK(stats.addr == 0x77);
+	CHECK(stats.count == 2);
+	CHECK(stats.errors == 1);
+	CHECK(stats.latencyMax == 10);
+	CHECK(stats.latencySum == 13);
+
+	REQUIRE(bus.GetStats(dev, stats));
+	CHECK(stats.count == 0);
+	CHECK(stats.addr == 0x77);
+	REQUIRE(!bus.GetStats(dev + 1, stats));
+}
+
+// a register file behind the fake bus
+struct FakeRegs
+{
+	uint8_t regs[256];
+};
+
+static HAL_StatusTypeDef RegSlave(void *ctx, const FakeI2cXfer &xfer, uint8_t *data)
+{
+	FakeRegs *pRegs = (FakeRegs *) ctx;
+
+	if (xfer.read)
+		memcpy(data, &pRegs->regs[xfer.reg], xfer.len);
+	else
+		memcpy(&pRegs->regs[xfer.reg], data, xfer.len);
+	return HAL_OK;
+}
+
+static HAL_StatusTypeDef StuckSlave(void *ctx, const FakeI2cXfer &xfer, uint8_t *data)
+{
+	return HAL_TIMEOUT;
+}
+
+TEST_CASE("I2cBus blocking calls", "[I2cBus]")
+{
+	FakeReset();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	int dev = bus.AddDevice(0x77);
+	FakeRegs regs = {};
+	uint8_t out[2] = {0x12, 0x34};
+	uint8_t in[2] = {};
+
+	Fake.i2cSlave = RegSlave;
+	Fake.i2cSlaveCtx = &regs;
+	REQUIRE(bus.MemWrite(dev, 0xF4, out, 2) == HAL_OK);
+	REQUIRE(bus.MemRead(dev, 0xF4, in, 2) == HAL_OK);
+	CHECK(in[0] == 0x12);
+	CHECK(in[1] == 0x34);
+	REQUIRE(bus.MemRead(dev + 1, 0xF4, in, 2) == HAL_ERROR);
+
+	// ends by the timeout, the clock moves on while it polls
+	Fake.i2cSlave = StuckSlave;
+	Fake.tickStep = 1;
+	REQUIRE(bus.Receive(dev, in, 1) == HAL_TIMEOUT);
+	CHECK(Fake.i2cDeInits == 1);
+	REQUIRE(bus.IsIdle());
+
+	Fake.i2cSlave = RegSlave;
+	REQUIRE(bus.Transmit(dev, out, 1) == HAL_OK);
+}
@@ -0,0 +1,135 @@
+/*
+ * test_NS_energyShield2.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include "HalFake.h"
+#include "NS_energyShield2.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//	struct FakeRtc
+//
+//	registers of the shield's RTC on the fake I2C bus; the other chips of
+//	the shield read as 0
+//
+struct FakeRtc
+{
+	uint8_t 			regs[0x12];
+	int 				alarmWrites;
+
+	FakeRtc()
+	{
+		memset(regs, 0, sizeof(regs));
+		alarmWrites = 0;
+	}
+
+	void Attach()
+	{
+		Fake.i2cSlave = Slave;
+		Fake.i2cSlaveCtx = this;
+	}
+
+	static HAL_StatusTypeDef Slave(void *ctx, const FakeI2cXfer &xfer, uint8_t *data)
+	{
+		FakeRtc *pRtc = (FakeRtc *) ctx;
+
+		if (xfer.addr != RTC_SLAVE_ADDR)
+		{
+			if (xfer.read)
+				memset(data, 0, xfer.len);
+			return HAL_OK;
+		}
+		if (xfer.reg < 0 || xfer.reg + xfer.len > (int) sizeof(pRtc->regs))
+			return HAL_ERROR;
+
+		if (xfer.read)
+			memcpy(data, &pRtc->regs[xfer.reg], xfer.len);
+		else
+		{
+			memcpy(&pRtc->regs[xfer.reg], data, xfer.len);
+			if (xfer.reg == 0x0B)
+				pRtc->alarmWrites++;
+		}
+		return HAL_OK;
+	}
+};
+
+TEST_CASE("NS_energyShield2 RTC time as epoch", "[NS_energyShield2]")
+{
+	FakeReset();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	FakeRtc rtc;
+	NS_energyShield2 es2(&bus);
+
+	// the RTC is given a gap between transfers, let the time go on
+	Fake.tickStep = 1;
+	rtc.Attach();
+
+	// 2026-12-31 23:59:50, a Thursday
+	es2.setEpoch(1798761590);
+	const uint8_t expect[7] = {0x50, 0x59, 0x23, 0x31, 4, 0x12, 0x26};
+	CHECK(memcmp(&rtc.regs[0x04], expect, 7) == 0);
+	CHECK(es2.readEpoch() == 1798761590);
+	CHECK(es2.dayOfWeek() == 4);
+
+	// a leap day, 2028-02-29 12:30:00
+	es2.setEpoch(1835440200);
+	CHECK(es2.readEpoch() == 1835440200);
+	CHECK(es2.month() == 2);
+	CHECK(es2.dayOfMonth() == 29);
+	CHECK(es2.year() == 28);
+
+	// the oscillator stopped, the time is lost
+	rtc.regs[0x04] |= 0x80;
+	CHECK(es2.readEpoch() == 0);
+
+	// registers out of range
+	es2.setEpoch(1798761590);
+	rtc.regs[0x09] = 0x13;
+	CHECK(es2.readEpoch() == 0);
+	rtc.regs[0x09] = 0x12;
+	rtc.regs[0x07] = 0x00;
+	CHECK(es2.readEpoch() == 0);
+}
+
+TEST_CASE("NS_energyShield2 alarm fields carry over", "[NS_energyShield2]")
+{
+	FakeReset();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	FakeRtc rtc;
+	NS_energyShield2 es2(&bus);
+
+	// the RTC is given a gap between transfers, let the time go on
+	Fake.tickStep = 1;
+	rtc.Attach();
+	es2.setEpoch(1798761590);
+	es2.readClock();
+
+	// 15 s: the seconds alone, over midnight and new year
+	es2.writeAlarms(15);
+	const uint8_t seconds[5] = {0x05, 0x80, 0x80, 0x80, 0x80};
+	CHECK(memcmp(&rtc.regs[0x0B], seconds, 5) == 0);
+	CHECK(rtc.alarmWrites == 1);
+
+	// 90 s: 2027-01-01 00:01:20
+	es2.writeAlarms(90);
+	const uint8_t minutes[5] = {0x20, 0x01, 0x80, 0x80, 0x80};
+	CHECK(memcmp(&rtc.regs[0x0B], minutes, 5) == 0);
+
+	// a day and an hour: 2027-01-02 00:59:50
+	es2.writeAlarms(SECS_PER_DAY + 3600);
+	const uint8_t days[5] = {0x50, 0x59, 0x00, 0x02, 0x80};
+	CHECK(memcmp(&rtc.regs[0x0B], days, 5) == 0);
+
+	// none or a negative time is 1 s
+	es2.writeAlarms(0);
+	CHECK(rtc.regs[0x0B] == 0x51);
+	es2.writeAlarms(-10);
+	CHECK(rtc.regs[0x0B] == 0x51);
+}
@@ -0,0 +1,154 @@
+/*
+ * test_PowerManager.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include "HalFake.h"
+#include "PowerManager.h"
+
+TEST_CASE("PowerManager picks the state for an idle time", "[PowerManager]")
+{
+	uint32_t stopMs;
+
+	CHECK(PowerManager::Plan(0, powerStop2, &stopMs) == powerRun);
+	CHECK(stopMs == 0);
+	CHECK(PowerManager::Plan(100, powerRun, &stopMs) == powerRun);
+
+	// too short for a stop, or a client needs the clocks
+	CHECK(PowerManager::Plan(1, powerStop2, &stopMs) == powerSleep);
+	CHECK(PowerManager::Plan(POWER_STOP_MIN_MS - 1, powerStop2, &stopMs) == powerSleep);
+	CHECK(stopMs == 0);
+	CHECK(PowerManager::Plan(100, powerSleep, &stopMs) == powerSleep);
+	CHECK(stopMs == 0);
+
+	// woken early enough to restore the clocks
+	CHECK(PowerManager::Plan(POWER_STOP_MIN_MS, powerStop2, &stopMs) == powerStop2);
+	CHECK(stopMs == POWER_STOP_MIN_MS - POWER_WAKE_MARGIN_MS);
+	CHECK(PowerManager::Plan(1000, powerStop1, &stopMs) == powerStop1);
+	CHECK(stopMs == 1000 - POWER_WAKE_MARGIN_MS);
+
+	// the 16 bit LPTIM1 counter limits a stop
+	CHECK(PowerManager::Plan(100000, powerStop2, &stopMs) == powerStop2);
+	CHECK(stopMs == POWER_STOP_MAX_MS);
+	CHECK(PowerManager::Plan(0xFFFFFFFF, powerStop2, &stopMs) == powerStop2);
+	CHECK(stopMs == POWER_STOP_MAX_MS);
+}
+
+// a client with a fixed limit that notes its calls
+struct TestClient
+{
+	PowerStateEnum 	limit;
+	int 			limits;
+	int 			suspends;
+	int 			resumes;
+	char 			*log;		// order of the calls
+	char 			id;
+};
+
+static PowerStateEnum ClientLimit(void *ctx)
+{
+	TestClient *pClient = (TestClient *) ctx;
+
+	pClient->limits++;
+	return pClient->limit;
+}
+
+static void ClientSuspend(void *ctx)
+{
+	TestClient *pClient = (TestClient *) ctx;
+
+	pClient->suspends++;
+	strncat(pClient->log, &pClient->id, 1);
+}
+
+static void ClientResume(void *ctx)
+{
+	TestClient *pClient = (TestClient *) ctx;
+
+	pClient->resumes++;
+	strncat(pClient->log, &pClient->id, 1);
+}
+
+TEST_CASE("PowerManager idles as deep as the clients allow", "[PowerManager]")
+{
+	FakeReset();
+	LPTIM_HandleTypeDef hlptim = {};
+	PowerManager power(&hlptim);
+	char log[16] = "";
+	TestClient wifi = {powerStop2, 0, 0, 0, log, 'w'};
+	TestClient adc = {powerStop2, 0, 0, 0, log, 'a'};
+	PowerStats stats;
+
+	REQUIRE(power.AddClient("wifi", ClientLimit, ClientSuspend, ClientResume, &wifi) == 0);
+	REQUIRE(power.AddClient("adc", ClientLimit, ClientSuspend, ClientResume, &adc) == 1);
+
+	// a short wait sleeps without asking the clients
+	power.Idle(5);
+	CHECK(Fake.sleeps == 1);
+	CHECK(wifi.limits == 0);
+
+	// a busy client keeps the clocks running
+	adc.limit = powerSleep;
+	power.Idle(100);
+	CHECK(Fake.sleeps == 2);
+	CHECK(Fake.stop2s == 0);
+	CHECK(wifi.suspends == 0);
+
+	// a client limits to STOP1, the others are suspended too
+	adc.limit = powerStop2;
+	wifi.limit = powerStop1;
+	Fake.lptimCounter = 40;
+	uwTick = 1000;
+	power.Idle(100);
+	CHECK(Fake.stop1s == 1);
+	CHECK(Fake.lptimPeriod == 100 - POWER_WAKE_MARGIN_MS - 1);
+	CHECK(!Fake.lptimRunning);
+	CHECK(strcmp(log, "waaw") == 0);
+
+	// no LPTIM1 interrupt came: woken early, the tick caught up by the count
+	CHECK(uwTick == 1040);
+
+	wifi.limit = powerStop2;
+	power.Idle(100);
+	CHECK(Fake.stop2s == 1);
+	CHECK(wifi.suspends == 2);
+	CHECK(adc.resumes == 2);
+
+	power.GetStats(stats, true);
+	CHECK(stats.entries[powerSleep] == 2);
+	CHECK(stats.entries[powerStop1] == 1);
+	CHECK(stats.entries[powerStop2] == 1);
+	CHECK(stats.time[powerStop1] == 40);
+	CHECK(stats.time[powerStop2] == 40);
+	CHECK(stats.vetoes == 2);
+	CHECK(stats.earlyWakes == 2);
+
+	power.GetStats(stats);
+	CHECK(stats.entries[powerSleep] == 0);
+	CHECK(stats.vetoes == 0);
+}
+
+TEST_CASE("PowerManager clients", "[PowerManager]")
+{
+	FakeReset();
+	LPTIM_HandleTypeDef hlptim = {};
+	PowerManager power(&hlptim);
+
+	// a client without a limit only gets the calls
+	REQUIRE(power.AddClient("log", NULL) == 0);
+	power.Idle(100);
+	CHECK(Fake.stop2s == 1);
+
+	for (int i = 1; i < POWER_MAX_CLIENTS; i++)
+		REQUIRE(power.AddClient("client", NULL) == i);
+	REQUIRE(power.AddClient("client", NULL) == -1);
+
+	// nothing to wait for
+	power.Idle(0);
+	CHECK(Fake.sleeps == 0);
+	CHECK(Fake.stop2s == 1);
+}
@@ -0,0 +1,107 @@
+/*
+ * test_SFE_BMP180.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <math.h>
+#include "HalFake.h"
+#include "FakeBmp180.h"
+#include "SFE_BMP180.h"
+
+TEST_CASE("SFE_BMP180 integer compensation gives the data sheet example", "[BMP180]")
+{
+	FakeReset();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	FakeBmp180 sensor;
+	SFE_BMP180 bmp(&bus);
+	int32_t t, p;
+
+	sensor.Attach();
+	REQUIRE(bmp.Begin());
+
+	REQUIRE(bmp.StartTemperature() == 5);
+	REQUIRE(bmp.GetTemperature(t));
+	CHECK(t == 150);
+
+	REQUIRE(bmp.StartPressure(0) == 5);
+	REQUIRE(bmp.GetPressure(p));
+	CHECK(p == 69964);
+
+	// the same through the float interface
+	float tf, pf;
+	REQUIRE(bmp.StartTemperature() == 5);
+	REQUIRE(bmp.GetTemperature(tf));
+	CHECK(tf == Approx(15.0f));
+	REQUIRE(bmp.StartPressure(0) == 5);
+	REQUIRE(bmp.GetPressure(pf, tf));
+	CHECK(pf == Approx(699.64f));
+}
+
+TEST_CASE("SFE_BMP180 oversampling", "[BMP180]")
+{
+	FakeReset();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	FakeBmp180 sensor;
+	SFE_BMP180 bmp(&bus);
+	int32_t t, p;
+
+	sensor.Attach();
+	REQUIRE(bmp.Begin());
+	REQUIRE(bmp.StartTemperature());
+	REQUIRE(bmp.GetTemperature(t));
+
+	// the raw pressure of OSS 3 has 3 more bits, the same pressure
+	sensor.up[0] = 23843 << 3;
+	REQUIRE(bmp.StartPressure(3) == 26);
+	REQUIRE(bmp.GetPressure(p));
+	CHECK(p >= 69962);
+	CHECK(p <= 69966);
+
+	CHECK(bmp.StartPressure(1) == 8);
+	CHECK(bmp.StartPressure(2) == 14);
+}
+
+TEST_CASE("SFE_BMP180 float compensation stays close to the integer one", "[BMP180]")
+{
+	FakeReset();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	FakeBmp180 sensor;
+	SFE_BMP180 bmp(&bus, bmpCompFloat);
+	float t, p;
+
+	sensor.Attach();
+	REQUIRE(bmp.Begin());
+	REQUIRE(bmp.StartTemperature());
+	REQUIRE(bmp.GetTemperature(t));
+	CHECK(fabsf(t - 15.0f) < 0.1f);
+	REQUIRE(bmp.StartPressure(0));
+	REQUIRE(bmp.GetPressure(p, t));
+	CHECK(fabsf(p - 699.64f) < 0.5f);
+}
+
+TEST_CASE("SFE_BMP180 reports a bus error", "[BMP180]")
+{
+	FakeReset();
+	I2C_HandleTypeDef hi2c = {};
+	I2cBus bus(&hi2c);
+	FakeBmp180 sensor;
+	SFE_BMP180 bmp(&bus);
+	int32_t t;
+
+	sensor.Attach();
+	sensor.status = HAL_ERROR;
+	REQUIRE(!bmp.Begin());
+	CHECK(bmp.GetError() == HAL_ERROR);
+
+	sensor.status = HAL_OK;
+	REQUIRE(bmp.Begin());
+	sensor.status = HAL_ERROR;
+	CHECK(bmp.StartTemperature() == 0);
+	CHECK(!bmp.GetTemperature(t));
+}
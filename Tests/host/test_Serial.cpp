@@ -0,0 +1,156 @@
+/*
+ * test_Serial.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include "FakeUart.h"
+#include "Serial.h"
+
+// the hardware while Write waits: a byte comes in through RXNE with TXE
+// set, as TDR is empty while the DMA waits, then one DMA transmission ends
+struct Line
+{
+	FakeUart 	*uart;
+	uint8_t 	rx;
+	int 		received;
+};
+
+static void LineTick(void *ctx)
+{
+	Line *line = (Line *) ctx;
+
+	line->uart->Receive(&line->rx, 1);
+	line->rx++;
+	line->received++;
+
+	if (Fake.uartTxBusy)
+	{
+		Fake.uartTxBusy = false;
+		HAL_UART_TxCpltCallback(&line->uart->huart);
+	}
+}
+
+static void CountDone(void *ctx)
+{
+	(*(int *) ctx)++;
+}
+
+TEST_CASE("Serial DMA transmission puts exactly the queued bytes on the wire", "[Serial]")
+{
+	FakeReset();
+	FakeUart uart;
+	Serial serial(&uart.huart, rxModeIrq, txModeDma);
+	Line line = {&uart, 0, 0};
+	uint8_t text[600], ref[40], expect[700];
+	int dones = 0;
+
+	REQUIRE(serial.TxMode() == txModeDma);
+	REQUIRE(serial.RxMode() == rxModeIrq);
+
+	for (int i = 0; i < (int) sizeof(text); i++)
+		text[i] = 'a' + i % 26;
+	for (int i = 0; i < (int) sizeof(ref); i++)
+		ref[i] = '0' + i % 10;
+
+	Fake.tickHook = LineTick;
+	Fake.tickHookCtx = &line;
+
+	// more than the TX ring holds, with a caller's buffer in between
+	CHECK(serial.Write(text, 300, 1000) == 300);
+	CHECK(serial.WriteRef(ref, sizeof(ref), CountDone, &dones, 1000));
+	CHECK(serial.Write(text + 300, 300, 1000) == 300);
+
+	Fake.tickHook = NULL;
+	uart.CompleteTx();
+
+	memcpy(expect, text, 300);
+	memcpy(expect + 300, ref, sizeof(ref));
+	memcpy(expect + 340, text + 300, 300);
+
+	REQUIRE(Fake.uartWireLen == 640);
+	CHECK(memcmp(Fake.uartWire, expect, 640) == 0);
+	CHECK(dones == 1);
+	CHECK(serial.TxPending() == 0);
+
+	// the received bytes came through, TDR was never written
+	CHECK(line.received > 0);
+	CHECK(serial.Available() == line.received);
+	CHECK(uart.tdrWrites == 0);
+	CHECK((uart.huart.Instance->CR1 & USART_CR1_TXEIE) == 0);
+}
+
+TEST_CASE("Serial ignores TXE while its transmit interrupt is off", "[Serial]")
+{
+	FakeReset();
+	FakeUart uart;
+	Serial serial(&uart.huart, rxModeIrq, txModeDma);
+	uint8_t data[] = "AT+CIPSTATUS\r\n";
+
+	// queued and in flight, TDR empty; an RXNE interrupt must not take from
+	// the ring the DMA is sending from
+	CHECK(serial.Write(data, sizeof(data) - 1, 0) == (int) sizeof(data) - 1);
+	REQUIRE(Fake.uartTxBusy);
+
+	uart.Receive("OK");
+	CHECK_FALSE(uart.Irq());
+
+	uart.CompleteTx();
+	REQUIRE(Fake.uartWireLen == (int) sizeof(data) - 1);
+	CHECK(memcmp(Fake.uartWire, data, sizeof(data) - 1) == 0);
+	CHECK(uart.tdrWrites == 0);
+	CHECK(serial.Available() == 2);
+}
+
+TEST_CASE("Serial interrupt transmission sends from the ring through TXE", "[Serial]")
+{
+	FakeReset();
+	FakeUart uart;
+	Serial serial(&uart.huart, rxModeIrq, txModeIrq);
+	uint8_t data[] = "AT+CIPSEND=0,5\r\n";
+	int dones = 0;
+
+	CHECK(serial.Write(data, sizeof(data) - 1, 0) == (int) sizeof(data) - 1);
+	CHECK((uart.huart.Instance->CR1 & USART_CR1_TXEIE) != 0);
+
+	// the receive interrupt sends along while TXEIE is on
+	uart.Receive("x");
+	CHECK(uart.tdrWrites == 1);
+	CHECK(uart.DrainTxe() == (int) sizeof(data) - 2);
+
+	CHECK(serial.WriteRef((const uint8_t *) "hello", 5, CountDone, &dones, 0));
+	CHECK(dones == 1);
+	CHECK(uart.DrainTxe() == 5);
+
+	const char expect[] = "AT+CIPSEND=0,5\r\nhello";
+	REQUIRE(Fake.uartWireLen == (int) strlen(expect));
+	CHECK(memcmp(Fake.uartWire, expect, strlen(expect)) == 0);
+	CHECK((uart.huart.Instance->CR1 & USART_CR1_TXEIE) == 0);
+	CHECK(Fake.uartTxStarts == 0);
+}
+
+TEST_CASE("Serial falls back to interrupts without DMA", "[Serial]")
+{
+	FakeReset();
+	Fake.dmaInitStatus = HAL_ERROR;
+	FakeUart uart;
+	Serial serial(&uart.huart);
+	uint8_t data[] = "AT\r\n";
+
+	CHECK(serial.RxMode() == rxModeIrq);
+	CHECK(serial.TxMode() == txModeIrq);
+	CHECK((uart.huart.Instance->CR1 & USART_CR1_RXNEIE) != 0);
+
+	CHECK(serial.Write(data, 4, 0) == 4);
+	CHECK(uart.DrainTxe() == 4);
+	REQUIRE(Fake.uartWireLen == 4);
+	CHECK(memcmp(Fake.uartWire, data, 4) == 0);
+
+	uart.Receive("OK\r\n");
+	uint8_t got[4];
+	REQUIRE(serial.Read(got, 4, 0) == 4);
+	CHECK(memcmp(got, "OK\r\n", 4) == 0);
+}
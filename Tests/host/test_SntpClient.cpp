@@ -0,0 +1,403 @@
+/*
+ * test_SntpClient.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include "FakeUdp.h"
+#include "SntpClient.h"
+
+#define T1			1792310400123LL			// ms, 2026-10-18 09:20:00.123
+
+static uint32_t s_tick;
+
+static uint32_t Tick(void)
+{
+	return s_tick;
+}
+
+static void PutU64(uint8_t *p, uint64_t v)
+{
+	for (int i = 7; i >= 0; i--, v >>= 8)
+		p[i] = v & 0xFF;
+}
+
+// a server reply to the request with transmit time origin
+static void Reply(uint8_t *pkt, uint64_t origin, int64_t t2, int64_t t3)
+{
+	memset(pkt, 0, SNTP_PACKET_SIZE);
+	pkt[0] = (4 << 3) | 4;			// no leap warning, version 4, server
+	pkt[1] = 2;
+	PutU64(pkt + 24, origin);
+	PutU64(pkt + 32, SntpClient::ToNtp(t2));
+	PutU64(pkt + 40, SntpClient::ToNtp(t3));
+}
+
+TEST_CASE("SNTP timestamps", "[SntpClient]")
+{
+	const int64_t times[] = {0, 1, 999, 1000, T1, T1 + 877, 2085978495999LL};
+
+	CHECK(SntpClient::ToNtp(0) == (uint64_t) SNTP_UNIX_OFFSET << 32);
+	CHECK(SntpClient::ToNtp(500) == (((uint64_t) SNTP_UNIX_OFFSET << 32) | 0x80000000));
+
+	for (int64_t ms : times)
+		CHECK(SntpClient::FromNtp(SntpClient::ToNtp(ms)) == ms);
+
+	// era 1 from 2036-02-07 06:28:16 on, the seconds start again from 0
+	int64_t era1 = 2085978496000LL;
+	uint32_t secs = SntpClient::ToNtp(era1) >> 32;
+	CHECK(secs == 0);
+	CHECK(SntpClient::FromNtp(SntpClient::ToNtp(era1)) == era1);
+	CHECK(SntpClient::FromNtp(SntpClient::ToNtp(era1 + 86400250)) == era1 + 86400250);
+
+	uint8_t pkt[SNTP_PACKET_SIZE];
+	uint64_t transmit = SntpClient::ToNtp(T1);
+	uint8_t expect[8];
+
+	SntpClient::BuildRequest(pkt, transmit);
+	PutU64(expect, transmit);
+	CHECK(pkt[0] == 0x23);
+	CHECK(memcmp(pkt + 40, expect, 8) == 0);
+	for (int i = 1; i < 40; i++)
+		CHECK(pkt[i] == 0);
+}
+
+TEST_CASE("SNTP offset and delay", "[SntpClient]")
+{
+	uint8_t pkt[SNTP_PACKET_SIZE];
+	uint64_t origin = SntpClient::ToNtp(T1);
+	SntpSample sample;
+
+	// server 250 ms ahead, 20 ms each way, 5 ms in the server
+	Reply(pkt, origin, T1 + 20 + 250, T1 + 25 + 250);
+	REQUIRE(SntpClient::ParseReply(pkt, sizeof(pkt), origin, T1, T1 + 45, sample));
+	CHECK(sample.valid);
+	CHECK(sample.offset == 250);
+	CHECK(sample.delay == 40);
+	CHECK(sample.stratum == 2);
+
+	// server behind, the way out slower than the way back: half of the
+	// asymmetry goes into the offset
+	Reply(pkt, origin, T1 + 60 - 1000, T1 + 62 - 1000);
+	REQUIRE(SntpClient::ParseReply(pkt, sizeof(pkt), origin, T1, T1 + 72, sample));
+	CHECK(sample.offset == -1000 + 25);
+	CHECK(sample.delay == 70);
+
+	// a longer packet is fine
+	uint8_t longer[SNTP_PACKET_SIZE + 20] = {0};
+	Reply(longer, origin, T1 + 10, T1 + 10);
+	CHECK(SntpClient::ParseReply(longer, sizeof(longer), origin, T1, T1 + 20, sample));
+	CHECK(sample.offset == 0);
+}
+
+TEST_CASE("SNTP rejects unusable replies", "[SntpClient]")
+{
+	uint8_t pkt[SNTP_PACKET_SIZE];
+	uint64_t origin = SntpClient::ToNtp(T1);
+	SntpSample sample;
+
+	Reply(pkt, origin, T1 + 10, T1 + 11);
+	REQUIRE(SntpClient::ParseReply(pkt, sizeof(pkt), origin, T1, T1 + 21, sample));
+	CHECK(!SntpClient::ParseReply(pkt, sizeof(pkt) - 1, origin, T1, T1 + 21, sample));
+	CHECK(!sample.valid);
+
+	// not an answer to this request
+	CHECK(!SntpClient::ParseReply(pkt, sizeof(pkt), origin + 1, T1, T1 + 21, sample));
+
+	// round trip too long, negative or the server's times reversed
+	CHECK(!SntpClient::ParseReply(pkt, sizeof(pkt), origin, T1, T1 + SNTP_MAX_DELAY_MS + 2, sample));
+	CHECK(!SntpClient::ParseReply(pkt, sizeof(pkt), origin, T1, T1, sample));
+	Reply(pkt, origin, T1 + 11, T1 + 10);
+	CHECK(!SntpClient::ParseReply(pkt, sizeof(pkt), origin, T1, T1 + 21, sample));
+
+	struct
+	{
+		int 		offset;
+		uint8_t 	value;
+	} bad[] =
+	{
+		{0, (4 << 3) | 3},				// a client packet
+		{0, 4},							// version 0
+		{0, 0xC0 | (4 << 3) | 4},		// server not synchronized
+		{1, 0},							// kiss of death
+		{1, 16},						// unsynchronized
+	};
+
+	for (auto &b : bad)
+	{
+		Reply(pkt, origin, T1 + 10, T1 + 11);
+		pkt[b.offset] = b.value;
+		CHECK(!SntpClient::ParseReply(pkt, sizeof(pkt), origin, T1, T1 + 21, sample));
+	}
+
+	// no transmit time
+	Reply(pkt, origin, T1 + 10, T1 + 11);
+	memset(pkt + 40, 0, 8);
+	CHECK(!SntpClient::ParseReply(pkt, sizeof(pkt), origin, T1, T1 + 21, sample));
+}
+
+TEST_CASE("SNTP median of the servers", "[SntpClient]")
+{
+	SntpSample samples[SNTP_MAX_SERVERS] = {};
+	int64_t offset = 0;
+
+	CHECK(!SntpClient::Combine(samples, SNTP_MAX_SERVERS, &offset));
+
+	samples[1] = {true, -40, 30, 2};
+	REQUIRE(SntpClient::Combine(samples, SNTP_MAX_SERVERS, &offset));
+	CHECK(offset == -40);
+
+	// one server far off does not pull the result
+	samples[0] = {true, 90000, 30, 1};
+	samples[2] = {true, -10, 25, 2};
+	REQUIRE(SntpClient::Combine(samples, 3, &offset));
+	CHECK(offset == -10);
+
+	// an even count takes the middle two
+	samples[3] = {true, -30, 40, 3};
+	REQUIRE(SntpClient::Combine(samples, 4, &offset));
+	CHECK(offset == -20);
+
+	// invalid ones do not count
+	samples[0].valid = false;
+	REQUIRE(SntpClient::Combine(samples, 4, &offset));
+	CHECK(offset == -30);
+}
+
+static uint32_t ReceiveTick(void *ctx)
+{
+	return ((FakeUdp *) ctx)->ReceiveTick();
+}
+
+struct SyncLog
+{
+	int 		count;
+	int64_t 	offset;
+};
+
+static void LogSync(void *ctx, int64_t offsetMs)
+{
+	SyncLog *log = (SyncLog *) ctx;
+
+	log->count++;
+	log->offset = offsetMs;
+}
+
+// follows the waits Poll() asks for until a round ends, returns its last wait
+static uint32_t RunRound(SntpClient &sntp, int *polls)
+{
+	uint32_t wait = 0;
+
+	for (*polls = 0; *polls < 10000; (*polls)++)
+	{
+		wait = sntp.Poll();
+		if (wait >= SNTP_RETRY_MS)
+			break;
+		s_tick += wait;
+	}
+	return wait;
+}
+
+TEST_CASE("SNTP Poll takes the fastest reply of each server and the median", "[SntpClient]")
+{
+	s_tick = 5000;
+	WallClock clock(Tick);
+	FakeUdp udp(&s_tick);
+	SntpClient sntp(&udp, &clock, Tick);
+	SyncLog log = {};
+	int polls;
+
+	// b drops its second request, answers the third with a kiss of death
+	// and the last one too late; c is 90 s off
+	const int delaysA[SNTP_SAMPLES] = {40, 12, 30, 25};
+	const int delaysB[SNTP_SAMPLES] = {20, 20, 15, 5};
+	const int delaysC[SNTP_SAMPLES] = {8, 8, 8, 8};
+	const FakeAnswerEnum answersB[SNTP_SAMPLES] = {answerReply, answerDrop, answerKiss, answerLate};
+
+	udp.AddServer("a.pool", T1, delaysA);
+	udp.AddServer("b.pool", T1 + 20, delaysB, answersB);
+	udp.AddServer("c.pool", T1 + 90000, delaysC);
+	for (int i = 0; i < udp.count; i++)
+		REQUIRE(sntp.AddServer(udp.servers[i].host));
+	sntp.SetSyncHandler(LogSync, &log);
+	sntp.SetReceiveTick(ReceiveTick, &udp);
+	sntp.Begin(4123);
+
+	CHECK(RunRound(sntp, &polls) == SNTP_INTERVAL_MS);
+	CHECK(udp.opens == 1);
+
+	// every server asked SNTP_SAMPLES times, one after the other
+	for (int i = 0; i < udp.count; i++)
+		CHECK(udp.servers[i].requests == SNTP_SAMPLES);
+	CHECK(udp.sent == 3 * SNTP_SAMPLES);
+	CHECK(udp.late == 0);
+
+	SntpStats stats;
+	sntp.GetStats(stats);
+	CHECK(stats.requests == 3 * SNTP_SAMPLES);
+	CHECK(stats.timeouts == 3);
+	CHECK(stats.rejected == 1);
+	CHECK(stats.syncs == 1);
+	CHECK(stats.failures == 0);
+	// a's best round trip, 12 ms each way
+	CHECK(stats.lastDelay == 24);
+
+	// the offset is exact with the receive tick, b's is the median; the
+	// clock counted from 0 at 5000 and is stepped to b's time
+	REQUIRE(log.count == 1);
+	CHECK(log.offset == T1 + 20 + 5000);
+	CHECK(stats.lastOffset == log.offset);
+	CHECK(sntp.IsSynced());
+	CHECK(clock.IsSet());
+	int64_t error = clock.Now() - (T1 + 20 + s_tick);
+	CHECK(error == 0);
+
+	// the next round is due an interval later
+	s_tick += 1000;
+	CHECK(sntp.Poll() == SNTP_INTERVAL_MS - 1000);
+	CHECK(udp.sent == 3 * SNTP_SAMPLES);
+}
+
+TEST_CASE("SNTP Poll retries a round without replies", "[SntpClient]")
+{
+	s_tick = 0;
+	WallClock clock(Tick);
+	FakeUdp udp(&s_tick);
+	SntpClient sntp(&udp, &clock, Tick);
+	SyncLog log = {};
+	int polls;
+
+	const int delays[SNTP_SAMPLES] = {10, 10, 10, 10};
+	const FakeAnswerEnum answers[SNTP_SAMPLES] = {answerDrop, answerDrop, answerDrop, answerDrop};
+
+	// no servers, nothing to do
+	CHECK(sntp.Poll() == SNTP_INTERVAL_MS);
+
+	udp.AddServer("a.pool", T1, delays, answers);
+	REQUIRE(sntp.AddServer("a.pool"));
+	sntp.SetSyncHandler(LogSync, &log);
+	sntp.Begin(4123);
+
+	// no socket: the round ends at once
+	udp.refuse = true;
+	CHECK(sntp.Poll() == SNTP_RETRY_MS);
+	CHECK(udp.sent == 0);
+
+	// every request times out, the round waits SNTP_TIMEOUT_MS for each
+	udp.refuse = false;
+	uint32_t start = s_tick;
+	s_tick += SNTP_RETRY_MS;
+	CHECK(RunRound(sntp, &polls) == SNTP_RETRY_MS);
+	uint32_t took = s_tick - start - SNTP_RETRY_MS;
+	CHECK(took >= SNTP_SAMPLES * SNTP_TIMEOUT_MS);
+	CHECK(udp.opens == 2);
+	CHECK(udp.sent == SNTP_SAMPLES);
+
+	SntpStats stats;
+	sntp.GetStats(stats, true);
+	CHECK(stats.requests == SNTP_SAMPLES);
+	CHECK(stats.timeouts == SNTP_SAMPLES);
+	CHECK(stats.failures == 2);
+	CHECK(stats.syncs == 0);
+	CHECK(log.count == 0);
+	CHECK_FALSE(sntp.IsSynced());
+	CHECK_FALSE(clock.IsSet());
+
+	// the reset keeps the last offset and delay only
+	sntp.GetStats(stats);
+	CHECK(stats.failures == 0);
+	CHECK(stats.requests == 0);
+}
+
+TEST_CASE("WallClock steps and slews", "[WallClock]")
+{
+	s_tick = 0xFFFFF000;					// wraps on the way
+	WallClock clock(Tick);
+
+	// counts from 0 until it is set
+	CHECK(!clock.IsSet());
+	s_tick += 1500;
+	CHECK(clock.Now() == 1500);
+
+	clock.Discipline(T1 - 1500);
+	CHECK(clock.IsSet());
+	CHECK(clock.Now() == T1);
+	CHECK(clock.Seconds() == (uint32_t) (T1 / 1000));
+
+	// a large offset is stepped
+	clock.Discipline(-5000);
+	CHECK(clock.Now() == T1 - 5000);
+	int64_t base = T1 - 5000;
+
+	// a small one slewed in at 5 ms per s, the time never goes back
+	clock.Discipline(-800);
+	int64_t last = clock.Now();
+	for (int s = 1; s <= 200; s++)
+	{
+		s_tick += 1000;
+		int64_t now = clock.Now();
+		CHECK(now > last);
+		last = now;
+
+		int64_t slewed = s * 5 < 800 ? s * 5 : 800;
+		int64_t expect = base + s * 1000 - slewed;
+		// the frequency estimate takes part of it already
+		int64_t error = now - expect;
+		CHECK(error >= -800);
+		CHECK(error <= 0);
+		if (s == 1)
+			CHECK(error == 0);
+	}
+
+	// Set() steps, e.g. from the RTC
+	clock.Set(T1);
+	CHECK(clock.Now() == T1);
+}
+
+TEST_CASE("WallClock learns the tick's frequency error", "[WallClock]")
+{
+	// the tick runs 1 % slow
+	s_tick = 0;
+	WallClock clock(Tick);
+	int64_t truth = T1;
+
+	clock.Discipline(truth);
+	for (int sync = 0; sync < 40; sync++)
+	{
+		for (int s = 0; s < 60; s++)
+		{
+			s_tick += 990;
+			truth += 1000;
+			clock.Now();
+		}
+		clock.Discipline(truth - clock.Now());
+	}
+
+	int32_t ppm = clock.GetPpm();
+	CHECK(ppm > 9500);
+	CHECK(ppm < 10700);
+
+	// and keeps time between the syncs
+	for (int s = 0; s < 600; s++)
+	{
+		s_tick += 990;
+		truth += 1000;
+	}
+	int64_t error = clock.Now() - truth;
+	CHECK(error > -100);
+	CHECK(error < 100);
+
+	// the correction is bounded
+	s_tick = 0;
+	WallClock wild(Tick);
+	wild.Discipline(T1);
+	for (int sync = 0; sync < 60; sync++)
+	{
+		s_tick += 200000;
+		wild.Discipline(WALL_STEP_MS - 1);
+	}
+	CHECK(wild.GetPpm() == WALL_MAX_PPM);
+}
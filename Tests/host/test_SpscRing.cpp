@@ -0,0 +1,198 @@
+/*
+ * test_SpscRing.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <stdio.h>
+#include <thread>
+#include "SpscRing.h"
+#include "Queue.h"
+#include "Profiler.h"
+
+// byte n of the stream, not periodic in the ring size
+static uint8_t StreamByte(uint32_t n)
+{
+	return (uint8_t) (n ^ (n >> 8) ^ (n >> 17));
+}
+
+// span sizes of a side, from its own generator
+static int SpanLen(uint32_t &seed, int max)
+{
+	seed = seed * 1103515245 + 12345;
+	return 1 + (int) ((seed >> 16) % max);
+}
+
+TEST_CASE("SpscRing keeps a stream intact between two threads", "[SpscRing]")
+{
+	static SpscRing<256> ring;
+	const uint32_t total = 4 * 1024 * 1024;
+	uint32_t errors = 0;
+	uint32_t firstError = 0;
+	uint32_t received = 0;
+	uint32_t spans = 0;
+
+	// producer: spans of PeekWritable() filled in place, committed in pieces
+	std::thread producer([&]()
+	{
+		uint32_t seed = 1;
+		uint32_t n = 0;
+
+		while (n < total)
+		{
+			uint8_t *ptr;
+			int len = ring.PeekWritable(&ptr);
+			if (len == 0)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			int want = SpanLen(seed, 97);
+			if (len > want)
+				len = want;
+			if ((uint32_t) len > total - n)
+				len = total - n;
+			for (int i = 0; i < len; i++)
+				ptr[i] = StreamByte(n + i);
+			ring.CommitWrite(len);
+			n += len;
+		}
+	});
+
+	// consumer: spans of PeekContiguous(), checked and released in pieces
+	std::thread consumer([&]()
+	{
+		uint32_t seed = 7;
+
+		while (received < total)
+		{
+			const uint8_t *ptr;
+			int len = ring.PeekContiguous(&ptr);
+			if (len == 0)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			int want = SpanLen(seed, 131);
+			if (len > want)
+				len = want;
+			for (int i = 0; i < len; i++)
+			{
+				if (ptr[i] != StreamByte(received + i))
+				{
+					if (errors++ == 0)
+						firstError = received + i;
+				}
+			}
+			ring.Commit(len);
+			received += len;
+			spans++;
+		}
+	});
+
+	producer.join();
+	consumer.join();
+
+	INFO("first wrong byte at " << firstError);
+	CHECK(errors == 0);
+	CHECK(received == total);
+	CHECK(ring.IsEmpty());
+	CHECK(spans > total / 131);
+}
+
+TEST_CASE("SpscRing Push and Pop between two threads", "[SpscRing]")
+{
+	static SpscRing<64> ring;
+	const uint32_t total = 1024 * 1024;
+	uint32_t errors = 0;
+
+	std::thread producer([&]()
+	{
+		for (uint32_t n = 0; n < total; )
+		{
+			if (ring.Push(StreamByte(n)))
+				n++;
+			else
+				std::this_thread::yield();
+		}
+	});
+
+	uint32_t n = 0;
+	while (n < total)
+	{
+		uint8_t c;
+		if (ring.Pop(&c))
+		{
+			if (c != StreamByte(n))
+				errors++;
+			n++;
+		}
+		else
+			std::this_thread::yield();
+	}
+	producer.join();
+
+	CHECK(errors == 0);
+	CHECK(ring.IsEmpty());
+}
+
+// the old Serial moved every byte through Push() and Pop() of a Queue
+TEST_CASE("SpscRing throughput against the Queue it replaced", "[SpscRing][bench]")
+{
+	const int total = 32 * 1024 * 1024;
+	const int block = 64;
+	uint8_t in[block], out[block];
+	uint32_t sum = 0;
+
+	for (int i = 0; i < block; i++)
+		in[i] = StreamByte(i);
+
+	// Queue(256), byte by byte as Serial::Write and Serial::Read did
+	Queue queue(256);
+	uint32_t start = ProfNow();
+	for (int n = 0; n < total; n += block)
+	{
+		for (int i = 0; i < block; i++)
+			queue.Push(in[i]);
+		for (int i = 0; i < block; i++)
+			out[i] = queue.Pop();
+		sum += out[block - 1];
+	}
+	uint32_t queueNs = ProfNow() - start;
+
+	// SpscRing<256> byte by byte
+	SpscRing<256> ring;
+	start = ProfNow();
+	for (int n = 0; n < total; n += block)
+	{
+		for (int i = 0; i < block; i++)
+			ring.Push(in[i]);
+		for (int i = 0; i < block; i++)
+			ring.Pop(&out[i]);
+		sum += out[block - 1];
+	}
+	uint32_t popNs = ProfNow() - start;
+
+	// SpscRing<256> by spans, as the DMA paths use it
+	start = ProfNow();
+	for (int n = 0; n < total; n += block)
+	{
+		ring.Write(in, block);
+		ring.Read(out, block);
+		sum += out[block - 1];
+	}
+	uint32_t spanNs = ProfNow() - start;
+
+	double mb = total / 1e6;
+	printf("byte rings: Queue %.1f MB/s, SpscRing Push/Pop %.1f MB/s, "
+		"SpscRing spans %.1f MB/s (%.1fx the Queue)\n",
+		mb / (queueNs / 1e9), mb / (popNs / 1e9), mb / (spanNs / 1e9),
+		(double) queueNs / spanNs);
+
+	CHECK(sum == 3U * (total / block) * in[block - 1]);
+	CHECK(spanNs < queueNs);
+}
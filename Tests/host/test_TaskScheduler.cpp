@@ -0,0 +1,231 @@
+/*
+ * test_TaskScheduler.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include "TaskScheduler.h"
+
+// the clock of the scheduler, moved by the tests and by the tasks
+static uint32_t FakeNow;
+
+static uint32_t FakeTick(void)
+{
+	return FakeNow;
+}
+
+// a task that logs its steps, takes exec ms per step and waits period ms
+struct TestTask
+{
+	int 		id;
+	uint32_t 	exec;
+	uint32_t 	period;
+	int 		steps;			// SCHED_STOP after every this many, 0 for never
+	int 		runs;
+	uint32_t 	lastRun;
+	int 		*log;
+	int 		*logLen;
+};
+
+static uint32_t TestStep(void *ctx)
+{
+	TestTask *task = (TestTask *) ctx;
+
+	task->lastRun = FakeNow;
+	task->log[(*task->logLen)++] = task->id;
+	FakeNow += task->exec;
+
+	task->runs++;
+	if (task->steps > 0 && task->runs % task->steps == 0)
+		return SCHED_STOP;
+	return task->period;
+}
+
+TEST_CASE("TaskScheduler runs the due tasks earliest first", "[TaskScheduler]")
+{
+	int log[16];
+	int logLen = 0;
+	TestTask a = {0, 0, 100, 0, 0, 0, log, &logLen};
+	TestTask b = {1, 0, 100, 0, 0, 0, log, &logLen};
+	TestTask c = {2, 0, 100, 0, 0, 0, log, &logLen};
+
+	FakeNow = 1000;
+	TaskScheduler sched(FakeTick);
+
+	a.id = sched.Add("a", TestStep, &a, 30);
+	b.id = sched.Add("b", TestStep, &b, 10);
+	c.id = sched.Add("c", TestStep, &c, 20);
+	CHECK(sched.Count() == 3);
+
+	// nothing due yet, the wait is to the earliest
+	CHECK(sched.Run() == 10);
+	CHECK(logLen == 0);
+
+	// all three late, the one due first runs first; then all are due at 1150
+	FakeNow = 1050;
+	CHECK(sched.Run() == 100);
+	REQUIRE(logLen == 3);
+	CHECK(log[0] == b.id);
+	CHECK(log[1] == c.id);
+	CHECK(log[2] == a.id);
+
+	// a tie goes to the task added first
+	logLen = 0;
+	FakeNow = 1150;
+	sched.Run();
+	REQUIRE(logLen == 3);
+	CHECK(log[0] == a.id);
+	CHECK(log[1] == b.id);
+	CHECK(log[2] == c.id);
+}
+
+TEST_CASE("TaskScheduler does not let an always due task starve the others", "[TaskScheduler]")
+{
+	int log[64];
+	int logLen = 0;
+	TestTask busy = {0, 1, 0, 0, 0, 0, log, &logLen};
+	TestTask slow = {0, 0, 5, 0, 0, 0, log, &logLen};
+
+	FakeNow = 0;
+	TaskScheduler sched(FakeTick);
+
+	busy.id = sched.Add("busy", TestStep, &busy);
+	slow.id = sched.Add("slow", TestStep, &slow);
+
+	// a Run ends after as many steps as there are tasks
+	for (int i = 0; i < 20; i++)
+	{
+		int before = logLen;
+		CHECK(sched.Run() == 0);
+		int steps = logLen - before;
+		CHECK(steps <= sched.Count());
+	}
+
+	// the other task gets its steps within a step of busy of their due time
+	SchedStats stats;
+	REQUIRE(sched.GetStats(slow.id, stats));
+	CHECK(stats.runs == (uint32_t) slow.runs);
+	CHECK(slow.runs >= (int) (FakeNow / 6));
+	CHECK(stats.latencyMax <= busy.exec);
+}
+
+TEST_CASE("TaskScheduler stops and wakes tasks", "[TaskScheduler]")
+{
+	int log[16];
+	int logLen = 0;
+	TestTask once = {0, 0, 10, 1, 0, 0, log, &logLen};
+	TestTask tick = {0, 0, 50, 0, 0, 0, log, &logLen};
+
+	FakeNow = 0;
+	TaskScheduler sched(FakeTick);
+
+	once.id = sched.Add("once", TestStep, &once);
+	CHECK(sched.Run() == SCHED_STOP);
+	CHECK(once.runs == 1);
+
+	// stays stopped until woken, then runs after the delay
+	FakeNow = 500;
+	CHECK(sched.Run() == SCHED_STOP);
+	sched.Wake(once.id, 25);
+	CHECK(sched.Run() == 25);
+	FakeNow = 525;
+	CHECK(sched.Run() == SCHED_STOP);
+	CHECK(once.runs == 2);
+	CHECK(once.lastRun == 525);
+
+	// a wake moves the next step of a waiting task ahead
+	tick.id = sched.Add("tick", TestStep, &tick, 50);
+	sched.Wake(tick.id);
+	CHECK(sched.Run() == 50);
+	CHECK(tick.runs == 1);
+	CHECK(tick.lastRun == 525);
+
+	// ids out of range are ignored
+	sched.Wake(-1);
+	sched.Wake(SCHED_MAX_TASKS);
+	SchedStats stats;
+	CHECK_FALSE(sched.GetStats(5, stats));
+}
+
+TEST_CASE("TaskScheduler keeps latency, jitter and step time", "[TaskScheduler]")
+{
+	int log[16];
+	int logLen = 0;
+	TestTask task = {0, 3, 100, 0, 0, 0, log, &logLen};
+
+	FakeNow = 0;
+	TaskScheduler sched(FakeTick);
+
+	task.id = sched.Add("task", TestStep, &task, 100);
+
+	// due at 100, run at 102: latency 2, next due 105 + 100 = 205
+	FakeNow = 102;
+	CHECK(sched.Run() == 100);
+	// run at 212: latency 7, jitter 5, next due 315
+	FakeNow = 212;
+	sched.Run();
+	// run at 315: latency 0, jitter 7
+	FakeNow = 315;
+	sched.Run();
+
+	SchedStats stats;
+	REQUIRE(sched.GetStats(task.id, stats, true));
+	CHECK(strcmp(stats.name, "task") == 0);
+	CHECK(stats.runs == 3);
+	CHECK(stats.latencyMax == 7);
+	CHECK(stats.latencySum == 9);
+	CHECK(stats.jitterMax == 7);
+	CHECK(stats.execMax == 3);
+
+	// started over, the name stays
+	REQUIRE(sched.GetStats(task.id, stats));
+	CHECK(strcmp(stats.name, "task") == 0);
+	CHECK(stats.runs == 0);
+	CHECK(stats.latencyMax == 0);
+	CHECK(stats.execMax == 0);
+}
+
+TEST_CASE("TaskScheduler runs on across the tick wrap", "[TaskScheduler]")
+{
+	int log[64];
+	int logLen = 0;
+	TestTask fast = {0, 1, 10, 0, 0, 0, log, &logLen};
+	TestTask late = {0, 0, 0, 1, 0, 0, log, &logLen};
+
+	FakeNow = 0xFFFFFFF0;
+	TaskScheduler sched(FakeTick);
+
+	fast.id = sched.Add("fast", TestStep, &fast, 10);
+	// due past the wrap, 0x10 as a number, must not run first
+	late.id = sched.Add("late", TestStep, &late, 0x20);
+
+	// follow the waits the scheduler asks for
+	for (int i = 0; i < 6; i++)
+	{
+		uint32_t wait = sched.Run();
+		REQUIRE(wait != SCHED_STOP);
+		FakeNow += wait;
+	}
+
+	REQUIRE(logLen == 6);
+	// fast at 0xFFFFFFFA, 0x05 and 0x10 (a tie, added first), late at 0x11,
+	// fast again at 0x1B
+	CHECK(log[0] == fast.id);
+	CHECK(log[1] == fast.id);
+	CHECK(log[2] == fast.id);
+	CHECK(log[3] == late.id);
+	CHECK(log[4] == fast.id);
+	CHECK(late.lastRun == 0x11);
+
+	SchedStats stats;
+	REQUIRE(sched.GetStats(fast.id, stats));
+	CHECK(stats.latencyMax == 0);
+	CHECK(stats.jitterMax == 0);
+	CHECK(stats.execMax == 1);
+	REQUIRE(sched.GetStats(late.id, stats));
+	CHECK(stats.runs == 1);
+	CHECK(stats.latencyMax == 1);
+}
@@ -0,0 +1,299 @@
+/*
+ * test_Telemetry.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Telemetry.h"
+#include "VarintCodec.h"
+#include "Profiler.h"
+
+TEST_CASE("Varint round trip and length", "[Telemetry]")
+{
+	const uint32_t values[] = {0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 0x1FFFFF, 0x200000,
+		0xFFFFFFF, 0x10000000, 0xFFFFFFFF};
+	const int lengths[] = {1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5};
+	uint8_t buf[VARINT_MAX_LEN];
+	uint32_t v;
+
+	for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+	{
+		int n = VarintPut(buf, values[i]);
+		CHECK(n == lengths[i]);
+		REQUIRE(VarintGet(buf, n, &v) == n);
+		CHECK(v == values[i]);
+
+		// cut short
+		CHECK(VarintGet(buf, n - 1, &v) == 0);
+	}
+
+	// no more than five bytes
+	memset(buf, 0x80, sizeof(buf));
+	CHECK(VarintGet(buf, sizeof(buf), &v) == 0);
+}
+
+TEST_CASE("ZigZag keeps small magnitudes small", "[Telemetry]")
+{
+	CHECK(ZigZagEncode(0) == 0);
+	CHECK(ZigZagEncode((uint32_t) -1) == 1);
+	CHECK(ZigZagEncode(1) == 2);
+	CHECK(ZigZagEncode((uint32_t) -2) == 3);
+	CHECK(ZigZagEncode(0x7FFFFFFF) == 0xFFFFFFFE);
+	CHECK(ZigZagEncode(0x80000000) == 0xFFFFFFFF);
+
+	const int32_t values[] = {0, 1, -1, 63, -64, 64, 1000000, -1000000, INT32_MAX, INT32_MIN};
+	for (int32_t value : values)
+		CHECK((int32_t) ZigZagDecode(ZigZagEncode((uint32_t) value)) == value);
+
+	// a difference that wrapped comes back
+	uint32_t a = 0x7FFFFFF0, b = 0x80000010;
+	uint32_t back = a + ZigZagDecode(ZigZagEncode(b - a));
+	CHECK(back == b);
+}
+
+TEST_CASE("CRC-16/CCITT check value", "[Telemetry]")
+{
+	const uint8_t check[] = "123456789";
+
+	CHECK(Crc16Ccitt(check, 9) == 0x29B1);
+	CHECK(Crc16Ccitt(check + 4, 5, Crc16Ccitt(check, 4)) == 0x29B1);
+	CHECK(Crc16Ccitt(check, 0) == 0xFFFF);
+}
+
+static TelemetrySample Sample(uint32_t time, int count, int32_t base)
+{
+	TelemetrySample sample;
+
+	sample.time = time;
+	sample.count = count;
+	for (int i = 0; i < count; i++)
+		sample.values[i] = base + i * 1000 - 5000;
+	return sample;
+}
+
+static bool Same(const TelemetrySample &a, const TelemetrySample &b)
+{
+	return a.time == b.time && a.count == b.count &&
+		memcmp(a.values, b.values, a.count * sizeof(a.values[0])) == 0;
+}
+
+TEST_CASE("Telemetry frames round trip", "[Telemetry]")
+{
+	TelemetryEncoder encoder;
+	TelemetryDecoder decoder;
+	TelemetrySample out;
+	uint8_t buf[TLM_MAX_FRAME];
+
+	for (int i = 0; i < 40; i++)
+	{
+		TelemetrySample in = Sample(1792310400 + 60 * i, TLM_FIELDS, (i & 1) ? -i : i * 7);
+		int len = encoder.Encode(in, buf, sizeof(buf));
+
+		REQUIRE(len > TLM_HEADER);
+		CHECK(buf[2] == (uint8_t) i);
+		// a key frame every TLM_KEY_INTERVAL frames
+		CHECK(((buf[1] & TLM_FLAG_KEY) != 0) == (i % TLM_KEY_INTERVAL == 0));
+		REQUIRE(decoder.Decode(buf, len, out) == TLM_OK);
+		REQUIRE(Same(in, out));
+	}
+
+	// a sample with another count is a key frame
+	TelemetrySample in = Sample(1792313000, 3, 12);
+	int len = encoder.Encode(in, buf, sizeof(buf));
+	CHECK((buf[1] & TLM_FLAG_KEY) != 0);
+	REQUIRE(decoder.Decode(buf, len, out) == TLM_OK);
+	REQUIRE(Same(in, out));
+
+	// extreme values and a time going back
+	TelemetrySample wide = Sample(100, 3, 0);
+	wide.values[0] = INT32_MIN;
+	wide.values[1] = INT32_MAX;
+	len = encoder.Encode(wide, buf, sizeof(buf));
+	CHECK((buf[1] & TLM_FLAG_KEY) == 0);
+	CHECK(len <= TLM_MAX_FRAME);
+	REQUIRE(decoder.Decode(buf, len, out) == TLM_OK);
+	REQUIRE(Same(wide, out));
+
+	// does not fit
+	CHECK(encoder.Encode(wide, buf, TLM_MAX_FRAME - 1) == 0);
+}
+
+TEST_CASE("Telemetry decoder refuses bad frames", "[Telemetry]")
+{
+	TelemetryEncoder encoder;
+	TelemetryDecoder decoder;
+	TelemetrySample out;
+	uint8_t key[TLM_MAX_FRAME], delta[TLM_MAX_FRAME], next[TLM_MAX_FRAME];
+
+	int keyLen = encoder.Encode(Sample(1000, 4, 1), key, sizeof(key));
+	int deltaLen = encoder.Encode(Sample(1060, 4, 2), delta, sizeof(delta));
+	int nextLen = encoder.Encode(Sample(1120, 4, 3), next, sizeof(next));
+
+	// a delta before any key frame
+	CHECK(decoder.Decode(delta, deltaLen, out) == TLM_ERR_BASE);
+
+	// damaged
+	key[4] ^= 0x01;
+	CHECK(decoder.Decode(key, keyLen, out) == TLM_ERR_CRC);
+	key[4] ^= 0x01;
+	CHECK(decoder.Decode(key, 4, out) == TLM_ERR_FORMAT);
+
+	REQUIRE(decoder.Decode(key, keyLen, out) == TLM_OK);
+
+	// the frame in between lost, the base stays gone until the next key frame
+	CHECK(decoder.Decode(next, nextLen, out) == TLM_ERR_BASE);
+	CHECK(decoder.Decode(delta, deltaLen, out) == TLM_ERR_BASE);
+
+	REQUIRE(decoder.Decode(key, keyLen, out) == TLM_OK);
+	REQUIRE(decoder.Decode(delta, deltaLen, out) == TLM_OK);
+	REQUIRE(decoder.Decode(next, nextLen, out) == TLM_OK);
+	REQUIRE(Same(out, Sample(1120, 4, 3)));
+
+	// another version, the CRC made to match
+	key[0] = TLM_VERSION + 1;
+	uint16_t crc = Crc16Ccitt(key, keyLen - 2);
+	key[keyLen - 2] = crc & 0xFF;
+	key[keyLen - 1] = crc >> 8;
+	CHECK(decoder.Decode(key, keyLen, out) == TLM_ERR_VERSION);
+}
+
+// the values of the station over a day, minute by minute: slow daily
+// swings with a little noise, the way the sensors report them
+static void StationSample(int minute, TelemetrySample &sample, uint32_t &noise)
+{
+	double day = 2 * M_PI * minute / 1440;
+
+	noise = noise * 1103515245 + 12345;
+	int jitter = (int) ((noise >> 16) % 5) - 2;
+
+	sample.time = 1792310400 + 60 * minute;
+	sample.count = TLM_FIELDS;
+	sample.values[TLM_BATTERY_VOLTAGE] = 3900 + (int) (150 * sin(day)) + jitter;
+	sample.values[TLM_BATTERY_CURRENT] = sin(day) > 0 ? 180 + jitter : -45 + jitter;
+	sample.values[TLM_STATE_OF_CHARGE] = 70 + (int) (20 * sin(day));
+	sample.values[TLM_REMAINING_CAPACITY] = 1400 + (int) (400 * sin(day));
+	sample.values[TLM_FULL_CAPACITY] = 2000;
+	sample.values[TLM_INPUT_VOLTAGE] = sin(day) > 0 ? 5100 + (int) (300 * sin(day)) + jitter : 0;
+	sample.values[TLM_BATTERY_TEMP] = 200 + (int) (60 * sin(day));
+	sample.values[TLM_BMP_TEMP] = 180 + (int) (80 * sin(day)) + jitter;
+	sample.values[TLM_BMP_PRESSURE] = 101325 + (int) (200 * sin(day / 2)) + 3 * jitter;
+	sample.values[TLM_DHT_TEMP] = 180 + (int) (80 * sin(day)) / 10 * 10;
+	sample.values[TLM_DHT_HUMIDITY] = 600 - (int) (200 * sin(day)) / 10 * 10;
+	sample.values[TLM_MCU_TEMP] = 250 + (int) (70 * sin(day)) + 2 * jitter;
+	sample.values[TLM_WIND_VOLTAGE] = 300 + (int) (250 * fabs(sin(7 * day))) + 10 * jitter;
+	sample.values[TLM_RAIN_VOLTAGE] = (minute > 600 && minute < 700) ? 800 + 20 * jitter : 0;
+}
+
+// The console report ReportTask printed for every reading before the binary
+// frames, format for format as in main.cpp of commit e796ba2^ (without the
+// scheduler statistics it added every STATS_PERIOD reports). The values come
+// back from the telemetry units, the shield's date and time from the sample
+// time; VDDA is no telemetry field and printed as 3300 mV.
+static int OldReport(char *buf, int size, const TelemetrySample &sample)
+{
+	const int32_t *v = sample.values;
+	float bmpTemp = v[TLM_BMP_TEMP] / 10.0f;
+	float dhtTemp = v[TLM_DHT_TEMP] / 10.0f;
+	float temperature = (float) v[TLM_BATTERY_TEMP] / 10;
+	int mcuTemp = v[TLM_MCU_TEMP];
+	time_t t = sample.time;
+	struct tm tm;
+	int n = 0;
+
+	gmtime_r(&t, &tm);
+
+	n += snprintf(buf + n, size - n, "Battery Voltage    = %f V\n", (float) v[TLM_BATTERY_VOLTAGE] / 1000.0);
+	n += snprintf(buf + n, size - n, "Battery Voltage    = %d.%03d V\n", v[TLM_BATTERY_VOLTAGE] / 1000,
+			v[TLM_BATTERY_VOLTAGE] % 1000);
+	n += snprintf(buf + n, size - n, "Battery Current    = %f V\n", (float) v[TLM_BATTERY_CURRENT] / 1000.0);
+	n += snprintf(buf + n, size - n, "Full Capacity      = %d mAh\n", v[TLM_FULL_CAPACITY]);
+	n += snprintf(buf + n, size - n, "Remaining Capacity = %d mAh\n", v[TLM_REMAINING_CAPACITY]);
+	n += snprintf(buf + n, size - n, "State of Charge    = %d %% \n", v[TLM_STATE_OF_CHARGE]);
+	n += snprintf(buf + n, size - n, "Input Voltage      = %f V\n", (float) v[TLM_INPUT_VOLTAGE] / 1000);
+	n += snprintf(buf + n, size - n, "Batt. Temp         = %f F\n", (temperature * 9.0 / 5.0) + 32.0);
+
+	n += snprintf(buf + n, size - n, "BMP180 Temp = %f C, %f F\n", bmpTemp, ((bmpTemp * 9.0) / 5) + 32);
+	n += snprintf(buf + n, size - n, "BMP180 Pressure = %f mbar\n", v[TLM_BMP_PRESSURE] / 100.0f);
+	n += snprintf(buf + n, size - n, "MCU Temp = %d.%d C, VDDA = %d mV\n", mcuTemp / 10, abs(mcuTemp % 10), 3300);
+	n += snprintf(buf + n, size - n, "Wind = %d mV, Rain = %d mV\n", v[TLM_WIND_VOLTAGE], v[TLM_RAIN_VOLTAGE]);
+	n += snprintf(buf + n, size - n, "DHT11 Temp = %f C, Humidity = %f %%\n", dhtTemp,
+			v[TLM_DHT_HUMIDITY] / 10.0f);
+
+	n += snprintf(buf + n, size - n, "\n\tTime:: %d:%d:%d \t Date:: %d-%d-%d\n", tm.tm_hour,
+			tm.tm_min, tm.tm_sec, tm.tm_mon + 1, tm.tm_mday, tm.tm_year % 100);
+	n += snprintf(buf + n, size - n, "\n\n\n");
+	return n;
+}
+
+TEST_CASE("Telemetry frames against the console report", "[Telemetry][bench]")
+{
+	static TelemetrySample day[1440];
+	TelemetryEncoder encoder;
+	TelemetryDecoder decoder;
+	TelemetrySample out;
+	uint8_t buf[TLM_MAX_FRAME];
+	char report[1024];
+	uint32_t noise = 1;
+	long frameBytes = 0, keyBytes = 0, reportBytes = 0;
+	int keys = 0;
+
+	for (int minute = 0; minute < 1440; minute++)
+	{
+		StationSample(minute, day[minute], noise);
+
+		int len = encoder.Encode(day[minute], buf, sizeof(buf));
+		REQUIRE(len > 0);
+		REQUIRE(decoder.Decode(buf, len, out) == TLM_OK);
+		REQUIRE(Same(day[minute], out));
+
+		frameBytes += len;
+		if (buf[1] & TLM_FLAG_KEY)
+		{
+			keyBytes += len;
+			keys++;
+		}
+		reportBytes += OldReport(report, sizeof(report), day[minute]);
+	}
+
+	// time of the encoding alone, and of the report it replaced
+	const int passes = 50;
+	long sum = 0;
+	uint32_t start = ProfNow();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (int minute = 0; minute < 1440; minute++)
+			sum += encoder.Encode(day[minute], buf, sizeof(buf));
+	}
+	uint32_t encodeNs = ProfNow() - start;
+
+	start = ProfNow();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (int minute = 0; minute < 1440; minute++)
+			sum += OldReport(report, sizeof(report), day[minute]);
+	}
+	uint32_t reportNs = ProfNow() - start;
+
+	double perFrame = frameBytes / 1440.0;
+	double perReport = reportBytes / 1440.0;
+	double encodeFrameNs = (double) encodeNs / (passes * 1440);
+	double reportFrameNs = (double) reportNs / (passes * 1440);
+	printf("telemetry: %.1f bytes and %.0f ns per frame (key frames %.1f bytes, %d of them); "
+		"the printf report: %.1f bytes and %.0f ns, %.1fx the bytes and %.1fx the time\n",
+		perFrame, encodeFrameNs, (double) keyBytes / keys, keys, perReport, reportFrameNs,
+		perReport / perFrame, reportFrameNs / encodeFrameNs);
+
+	CHECK(sum == passes * (frameBytes + reportBytes));
+	CHECK(keys == 1440 / TLM_KEY_INTERVAL);
+	CHECK(perFrame < 30);
+	double tenth = perReport / 10;
+	CHECK(perFrame < tenth);
+	CHECK(encodeFrameNs < reportFrameNs);
+}
@@ -0,0 +1,218 @@
+/*
+ * test_WiFiEspUdp.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <stdio.h>
+#include <string.h>
+#include "FakeEsp8266.h"
+#include "WiFiEsp.h"
+#include "WiFiEspUdp.h"
+#include "Profiler.h"
+
+// datagrams that fit the socket buffer and its packet records together
+#define UDP_BURST		8
+#define UDP_LEN			120
+
+static uint8_t DatagramByte(int packet, int n)
+{
+	return (uint8_t) (packet * 31 + n * 7);
+}
+
+// the module and the driver, without the reset and enable pins of init()
+struct UdpRig
+{
+	FakeUart 		uart;
+	FakeEsp8266 	esp;
+	WiFiEspClass 	wifi;
+	WiFiEspUDP 		udp;
+	int 			sock;
+
+	UdpRig() : esp(uart), wifi(NULL, 0, NULL, 0), udp(&wifi)
+	{
+		esp.Attach();
+		wifi.GetDrv()->wifiDriverInit(&uart.huart);
+
+		// the sockets are handed out from the top
+		sock = MAX_SOCK_NUM - 1;
+		udp.begin(123);
+
+		// from here the line moves with Burst() only, a chunk per poll
+		Fake.tickHook = NULL;
+	}
+
+	// a burst of datagrams, numbered from first
+	void Burst(int first, int count, int len)
+	{
+		uint8_t data[UDP_LEN];
+
+		for (int p = first; p < first + count; p++)
+		{
+			for (int i = 0; i < len; i++)
+				data[i] = DatagramByte(p, i);
+			esp.Ipd(sock, data, len);
+		}
+		while (esp.Pending())
+		{
+			esp.Step();
+			wifi.GetDrv()->poll();
+		}
+	}
+};
+
+// a line of Profiler::Dump()
+static void PrintProf(void *ctx, const char *line)
+{
+	printf("%s\n", line);
+}
+
+TEST_CASE("WiFiEspUDP reads stop at the packet boundaries", "[WiFiEspUdp]")
+{
+	FakeReset();
+	Fake.tickStep = 1;
+	UdpRig rig;
+	uint8_t buf[2 * UDP_LEN];
+
+	CHECK(strncmp(rig.esp.lastCmd, "AT+CIPSTART=", 12) == 0);
+
+	// no packet open
+	CHECK(rig.udp.read(buf, sizeof(buf)) == 0);
+	CHECK(rig.udp.read() == -1);
+	CHECK(rig.udp.parsePacket() == 0);
+
+	rig.Burst(0, 3, 50);
+
+	// a read larger than the packet ends at its end
+	REQUIRE(rig.udp.parsePacket() == 50);
+	CHECK(rig.udp.read(buf, sizeof(buf)) == 50);
+	CHECK(buf[49] == DatagramByte(0, 49));
+	CHECK(rig.udp.available() == 0);
+	CHECK(rig.udp.read(buf, sizeof(buf)) == 0);
+
+	// the rest of a packet left unread is skipped
+	REQUIRE(rig.udp.parsePacket() == 50);
+	CHECK(rig.udp.read() == DatagramByte(1, 0));
+	CHECK(rig.udp.peek() == DatagramByte(1, 1));
+	REQUIRE(rig.udp.parsePacket() == 50);
+	CHECK(rig.udp.read() == DatagramByte(2, 0));
+	rig.udp.flush();
+	CHECK(rig.udp.read(buf, sizeof(buf)) == 0);
+	CHECK(rig.udp.parsePacket() == 0);
+}
+
+TEST_CASE("WiFiEspUDP does not send a datagram cut short", "[WiFiEspUdp]")
+{
+	FakeReset();
+	Fake.tickStep = 1;
+	UdpRig rig;
+	static uint8_t big[UDP_TX_BUFFER_SIZE + 1];
+
+	// the module answers the sends
+	rig.esp.Attach();
+
+	REQUIRE(rig.udp.beginPacket("10.0.0.1", 4000) == 1);
+	CHECK(rig.udp.write(big, sizeof(big)) == UDP_TX_BUFFER_SIZE);
+	CHECK(rig.udp.getWriteError() != 0);
+	CHECK(rig.udp.endPacket() == 0);
+	CHECK(rig.esp.sends == 0);
+
+	// the next datagram starts without the error
+	REQUIRE(rig.udp.beginPacket("10.0.0.1", 4000) == 1);
+	CHECK(rig.udp.getWriteError() == 0);
+	CHECK(rig.udp.write((const uint8_t *) "ping", 4) == 4);
+	CHECK(rig.udp.endPacket() == 1);
+	CHECK(rig.esp.sends == 1);
+	REQUIRE(rig.esp.payloadBytes[rig.sock] == 4);
+	CHECK(memcmp(rig.esp.payload[rig.sock], "ping", 4) == 0);
+
+	// in a batch it counts as failed, the others go out
+	rig.udp.beginBatch();
+	REQUIRE(rig.udp.beginPacket("10.0.0.1", 4000) == 1);
+	rig.udp.write((const uint8_t *) "one", 3);
+	CHECK(rig.udp.endPacket() == 1);
+	REQUIRE(rig.udp.beginPacket("10.0.0.1", 4000) == 1);
+	rig.udp.write(big, sizeof(big));
+	CHECK(rig.udp.endPacket() == 0);
+	REQUIRE(rig.udp.beginPacket("10.0.0.1", 4000) == 1);
+	rig.udp.write((const uint8_t *) "two", 3);
+	CHECK(rig.udp.endPacket() == 1);
+	CHECK(rig.udp.endBatch() == 0);
+
+	CHECK(rig.esp.sends == 3);
+	REQUIRE(rig.esp.payloadBytes[rig.sock] == 10);
+	CHECK(memcmp(rig.esp.payload[rig.sock] + 4, "onetwo", 6) == 0);
+}
+
+TEST_CASE("WiFiEspUDP per byte and bulk reads", "[WiFiEspUdp][bench]")
+{
+	FakeReset();
+	Fake.tickStep = 1;
+	UdpRig rig;
+	const int rounds = 2000;
+	uint8_t buf[UDP_LEN];
+	uint32_t byteNs = 0, bulkNs = 0, spanNs = 0;
+	long bytes[3] = {};
+	int errors = 0;
+	Profiler::Reset();
+
+	// the datagrams come in untimed, only their reading is timed: read(),
+	// read(buf, size) and peekBuffer()/consume() take turns
+	for (int r = 0; r < rounds; r++)
+	{
+		rig.Burst(r * UDP_BURST, UDP_BURST, UDP_LEN);
+
+		int mode = r % 3;
+		uint32_t start = ProfNow();
+		for (int p = r * UDP_BURST; p < (r + 1) * UDP_BURST; p++)
+		{
+			int len = rig.udp.parsePacket();
+			int n = 0;
+
+			if (mode == 0)
+			{
+				int c;
+				while ((c = rig.udp.read()) >= 0)
+					buf[n++] = c;
+			}
+			else if (mode == 1)
+				n = rig.udp.read(buf, sizeof(buf));
+			else
+			{
+				const uint8_t *span;
+				int got;
+				while ((got = rig.udp.peekBuffer(&span)) > 0)
+				{
+					memcpy(buf + n, span, got);
+					rig.udp.consume(got);
+					n += got;
+				}
+			}
+
+			if (len != UDP_LEN || n != UDP_LEN || buf[UDP_LEN - 1] != DatagramByte(p, UDP_LEN - 1))
+				errors++;
+			bytes[mode] += n;
+		}
+		uint32_t ns = ProfNow() - start;
+
+		if (mode == 0)
+			byteNs += ns;
+		else if (mode == 1)
+			bulkNs += ns;
+		else
+			spanNs += ns;
+	}
+
+	double byteCost = (double) byteNs / bytes[0];
+	double bulkCost = (double) bulkNs / bytes[1];
+	printf("UDP reads of %d byte datagrams: read() %.1f MB/s, read(buf, size) %.1f MB/s "
+		"(%.1fx), peekBuffer() %.1f MB/s\n", UDP_LEN,
+		bytes[0] * 1e3 / byteNs, bytes[1] * 1e3 / bulkNs,
+		byteCost / bulkCost, bytes[2] * 1e3 / spanNs);
+	Profiler::Dump(PrintProf, NULL);
+
+	CHECK(errors == 0);
+	CHECK(bulkCost < byteCost);
+}
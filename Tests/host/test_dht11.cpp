@@ -0,0 +1,101 @@
+/*
+ * test_dht11.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Archer
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include "dht11.h"
+
+// capture of a DHT11 answering 47 %RH, 22.3 deg C: the release of the start
+// signal, the 80/80 us response, 40 bits with a few us of jitter and the
+// final fall; the 1 MHz counter wraps during the response
+static const uint16_t Capture[DHT_EDGES] =
+{
+	65380, 65411, 65491,    34,    88,   112,   161,   189,   238,   308,
+	  361,   385,   438,   507,   556,   624,   676,   747,   796,   865,
+	  914,   942,   994,  1018,  1073,  1101,  1150,  1175,  1229,  1258,
+	 1311,  1335,  1388,  1416,  1468,  1492,  1542,  1566,  1619,  1644,
+	 1695,  1722,  1772,  1844,  1893,  1921,  1972,  2044,  2099,  2172,
+	 2222,  2246,  2299,  2327,  2381,  2406,  2457,  2481,  2534,  2563,
+	 2612,  2640,  2689,  2717,  2767,  2838,  2892,  2964,  3016,  3042,
+	 3094,  3166,  3218,  3244,  3295,  3320,  3375,  3444,  3498,  3523,
+	 3572,  3600,  3651,  3679,  3731,
+};
+
+static const uint8_t Frame[5] = {47, 0, 22, 3, 72};
+
+// index in Capture of the rising edge of a bit
+#define RISE(bit)	(4 + 2 * (bit))
+
+// makes the pulse ending at edges[index] longer, the later edges move
+static void Stretch(uint16_t *edges, int index, int us)
+{
+	for (int i = index; i < DHT_EDGES; i++)
+		edges[i] += us;
+}
+
+TEST_CASE("DHT11 decodes a captured frame", "[DHT11]")
+{
+	uint8_t data[5];
+
+	REQUIRE(DHT11::Decode(Capture, DHT_EDGES, data) == DHT_OK);
+	CHECK(memcmp(data, Frame, 5) == 0);
+
+	// the capture started after the release
+	memset(data, 0, 5);
+	REQUIRE(DHT11::Decode(Capture + 1, DHT_EDGES - 1, data) == DHT_OK);
+	CHECK(memcmp(data, Frame, 5) == 0);
+
+	// the final fall is not needed either
+	REQUIRE(DHT11::Decode(Capture + 1, DHT_EDGES - 2, data) == DHT_OK);
+	CHECK(memcmp(data, Frame, 5) == 0);
+}
+
+TEST_CASE("DHT11 missing edges", "[DHT11]")
+{
+	uint8_t data[5];
+
+	REQUIRE(DHT11::Decode(Capture, 0, data) == DHT_ERR_TIMEOUT);
+	REQUIRE(DHT11::Decode(Capture, DHT_EDGES - 3, data) == DHT_ERR_TIMEOUT);
+
+	// enough edges, but the response is not among them
+	REQUIRE(DHT11::Decode(Capture + 2, DHT_EDGES - 2, data) == DHT_ERR_FRAME);
+}
+
+TEST_CASE("DHT11 frame errors", "[DHT11]")
+{
+	uint16_t edges[DHT_EDGES];
+	uint8_t data[5];
+
+	// response low of 140 us
+	memcpy(edges, Capture, sizeof(edges));
+	Stretch(edges, 2, 60);
+	REQUIRE(DHT11::Decode(edges, DHT_EDGES, data) == DHT_ERR_FRAME);
+
+	// a bit high for over 100 us
+	memcpy(edges, Capture, sizeof(edges));
+	Stretch(edges, RISE(10) + 1, 80);
+	REQUIRE(DHT11::Decode(edges, DHT_EDGES, data) == DHT_ERR_FRAME);
+
+	// a bit low for 20 us
+	memcpy(edges, Capture, sizeof(edges));
+	Stretch(edges, RISE(20), -30);
+	REQUIRE(DHT11::Decode(edges, DHT_EDGES, data) == DHT_ERR_FRAME);
+}
+
+TEST_CASE("DHT11 checksum", "[DHT11]")
+{
+	uint16_t edges[DHT_EDGES];
+	uint8_t data[5];
+
+	// the last bit of the checksum turns from 0 into 1
+	memcpy(edges, Capture, sizeof(edges));
+	int high = edges[RISE(39) + 1] - edges[RISE(39)];
+	REQUIRE(high < DHT_BIT_THRESHOLD);
+	Stretch(edges, RISE(39) + 1, 44);
+	REQUIRE(DHT11::Decode(edges, DHT_EDGES, data) == DHT_ERR_CHECKSUM);
+	CHECK(data[4] == 73);
+}
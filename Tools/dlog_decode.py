@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+#
+# dlog_decode.py
+#
+#  Created on: Oct 18, 2026
+#      Author: Archer
+#
+# Formats the binary deferred log records (Src/DLog) captured from the ITM
+# stimulus port 1, e.g. with an SWO viewer saving the raw port data.
+#
+#   dlog_decode.py [-t] Debug/Weather.elf capture.bin
+#
+# A record is: length, level, time in ms, address of the format string in the
+# .dlog section, then the arguments, 32 bit words and strings as a length byte
+# followed by the characters.
+
+import re
+import struct
+import sys
+
+HEADER = 10
+LEVELS = {1: 'E', 2: 'W', 3: 'I', 4: 'D'}
+SPEC = re.compile(r'%([-+ #0-9.]*)[lhzjt]*([diouxXcsfFeEgGp%])')
+
+
+def load_section(path, name):
+    with open(path, 'rb') as f:
+        elf = f.read()
+    if elf[:4] != b'\x7fELF':
+        sys.exit('%s is not an ELF file' % path)
+    is64 = elf[4] == 2
+    end = '<' if elf[5] == 1 else '>'
+    if is64:
+        shoff, = struct.unpack_from(end + 'Q', elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(end + 'HHH', elf, 0x3A)
+    else:
+        shoff, = struct.unpack_from(end + 'I', elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(end + 'HHH', elf, 0x2E)
+
+    def section(i):
+        base = shoff + i * shentsize
+        if is64:
+            sh_name, _, _, addr, off, size = struct.unpack_from(end + 'IIQQQQ', elf, base)
+        else:
+            sh_name, _, _, addr, off, size = struct.unpack_from(end + 'IIIIII', elf, base)
+        return sh_name, addr, off, size
+
+    _, _, stroff, _ = section(shstrndx)
+    for i in range(shnum):
+        sh_name, addr, off, size = section(i)
+        nend = elf.index(b'\0', stroff + sh_name)
+        if elf[stroff + sh_name:nend].decode() == name:
+            return addr, elf[off:off + size]
+    sys.exit('no %s section in %s' % (name, path))
+
+
+def format_record(fmt, args):
+    pos = 0
+    out = []
+    last = 0
+    for m in SPEC.finditer(fmt):
+        out.append(fmt[last:m.start()])
+        last = m.end()
+        flags, conv = m.groups()
+        if conv == '%':
+            out.append('%')
+            continue
+        if conv == 's':
+            n = args[pos] if pos < len(args) else 0
+            value = args[pos + 1:pos + 1 + n].decode('latin-1')
+            pos += 1 + n
+        else:
+            word, = struct.unpack_from('<I', args, pos) if pos + 4 <= len(args) else (0,)
+            pos += 4
+            if conv in 'fFeEgG':
+                value, = struct.unpack('<f', struct.pack('<I', word))
+            elif conv in 'di':
+                value = word - (1 << 32) if word & 0x80000000 else word
+                conv = 'd'
+            elif conv == 'p':
+                value, flags, conv = word, '#010', 'x'
+            elif conv == 'c':
+                value = chr(word & 0xFF)
+            else:
+                value = word
+                conv = 'd' if conv == 'u' else conv
+        out.append(('%' + flags + conv) % value)
+    out.append(fmt[last:])
+    return ''.join(out)
+
+
+def main():
+    args = sys.argv[1:]
+    stamp = '-t' in args
+    args = [a for a in args if a != '-t']
+    if len(args) != 2:
+        sys.exit('usage: dlog_decode.py [-t] firmware.elf capture.bin')
+
+    base, strings = load_section(args[0], '.dlog')
+    with open(args[1], 'rb') as f:
+        data = f.read()
+
+    pos = 0
+    while pos + HEADER <= len(data):
+        length, level, time, addr = struct.unpack_from('<BBII', data, pos)
+        # not a record start, the capture lost bytes: move on by one
+        if length < HEADER or level not in LEVELS or not base <= addr < base + len(strings):
+            pos += 1
+            continue
+        off = addr - base
+        fmt = strings[off:strings.index(b'\0', off)].decode('latin-1')
+        text = format_record(fmt, data[pos + HEADER:pos + length])
+        if stamp:
+            text = '[%7.3f %s] %s' % (time / 1000.0, LEVELS[level], text)
+        sys.stdout.write(text)
+        pos += length
+
+
+if __name__ == '__main__':
+    main()